@@ -0,0 +1,200 @@
+#include "audio_format.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+const AudioFormatKernels *audioFormatKernelsSse41();
+const AudioFormatKernels *audioFormatKernelsAvx2();
+#endif
+
+namespace {
+
+const int kBias = 0x84;
+const int kClip = 8159;
+
+// 段号: val 不超过 end[i] 的最小 i, 都不满足返回 8
+int segment(int val, const int16_t *end)
+{
+    for (int i = 0; i < 8; ++i) {
+        if (val <= end[i]) {
+            return i;
+        }
+    }
+    return 8;
+}
+
+const int16_t kUlawSegEnd[8] = {0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+const int16_t kAlawSegEnd[8] = {0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
+
+void ulawDecodeScalar(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        int u = ~src[i] & 0xFF;
+        int t = (((u & 0x0F) << 3) + kBias) << ((u & 0x70) >> 4);
+        dst[i] = static_cast<int16_t>((u & 0x80) ? (kBias - t) : (t - kBias));
+    }
+}
+
+void ulawEncodeScalar(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        int val = src[i] >> 2;
+        int mask = 0xFF;
+        if (val < 0) {
+            val = -val;
+            mask = 0x7F;
+        }
+        if (val > kClip) {
+            val = kClip;
+        }
+        val += kBias >> 2;
+        int seg = segment(val, kUlawSegEnd);
+        int u = seg >= 8 ? 0x7F : ((seg << 4) | ((val >> (seg + 1)) & 0x0F));
+        dst[i] = static_cast<uint8_t>(u ^ mask);
+    }
+}
+
+void alawDecodeScalar(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        int a = src[i] ^ 0x55;
+        int t = (a & 0x0F) << 4;
+        int seg = (a & 0x70) >> 4;
+        if (seg == 0) {
+            t += 8;
+        }
+        else {
+            t = (t + 0x108) << (seg - 1);
+        }
+        dst[i] = static_cast<int16_t>((a & 0x80) ? t : -t);
+    }
+}
+
+void alawEncodeScalar(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        int val = src[i] >> 3;
+        int mask = 0xD5;
+        if (val < 0) {
+            val = -val - 1;
+            mask = 0x55;
+        }
+        int seg = segment(val, kAlawSegEnd);
+        int a = 0x7F;
+        if (seg < 8) {
+            a = (seg << 4) | ((val >> (seg < 2 ? 1 : seg)) & 0x0F);
+        }
+        dst[i] = static_cast<uint8_t>(a ^ mask);
+    }
+}
+
+void s16ToFloatScalar(const int16_t *src, float *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = src[i] * (1.0f / 32768.0f);
+    }
+}
+
+void floatToS16Scalar(const float *src, int16_t *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        float v = src[i] * 32768.0f;
+        if (!(v >= -32768.0f)) {
+            v = -32768.0f;
+        }
+        if (v > 32767.0f) {
+            v = 32767.0f;
+        }
+        dst[i] = static_cast<int16_t>(std::lrint(v));
+    }
+}
+
+void byteSwap16Scalar(const int16_t *src, int16_t *dst, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        uint16_t v = static_cast<uint16_t>(src[i]);
+        dst[i] = static_cast<int16_t>(static_cast<uint16_t>((v << 8) | (v >> 8)));
+    }
+}
+
+const AudioFormatKernels kScalarKernels = {
+    "scalar",
+    ulawDecodeScalar,
+    ulawEncodeScalar,
+    alawDecodeScalar,
+    alawEncodeScalar,
+    s16ToFloatScalar,
+    floatToS16Scalar,
+    byteSwap16Scalar,
+};
+
+const AudioFormatKernels &selectKernels()
+{
+    const AudioFormatKernels *k = audioFormatKernels(kIsaAvx2);
+    if (!k) {
+        k = audioFormatKernels(kIsaSse41);
+    }
+    return k ? *k : kScalarKernels;
+}
+
+} // namespace
+
+const AudioFormatKernels *audioFormatKernels(AudioIsa isa)
+{
+    switch (isa) {
+        case kIsaScalar: {
+            return &kScalarKernels;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        case kIsaSse41: {
+            return __builtin_cpu_supports("sse4.1") ? audioFormatKernelsSse41() : nullptr;
+        }
+        case kIsaAvx2: {
+            return __builtin_cpu_supports("avx2") ? audioFormatKernelsAvx2() : nullptr;
+        }
+#endif
+        default: {
+            return nullptr;
+        }
+    }
+}
+
+const AudioFormatKernels &audioFormatKernels()
+{
+    static const AudioFormatKernels &kernels = selectKernels();
+    return kernels;
+}
+
+void ulawDecode(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    audioFormatKernels().ulaw_decode(src, dst, n);
+}
+
+void ulawEncode(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    audioFormatKernels().ulaw_encode(src, dst, n);
+}
+
+void alawDecode(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    audioFormatKernels().alaw_decode(src, dst, n);
+}
+
+void alawEncode(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    audioFormatKernels().alaw_encode(src, dst, n);
+}
+
+void s16ToFloat(const int16_t *src, float *dst, std::size_t n)
+{
+    audioFormatKernels().s16_to_float(src, dst, n);
+}
+
+void floatToS16(const float *src, int16_t *dst, std::size_t n)
+{
+    audioFormatKernels().float_to_s16(src, dst, n);
+}
+
+void byteSwap16(const int16_t *src, int16_t *dst, std::size_t n)
+{
+    audioFormatKernels().byte_swap16(src, dst, n);
+}
@@ -0,0 +1,53 @@
+#ifndef _AUDIO_FORMAT_H_
+#define _AUDIO_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief G.711 (μ-law / A-law) 与 PCM 格式转换
+ *
+ * 接口按块处理 n 个采样, 首次调用时按 CPU 特性选择 AVX2 / SSE4.1 / 标量实现,
+ * 各实现的输出逐位一致 (与 ITU-T G.711 参考实现相同)
+ */
+
+// μ-law 字节 -> 线性 PCM16
+void ulawDecode(const uint8_t *src, int16_t *dst, std::size_t n);
+// 线性 PCM16 -> μ-law 字节
+void ulawEncode(const int16_t *src, uint8_t *dst, std::size_t n);
+// A-law 字节 -> 线性 PCM16
+void alawDecode(const uint8_t *src, int16_t *dst, std::size_t n);
+// 线性 PCM16 -> A-law 字节
+void alawEncode(const int16_t *src, uint8_t *dst, std::size_t n);
+
+// PCM16 -> float [-1, 1)
+void s16ToFloat(const int16_t *src, float *dst, std::size_t n);
+// float -> PCM16, 超出范围饱和, 就近取偶舍入, NaN 视为 -1
+void floatToS16(const float *src, int16_t *dst, std::size_t n);
+
+// PCM16 大小端互换 (s16le <-> s16be), src 与 dst 可相同
+void byteSwap16(const int16_t *src, int16_t *dst, std::size_t n);
+
+enum AudioIsa {
+    kIsaScalar,
+    kIsaSse41,
+    kIsaAvx2,
+};
+
+struct AudioFormatKernels {
+    const char *name;
+    void (*ulaw_decode)(const uint8_t *, int16_t *, std::size_t);
+    void (*ulaw_encode)(const int16_t *, uint8_t *, std::size_t);
+    void (*alaw_decode)(const uint8_t *, int16_t *, std::size_t);
+    void (*alaw_encode)(const int16_t *, uint8_t *, std::size_t);
+    void (*s16_to_float)(const int16_t *, float *, std::size_t);
+    void (*float_to_s16)(const float *, int16_t *, std::size_t);
+    void (*byte_swap16)(const int16_t *, int16_t *, std::size_t);
+};
+
+// 指定实现, 当前 CPU 或编译目标不支持时返回 nullptr (kIsaScalar 总是可用)
+const AudioFormatKernels *audioFormatKernels(AudioIsa isa);
+// 当前进程选中的实现
+const AudioFormatKernels &audioFormatKernels();
+
+#endif // _AUDIO_FORMAT_H_
@@ -0,0 +1,341 @@
+#include "audio_format.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// 每个函数用 target 属性单独开启指令集, 避免整个文件带 -mavx2 编译后
+// 内联函数被链接器选中, 在不支持的 CPU 上执行到 AVX2 指令
+
+#define AUDIO_SSE41 __attribute__((target("sse4.1")))
+#define AUDIO_AVX2 __attribute__((target("avx2")))
+
+namespace {
+
+const AudioFormatKernels &scalar()
+{
+    return *audioFormatKernels(kIsaScalar);
+}
+
+/*
+ * 编码时的段号/尾数通过 int -> float 转换得到:
+ * float(v) 的指数即最高位位置, 尾数字段最高 4 位正好是最高位之后的 4 位,
+ * 省掉了按段号的可变移位
+ */
+
+AUDIO_SSE41 __m128i ulawEncode4(__m128i x)
+{
+    __m128i v = _mm_srai_epi32(x, 2);
+    __m128i neg = _mm_cmplt_epi32(v, _mm_setzero_si128());
+    v = _mm_min_epi32(_mm_abs_epi32(v), _mm_set1_epi32(8159));
+    v = _mm_add_epi32(v, _mm_set1_epi32(0x21));
+    __m128i f = _mm_castps_si128(_mm_cvtepi32_ps(v));
+    __m128i seg = _mm_sub_epi32(_mm_srli_epi32(f, 23), _mm_set1_epi32(127 + 5));
+    __m128i mant = _mm_and_si128(_mm_srli_epi32(f, 19), _mm_set1_epi32(0x0F));
+    __m128i u = _mm_or_si128(_mm_slli_epi32(seg, 4), mant);
+    u = _mm_min_epi32(u, _mm_set1_epi32(0x7F));
+    __m128i mask = _mm_blendv_epi8(_mm_set1_epi32(0xFF), _mm_set1_epi32(0x7F), neg);
+    return _mm_xor_si128(u, mask);
+}
+
+AUDIO_SSE41 __m128i alawEncode4(__m128i x)
+{
+    __m128i v = _mm_srai_epi32(x, 3);
+    __m128i neg = _mm_cmplt_epi32(v, _mm_setzero_si128());
+    v = _mm_xor_si128(v, neg);
+    __m128i small = _mm_cmplt_epi32(v, _mm_set1_epi32(32));
+    __m128i f = _mm_castps_si128(_mm_cvtepi32_ps(v));
+    __m128i seg = _mm_sub_epi32(_mm_srli_epi32(f, 23), _mm_set1_epi32(127 + 4));
+    __m128i mant = _mm_and_si128(_mm_srli_epi32(f, 19), _mm_set1_epi32(0x0F));
+    __m128i a = _mm_or_si128(_mm_slli_epi32(seg, 4), mant);
+    a = _mm_blendv_epi8(a, _mm_srli_epi32(v, 1), small);
+    __m128i mask = _mm_blendv_epi8(_mm_set1_epi32(0xD5), _mm_set1_epi32(0x55), neg);
+    return _mm_xor_si128(a, mask);
+}
+
+AUDIO_SSE41 void ulawDecodeSse41(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    const __m128i pow2 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i u = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+        u = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+        // 高字节索引置 0x80, pshufb 得到零扩展的 16 位 2^exp
+        __m128i exp = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi16(0x07)),
+                                   _mm_set1_epi16((short)0x8000));
+        __m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0x0F)), 3),
+                                  _mm_set1_epi16(0x84));
+        t = _mm_sub_epi16(_mm_mullo_epi16(t, _mm_shuffle_epi8(pow2, exp)), _mm_set1_epi16(0x84));
+        __m128i sign = _mm_cmpgt_epi16(u, _mm_set1_epi16(0x7F));
+        // sign ? -t : t
+        t = _mm_sub_epi16(_mm_xor_si128(t, sign), sign);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), t);
+    }
+    scalar().ulaw_decode(src + i, dst + i, n - i);
+}
+
+AUDIO_SSE41 void ulawEncodeSse41(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i lo = ulawEncode4(_mm_cvtepi16_epi32(x));
+        __m128i hi = ulawEncode4(_mm_cvtepi16_epi32(_mm_srli_si128(x, 8)));
+        __m128i u = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), u);
+    }
+    scalar().ulaw_encode(src + i, dst + i, n - i);
+}
+
+AUDIO_SSE41 void alawDecodeSse41(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    const __m128i pow2 = _mm_setr_epi8(1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+        a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+        __m128i seg = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(0x07));
+        __m128i seg0 = _mm_cmpeq_epi16(seg, _mm_setzero_si128());
+        __m128i bias = _mm_blendv_epi8(_mm_set1_epi16(0x108), _mm_set1_epi16(8), seg0);
+        __m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x0F)), 4), bias);
+        t = _mm_mullo_epi16(t, _mm_shuffle_epi8(pow2, _mm_or_si128(seg, _mm_set1_epi16((short)0x8000))));
+        __m128i pos = _mm_cmpgt_epi16(a, _mm_set1_epi16(0x7F));
+        __m128i neg = _mm_xor_si128(pos, _mm_set1_epi16(-1));
+        t = _mm_sub_epi16(_mm_xor_si128(t, neg), neg);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), t);
+    }
+    scalar().alaw_decode(src + i, dst + i, n - i);
+}
+
+AUDIO_SSE41 void alawEncodeSse41(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i lo = alawEncode4(_mm_cvtepi16_epi32(x));
+        __m128i hi = alawEncode4(_mm_cvtepi16_epi32(_mm_srli_si128(x, 8)));
+        __m128i a = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), a);
+    }
+    scalar().alaw_encode(src + i, dst + i, n - i);
+}
+
+AUDIO_SSE41 void s16ToFloatSse41(const int16_t *src, float *dst, std::size_t n)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(x));
+        __m128 hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(x, 8)));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(lo, scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(hi, scale));
+    }
+    scalar().s16_to_float(src + i, dst + i, n - i);
+}
+
+AUDIO_SSE41 void floatToS16Sse41(const float *src, int16_t *dst, std::size_t n)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo_clip = _mm_set1_ps(-32768.0f);
+    const __m128 hi_clip = _mm_set1_ps(32767.0f);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // max_ps 在任一操作数为 NaN 时返回第二个操作数, 与标量实现一致
+        __m128 lo = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo_clip), hi_clip);
+        __m128 hi = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo_clip), hi_clip);
+        __m128i s = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s);
+    }
+    scalar().float_to_s16(src + i, dst + i, n - i);
+}
+
+AUDIO_SSE41 void byteSwap16Sse41(const int16_t *src, int16_t *dst, std::size_t n)
+{
+    const __m128i shuf = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(x, shuf));
+    }
+    scalar().byte_swap16(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 __m256i ulawEncode8(__m256i x)
+{
+    __m256i v = _mm256_srai_epi32(x, 2);
+    __m256i neg = _mm256_cmpgt_epi32(_mm256_setzero_si256(), v);
+    v = _mm256_min_epi32(_mm256_abs_epi32(v), _mm256_set1_epi32(8159));
+    v = _mm256_add_epi32(v, _mm256_set1_epi32(0x21));
+    __m256i f = _mm256_castps_si256(_mm256_cvtepi32_ps(v));
+    __m256i seg = _mm256_sub_epi32(_mm256_srli_epi32(f, 23), _mm256_set1_epi32(127 + 5));
+    __m256i mant = _mm256_and_si256(_mm256_srli_epi32(f, 19), _mm256_set1_epi32(0x0F));
+    __m256i u = _mm256_or_si256(_mm256_slli_epi32(seg, 4), mant);
+    u = _mm256_min_epi32(u, _mm256_set1_epi32(0x7F));
+    __m256i mask = _mm256_blendv_epi8(_mm256_set1_epi32(0xFF), _mm256_set1_epi32(0x7F), neg);
+    return _mm256_xor_si256(u, mask);
+}
+
+AUDIO_AVX2 __m256i alawEncode8(__m256i x)
+{
+    __m256i v = _mm256_srai_epi32(x, 3);
+    __m256i neg = _mm256_cmpgt_epi32(_mm256_setzero_si256(), v);
+    v = _mm256_xor_si256(v, neg);
+    __m256i small = _mm256_cmpgt_epi32(_mm256_set1_epi32(32), v);
+    __m256i f = _mm256_castps_si256(_mm256_cvtepi32_ps(v));
+    __m256i seg = _mm256_sub_epi32(_mm256_srli_epi32(f, 23), _mm256_set1_epi32(127 + 4));
+    __m256i mant = _mm256_and_si256(_mm256_srli_epi32(f, 19), _mm256_set1_epi32(0x0F));
+    __m256i a = _mm256_or_si256(_mm256_slli_epi32(seg, 4), mant);
+    a = _mm256_blendv_epi8(a, _mm256_srli_epi32(v, 1), small);
+    __m256i mask = _mm256_blendv_epi8(_mm256_set1_epi32(0xD5), _mm256_set1_epi32(0x55), neg);
+    return _mm256_xor_si256(a, mask);
+}
+
+// 16 个 int32 -> 16 个字节 (packs 按 128 位通道交错, 需要 permute 还原顺序)
+AUDIO_AVX2 __m128i packBytes16(__m256i lo, __m256i hi)
+{
+    __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+    return _mm_packus_epi16(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+AUDIO_AVX2 void ulawDecodeAvx2(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    const __m256i pow2 = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i u = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        u = _mm256_xor_si256(u, _mm256_set1_epi16(0xFF));
+        __m256i exp = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(u, 4), _mm256_set1_epi16(0x07)),
+                                      _mm256_set1_epi16((short)0x8000));
+        __m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x0F)), 3),
+                                     _mm256_set1_epi16(0x84));
+        t = _mm256_sub_epi16(_mm256_mullo_epi16(t, _mm256_shuffle_epi8(pow2, exp)), _mm256_set1_epi16(0x84));
+        __m256i sign = _mm256_cmpgt_epi16(u, _mm256_set1_epi16(0x7F));
+        t = _mm256_sub_epi16(_mm256_xor_si256(t, sign), sign);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), t);
+    }
+    scalar().ulaw_decode(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 void ulawEncodeAvx2(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i lo = ulawEncode8(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+        __m256i hi = ulawEncode8(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packBytes16(lo, hi));
+    }
+    scalar().ulaw_encode(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 void alawDecodeAvx2(const uint8_t *src, int16_t *dst, std::size_t n)
+{
+    const __m256i pow2 = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        a = _mm256_xor_si256(a, _mm256_set1_epi16(0x55));
+        __m256i seg = _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi16(0x07));
+        __m256i seg0 = _mm256_cmpeq_epi16(seg, _mm256_setzero_si256());
+        __m256i bias = _mm256_blendv_epi8(_mm256_set1_epi16(0x108), _mm256_set1_epi16(8), seg0);
+        __m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x0F)), 4), bias);
+        t = _mm256_mullo_epi16(t, _mm256_shuffle_epi8(pow2, _mm256_or_si256(seg, _mm256_set1_epi16((short)0x8000))));
+        __m256i pos = _mm256_cmpgt_epi16(a, _mm256_set1_epi16(0x7F));
+        __m256i neg = _mm256_xor_si256(pos, _mm256_set1_epi16(-1));
+        t = _mm256_sub_epi16(_mm256_xor_si256(t, neg), neg);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), t);
+    }
+    scalar().alaw_decode(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 void alawEncodeAvx2(const int16_t *src, uint8_t *dst, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i lo = alawEncode8(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+        __m256i hi = alawEncode8(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packBytes16(lo, hi));
+    }
+    scalar().alaw_encode(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 void s16ToFloatAvx2(const int16_t *src, float *dst, std::size_t n)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(lo, scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(hi, scale));
+    }
+    scalar().s16_to_float(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 void floatToS16Avx2(const float *src, int16_t *dst, std::size_t n)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 lo_clip = _mm256_set1_ps(-32768.0f);
+    const __m256 hi_clip = _mm256_set1_ps(32767.0f);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 lo = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo_clip), hi_clip);
+        __m256 hi = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo_clip), hi_clip);
+        __m256i s = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(s, 0xD8));
+    }
+    scalar().float_to_s16(src + i, dst + i, n - i);
+}
+
+AUDIO_AVX2 void byteSwap16Avx2(const int16_t *src, int16_t *dst, std::size_t n)
+{
+    const __m256i shuf = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(x, shuf));
+    }
+    scalar().byte_swap16(src + i, dst + i, n - i);
+}
+
+const AudioFormatKernels kSse41Kernels = {
+    "sse4.1",
+    ulawDecodeSse41,
+    ulawEncodeSse41,
+    alawDecodeSse41,
+    alawEncodeSse41,
+    s16ToFloatSse41,
+    floatToS16Sse41,
+    byteSwap16Sse41,
+};
+
+const AudioFormatKernels kAvx2Kernels = {
+    "avx2",
+    ulawDecodeAvx2,
+    ulawEncodeAvx2,
+    alawDecodeAvx2,
+    alawEncodeAvx2,
+    s16ToFloatAvx2,
+    floatToS16Avx2,
+    byteSwap16Avx2,
+};
+
+} // namespace
+
+const AudioFormatKernels *audioFormatKernelsSse41()
+{
+    return &kSse41Kernels;
+}
+
+const AudioFormatKernels *audioFormatKernelsAvx2()
+{
+    return &kAvx2Kernels;
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include "audio_format.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+ * 各 SIMD 实现与标量实现逐位比较:
+ * 编码 / s16ToFloat / byteSwap16 覆盖全部 65536 个 int16 输入, 解码覆盖全部 256 个码字,
+ * floatToS16 覆盖每个 int16 附近的值、半整数、越界、Inf / NaN 和随机位模式;
+ * 每组输入再按不同的起始偏移和长度切块调用, 覆盖不对齐的首尾
+ */
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *isa, const char *what, std::size_t offset, std::size_t n)
+{
+    if (!ok) {
+        std::printf("FAIL %s %s offset %zu n %zu\n", isa, what, offset, n);
+        ++g_failures;
+    }
+}
+
+// 分块调用 fn(src + offset, dst + offset, n), 块长从 0 到 70 循环, 覆盖各种向量宽度的尾部
+template <typename Src, typename Dst, typename Fn>
+static void run_chunked(Fn fn, const std::vector<Src> &src, std::vector<Dst> &dst)
+{
+    std::size_t offset = 0;
+    std::size_t len = 0;
+    while (offset < src.size()) {
+        std::size_t n = std::min(len, src.size() - offset);
+        fn(src.data() + offset, dst.data() + offset, n);
+        offset += n;
+        len = len == 70 ? 1 : len + 1;
+    }
+}
+
+template <typename Src, typename Dst>
+static void compare(const char *isa,
+                    const char *what,
+                    void (*scalar)(const Src *, Dst *, std::size_t),
+                    void (*simd)(const Src *, Dst *, std::size_t),
+                    const std::vector<Src> &src)
+{
+    std::vector<Dst> expected(src.size());
+    scalar(src.data(), expected.data(), src.size());
+
+    // 整块调用
+    std::vector<Dst> got(src.size());
+    simd(src.data(), got.data(), src.size());
+    check(std::memcmp(got.data(), expected.data(), got.size() * sizeof(Dst)) == 0, isa, what, 0, src.size());
+
+    // 分块调用
+    std::vector<Dst> chunked(src.size());
+    run_chunked(simd, src, chunked);
+    check(std::memcmp(chunked.data(), expected.data(), chunked.size() * sizeof(Dst)) == 0, isa, what, 0, 0);
+
+    // 从每个不对齐的起始偏移转换剩下的全部输入
+    for (std::size_t offset = 1; offset < 64 && offset < src.size(); ++offset) {
+        std::size_t n = src.size() - offset;
+        std::vector<Dst> part(n);
+        simd(src.data() + offset, part.data(), n);
+        check(std::memcmp(part.data(), expected.data() + offset, n * sizeof(Dst)) == 0, isa, what, offset, n);
+    }
+}
+
+static std::vector<float> float_inputs()
+{
+    std::vector<float> in;
+    for (int v = -32768; v <= 32767; ++v) {
+        float x = static_cast<float>(v) / 32768.0f;
+        in.push_back(x);
+        // 相邻的可表示值和半个量化步长, 检查舍入
+        in.push_back(std::nextafter(x, 2.0f));
+        in.push_back(std::nextafter(x, -2.0f));
+        in.push_back((static_cast<float>(v) + 0.5f) / 32768.0f);
+    }
+    const float specials[] = {
+        1.0f, -1.0f, 1.5f, -1.5f, 2.0f, -2.0f, 1e10f, -1e10f, 0.0f, -0.0f,
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::denorm_min(), std::numeric_limits<float>::max(),
+        std::numeric_limits<float>::lowest(),
+    };
+    in.insert(in.end(), std::begin(specials), std::end(specials));
+    std::mt19937 rng(12345);
+    for (int i = 0; i < (1 << 20); ++i) {
+        uint32_t bits = rng();
+        float x;
+        std::memcpy(&x, &bits, sizeof(x));
+        in.push_back(x);
+    }
+    return in;
+}
+
+// 标量实现按 ITU-T G.711 参考实现的几个已知码字
+static void check_reference()
+{
+    const uint8_t codes[] = {0x00, 0x7F, 0x80, 0xFF, 0x55, 0xD5};
+    int16_t ulaw[6];
+    int16_t alaw[6];
+    const AudioFormatKernels *scalar = audioFormatKernels(kIsaScalar);
+    scalar->ulaw_decode(codes, ulaw, 6);
+    scalar->alaw_decode(codes, alaw, 6);
+    const int16_t ulaw_expected[] = {-32124, 0, 32124, 0, -716, 716};
+    const int16_t alaw_expected[] = {-5504, -848, 5504, 848, -8, 8};
+    check(std::memcmp(ulaw, ulaw_expected, sizeof(ulaw)) == 0, "scalar", "ulaw reference", 0, 6);
+    check(std::memcmp(alaw, alaw_expected, sizeof(alaw)) == 0, "scalar", "alaw reference", 0, 6);
+}
+
+int main()
+{
+    check_reference();
+
+    std::vector<int16_t> s16(65536);
+    for (std::size_t i = 0; i < s16.size(); ++i) {
+        s16[i] = static_cast<int16_t>(static_cast<uint16_t>(i));
+    }
+    // 全部码字重复几遍, 长度足够跑满向量循环
+    std::vector<uint8_t> codes(256 * 9);
+    for (std::size_t i = 0; i < codes.size(); ++i) {
+        codes[i] = static_cast<uint8_t>(i);
+    }
+    std::vector<float> floats = float_inputs();
+
+    const AudioFormatKernels *scalar = audioFormatKernels(kIsaScalar);
+    const AudioIsa isas[] = {kIsaSse41, kIsaAvx2};
+    for (AudioIsa isa : isas) {
+        const AudioFormatKernels *k = audioFormatKernels(isa);
+        if (!k) {
+            std::printf("skip isa %d: not supported on this CPU\n", static_cast<int>(isa));
+            continue;
+        }
+        compare(k->name, "ulaw_decode", scalar->ulaw_decode, k->ulaw_decode, codes);
+        compare(k->name, "alaw_decode", scalar->alaw_decode, k->alaw_decode, codes);
+        compare(k->name, "ulaw_encode", scalar->ulaw_encode, k->ulaw_encode, s16);
+        compare(k->name, "alaw_encode", scalar->alaw_encode, k->alaw_encode, s16);
+        compare(k->name, "s16_to_float", scalar->s16_to_float, k->s16_to_float, s16);
+        compare(k->name, "float_to_s16", scalar->float_to_s16, k->float_to_s16, floats);
+        compare(k->name, "byte_swap16", scalar->byte_swap16, k->byte_swap16, s16);
+        std::printf("%s: checked\n", k->name);
+    }
+
+    // byteSwap16 允许原地转换
+    std::vector<int16_t> in_place(s16);
+    audioFormatKernels().byte_swap16(in_place.data(), in_place.data(), in_place.size());
+    std::vector<int16_t> swapped(s16.size());
+    scalar->byte_swap16(s16.data(), swapped.data(), s16.size());
+    check(in_place == swapped, audioFormatKernels().name, "byte_swap16 in place", 0, s16.size());
+
+    if (g_failures) {
+        std::printf("%d failures\n", g_failures);
+        return 1;
+    }
+    std::printf("all kernels bit-exact\n");
+    return 0;
+}
@@ -1 +1,125 @@
-#include "rtp_session_impl.h"
\ No newline at end of file
+#include "rtp_session_impl.h"
+#include <jrtplib3/rtcpsrpacket.h>
+#include <jrtplib3/rtcprrpacket.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstring>
+
+RtpSessionImpl::RtpSessionImpl(uint32_t clock_rate) :
+    m_stats(256, clock_rate),
+    m_addresses(m_stats.capacity()),
+    m_address_ssrc(m_stats.capacity(), 0)
+{
+}
+
+RtpSessionImpl::~RtpSessionImpl()
+{
+}
+
+void RtpSessionImpl::OnRTPPacket(jrtplib::RTPPacket *pack, const jrtplib::RTPTime &receivetime, const jrtplib::RTPAddress *senderaddress)
+{
+    bool is_new = false;
+    int index = m_stats.onRtp(pack->GetSSRC(),
+                              pack->GetSequenceNumber(),
+                              pack->GetTimestamp(),
+                              receivetime.GetDouble(),
+                              is_new);
+    // 地址类型只在第一次见到这个源时解析
+    if (is_new && senderaddress) {
+        cacheAddress(index, pack->GetSSRC(), senderaddress);
+    }
+}
+
+void RtpSessionImpl::OnRTCPCompoundPacket(jrtplib::RTCPCompoundPacket *pack, const jrtplib::RTPTime &receivetime, const jrtplib::RTPAddress * /*senderaddress*/)
+{
+    // 到达时间的 NTP 中间 32 位, 与 LSR / DLSR 同单位
+    jrtplib::RTPNTPTime ntp = receivetime.GetNTPTime();
+    uint32_t arrival = ((ntp.GetMSW() & 0xFFFF) << 16) | (ntp.GetLSW() >> 16);
+    uint32_t local_ssrc = GetLocalSSRC();
+
+    pack->GotoFirstPacket();
+    jrtplib::RTCPPacket *rtcp;
+    while ((rtcp = pack->GetNextPacket()) != nullptr) {
+        if (!rtcp->IsKnownFormat()) {
+            continue;
+        }
+        if (rtcp->GetPacketType() == jrtplib::RTCPPacket::SR) {
+            auto *sr = static_cast<jrtplib::RTCPSRPacket *>(rtcp);
+            for (int i = 0; i < sr->GetReceptionReportCount(); ++i) {
+                if (sr->GetSSRC(i) == local_ssrc) {
+                    double rtt = RtpStatsTable::rttFromReport(arrival, sr->GetLSR(i), sr->GetDLSR(i));
+                    if (rtt >= 0) {
+                        m_stats.onRtt(sr->GetSenderSSRC(), rtt);
+                    }
+                }
+            }
+        }
+        else if (rtcp->GetPacketType() == jrtplib::RTCPPacket::RR) {
+            auto *rr = static_cast<jrtplib::RTCPRRPacket *>(rtcp);
+            for (int i = 0; i < rr->GetReceptionReportCount(); ++i) {
+                if (rr->GetSSRC(i) == local_ssrc) {
+                    double rtt = RtpStatsTable::rttFromReport(arrival, rr->GetLSR(i), rr->GetDLSR(i));
+                    if (rtt >= 0) {
+                        m_stats.onRtt(rr->GetSenderSSRC(), rtt);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void RtpSessionImpl::OnBYEPacket(jrtplib::RTPSourceData *srcdat)
+{
+    m_stats.remove(srcdat->GetSSRC());
+}
+
+bool RtpSessionImpl::getAddress(uint32_t ssrc, SourceAddress &address)
+{
+    std::lock_guard<std::mutex> lock(m_addr_mtx);
+    for (std::size_t i = 0; i < m_address_ssrc.size(); ++i) {
+        if (m_address_ssrc[i] == ssrc && m_addresses[i].ip_len) {
+            address = m_addresses[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void RtpSessionImpl::cacheAddress(int index, uint32_t ssrc, const jrtplib::RTPAddress *senderaddress)
+{
+    SourceAddress address;
+    std::memset(&address, 0, sizeof(address));
+    address.type = senderaddress->GetAddressType();
+    switch (address.type) {
+        case jrtplib::RTPAddress::IPv4Address: {
+            auto *ipv4 = static_cast<const jrtplib::RTPIPv4Address *>(senderaddress);
+            uint32_t ip = htonl(ipv4->GetIP());
+            std::memcpy(address.ip, &ip, 4);
+            address.ip_len = 4;
+            address.port = ipv4->GetPort();
+            address.rtcp_port = ipv4->GetRTCPSendPort();
+            break;
+        }
+        case jrtplib::RTPAddress::IPv6Address: {
+            auto *ipv6 = static_cast<const jrtplib::RTPIPv6Address *>(senderaddress);
+            in6_addr ip = ipv6->GetIP();
+            std::memcpy(address.ip, &ip, 16);
+            address.ip_len = 16;
+            address.port = ipv6->GetPort();
+            break;
+        }
+        case jrtplib::RTPAddress::ByteAddress: {
+            auto *bytes = static_cast<const jrtplib::RTPByteAddress *>(senderaddress);
+            address.ip_len = std::min<std::size_t>(bytes->GetHostAddressLength(), sizeof(address.ip));
+            std::memcpy(address.ip, bytes->GetHostAddress(), address.ip_len);
+            address.port = bytes->GetPort();
+            break;
+        }
+        default:
+            // UserDefinedAddress / TCPAddress 没有可缓存的 IP
+            return;
+    }
+    std::lock_guard<std::mutex> lock(m_addr_mtx);
+    m_addresses[index] = address;
+    m_address_ssrc[index] = ssrc;
+}
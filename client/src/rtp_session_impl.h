@@ -1,58 +1,55 @@
 #ifndef _SESSION_IMPL_H_
 #define _SESSION_IMPL_H_
 
+#include "rtp_stats.h"
 #include <jrtplib3/rtpsession.h>
 #include <jrtplib3/rtppacket.h>
 #include <jrtplib3/rtpipv4address.h>
 #include <jrtplib3/rtpipv6address.h>
 #include <jrtplib3/rtpbyteaddress.h>
 #include <jrtplib3/rtptcpaddress.h>
+#include <jrtplib3/rtcpcompoundpacket.h>
+#include <mutex>
+#include <vector>
 
 class RtpSessionImpl : public jrtplib::RTPSession
 {
-private:
-    const jrtplib::RTPAddress *m_address;
+public:
+    /**
+     * @brief 第一次见到某个源时解析并缓存的发送端地址
+     */
+    struct SourceAddress {
+        jrtplib::RTPAddress::AddressType type;
+        uint8_t ip[16];      // 网络序, IPv4 只用前 4 字节
+        std::size_t ip_len;
+        uint16_t port;
+        uint16_t rtcp_port;  // 仅 IPv4 地址带有
+    };
 
 public:
-    explicit RtpSessionImpl();
+    explicit RtpSessionImpl(uint32_t clock_rate = 48000);
     virtual ~RtpSessionImpl();
 
-    virtual void OnRTPPacket(jrtplib::RTPPacket *pack, const jrtplib::RTPTime &receivetime, const jrtplib::RTPAddress *senderaddress)
-    {
-        m_address = senderaddress;
-        auto address_type = senderaddress->GetAddressType();
-        switch (address_type) {
-            case jrtplib::RTPAddress::IPv4Address: {
-                jrtplib::RTPIPv4Address *ipv4 = (jrtplib::RTPIPv4Address *)senderaddress;
-                auto ip = ipv4->GetIP();
-                auto port = ipv4->GetPort();
-                auto rtcp_port = ipv4->GetRTCPSendPort();
-            }
-            case jrtplib::RTPAddress::IPv6Address: {
-                jrtplib::RTPIPv6Address *ipv6 = (jrtplib::RTPIPv6Address *)senderaddress;
-                auto ip = ipv6->GetIP();
-                auto port = ipv6->GetPort();
-            }
-            case jrtplib::RTPAddress::ByteAddress: {
-                jrtplib::RTPByteAddress *byte = (jrtplib::RTPByteAddress *)senderaddress;
-                auto ip = byte->GetHostAddress();
-                auto port = byte->GetPort();
-            }
-            case jrtplib::RTPAddress::UserDefinedAddress: {
-            }
-            case jrtplib::RTPAddress::TCPAddress: {
-            }
-        }
-    }
-    virtual void OnBYEPacket(jrtplib::RTPSourceData *srcdat)
-    {
-        
-    }
+    virtual void OnRTPPacket(jrtplib::RTPPacket *pack, const jrtplib::RTPTime &receivetime, const jrtplib::RTPAddress *senderaddress);
+    virtual void OnRTCPCompoundPacket(jrtplib::RTCPCompoundPacket *pack, const jrtplib::RTPTime &receivetime, const jrtplib::RTPAddress *senderaddress);
+    virtual void OnBYEPacket(jrtplib::RTPSourceData *srcdat);
 
-    const jrtplib::RTPAddress *getAddress() const
+    bool getAddress(uint32_t ssrc, SourceAddress &address);
+
+    // 报告线程调用, 不会阻塞接收线程
+    std::size_t getStats(std::vector<RtpStatsTable::Snapshot> &out) const
     {
-        return m_address;
+        return m_stats.snapshot(out);
     }
+
+private:
+    void cacheAddress(int index, uint32_t ssrc, const jrtplib::RTPAddress *senderaddress);
+
+private:
+    RtpStatsTable m_stats;
+    std::mutex m_addr_mtx; // 只在新源出现和查询时使用
+    std::vector<SourceAddress> m_addresses;
+    std::vector<uint32_t> m_address_ssrc;
 };
 
-#endif // _SESSION_IMPL_H_
\ No newline at end of file
+#endif // _SESSION_IMPL_H_
@@ -1,9 +1,297 @@
 #include "rtp_session_mgr.h"
+#include "logger.h"
+#include <jrtplib3/rtpsessionparams.h>
+#include <jrtplib3/rtperrors.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 
-RtpSessionMgr::RtpSessionMgr()
+// 一次唤醒里每个 socket 最多连续 recvmmsg 的次数, 防止一个 socket 饿死其他 socket
+static const int kMaxRecvRounds = 16;
+// 没有包时也要定期 Poll, jrtplib 在 Poll 里发送 RTCP 和处理超时
+static const int kPollIntervalMs = 100;
+static const int kWaitMs = 5;
+
+RtpSessionMgr::RtpSessionMgr(const std::string &ip, uint16_t base_port, std::size_t sockets) :
+    m_ip(ip),
+    m_base_port(base_port),
+    m_epoll_fd(-1),
+    m_running(false),
+    m_next_socket(0),
+    m_looping(false)
 {
+    for (std::size_t i = 0; i < std::max<std::size_t>(sockets, 1); ++i) {
+        m_sockets.emplace_back(new UdpBatchSocket());
+    }
 }
 
 RtpSessionMgr::~RtpSessionMgr()
 {
+    stop();
+}
+
+bool RtpSessionMgr::start()
+{
+    if (m_running.load()) {
+        return true;
+    }
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        LOG_ERROR("epoll_create1 failed: {}", strerror(errno));
+        return false;
+    }
+    for (std::size_t i = 0; i < m_sockets.size(); ++i) {
+        uint16_t port = m_base_port ? static_cast<uint16_t>(m_base_port + i) : 0;
+        if (!m_sockets[i]->open(m_ip, port)) {
+            LOG_ERROR("bind udp {}:{} failed: {}", m_ip, port, strerror(errno));
+            stop();
+            return false;
+        }
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_sockets[i]->fd(), &ev);
+    }
+    m_running.store(true);
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_looping = true;
+    }
+    m_thread = std::thread([this]() {
+        run();
+    });
+    return true;
+}
+
+void RtpSessionMgr::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_looping = false;
+    }
+    // 收包线程退出前没来得及销毁的
+    destroyPending();
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    for (auto &socket : m_sockets) {
+        socket->close();
+    }
+}
+
+RtpSessionMgr::SessionSptr RtpSessionMgr::createSession(const std::string &remote_ip,
+                                                        uint16_t remote_port,
+                                                        uint32_t remote_ssrc,
+                                                        double timestamp_unit)
+{
+    auto entry = std::make_shared<Entry>();
+    std::memset(&entry->remote, 0, sizeof(entry->remote));
+    entry->remote.sin_family = AF_INET;
+    entry->remote.sin_port = htons(remote_port);
+    if (inet_pton(AF_INET, remote_ip.c_str(), &entry->remote.sin_addr) != 1) {
+        LOG_ERROR("invalid remote address {}", remote_ip);
+        return nullptr;
+    }
+    entry->remote_ssrc = remote_ssrc;
+    entry->dirty = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        entry->socket_index = m_next_socket++ % m_sockets.size();
+    }
+    entry->sender.reset(new Sender(m_sockets[entry->socket_index].get(), entry->remote));
+    entry->session = std::make_shared<RtpSessionImpl>();
+
+    jrtplib::RTPSessionParams session_params;
+    session_params.SetOwnTimestampUnit(timestamp_unit);
+    session_params.SetUsePollThread(false);
+    // IPv4 + UDP 头
+    jrtplib::RTPExternalTransmissionParams trans_params(entry->sender.get(), 28);
+    int status = entry->session->Create(session_params, &trans_params, jrtplib::RTPTransmitter::ExternalProto);
+    if (status < 0) {
+        LOG_ERROR("create rtp session failed: {}", jrtplib::RTPGetErrorString(status));
+        return nullptr;
+    }
+    auto *info = static_cast<jrtplib::RTPExternalTransmissionInfo *>(entry->session->GetTransmissionInfo());
+    entry->injecter = info->GetPacketInjector();
+    entry->session->DeleteTransmissionInfo(info);
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    uint64_t key = addrKey(entry->socket_index, entry->remote);
+    if (m_by_addr.count(key)) {
+        LOG_ERROR("remote {}:{} already has a session", remote_ip, remote_port);
+        return nullptr;
+    }
+    m_by_addr[key] = entry;
+    m_by_session[entry->session.get()] = entry;
+    return entry->session;
+}
+
+void RtpSessionMgr::destroySession(const SessionSptr &session)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        auto it = m_by_session.find(session.get());
+        if (it == m_by_session.end()) {
+            return;
+        }
+        EntrySptr entry = it->second;
+        m_by_session.erase(it);
+        m_by_addr.erase(addrKey(entry->socket_index, entry->remote));
+        // 已经不在表里, 之后不会再被分发; 收包线程在下一轮 Poll 之前销毁它
+        m_destroying.push_back(std::move(entry));
+        if (m_looping) {
+            return;
+        }
+    }
+    destroyPending();
+}
+
+void RtpSessionMgr::destroyPending()
+{
+    std::vector<EntrySptr> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        entries.swap(m_destroying);
+    }
+    if (entries.empty()) {
+        return;
+    }
+    // BYE 经由 Sender 排进发送批次, entry 在此之前不能释放
+    for (auto &entry : entries) {
+        entry->session->BYEDestroy(jrtplib::RTPTime(0, 0), nullptr, 0);
+    }
+    flush();
+}
+
+void RtpSessionMgr::flush()
+{
+    for (auto &socket : m_sockets) {
+        socket->flush();
+    }
+}
+
+uint16_t RtpSessionMgr::localPort(std::size_t index) const
+{
+    return index < m_sockets.size() ? m_sockets[index]->localPort() : 0;
+}
+
+std::size_t RtpSessionMgr::sessionCount()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_by_session.size();
+}
+
+UdpBatchSocket::Stats RtpSessionMgr::stats()
+{
+    UdpBatchSocket::Stats total;
+    std::memset(&total, 0, sizeof(total));
+    for (auto &socket : m_sockets) {
+        UdpBatchSocket::Stats s = socket->stats();
+        total.recv_calls += s.recv_calls;
+        total.recv_packets += s.recv_packets;
+        total.send_calls += s.send_calls;
+        total.send_packets += s.send_packets;
+        total.send_dropped += s.send_dropped;
+        total.gso_messages += s.gso_messages;
+        total.gro_messages += s.gro_messages;
+    }
+    return total;
+}
+
+void RtpSessionMgr::run()
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<epoll_event> events(m_sockets.size());
+    Clock::time_point next_poll = Clock::now() + std::chrono::milliseconds(kPollIntervalMs);
+    while (m_running.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(m_epoll_fd, events.data(), static_cast<int>(events.size()), kWaitMs);
+        for (int i = 0; i < n; ++i) {
+            std::size_t index = events[i].data.u64;
+            for (int round = 0; round < kMaxRecvRounds; ++round) {
+                int count = m_sockets[index]->recv();
+                if (count == 0) {
+                    break;
+                }
+                dispatch(index, count);
+            }
+        }
+        if (Clock::now() >= next_poll) {
+            pollAll();
+            next_poll = Clock::now() + std::chrono::milliseconds(kPollIntervalMs);
+        }
+        destroyPending();
+        flush();
+    }
+}
+
+void RtpSessionMgr::dispatch(std::size_t socket_index, int count)
+{
+    UdpBatchSocket &socket = *m_sockets[socket_index];
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        for (int i = 0; i < count; ++i) {
+            const UdpBatchSocket::Datagram &d = socket.datagram(i);
+            if (d.addr->sa_family != AF_INET || d.size < 8) {
+                continue;
+            }
+            const auto *from = reinterpret_cast<const sockaddr_in *>(d.addr);
+            bool rtcp = isRtcpPacket(d.data, d.size);
+            if (!rtcp && d.size < kRtpHeaderSize) {
+                continue;
+            }
+            // 只按收包的 socket 和源地址找会话: 只按 SSRC 找的话, 任何源猜中 SSRC 就能往会话里注入包
+            auto it = m_by_addr.find(addrKey(socket_index, *from));
+            if (it == m_by_addr.end()) {
+                continue;
+            }
+            const EntrySptr *found = &it->second;
+            Entry *entry = found->get();
+            // RTP 的 SSRC 在第 8 字节; 第一次见到或对端重启换了 SSRC 时记下来
+            if (!rtcp) {
+                entry->remote_ssrc = rtpRead32(d.data + 8);
+            }
+
+            jrtplib::RTPIPv4Address address(ntohl(from->sin_addr.s_addr), ntohs(from->sin_port));
+            if (rtcp) {
+                entry->injecter->InjectRTCP(d.data, d.size, address);
+            }
+            else {
+                entry->injecter->InjectRTP(d.data, d.size, address);
+            }
+            if (!entry->dirty) {
+                entry->dirty = true;
+                m_dirty.push_back(*found);
+            }
+        }
+    }
+    // Poll 会回调 OnRTPPacket 等, 不能持有 m_mtx
+    for (auto &entry : m_dirty) {
+        entry->dirty = false;
+        entry->session->Poll();
+    }
+    m_dirty.clear();
+}
+
+void RtpSessionMgr::pollAll()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        for (auto &it : m_by_session) {
+            m_dirty.push_back(it.second);
+        }
+    }
+    for (auto &entry : m_dirty) {
+        entry->session->Poll();
+    }
+    m_dirty.clear();
 }
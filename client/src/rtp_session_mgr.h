@@ -1,11 +1,122 @@
 #ifndef _RTP_SESSION_MGR_H_
 #define _RTP_SESSION_MGR_H_
 
+#include "rtp_session_impl.h"
+#include "udp_batch_socket.h"
+#include <jrtplib3/rtpexternaltransmitter.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 多路 RTP 会话共用少量 UDP socket
+ *
+ * 每个 RtpSessionImpl 用 jrtplib 的外部传输 (ExternalProto) 创建, 不再各自占一对 socket
+ * 和一个 poll 线程; 管理器的一个线程用 epoll + recvmmsg 批量收包, 按 (收包 socket, 对端地址)
+ * 找到会话并注入, 批次结束后统一 Poll 这些会话; 发送经由 sendmmsg 批量发出
+ * 只认会话的对端地址: 别的源冒用会话的 SSRC 发来的包直接丢弃, 不会注入到这个会话
+ * RTP 与 RTCP 走同一个端口 (rtcp-mux)
+ */
 class RtpSessionMgr
 {
 public:
-    RtpSessionMgr();
+    using SessionSptr = std::shared_ptr<RtpSessionImpl>;
+
+    RtpSessionMgr(const std::string &ip = "", uint16_t base_port = 0, std::size_t sockets = 1);
     ~RtpSessionMgr();
+
+    bool start();
+    void stop();
+
+    // remote_ssrc 未知时传 0, 由第一个来自 remote 的包学习; 对端换了 SSRC 时跟着更新
+    SessionSptr createSession(const std::string &remote_ip,
+                              uint16_t remote_port,
+                              uint32_t remote_ssrc = 0,
+                              double timestamp_unit = 1.0 / 48000);
+    void destroySession(const SessionSptr &session);
+
+    // 立即发出各 socket 上排队的包; 不调用时由收包线程每次唤醒后发出
+    void flush();
+
+    uint16_t localPort(std::size_t index = 0) const;
+    std::size_t sessionCount();
+    UdpBatchSocket::Stats stats();
+
+private:
+    class Sender : public jrtplib::RTPExternalSender
+    {
+    public:
+        Sender(UdpBatchSocket *socket, const sockaddr_in &remote) :
+            m_socket(socket),
+            m_remote(remote)
+        {
+        }
+
+        bool SendRTP(const void *data, size_t len) override
+        {
+            return m_socket->queue(reinterpret_cast<const sockaddr *>(&m_remote), sizeof(m_remote),
+                                   static_cast<const uint8_t *>(data), len);
+        }
+
+        bool SendRTCP(const void *data, size_t len) override
+        {
+            return SendRTP(data, len);
+        }
+
+        bool ComesFromThisSender(const jrtplib::RTPAddress *) override
+        {
+            return false;
+        }
+
+    private:
+        UdpBatchSocket *m_socket;
+        sockaddr_in m_remote;
+    };
+
+    struct Entry {
+        SessionSptr session;
+        std::unique_ptr<Sender> sender;
+        jrtplib::RTPExternalPacketInjecter *injecter;
+        std::size_t socket_index; // 收发用的 socket
+        sockaddr_in remote;
+        uint32_t remote_ssrc;
+        bool dirty;
+    };
+    using EntrySptr = std::shared_ptr<Entry>;
+
+    void run();
+    void dispatch(std::size_t socket_index, int count);
+    void pollAll();
+    void destroyPending();
+
+    // <socket 序号 << 48 | IPv4 地址 << 16 | 端口>
+    static uint64_t addrKey(std::size_t socket_index, const sockaddr_in &addr)
+    {
+        return (static_cast<uint64_t>(socket_index) << 48) | (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16)
+               | addr.sin_port;
+    }
+
+private:
+    std::string m_ip;
+    uint16_t m_base_port;
+    std::vector<std::unique_ptr<UdpBatchSocket>> m_sockets;
+    int m_epoll_fd;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+
+    std::mutex m_mtx; // 保护下面两个表和 m_destroying, m_looping
+    std::unordered_map<uint64_t, EntrySptr> m_by_addr; // <addrKey, entry>
+    std::unordered_map<RtpSessionImpl *, EntrySptr> m_by_session;
+    std::size_t m_next_socket;
+    // 收包线程可能正在 Poll 要销毁的会话, BYEDestroy 交给收包线程做
+    std::vector<EntrySptr> m_destroying;
+    bool m_looping; // 收包线程在跑, 没有时 destroySession 直接销毁
+
+    std::vector<EntrySptr> m_dirty; // 只在收包线程使用
 };
 
-#endif // _RTP_SESSION_MGR_H_
\ No newline at end of file
+#endif // _RTP_SESSION_MGR_H_
@@ -0,0 +1,194 @@
+#include "media_worker_pool.h"
+#include <opus/opus.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**
+ * 48 kHz 单声道 20 ms 帧的 Opus 编解码容量 (流/核):
+ * 1) 单线程测一路流每帧 opus_encode + opus_decode 的耗时, 折算成每核的理论流数;
+ * 2) 起 workers 个 worker 的 MediaWorkerPool, 每 20 ms 给每路流推一帧 PCM, 编出的包回灌同一路流解码,
+ *    流数从 8 起翻倍, 出现 tick 超时 (超过 1%) / 丢帧 / 负载超过 90% 后在最后两级之间二分;
+ *    每级打印 worker 负载、超时次数和窃取的流数
+ * 用法 media_worker_pool_bench [workers] [seconds]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const int kSampleRate = 48000;
+static const std::size_t kFrameSamples = kSampleRate / 1000 * 20;
+// 通过判定: 每个 worker 负载不超过这个比例, tick 超时不超过 tick 数的这个比例 (容忍调度抖动)
+static const double kMaxLoad = 0.9;
+static const double kMaxOverrunRatio = 0.01;
+
+// 1 s 的测试信号: 两个正弦加少量噪声, 避免编码器走静音分支
+static std::vector<int16_t> make_signal()
+{
+    std::vector<int16_t> pcm(kSampleRate);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 300.0);
+    for (std::size_t i = 0; i < pcm.size(); ++i) {
+        double t = static_cast<double>(i) / kSampleRate;
+        double v = 6000.0 * std::sin(2 * M_PI * 220.0 * t) + 3000.0 * std::sin(2 * M_PI * 1330.0 * t) + noise(rng);
+        pcm[i] = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, v)));
+    }
+    return pcm;
+}
+
+// 单线程一路流编码 + 解码一帧的平均耗时 (us)
+static double measure_frame(const std::vector<int16_t> &signal, const MediaStream::Config &cfg)
+{
+    int err = OPUS_OK;
+    OpusEncoder *enc = opus_encoder_create(kSampleRate, 1, OPUS_APPLICATION_VOIP, &err);
+    OpusDecoder *dec = opus_decoder_create(kSampleRate, 1, &err);
+    if (!enc || !dec) {
+        std::printf("opus create failed\n");
+        std::exit(1);
+    }
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE(cfg.bitrate));
+    std::vector<uint8_t> packet(MediaStream::kMaxPacket);
+    std::vector<int16_t> out(kFrameSamples);
+    std::size_t frames_per_signal = signal.size() / kFrameSamples;
+    uint64_t frames = 0;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end;
+    do {
+        for (std::size_t i = 0; i < frames_per_signal; ++i) {
+            int n = opus_encode(enc, signal.data() + i * kFrameSamples, static_cast<int>(kFrameSamples),
+                                packet.data(), static_cast<opus_int32>(packet.size()));
+            opus_decode(dec, packet.data(), n, out.data(), static_cast<int>(kFrameSamples), 0);
+        }
+        frames += frames_per_signal;
+        end = Clock::now();
+    } while (end - begin < std::chrono::seconds(1));
+    opus_encoder_destroy(enc);
+    opus_decoder_destroy(dec);
+    return std::chrono::duration<double, std::micro>(end - begin).count() / frames;
+}
+
+struct Level {
+    std::size_t streams;
+    double max_load;
+    double mean_load;
+    uint64_t overruns;
+    uint64_t stolen;
+    double done;     // 实际处理的帧 / 应处理的帧
+    uint64_t dropped;
+    bool ok;
+};
+
+static Level run_level(std::size_t workers, std::size_t count, double seconds,
+                       const std::vector<int16_t> &signal, const MediaStream::Config &cfg)
+{
+    MediaWorkerPool pool(workers);
+    std::vector<MediaStream::Sptr> streams(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        // 编码结果回灌解码, 每路流每个 tick 一次编码一次解码
+        streams[i] = pool.addStream(cfg, [&streams, i](const uint8_t *data, std::size_t size) {
+            streams[i]->pushOpus(data, size);
+        }, nullptr);
+        if (!streams[i]) {
+            std::printf("addStream failed\n");
+            std::exit(1);
+        }
+    }
+
+    std::size_t frames_per_signal = signal.size() / kFrameSamples;
+    std::chrono::milliseconds period(20);
+    auto warmup = static_cast<uint64_t>(500 / period.count());
+    auto ticks = static_cast<uint64_t>(seconds * 1000 / period.count());
+    std::vector<MediaWorkerPool::WorkerStats> before;
+    Clock::time_point begin;
+    Clock::time_point next = Clock::now();
+    for (uint64_t t = 0; t < warmup + ticks; ++t) {
+        if (t == warmup) {
+            before = pool.stats();
+            begin = Clock::now();
+        }
+        // 各流错开起始位置, 模拟不同内容
+        for (std::size_t i = 0; i < count; ++i) {
+            std::size_t frame = (t + i) % frames_per_signal;
+            streams[i]->pushPcm(signal.data() + frame * kFrameSamples, kFrameSamples);
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    // 让最后一个 tick 处理完
+    std::this_thread::sleep_for(period * 2);
+    std::vector<MediaWorkerPool::WorkerStats> after = pool.stats();
+    double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    pool.stop();
+
+    Level level = {};
+    level.streams = count;
+    uint64_t frames = 0;
+    for (std::size_t w = 0; w < after.size(); ++w) {
+        double load = (after[w].busy_ms - before[w].busy_ms) / wall_ms;
+        level.max_load = std::max(level.max_load, load);
+        level.mean_load += load / after.size();
+        level.overruns += after[w].overruns - before[w].overruns;
+        level.stolen += after[w].stolen - before[w].stolen;
+        frames += after[w].frames - before[w].frames;
+    }
+    for (auto &stream : streams) {
+        level.dropped += stream->dropped();
+    }
+    level.done = static_cast<double>(frames) / (2.0 * count * ticks);
+    level.ok = level.overruns <= kMaxOverrunRatio * ticks * workers && level.dropped == 0
+               && level.max_load <= kMaxLoad && level.done >= 0.99;
+    return level;
+}
+
+static void print_level(const Level &level, std::size_t workers)
+{
+    std::printf("%8zu %10.1f %8.1f %8.1f %9llu %7llu %8llu %7.1f%%  %s\n", level.streams,
+                static_cast<double>(level.streams) / workers, level.max_load * 100, level.mean_load * 100,
+                static_cast<unsigned long long>(level.overruns), static_cast<unsigned long long>(level.stolen),
+                static_cast<unsigned long long>(level.dropped), level.done * 100, level.ok ? "ok" : "FAIL");
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t workers = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+    double seconds = argc > 2 ? std::atof(argv[2]) : 3.0;
+    workers = std::max<std::size_t>(workers, 1);
+    if (seconds <= 0) {
+        seconds = 3.0;
+    }
+
+    MediaStream::Config cfg;
+    cfg.sample_rate = kSampleRate;
+    cfg.channels = 1;
+    cfg.frame_ms = 20;
+    std::vector<int16_t> signal = make_signal();
+
+    double frame_us = measure_frame(signal, cfg);
+    std::printf("48 kHz mono 20 ms, %d bps: encode+decode %.1f us/frame, %.0f streams/core at 100%% load\n",
+                cfg.bitrate, frame_us, 20000.0 / frame_us);
+
+    std::printf("pool: %zu workers, %.1f s per level\n", workers, seconds);
+    std::printf("%8s %10s %8s %8s %9s %7s %8s %8s\n", "streams", "per_worker", "max_load", "avg_load",
+                "overruns", "stolen", "dropped", "done");
+    std::size_t pass = 0;
+    std::size_t fail = 0;
+    for (std::size_t count = 8; !fail; count *= 2) {
+        Level level = run_level(workers, count, seconds, signal, cfg);
+        print_level(level, workers);
+        (level.ok ? pass : fail) = count;
+    }
+    // 在最后通过和第一次失败之间二分
+    for (int i = 0; i < 4 && fail - pass > 1; ++i) {
+        std::size_t count = pass + (fail - pass) / 2;
+        Level level = run_level(workers, count, seconds, signal, cfg);
+        print_level(level, workers);
+        (level.ok ? pass : fail) = count;
+    }
+    std::printf("sustained: %zu streams on %zu workers, %.1f streams/core\n", pass, workers,
+                static_cast<double>(pass) / workers);
+    return 0;
+}
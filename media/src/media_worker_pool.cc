@@ -0,0 +1,325 @@
+#include "media_worker_pool.h"
+#include <algorithm>
+#include <cstring>
+
+// tick 耗时超过周期的这个比例即认为落后
+static const double kBehindRatio = 0.9;
+// tick 耗时低于周期的这个比例才去帮别人
+static const double kIdleRatio = 0.5;
+// Opus 单包最长 120 ms
+static const int kMaxDecodeMs = 120;
+
+MediaStream::MediaStream(uint64_t id, const Config &cfg, OnEncoded &&on_encoded, OnDecoded &&on_decoded) :
+    m_id(id),
+    m_cfg(cfg),
+    m_frame_samples(static_cast<std::size_t>(cfg.sample_rate / 1000 * cfg.frame_ms)),
+    m_on_encoded(std::move(on_encoded)),
+    m_on_decoded(std::move(on_decoded)),
+    m_enc(nullptr),
+    m_dec(nullptr),
+    m_pcm_in(kQueueFrames * m_frame_samples * cfg.channels),
+    m_pcm_head(0),
+    m_pcm_count(0),
+    m_opus_in(kQueueFrames * kMaxPacket),
+    m_opus_size {},
+    m_opus_head(0),
+    m_opus_count(0),
+    m_pcm_work(static_cast<std::size_t>(cfg.sample_rate / 1000 * kMaxDecodeMs * cfg.channels)),
+    m_opus_work(kMaxPacket),
+    m_closed(false),
+    m_dropped(0),
+    m_errors(0)
+{
+}
+
+MediaStream::~MediaStream()
+{
+    if (m_enc) {
+        opus_encoder_destroy(m_enc);
+    }
+    if (m_dec) {
+        opus_decoder_destroy(m_dec);
+    }
+}
+
+bool MediaStream::init()
+{
+    int err = OPUS_OK;
+    if (m_cfg.encode) {
+        m_enc = opus_encoder_create(m_cfg.sample_rate, m_cfg.channels, OPUS_APPLICATION_VOIP, &err);
+        if (err != OPUS_OK) {
+            return false;
+        }
+        opus_encoder_ctl(m_enc, OPUS_SET_BITRATE(m_cfg.bitrate));
+    }
+    if (m_cfg.decode) {
+        m_dec = opus_decoder_create(m_cfg.sample_rate, m_cfg.channels, &err);
+        if (err != OPUS_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MediaStream::pushPcm(const int16_t *pcm, std::size_t samples)
+{
+    if (!m_enc || samples != m_frame_samples || closed()) {
+        return false;
+    }
+    std::size_t frame = m_frame_samples * m_cfg.channels;
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_pcm_count == kQueueFrames) {
+        // 队列满时丢最旧的一帧
+        m_pcm_head = (m_pcm_head + 1) % kQueueFrames;
+        --m_pcm_count;
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::size_t tail = (m_pcm_head + m_pcm_count) % kQueueFrames;
+    std::memcpy(m_pcm_in.data() + tail * frame, pcm, frame * sizeof(int16_t));
+    ++m_pcm_count;
+    return true;
+}
+
+bool MediaStream::pushOpus(const uint8_t *data, std::size_t size)
+{
+    if (!m_dec || size == 0 || size > kMaxPacket || closed()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_opus_count == kQueueFrames) {
+        m_opus_head = (m_opus_head + 1) % kQueueFrames;
+        --m_opus_count;
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::size_t tail = (m_opus_head + m_opus_count) % kQueueFrames;
+    std::memcpy(m_opus_in.data() + tail * kMaxPacket, data, size);
+    m_opus_size[tail] = size;
+    ++m_opus_count;
+    return true;
+}
+
+std::size_t MediaStream::process()
+{
+    // 流被窃取时可能短暂出现在两个 worker 上, 保证同一时刻只有一个在处理
+    if (m_busy.test_and_set(std::memory_order_acquire)) {
+        return 0;
+    }
+    std::size_t frames = 0;
+    std::size_t frame = m_frame_samples * m_cfg.channels;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (m_pcm_count == 0) {
+                break;
+            }
+            std::memcpy(m_pcm_work.data(), m_pcm_in.data() + m_pcm_head * frame, frame * sizeof(int16_t));
+            m_pcm_head = (m_pcm_head + 1) % kQueueFrames;
+            --m_pcm_count;
+        }
+        int n = opus_encode(m_enc, m_pcm_work.data(), static_cast<int>(m_frame_samples),
+                            m_opus_work.data(), static_cast<opus_int32>(m_opus_work.size()));
+        if (n < 0) {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        ++frames;
+        if (m_on_encoded) {
+            m_on_encoded(m_opus_work.data(), static_cast<std::size_t>(n));
+        }
+    }
+    for (;;) {
+        std::size_t size = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (m_opus_count == 0) {
+                break;
+            }
+            size = m_opus_size[m_opus_head];
+            std::memcpy(m_opus_work.data(), m_opus_in.data() + m_opus_head * kMaxPacket, size);
+            m_opus_head = (m_opus_head + 1) % kQueueFrames;
+            --m_opus_count;
+        }
+        int n = opus_decode(m_dec, m_opus_work.data(), static_cast<opus_int32>(size), m_pcm_work.data(),
+                            static_cast<int>(m_pcm_work.size() / m_cfg.channels), 0);
+        if (n < 0) {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        ++frames;
+        if (m_on_decoded) {
+            m_on_decoded(m_pcm_work.data(), static_cast<std::size_t>(n));
+        }
+    }
+    m_busy.clear(std::memory_order_release);
+    return frames;
+}
+
+MediaWorkerPool::~MediaWorkerPool()
+{
+    stop();
+}
+
+MediaStream::Sptr MediaWorkerPool::addStream(const MediaStream::Config &cfg,
+                                             MediaStream::OnEncoded on_encoded,
+                                             MediaStream::OnDecoded on_decoded)
+{
+    MediaStream::Sptr stream(new MediaStream(m_next_id.fetch_add(1, std::memory_order_relaxed), cfg,
+                                             std::move(on_encoded), std::move(on_decoded)));
+    if (!stream->init()) {
+        return nullptr;
+    }
+    // 放到当前流最少的 worker 上, 之后除非被窃取都由它处理
+    auto it = std::min_element(m_workers.begin(), m_workers.end(),
+                               [](const std::unique_ptr<Worker> &a, const std::unique_ptr<Worker> &b) {
+                                   return a->count.load(std::memory_order_relaxed) < b->count.load(std::memory_order_relaxed);
+                               });
+    Worker &worker = **it;
+    {
+        std::lock_guard<std::mutex> lock(worker.mtx);
+        worker.streams.push_back(stream);
+        worker.count.store(worker.streams.size(), std::memory_order_relaxed);
+    }
+    return stream;
+}
+
+std::vector<MediaWorkerPool::WorkerStats> MediaWorkerPool::stats()
+{
+    std::vector<WorkerStats> result;
+    result.reserve(m_workers.size());
+    for (auto &worker : m_workers) {
+        WorkerStats s;
+        s.streams = worker->count.load(std::memory_order_relaxed);
+        s.ticks = worker->ticks.load(std::memory_order_relaxed);
+        s.overruns = worker->overruns.load(std::memory_order_relaxed);
+        s.stolen = worker->stolen.load(std::memory_order_relaxed);
+        s.frames = worker->frames.load(std::memory_order_relaxed);
+        s.last_tick_ms = worker->last_tick_ns.load(std::memory_order_relaxed) / 1e6;
+        s.busy_ms = worker->busy_ns.load(std::memory_order_relaxed) / 1e6;
+        result.push_back(s);
+    }
+    return result;
+}
+
+void MediaWorkerPool::stop()
+{
+    m_running.store(false, std::memory_order_release);
+    for (auto &worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+MediaWorkerPool::MediaWorkerPool(std::size_t size) :
+    m_period(std::chrono::milliseconds(20)),
+    m_running(true),
+    m_next_id(1)
+{
+    size = std::max<std::size_t>(size, 1);
+    for (std::size_t i = 0; i < size; ++i) {
+        m_workers.emplace_back(new Worker);
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+        m_workers[i]->thread = std::thread([this, i]() {
+            run(i);
+        });
+    }
+}
+
+void MediaWorkerPool::run(std::size_t index)
+{
+    using Clock = std::chrono::steady_clock;
+    Worker &worker = *m_workers[index];
+    Clock::time_point next = Clock::now();
+    while (m_running.load(std::memory_order_acquire)) {
+        next += m_period;
+        Clock::time_point start = Clock::now();
+        worker.frames.fetch_add(tick(worker), std::memory_order_relaxed);
+        Clock::time_point end = Clock::now();
+
+        auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        worker.last_tick_ns.store(cost.count(), std::memory_order_relaxed);
+        worker.busy_ns.fetch_add(cost.count(), std::memory_order_relaxed);
+        worker.ticks.fetch_add(1, std::memory_order_relaxed);
+        worker.behind.store(cost.count() > m_period.count() * kBehindRatio, std::memory_order_relaxed);
+        if (end > next) {
+            // 错过的 tick 不补, 排队的帧下一次一起处理
+            worker.overruns.fetch_add(1, std::memory_order_relaxed);
+            next = end;
+            continue;
+        }
+        if (cost.count() < m_period.count() * kIdleRatio) {
+            steal(index);
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+std::size_t MediaWorkerPool::tick(Worker &worker)
+{
+    std::size_t frames = 0;
+    std::size_t i = 0;
+    for (;;) {
+        MediaStream::Sptr stream;
+        {
+            std::lock_guard<std::mutex> lock(worker.mtx);
+            // 已关闭的流用队尾替换, 队尾的流本 tick 还未处理
+            while (i < worker.streams.size() && worker.streams[i]->closed()) {
+                worker.streams[i] = std::move(worker.streams.back());
+                worker.streams.pop_back();
+            }
+            if (i >= worker.streams.size()) {
+                worker.count.store(worker.streams.size(), std::memory_order_relaxed);
+                break;
+            }
+            stream = worker.streams[i++];
+        }
+        frames += stream->process();
+    }
+    return frames;
+}
+
+void MediaWorkerPool::steal(std::size_t thief)
+{
+    Worker &self = *m_workers[thief];
+    std::size_t own = self.count.load(std::memory_order_relaxed);
+
+    Worker *victim = nullptr;
+    std::size_t victim_count = 0;
+    for (std::size_t i = 0; i < m_workers.size(); ++i) {
+        Worker &w = *m_workers[i];
+        std::size_t count = w.count.load(std::memory_order_relaxed);
+        if (i != thief && w.behind.load(std::memory_order_relaxed) && count > victim_count) {
+            victim = &w;
+            victim_count = count;
+        }
+    }
+    if (!victim || victim_count <= own + 1) {
+        return;
+    }
+
+    // 从队尾取走差值的一半, 队尾的流在对方本 tick 中最晚处理
+    std::vector<MediaStream::Sptr> taken;
+    {
+        std::lock_guard<std::mutex> lock(victim->mtx);
+        std::size_t size = victim->streams.size();
+        std::size_t n = size > own ? (size - own) / 2 : 0;
+        auto first = victim->streams.end() - static_cast<std::ptrdiff_t>(n);
+        taken.assign(std::make_move_iterator(first), std::make_move_iterator(victim->streams.end()));
+        victim->streams.erase(first, victim->streams.end());
+        victim->count.store(victim->streams.size(), std::memory_order_relaxed);
+        // 对方下一个 tick 重新评估, 避免多个 worker 同时从它身上取
+        victim->behind.store(false, std::memory_order_relaxed);
+    }
+    if (taken.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(self.mtx);
+        for (auto &stream : taken) {
+            self.streams.push_back(std::move(stream));
+        }
+        self.count.store(self.streams.size(), std::memory_order_relaxed);
+    }
+    self.stolen.fetch_add(taken.size(), std::memory_order_relaxed);
+}
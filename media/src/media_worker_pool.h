@@ -0,0 +1,170 @@
+#ifndef _MEDIA_WORKER_POOL_H_
+#define _MEDIA_WORKER_POOL_H_
+
+#include <opus/opus.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 一路媒体流的编解码状态
+ *
+ * 由 MediaWorkerPool 创建并固定在某个 worker 上, IO 线程只负责 push 帧,
+ * 编解码在 worker 的 20 ms tick 中批量完成; 帧缓冲全部预分配
+ */
+class MediaStream
+{
+    friend class MediaWorkerPool;
+
+public:
+    using Sptr = std::shared_ptr<MediaStream>;
+    using OnEncoded = std::function<void(const uint8_t *, std::size_t)>;
+    using OnDecoded = std::function<void(const int16_t *, std::size_t)>;
+
+    struct Config {
+        int sample_rate = 48000;
+        int channels = 1;
+        int frame_ms = 20;
+        int bitrate = 32000;
+        bool encode = true;
+        bool decode = true;
+    };
+
+    static const std::size_t kQueueFrames = 4;
+    static const std::size_t kMaxPacket = 1275;
+
+    ~MediaStream();
+
+    // 一帧 PCM (frame_ms 长), 下个 tick 编码后回调 OnEncoded
+    bool pushPcm(const int16_t *pcm, std::size_t samples);
+    // 一个 Opus 包, 下个 tick 解码后回调 OnDecoded
+    bool pushOpus(const uint8_t *data, std::size_t size);
+
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+    }
+
+    uint64_t id() const
+    {
+        return m_id;
+    }
+
+    uint64_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+    // opus_encode / opus_decode 失败的帧数
+    uint64_t errors() const
+    {
+        return m_errors.load(std::memory_order_relaxed);
+    }
+
+private:
+    MediaStream(uint64_t id, const Config &cfg, OnEncoded &&on_encoded, OnDecoded &&on_decoded);
+
+    bool init();
+    // 处理所有排队的帧, 返回处理的帧数; 只会在一个 worker 上同时执行
+    std::size_t process();
+
+    bool closed() const
+    {
+        return m_closed.load(std::memory_order_acquire);
+    }
+
+private:
+    uint64_t m_id;
+    Config m_cfg;
+    std::size_t m_frame_samples;
+    OnEncoded m_on_encoded;
+    OnDecoded m_on_decoded;
+    OpusEncoder *m_enc;
+    OpusDecoder *m_dec;
+
+    std::mutex m_mtx; // 保护下面的输入队列
+    std::vector<int16_t> m_pcm_in;     // kQueueFrames 帧
+    std::size_t m_pcm_head;
+    std::size_t m_pcm_count;
+    std::vector<uint8_t> m_opus_in;    // kQueueFrames 个包
+    std::size_t m_opus_size[kQueueFrames];
+    std::size_t m_opus_head;
+    std::size_t m_opus_count;
+
+    // worker 处理时使用, 不需要锁
+    std::vector<int16_t> m_pcm_work;
+    std::vector<uint8_t> m_opus_work;
+
+    std::atomic_flag m_busy = ATOMIC_FLAG_INIT;
+    std::atomic<bool> m_closed;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_errors;
+};
+
+/**
+ * @brief 服务端多路 Opus 编解码线程池
+ *
+ * 每个 worker 拥有一组流, 每 20 ms tick 一次批量处理这组流的全部排队帧,
+ * 新流分配给当前流最少的 worker 并固定下来 (缓存局部性);
+ * 某个 worker 的 tick 耗时超过周期 (落后) 时, 有空闲的 worker 从它的队尾
+ * 窃取一部分流过来
+ */
+class MediaWorkerPool
+{
+public:
+    struct WorkerStats {
+        std::size_t streams;
+        uint64_t ticks;
+        uint64_t overruns;
+        uint64_t stolen;
+        uint64_t frames;
+        double last_tick_ms;
+        double busy_ms; // tick 累计耗时, 两次采样之差除以墙钟时间即该 worker 的负载
+    };
+
+    explicit MediaWorkerPool(std::size_t size = std::thread::hardware_concurrency());
+    ~MediaWorkerPool();
+
+    MediaWorkerPool(const MediaWorkerPool &) = delete;
+    MediaWorkerPool &operator=(const MediaWorkerPool &) = delete;
+
+    // 编解码器创建失败时返回 nullptr
+
+    MediaStream::Sptr addStream(const MediaStream::Config &cfg,
+                                MediaStream::OnEncoded on_encoded,
+                                MediaStream::OnDecoded on_decoded);
+    std::vector<WorkerStats> stats();
+    void stop();
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex mtx; // 保护 streams
+        std::vector<MediaStream::Sptr> streams;
+        std::atomic<std::size_t> count {0};
+        std::atomic<bool> behind {false};
+        std::atomic<uint64_t> ticks {0};
+        std::atomic<uint64_t> overruns {0};
+        std::atomic<uint64_t> stolen {0};
+        std::atomic<uint64_t> frames {0};
+        std::atomic<int64_t> last_tick_ns {0};
+        std::atomic<int64_t> busy_ns {0};
+    };
+
+    void run(std::size_t index);
+    std::size_t tick(Worker &worker);
+    void steal(std::size_t thief);
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::chrono::nanoseconds m_period;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_next_id;
+};
+
+#endif // _MEDIA_WORKER_POOL_H_
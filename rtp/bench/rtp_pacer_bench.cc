@@ -0,0 +1,133 @@
+#include "rtp_pacer.h"
+#include "rtp_packetizer.h"
+#include <time.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * RtpPacer 的发送时刻抖动: 一个 pacer 线程带 streams 路 20 ms 周期的流,
+ * 每次回调用各自的 RtpPacketizer 打一个 160 字节 (G.711 20 ms) 的包, flush 时统一归还槽;
+ * 预热 1 s 后统计 seconds 秒内实际回调时刻相对计划时刻的延后分布 (2 的幂分桶, 打印桶上界),
+ * 以及实际发送速率、重新对齐次数和进程 CPU 占用; max 是含预热在内的最大延后
+ * 用法 rtp_pacer_bench [seconds] [streams...], 默认 1000 10000 50000 路
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const uint32_t kIntervalUs = 20000;
+static const std::size_t kPayload = 160;
+static const uint32_t kSamples = 160;
+
+static double process_cpu_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 分位数所在桶的上界 (us)
+static uint64_t quantile(const uint64_t *hist, uint64_t total, double q)
+{
+    uint64_t acc = 0;
+    for (std::size_t i = 0; i < RtpPacer::kLateBuckets; ++i) {
+        acc += hist[i];
+        if (acc >= q * total) {
+            return 1ull << i;
+        }
+    }
+    return 1ull << (RtpPacer::kLateBuckets - 1);
+}
+
+static void run_level(std::size_t streams, double seconds)
+{
+    // pacer 醒晚了会在一次 flush 前补跑多个 tick, 槽按一整个周期的包数准备; 槽只需容纳头部 + 负载
+    RtpPacketRing ring(streams + 64, kRtpHeaderSize + kPayload + 64);
+    std::vector<std::unique_ptr<RtpPacketizer>> packetizers;
+    packetizers.reserve(streams);
+    for (std::size_t i = 0; i < streams; ++i) {
+        packetizers.emplace_back(new RtpPacketizer(ring, static_cast<uint32_t>(i + 1), 0));
+    }
+    uint8_t payload[kPayload];
+    std::memset(payload, 0xD5, sizeof(payload));
+
+    RtpPacer pacer;
+    std::vector<std::size_t> pending;
+    pending.reserve(streams);
+    uint64_t ring_full = 0;
+    // 回调和 flush 都在 pacer 线程里执行
+    pacer.setFlush([&]() {
+        for (std::size_t slot : pending) {
+            ring.release(slot);
+        }
+        pending.clear();
+    });
+    for (std::size_t i = 0; i < streams; ++i) {
+        RtpPacketizer *packetizer = packetizers[i].get();
+        pacer.add(kIntervalUs, [&, packetizer](uint64_t) {
+            uint8_t *out = packetizer->payload();
+            if (!out) {
+                ++ring_full;
+                return true;
+            }
+            std::memcpy(out, payload, kPayload);
+            pending.push_back(packetizer->commit(kPayload, kSamples).slot);
+            return true;
+        });
+    }
+    pacer.start();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    RtpPacer::Stats before = pacer.stats();
+    double cpu_begin = process_cpu_s();
+    Clock::time_point begin = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    RtpPacer::Stats after = pacer.stats();
+    double cpu = process_cpu_s() - cpu_begin;
+    double wall = std::chrono::duration<double>(Clock::now() - begin).count();
+    pacer.stop();
+
+    uint64_t hist[RtpPacer::kLateBuckets];
+    uint64_t sends = after.sends - before.sends;
+    for (std::size_t i = 0; i < RtpPacer::kLateBuckets; ++i) {
+        hist[i] = after.late_hist[i] - before.late_hist[i];
+    }
+    double expected = streams * 1e6 / kIntervalUs;
+    std::printf("%8zu %11.0f %6.1f%% %7llu %7llu %7llu %7llu %7llu %9llu %6.1f%% %6llu\n", streams, sends / wall,
+                sends / wall / expected * 100, static_cast<unsigned long long>(quantile(hist, sends, 0.5)),
+                static_cast<unsigned long long>(quantile(hist, sends, 0.9)),
+                static_cast<unsigned long long>(quantile(hist, sends, 0.99)),
+                static_cast<unsigned long long>(quantile(hist, sends, 0.999)),
+                static_cast<unsigned long long>(after.late_max_us),
+                static_cast<unsigned long long>(after.resyncs - before.resyncs), cpu / wall * 100,
+                static_cast<unsigned long long>(ring_full));
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 5.0;
+    if (seconds <= 0) {
+        seconds = 5.0;
+    }
+    std::vector<std::size_t> levels;
+    for (int i = 2; i < argc; ++i) {
+        levels.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+    if (levels.empty()) {
+        levels = {1000, 10000, 50000};
+    }
+
+    std::printf("20 ms streams, 160 B payload, tick 1 ms, %.1f s per level; late = callback time - due time (us, "
+                "bucket upper bound)\n",
+                seconds);
+    std::printf("%8s %11s %7s %7s %7s %7s %7s %7s %9s %7s %6s\n", "streams", "pkt/s", "rate", "p50", "p90", "p99",
+                "p99.9", "max", "resyncs", "cpu", "full");
+    for (std::size_t streams : levels) {
+        run_level(streams, seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,295 @@
+#include "rtp_stats.h"
+#include "rtp_transport.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * 回环上每路 RTP 流的 CPU 开销: streams 对收发端, 每路 20 ms 发一个 160 字节的包 (50 pps),
+ * 预热 0.5 s 后统计 seconds 秒内的进程 CPU 时间 (含内核态), 折算每路占一个核的百分比
+ * 两种收发结构对比:
+ *   rtp_transport  所有 RtpTransport 共用一个 io_context 线程, 一个定时器驱动全部发送, 带 RTCP
+ *   thread/session 每个会话一个 socket 和一个 poll 线程收包 (jrtplib 默认的 RTPSession + poll thread 结构),
+ *                  应用线程逐路 sendto; 收包同样解析头部并更新 RtpStatsTable, 不含 RTCP 和按包分配,
+ *                  是这种结构开销的下限, 不是 jrtplib 本身的数字
+ * 用法 rtp_transport_bench [seconds] [streams...], 默认 3 s、100 500 1000 路
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const std::chrono::milliseconds kInterval(20);
+static const std::chrono::milliseconds kWarmup(500);
+static const std::size_t kPayload = 160;
+static const uint32_t kSamples = 960;
+
+struct Result {
+    uint64_t sent;
+    uint64_t received;
+    double cpu_s;
+    double wall_s;
+    double switches; // 自愿 + 非自愿上下文切换
+};
+
+static double process_cpu_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double context_switches()
+{
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return static_cast<double>(ru.ru_nvcsw + ru.ru_nivcsw);
+}
+
+static Result run_transport(std::size_t streams, double seconds)
+{
+    boost::asio::io_context ioc;
+    RtpTransport::Config cfg;
+    cfg.pool_size = 8;
+    cfg.send_slots = 8;
+    cfg.max_sources = 4;
+    std::vector<RtpTransport::Sptr> senders;
+    std::vector<RtpTransport::Sptr> receivers;
+    for (std::size_t i = 0; i < streams; ++i) {
+        RtpTransport::Sptr tx = RtpTransport::create(ioc, cfg);
+        RtpTransport::Sptr rx = RtpTransport::create(ioc, cfg);
+        if (!tx->open("127.0.0.1", 0) || !rx->open("127.0.0.1", 0)) {
+            std::printf("open failed (ulimit -n?)\n");
+            std::exit(1);
+        }
+        tx->connect("127.0.0.1", rx->localPort());
+        rx->connect("127.0.0.1", tx->localPort());
+        rx->setOnRtp([](const RtpHeader &, RtpTransport::Buffer &) {
+        });
+        tx->start();
+        rx->start();
+        senders.push_back(tx);
+        receivers.push_back(rx);
+    }
+
+    uint8_t payload[kPayload];
+    std::memset(payload, 0xD5, sizeof(payload));
+    boost::asio::steady_timer timer(ioc);
+    Clock::time_point due = Clock::now();
+    std::function<void()> tick = [&]() {
+        for (auto &tx : senders) {
+            tx->send(payload, kPayload, kSamples);
+        }
+        due += kInterval;
+        timer.expires_at(due);
+        timer.async_wait([&](const boost::system::error_code &ec) {
+            if (!ec) {
+                tick();
+            }
+        });
+    };
+    tick();
+    ioc.run_for(kWarmup);
+
+    auto totals = [&](uint64_t &sent, uint64_t &received) {
+        sent = 0;
+        received = 0;
+        for (std::size_t i = 0; i < streams; ++i) {
+            sent += senders[i]->stats().rtp_sent;
+            received += receivers[i]->stats().rtp_received;
+        }
+    };
+    uint64_t sent0, received0;
+    totals(sent0, received0);
+    double cpu_begin = process_cpu_s();
+    double switches_begin = context_switches();
+    Clock::time_point begin = Clock::now();
+    ioc.run_for(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+    Result r = {};
+    r.cpu_s = process_cpu_s() - cpu_begin;
+    r.wall_s = std::chrono::duration<double>(Clock::now() - begin).count();
+    r.switches = context_switches() - switches_begin;
+    uint64_t sent1, received1;
+    totals(sent1, received1);
+    r.sent = sent1 - sent0;
+    r.received = received1 - received0;
+
+    timer.cancel();
+    for (std::size_t i = 0; i < streams; ++i) {
+        senders[i]->close();
+        receivers[i]->close();
+    }
+    ioc.run_for(std::chrono::milliseconds(100));
+    return r;
+}
+
+// 一个会话: socket + poll 线程, 收到的 RTP 解析后记到自己的 RtpStatsTable
+struct Session {
+    int fd = -1;
+    sockaddr_in addr;
+    std::thread thread;
+    std::atomic<uint64_t> received {0};
+    RtpStatsTable table {4};
+};
+
+static void poll_loop(Session *s, const std::atomic<bool> *running, Clock::time_point epoch)
+{
+    uint8_t buf[kRtpMaxPacket];
+    pollfd pfd = {s->fd, POLLIN, 0};
+    while (running->load(std::memory_order_relaxed)) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        for (;;) {
+            ssize_t n = recv(s->fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n <= 0) {
+                break;
+            }
+            RtpHeader hdr;
+            if (!parseRtpHeader(buf, static_cast<std::size_t>(n), hdr)) {
+                continue;
+            }
+            bool is_new = false;
+            double arrival = std::chrono::duration<double>(Clock::now() - epoch).count();
+            s->table.onRtp(hdr.ssrc, hdr.seq, hdr.timestamp, arrival, is_new);
+            s->received.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+static bool open_session(Session &s)
+{
+    s.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s.fd < 0) {
+        return false;
+    }
+    std::memset(&s.addr, 0, sizeof(s.addr));
+    s.addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &s.addr.sin_addr);
+    socklen_t len = sizeof(s.addr);
+    return bind(s.fd, reinterpret_cast<sockaddr *>(&s.addr), sizeof(s.addr)) == 0
+           && getsockname(s.fd, reinterpret_cast<sockaddr *>(&s.addr), &len) == 0;
+}
+
+static Result run_threads(std::size_t streams, double seconds)
+{
+    std::atomic<bool> running {true};
+    Clock::time_point epoch = Clock::now();
+    // 发送端的会话也有自己的 poll 线程 (收对端的 RTCP), 这里它只会空等
+    std::vector<std::unique_ptr<Session>> senders;
+    std::vector<std::unique_ptr<Session>> receivers;
+    for (std::size_t i = 0; i < streams; ++i) {
+        senders.emplace_back(new Session);
+        receivers.emplace_back(new Session);
+        if (!open_session(*senders[i]) || !open_session(*receivers[i])) {
+            std::printf("open failed (ulimit -n?)\n");
+            std::exit(1);
+        }
+        connect(senders[i]->fd, reinterpret_cast<sockaddr *>(&receivers[i]->addr), sizeof(sockaddr_in));
+        senders[i]->thread = std::thread(poll_loop, senders[i].get(), &running, epoch);
+        receivers[i]->thread = std::thread(poll_loop, receivers[i].get(), &running, epoch);
+    }
+
+    uint8_t packet[kRtpHeaderSize + kPayload];
+    std::memset(packet, 0xD5, sizeof(packet));
+    uint16_t seq = 0;
+    uint32_t timestamp = 0;
+    uint64_t sent = 0;
+    auto send_all = [&]() {
+        packet[0] = 0x80;
+        packet[1] = 111;
+        rtpWrite16(packet + 2, seq++);
+        rtpWrite32(packet + 4, timestamp);
+        timestamp += kSamples;
+        for (std::size_t i = 0; i < streams; ++i) {
+            rtpWrite32(packet + 8, static_cast<uint32_t>(i + 1));
+            if (send(senders[i]->fd, packet, sizeof(packet), 0) > 0) {
+                ++sent;
+            }
+        }
+    };
+    auto received = [&]() {
+        uint64_t total = 0;
+        for (auto &s : receivers) {
+            total += s->received.load(std::memory_order_relaxed);
+        }
+        return total;
+    };
+
+    Clock::time_point due = Clock::now();
+    Clock::time_point warm_end = due + kWarmup;
+    while (due < warm_end) {
+        send_all();
+        due += kInterval;
+        std::this_thread::sleep_until(due);
+    }
+    uint64_t sent0 = sent;
+    uint64_t received0 = received();
+    double cpu_begin = process_cpu_s();
+    double switches_begin = context_switches();
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    while (due < end) {
+        send_all();
+        due += kInterval;
+        std::this_thread::sleep_until(due);
+    }
+    Result r = {};
+    r.cpu_s = process_cpu_s() - cpu_begin;
+    r.wall_s = std::chrono::duration<double>(Clock::now() - begin).count();
+    r.switches = context_switches() - switches_begin;
+    r.sent = sent - sent0;
+    r.received = received() - received0;
+
+    running = false;
+    for (std::size_t i = 0; i < streams; ++i) {
+        senders[i]->thread.join();
+        receivers[i]->thread.join();
+        close(senders[i]->fd);
+        close(receivers[i]->fd);
+    }
+    return r;
+}
+
+static void print_result(const char *mode, std::size_t streams, const Result &r)
+{
+    double per_stream = r.cpu_s / r.wall_s / streams * 100;
+    std::printf("%-15s %7zu %10.0f %7.2f%% %7.1f%% %10.3f%% %10.0f\n", mode, streams, r.sent / r.wall_s,
+                r.sent ? 100.0 * (r.sent - std::min(r.sent, r.received)) / r.sent : 0.0, r.cpu_s / r.wall_s * 100,
+                per_stream, r.switches / r.wall_s);
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 3.0;
+    if (seconds <= 0) {
+        seconds = 3.0;
+    }
+    std::vector<std::size_t> levels;
+    for (int i = 2; i < argc; ++i) {
+        levels.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+    if (levels.empty()) {
+        levels = {100, 500, 1000};
+    }
+
+    std::printf("loopback, 50 pps x %zu B per stream, %.1f s per row; cpu = process cpu time / wall time\n", kPayload,
+                seconds);
+    std::printf("%-15s %7s %10s %8s %8s %11s %10s\n", "mode", "streams", "pkt/s", "loss", "cpu", "cpu/stream",
+                "csw/s");
+    for (std::size_t streams : levels) {
+        print_result("rtp_transport", streams, run_transport(streams, seconds));
+        print_result("thread/session", streams, run_threads(streams, seconds));
+    }
+    return 0;
+}
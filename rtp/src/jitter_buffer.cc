@@ -0,0 +1,237 @@
+#include "jitter_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+JitterBuffer::JitterBuffer() :
+    JitterBuffer(Config())
+{
+}
+
+JitterBuffer::JitterBuffer(const Config &cfg) :
+    m_cfg(cfg),
+    m_mask(cfg.slots - 1),
+    m_slots(cfg.slots),
+    m_data(cfg.slots * cfg.max_payload),
+    m_margin_ms(0),
+    m_late_rate(0),
+    m_stats()
+{
+    reset();
+}
+
+void JitterBuffer::push(uint16_t seq, uint32_t timestamp, const uint8_t *payload, std::size_t size, double arrival_ms)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    ++m_stats.received;
+
+    // 已经播放 (或补帧) 过的 seq
+    if (m_have_played && seqDiff(seq, m_last_played) <= 0) {
+        if (seqDiff(m_last_played, seq) < static_cast<int>(m_slots.size())) {
+            updateJitter(timestamp, arrival_ms);
+            onLate();
+            return;
+        }
+        // 差距过大, 对端重新开始了流
+        reset();
+    }
+    if (m_playing && seqDiff(seq, m_next_seq) >= static_cast<int>(m_slots.size())) {
+        reset();
+    }
+    double ts_ms = updateJitter(timestamp, arrival_ms);
+    if (!m_playing) {
+        if (!m_have_first) {
+            m_have_first = true;
+            m_first_arrival_ms = arrival_ms;
+            m_next_seq = seq;
+            m_highest_seq = seq;
+        }
+        else if (seqDiff(seq, m_next_seq) < 0) {
+            m_next_seq = seq;
+        }
+    }
+
+    Slot &s = slot(seq);
+    if (s.valid && s.seq == seq) {
+        ++m_stats.duplicate;
+        return;
+    }
+    if (size > m_cfg.max_payload || (m_hold && (seq & m_mask) == (m_hold_seq & m_mask))) {
+        ++m_stats.dropped;
+        return;
+    }
+    std::memcpy(slotData(seq), payload, size);
+    s.valid = true;
+    s.seq = seq;
+    s.ts_ms = ts_ms;
+    s.size = size;
+    if (seqDiff(seq, m_highest_seq) > 0) {
+        m_highest_seq = seq;
+    }
+
+    // 按时到达: 迟到率衰减, 余量缓慢回落 (约 10 s 回落一帧)
+    m_late_rate -= m_late_rate / 64;
+    m_margin_ms = std::max(0.0, m_margin_ms - frameMs() / 500);
+}
+
+JitterBuffer::Frame JitterBuffer::pop(double now_ms)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_hold = false;
+    Frame f {kNone, nullptr, 0, m_next_seq};
+
+    if (!m_playing) {
+        if (!m_have_first || now_ms - m_first_arrival_ms < targetDelayMs()) {
+            return f;
+        }
+        Slot &first = slot(m_next_seq);
+        if (!first.valid || first.seq != m_next_seq) {
+            return f;
+        }
+        m_playing = true;
+        m_plc_run = 0;
+        m_play_ts_ms = first.ts_ms;
+    }
+
+    double offset = now_ms - m_play_ts_ms;
+    double desired = m_min_transit_ms + targetDelayMs();
+    if (offset < desired - frameMs()) {
+        // 延迟不足, 插入一帧, 媒体时间不前进
+        f.action = kPlc;
+        ++m_stats.plc;
+        ++m_stats.inserted;
+        return f;
+    }
+    if (offset > desired + 2 * frameMs() && seqDiff(m_highest_seq, m_next_seq) > 0) {
+        // 积压过多, 丢掉最旧的一帧追赶
+        Slot &old = slot(m_next_seq);
+        if (old.valid && old.seq == m_next_seq) {
+            old.valid = false;
+        }
+        m_have_played = true;
+        m_last_played = m_next_seq;
+        ++m_next_seq;
+        m_play_ts_ms += frameMs();
+        ++m_stats.dropped;
+    }
+
+    Slot &cur = slot(m_next_seq);
+    uint16_t next = static_cast<uint16_t>(m_next_seq + 1);
+    Slot &nxt = slot(next);
+    if (cur.valid && cur.seq == m_next_seq) {
+        f.action = kPacket;
+        f.payload = slotData(m_next_seq);
+        f.size = cur.size;
+        cur.valid = false;
+        m_hold = true;
+        m_hold_seq = m_next_seq;
+        m_plc_run = 0;
+        m_play_ts_ms = cur.ts_ms;
+        ++m_stats.played;
+    }
+    else if (nxt.valid && nxt.seq == next) {
+        // 下一个包还要正常解码, 不消费
+        f.action = kFec;
+        f.payload = slotData(next);
+        f.size = nxt.size;
+        m_hold = true;
+        m_hold_seq = next;
+        m_plc_run = 0;
+        ++m_stats.fec;
+    }
+    else if (++m_plc_run > m_cfg.max_plc_frames) {
+        // 对端停发 (DTX / 挂断), 停止补帧, 下一个包到来时按新的目标延迟重新起播
+        m_playing = false;
+        m_have_first = false;
+        return f;
+    }
+    else {
+        f.action = kPlc;
+        ++m_stats.plc;
+    }
+
+    f.seq = m_next_seq;
+    m_have_played = true;
+    m_last_played = m_next_seq;
+    ++m_next_seq;
+    m_play_ts_ms += frameMs();
+    return f;
+}
+
+JitterBuffer::Stats JitterBuffer::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    Stats s = m_stats;
+    s.jitter_ms = m_jitter_ms;
+    s.target_delay_ms = targetDelayMs();
+    return s;
+}
+
+double JitterBuffer::updateJitter(uint32_t timestamp, double arrival_ms)
+{
+    int64_t ts_ext = 0;
+    if (m_have_arrival) {
+        ts_ext = m_last_ts_ext + static_cast<int32_t>(timestamp - m_last_timestamp);
+    }
+    double ts_ms = ts_ext * 1000.0 / m_cfg.clock_rate;
+    double transit = arrival_ms - ts_ms;
+    if (m_have_arrival) {
+        double d = transit - (m_last_arrival_ms - m_last_ts_ext * 1000.0 / m_cfg.clock_rate);
+        m_jitter_ms += (std::fabs(d) - m_jitter_ms) / 16;
+        // 最小传输时延缓慢上浮, 以跟上路由变化与时钟漂移
+        m_min_transit_ms = std::min(transit, m_min_transit_ms + 0.01);
+    }
+    else {
+        m_min_transit_ms = transit;
+    }
+    m_have_arrival = true;
+    m_last_arrival_ms = arrival_ms;
+    m_last_timestamp = timestamp;
+    m_last_ts_ext = ts_ext;
+    return ts_ms;
+}
+
+void JitterBuffer::onLate()
+{
+    ++m_stats.late;
+    m_late_rate += (1.0 - m_late_rate) / 64;
+    if (m_late_rate > m_cfg.max_late_rate) {
+        m_margin_ms = std::min(m_margin_ms + frameMs(), m_cfg.max_delay_ms);
+        m_late_rate = 0;
+    }
+}
+
+void JitterBuffer::reset()
+{
+    for (auto &s : m_slots) {
+        s.valid = false;
+    }
+    m_playing = false;
+    m_have_first = false;
+    m_first_arrival_ms = 0;
+    m_next_seq = 0;
+    m_highest_seq = 0;
+    m_have_played = false;
+    m_last_played = 0;
+    m_hold_seq = 0;
+    m_hold = false;
+    m_plc_run = 0;
+    m_play_ts_ms = 0;
+    m_have_arrival = false;
+    m_last_arrival_ms = 0;
+    m_last_timestamp = 0;
+    m_last_ts_ext = 0;
+    m_min_transit_ms = 0;
+    m_jitter_ms = 0;
+}
+
+double JitterBuffer::frameMs() const
+{
+    return m_cfg.frame_samples * 1000.0 / m_cfg.clock_rate;
+}
+
+double JitterBuffer::targetDelayMs() const
+{
+    double delay = m_cfg.jitter_k * m_jitter_ms + m_margin_ms;
+    return std::min(std::max(delay, m_cfg.min_delay_ms), m_cfg.max_delay_ms);
+}
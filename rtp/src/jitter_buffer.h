@@ -0,0 +1,134 @@
+#ifndef _JITTER_BUFFER_H_
+#define _JITTER_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief 按 RTP seq / timestamp 排序的自适应抖动缓冲
+ *
+ * push 在网络线程调用, 负载拷贝进预分配的槽; pop 由播放时钟每帧调用一次,
+ * 返回该帧应当如何解码: 正常包 / 用下一个包的 in-band FEC 恢复 / PLC 补帧
+ *
+ * 播放延迟 (相对最小传输时延) = clamp(jitter_k * 到达抖动 (RFC 3550 A.8) + margin, min, max),
+ * margin 在迟到 (已被补帧后才到达) 的比例超过 max_late_rate 时增加一帧,
+ * 否则缓慢回落, 在延迟尽量小的同时把补帧率限制在上限附近;
+ * 实际延迟低于目标一帧以上时插入一帧 PLC, 高于目标两帧以上时丢弃最旧的一帧
+ */
+class JitterBuffer
+{
+public:
+    struct Config {
+        uint32_t clock_rate = 48000;
+        uint32_t frame_samples = 960;   // 20 ms
+        std::size_t slots = 64;         // 2 的幂
+        std::size_t max_payload = 1500;
+        double min_delay_ms = 20;
+        double max_delay_ms = 300;
+        double jitter_k = 3.0;
+        double max_late_rate = 0.02;
+        unsigned max_plc_frames = 5;    // 连续补帧超过此数后停止并重新缓冲
+    };
+
+    enum Action {
+        kNone,   // 缓冲中, 播放静音
+        kPacket, // 正常解码 payload
+        kFec,    // payload 是后一个包, 用 decode_fec=1 恢复当前帧
+        kPlc,    // 无数据, 丢包隐藏
+    };
+
+    struct Frame {
+        Action action;
+        const uint8_t *payload; // 指向内部槽, 下一次 push/pop 前有效
+        std::size_t size;
+        uint16_t seq;
+    };
+
+    struct Stats {
+        uint64_t received;
+        uint64_t played;
+        uint64_t late;
+        uint64_t duplicate;
+        uint64_t fec;
+        uint64_t plc;
+        uint64_t inserted; // 为加大延迟插入的 PLC 帧, 也计入 plc
+        uint64_t dropped;
+        double jitter_ms;
+        double target_delay_ms;
+    };
+
+    JitterBuffer();
+    explicit JitterBuffer(const Config &cfg);
+
+    // arrival_ms: 本地单调时钟的到达时间
+    void push(uint16_t seq, uint32_t timestamp, const uint8_t *payload, std::size_t size, double arrival_ms);
+
+    // 由播放线程每 frame_samples 调用一次; 返回的 payload 所在槽在下一次 pop 之前不会被 push 覆盖
+    Frame pop(double now_ms);
+
+    Stats stats();
+
+private:
+    struct Slot {
+        bool valid;
+        uint16_t seq;
+        double ts_ms; // 展开回绕后的时间戳
+        std::size_t size;
+    };
+
+    static int16_t seqDiff(uint16_t a, uint16_t b)
+    {
+        return static_cast<int16_t>(a - b);
+    }
+
+    Slot &slot(uint16_t seq)
+    {
+        return m_slots[seq & m_mask];
+    }
+
+    uint8_t *slotData(uint16_t seq)
+    {
+        return m_data.data() + (seq & m_mask) * m_cfg.max_payload;
+    }
+
+    double updateJitter(uint32_t timestamp, double arrival_ms);
+    void onLate();
+    void reset();
+    double frameMs() const;
+    double targetDelayMs() const;
+
+private:
+    Config m_cfg;
+    std::size_t m_mask;
+    std::vector<Slot> m_slots;
+    std::vector<uint8_t> m_data;
+    std::mutex m_mtx;
+
+    bool m_playing;
+    bool m_have_first;
+    double m_first_arrival_ms;
+    uint16_t m_next_seq;      // 下一帧要播放的 seq
+    uint16_t m_highest_seq;
+    bool m_have_played;
+    uint16_t m_last_played;
+    uint16_t m_hold_seq;      // 正在被调用方解码的槽
+    bool m_hold;
+    unsigned m_plc_run;
+
+    double m_play_ts_ms;      // 下一帧的媒体时间
+
+    bool m_have_arrival;
+    double m_last_arrival_ms;
+    uint32_t m_last_timestamp;
+    int64_t m_last_ts_ext;
+    double m_min_transit_ms;
+    double m_jitter_ms;
+    double m_margin_ms;
+    double m_late_rate;
+
+    Stats m_stats;
+};
+
+#endif // _JITTER_BUFFER_H_
@@ -0,0 +1,81 @@
+#include "rtp_buffer_pool.h"
+
+RtpBufferPool::Buffer::Buffer(Buffer &&other) :
+    m_pool(std::move(other.m_pool)),
+    m_data(other.m_data),
+    m_size(other.m_size),
+    m_capacity(other.m_capacity)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+}
+
+RtpBufferPool::Buffer &RtpBufferPool::Buffer::operator=(Buffer &&other)
+{
+    if (this != &other) {
+        reset();
+        m_pool = std::move(other.m_pool);
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_capacity = 0;
+    }
+    return *this;
+}
+
+void RtpBufferPool::Buffer::reset()
+{
+    if (m_data) {
+        m_pool->release(m_data);
+        m_data = nullptr;
+    }
+    m_pool.reset();
+    m_size = 0;
+    m_capacity = 0;
+}
+
+RtpBufferPool::Sptr RtpBufferPool::create(std::size_t count, std::size_t buf_size)
+{
+    return Sptr(new RtpBufferPool(count, buf_size));
+}
+
+RtpBufferPool::RtpBufferPool(std::size_t count, std::size_t buf_size) :
+    m_count(count),
+    m_buf_size(buf_size),
+    m_storage(count * buf_size)
+{
+    m_free.reserve(count);
+    for (std::size_t i = count; i > 0; --i) {
+        m_free.push_back(&m_storage[(i - 1) * buf_size]);
+    }
+}
+
+RtpBufferPool::Buffer RtpBufferPool::acquire()
+{
+    uint8_t *data;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_free.empty()) {
+            return Buffer();
+        }
+        // 后进先出, 刚还回来的缓冲大概率还在缓存里
+        data = m_free.back();
+        m_free.pop_back();
+    }
+    return Buffer(shared_from_this(), data, m_buf_size);
+}
+
+std::size_t RtpBufferPool::available()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_free.size();
+}
+
+void RtpBufferPool::release(uint8_t *data)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_free.push_back(data);
+}
@@ -0,0 +1,123 @@
+#ifndef _RTP_BUFFER_POOL_H_
+#define _RTP_BUFFER_POOL_H_
+
+#include "rtp_packet.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief 固定大小的收包缓冲池
+ *
+ * 所有缓冲在创建时一次性分配在连续内存上; Buffer 是只能移动的句柄,
+ * 析构时把缓冲还回池中, 所以可以交给上层 (如 JitterBuffer) 持有一段时间
+ * acquire / 归还可以在任意线程进行
+ */
+class RtpBufferPool : public std::enable_shared_from_this<RtpBufferPool>
+{
+public:
+    using Sptr = std::shared_ptr<RtpBufferPool>;
+
+    class Buffer
+    {
+    public:
+        Buffer() :
+            m_data(nullptr),
+            m_size(0),
+            m_capacity(0)
+        {
+        }
+
+        ~Buffer()
+        {
+            reset();
+        }
+
+        Buffer(Buffer &&other);
+        Buffer &operator=(Buffer &&other);
+
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+
+        // 提前归还缓冲
+        void reset();
+
+        uint8_t *data() const
+        {
+            return m_data;
+        }
+
+        std::size_t size() const
+        {
+            return m_size;
+        }
+
+        void resize(std::size_t size)
+        {
+            m_size = size < m_capacity ? size : m_capacity;
+        }
+
+        std::size_t capacity() const
+        {
+            return m_capacity;
+        }
+
+        explicit operator bool() const
+        {
+            return m_data != nullptr;
+        }
+
+    private:
+        friend class RtpBufferPool;
+
+        Buffer(const Sptr &pool, uint8_t *data, std::size_t capacity) :
+            m_pool(pool),
+            m_data(data),
+            m_size(0),
+            m_capacity(capacity)
+        {
+        }
+
+    private:
+        Sptr m_pool;
+        uint8_t *m_data;
+        std::size_t m_size;
+        std::size_t m_capacity;
+    };
+
+    static Sptr create(std::size_t count, std::size_t buf_size = kRtpMaxPacket);
+
+    RtpBufferPool(const RtpBufferPool &) = delete;
+    RtpBufferPool &operator=(const RtpBufferPool &) = delete;
+
+    // 池空时返回空 Buffer
+    Buffer acquire();
+
+    std::size_t available();
+
+    std::size_t count() const
+    {
+        return m_count;
+    }
+
+    std::size_t bufferSize() const
+    {
+        return m_buf_size;
+    }
+
+private:
+    RtpBufferPool(std::size_t count, std::size_t buf_size);
+
+    void release(uint8_t *data);
+
+private:
+    std::size_t m_count;
+    std::size_t m_buf_size;
+    std::vector<uint8_t> m_storage;
+    std::mutex m_mtx;
+    std::vector<uint8_t *> m_free;
+};
+
+#endif // _RTP_BUFFER_POOL_H_
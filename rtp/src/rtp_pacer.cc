@@ -0,0 +1,253 @@
+#include "rtp_pacer.h"
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cstring>
+#include <ctime>
+
+RtpPacer::RtpPacer() :
+    RtpPacer(Config())
+{
+}
+
+RtpPacer::RtpPacer(const Config &cfg) :
+    m_cfg(cfg),
+    m_mask(cfg.wheel_slots - 1),
+    m_timer_fd(-1),
+    m_running(false),
+    m_wheel(cfg.wheel_slots, kNil),
+    m_cur_tick(nowUs() / cfg.tick_us + 1),
+    m_stats()
+{
+}
+
+RtpPacer::~RtpPacer()
+{
+    stop();
+}
+
+uint64_t RtpPacer::nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000u + static_cast<uint64_t>(ts.tv_nsec) / 1000u;
+}
+
+uint64_t RtpPacer::add(uint32_t interval_us, Callback cb)
+{
+    if (interval_us == 0 || !cb) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    uint32_t index;
+    if (!m_free_ids.empty()) {
+        index = m_free_ids.back();
+        m_free_ids.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(m_gens.size());
+        m_gens.push_back(0);
+    }
+    uint64_t id = (static_cast<uint64_t>(++m_gens[index]) << 32) | index;
+    m_cmds.push_back(Command {id, interval_us, std::move(cb)});
+    return id;
+}
+
+void RtpPacer::remove(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(m_cmd_mtx);
+    m_cmds.push_back(Command {id, 0, nullptr});
+}
+
+bool RtpPacer::start(int cpu)
+{
+    if (m_running.load()) {
+        return true;
+    }
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (m_timer_fd < 0) {
+        return false;
+    }
+    // 周期定时器, 首次到期对齐到下一个要处理的 tick 边界
+    uint64_t first = m_cur_tick * m_cfg.tick_us;
+    struct itimerspec its;
+    its.it_value.tv_sec = static_cast<time_t>(first / 1000000u);
+    its.it_value.tv_nsec = static_cast<long>(first % 1000000u) * 1000;
+    its.it_interval.tv_sec = static_cast<time_t>(m_cfg.tick_us / 1000000u);
+    its.it_interval.tv_nsec = static_cast<long>(m_cfg.tick_us % 1000000u) * 1000;
+    if (timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &its, nullptr) < 0) {
+        close(m_timer_fd);
+        m_timer_fd = -1;
+        return false;
+    }
+    m_running.store(true);
+    m_thread = std::thread([this]() {
+        run();
+    });
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(m_thread.native_handle(), sizeof(set), &set);
+    }
+    return true;
+}
+
+void RtpPacer::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_timer_fd >= 0) {
+        close(m_timer_fd);
+        m_timer_fd = -1;
+    }
+}
+
+RtpPacer::Stats RtpPacer::stats()
+{
+    std::lock_guard<std::mutex> lock(m_stats_mtx);
+    return m_stats;
+}
+
+void RtpPacer::run()
+{
+    while (m_running.load(std::memory_order_relaxed)) {
+        uint64_t expirations = 0;
+        if (read(m_timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            continue;
+        }
+        uint64_t now = nowUs();
+        applyCommands(now);
+        if (fire(now) && m_flush) {
+            m_flush();
+        }
+    }
+}
+
+void RtpPacer::applyCommands(uint64_t now_us)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_cmd_mtx);
+        if (m_cmds.empty()) {
+            return;
+        }
+        m_cmds_work.swap(m_cmds);
+    }
+    for (auto &cmd : m_cmds_work) {
+        uint32_t index = static_cast<uint32_t>(cmd.id);
+        uint32_t gen = static_cast<uint32_t>(cmd.id >> 32);
+        if (cmd.interval_us == 0) {
+            // 只做标记, 到期处理时从时间轮上摘下
+            if (index < m_entries.size() && m_entries[index].gen == gen) {
+                m_entries[index].active = false;
+            }
+            continue;
+        }
+        if (index >= m_entries.size()) {
+            m_entries.resize(index + 1);
+        }
+        Entry &e = m_entries[index];
+        // 首次到期在一个周期内按 id 错开, 并对齐到 tick 边界
+        uint64_t phase = (static_cast<uint64_t>(index) * 2654435761u) % cmd.interval_us;
+        e.due_us = (now_us + phase) / m_cfg.tick_us * m_cfg.tick_us;
+        e.interval_us = cmd.interval_us;
+        e.gen = gen;
+        e.next = kNil;
+        e.active = true;
+        e.cb = std::move(cmd.cb);
+        schedule(index);
+        std::lock_guard<std::mutex> lock(m_stats_mtx);
+        ++m_stats.streams;
+    }
+    m_cmds_work.clear();
+}
+
+void RtpPacer::schedule(uint32_t index)
+{
+    Entry &e = m_entries[index];
+    uint64_t tick = e.due_us / m_cfg.tick_us;
+    if (tick < m_cur_tick) {
+        tick = m_cur_tick;
+    }
+    std::size_t slot = tick & m_mask;
+    e.next = m_wheel[slot];
+    m_wheel[slot] = index;
+}
+
+void RtpPacer::release(uint32_t index)
+{
+    m_entries[index].active = false;
+    m_entries[index].cb = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_cmd_mtx);
+        m_free_ids.push_back(index);
+    }
+    std::lock_guard<std::mutex> lock(m_stats_mtx);
+    --m_stats.streams;
+}
+
+bool RtpPacer::fire(uint64_t now_us)
+{
+    uint64_t now_tick = now_us / m_cfg.tick_us;
+    uint64_t sends = 0;
+    uint64_t resyncs = 0;
+    uint64_t late_max = 0;
+    uint64_t hist[kLateBuckets] = {};
+    while (m_cur_tick <= now_tick) {
+        uint64_t tick = m_cur_tick++;
+        std::size_t slot = tick & m_mask;
+        uint32_t index = m_wheel[slot];
+        m_wheel[slot] = kNil;
+        while (index != kNil) {
+            Entry &e = m_entries[index];
+            uint32_t next = e.next;
+            if (!e.active) {
+                release(index);
+            }
+            else if (e.due_us / m_cfg.tick_us > tick) {
+                // 时间轮的后面几圈才到期
+                e.next = m_wheel[slot];
+                m_wheel[slot] = index;
+            }
+            else {
+                uint64_t late = now_us > e.due_us ? now_us - e.due_us : 0;
+                std::size_t bucket = 0;
+                while (bucket + 1 < kLateBuckets && (1ull << bucket) <= late) {
+                    ++bucket;
+                }
+                ++hist[bucket];
+                if (late > late_max) {
+                    late_max = late;
+                }
+                ++sends;
+                if (!e.cb(e.due_us)) {
+                    release(index);
+                }
+                else {
+                    e.due_us += e.interval_us;
+                    if (e.due_us <= now_us) {
+                        // 落后超过一个周期: 跳过错过的发送时刻, 保持原来的相位
+                        e.due_us += ((now_us - e.due_us) / e.interval_us + 1) * e.interval_us;
+                        ++resyncs;
+                    }
+                    schedule(index);
+                }
+            }
+            index = next;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_stats_mtx);
+    ++m_stats.ticks;
+    m_stats.sends += sends;
+    m_stats.resyncs += resyncs;
+    if (late_max > m_stats.late_max_us) {
+        m_stats.late_max_us = late_max;
+    }
+    for (std::size_t i = 0; i < kLateBuckets; ++i) {
+        m_stats.late_hist[i] += hist[i];
+    }
+    return sends > 0;
+}
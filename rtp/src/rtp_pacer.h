@@ -0,0 +1,117 @@
+#ifndef _RTP_PACER_H_
+#define _RTP_PACER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 单线程时间轮 + timerfd 驱动的 RTP 发送节拍器
+ *
+ * 每个核一个 RtpPacer, 一个 timerfd 按 tick_us 唤醒, 每次取出时间轮上所有到期的流
+ * 依次回调 (回调里组包并放进发送批次), 然后调用一次 flush 把这批包发出去;
+ * 流的首次到期时间在周期内错开, 避免所有流挤在同一个 tick 上
+ *
+ * add / remove 可以在任意线程调用, 在下一个 tick 开始时生效
+ */
+class RtpPacer
+{
+public:
+    struct Config {
+        uint32_t tick_us = 1000;
+        std::size_t wheel_slots = 256; // 2 的幂, tick_us * wheel_slots 最好大于最长周期
+    };
+
+    // due_us: 本次计划发送时间 (CLOCK_MONOTONIC); 返回 false 则不再调度
+    using Callback = std::function<bool(uint64_t due_us)>;
+    using Flush = std::function<void()>;
+
+    // 实际回调时间相对计划时间的延后, 按 2 的幂 (微秒) 分桶
+    static const std::size_t kLateBuckets = 20;
+
+    struct Stats {
+        std::size_t streams;
+        uint64_t ticks;
+        uint64_t sends;
+        uint64_t resyncs;     // 落后超过一个周期, 重新对齐
+        uint64_t late_max_us;
+        uint64_t late_hist[kLateBuckets]; // [i] 统计 late < 2^i us, 最后一桶包含更大的值
+    };
+
+    RtpPacer();
+    explicit RtpPacer(const Config &cfg);
+    ~RtpPacer();
+
+    RtpPacer(const RtpPacer &) = delete;
+    RtpPacer &operator=(const RtpPacer &) = delete;
+
+    // 返回流 id; interval_us 为发送周期 (如 20 ms)
+    uint64_t add(uint32_t interval_us, Callback cb);
+    void remove(uint64_t id);
+
+    void setFlush(Flush flush)
+    {
+        m_flush = std::move(flush);
+    }
+
+    // cpu >= 0 时把线程绑到该核
+    bool start(int cpu = -1);
+    void stop();
+
+    Stats stats();
+
+    static uint64_t nowUs();
+
+private:
+    struct Entry {
+        uint64_t due_us;
+        uint32_t interval_us;
+        uint32_t gen;
+        uint32_t next;   // 同一槽内的下一个, kNil 结束
+        bool active;
+        Callback cb;
+    };
+
+    struct Command {
+        uint64_t id;
+        uint32_t interval_us;
+        Callback cb;
+    };
+
+    static const uint32_t kNil = 0xFFFFFFFFu;
+
+    void run();
+    void applyCommands(uint64_t now_us);
+    void schedule(uint32_t index);
+    void release(uint32_t index);
+    bool fire(uint64_t now_us);
+
+private:
+    Config m_cfg;
+    std::size_t m_mask;
+    int m_timer_fd;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    Flush m_flush;
+
+    // 以下只在 pacer 线程访问
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_wheel;  // 每个槽的链表头
+    uint64_t m_cur_tick;            // 下一个要处理的 tick 序号
+
+    std::mutex m_cmd_mtx;
+    std::vector<Command> m_cmds;
+    std::vector<Command> m_cmds_work;
+    // id = 代数 << 32 | 下标, 下标在 entry 从时间轮上摘下后才回收
+    std::vector<uint32_t> m_gens;
+    std::vector<uint32_t> m_free_ids;
+
+    std::mutex m_stats_mtx;
+    Stats m_stats;
+};
+
+#endif // _RTP_PACER_H_
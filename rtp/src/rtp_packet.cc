@@ -0,0 +1,51 @@
+#include "rtp_packet.h"
+
+bool parseRtpHeader(const uint8_t *data, std::size_t size, RtpHeader &hdr)
+{
+    if (size < kRtpHeaderSize || (data[0] >> 6) != 2) {
+        return false;
+    }
+    bool padding = (data[0] & 0x20) != 0;
+    bool extension = (data[0] & 0x10) != 0;
+    hdr.csrc_count = data[0] & 0x0F;
+    hdr.marker = (data[1] & 0x80) != 0;
+    hdr.payload_type = data[1] & 0x7F;
+    hdr.seq = rtpRead16(data + 2);
+    hdr.timestamp = rtpRead32(data + 4);
+    hdr.ssrc = rtpRead32(data + 8);
+
+    std::size_t offset = kRtpHeaderSize + 4u * hdr.csrc_count;
+    if (offset > size) {
+        return false;
+    }
+    hdr.csrc = data + kRtpHeaderSize;
+
+    hdr.ext_profile = 0;
+    hdr.ext = nullptr;
+    hdr.ext_size = 0;
+    if (extension) {
+        if (offset + 4 > size) {
+            return false;
+        }
+        hdr.ext_profile = rtpRead16(data + offset);
+        hdr.ext_size = 4u * rtpRead16(data + offset + 2);
+        offset += 4;
+        if (offset + hdr.ext_size > size) {
+            return false;
+        }
+        hdr.ext = data + offset;
+        offset += hdr.ext_size;
+    }
+
+    std::size_t end = size;
+    if (padding) {
+        std::size_t pad = data[size - 1];
+        if (pad == 0 || offset + pad > size) {
+            return false;
+        }
+        end -= pad;
+    }
+    hdr.payload = data + offset;
+    hdr.payload_size = end - offset;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef _RTP_PACKET_H_
+#define _RTP_PACKET_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief RTP 固定头 (RFC 3550 5.1) 的读写工具, 不分配内存
+ */
+
+const std::size_t kRtpHeaderSize = 12;
+const std::size_t kRtpMaxCsrc = 15;
+const std::size_t kRtpMaxPacket = 1500;
+// RFC 8285 one-byte 扩展头的 profile
+const uint16_t kRtpOneByteExtProfile = 0xBEDE;
+
+struct RtpHeader {
+    bool marker;
+    uint8_t payload_type;
+    uint16_t seq;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t csrc_count;
+    const uint8_t *csrc;          // 网络序, csrc_count 个
+    uint16_t ext_profile;
+    const uint8_t *ext;           // 扩展数据 (不含 4 字节扩展头), 无扩展时为 nullptr
+    std::size_t ext_size;
+    const uint8_t *payload;
+    std::size_t payload_size;     // 已去掉 padding
+};
+
+// 解析 RTP 包, 返回的指针都指向 data 内部; 格式不对时返回 false
+bool parseRtpHeader(const uint8_t *data, std::size_t size, RtpHeader &hdr);
+
+// 区分 RTP 与同端口复用的 RTCP (RFC 5761 4)
+inline bool isRtcpPacket(const uint8_t *data, std::size_t size)
+{
+    return size >= 2 && (data[0] & 0xC0) == 0x80 && data[1] >= 192 && data[1] <= 223;
+}
+
+inline uint16_t rtpRead16(const uint8_t *p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t rtpRead32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+           | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline void rtpWrite16(uint8_t *p, uint16_t v)
+{
+    p[0] = static_cast<uint8_t>(v >> 8);
+    p[1] = static_cast<uint8_t>(v);
+}
+
+inline void rtpWrite32(uint8_t *p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+#endif // _RTP_PACKET_H_
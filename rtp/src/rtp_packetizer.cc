@@ -0,0 +1,165 @@
+#include "rtp_packetizer.h"
+#include <cstring>
+
+RtpPacketRing::RtpPacketRing(std::size_t slots, std::size_t slot_size) :
+    m_slots(slots),
+    m_slot_size(slot_size),
+    m_next(0),
+    m_storage(slots * slot_size),
+    m_busy(new std::atomic<bool>[slots])
+{
+    for (std::size_t i = 0; i < m_slots; ++i) {
+        m_busy[i].store(false, std::memory_order_relaxed);
+    }
+}
+
+uint8_t *RtpPacketRing::acquire(std::size_t &slot)
+{
+    if (m_busy[m_next].load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    slot = m_next;
+    m_busy[slot].store(true, std::memory_order_relaxed);
+    if (++m_next == m_slots) {
+        m_next = 0;
+    }
+    return m_storage.data() + slot * m_slot_size;
+}
+
+void RtpPacketRing::release(std::size_t slot)
+{
+    m_busy[slot].store(false, std::memory_order_release);
+}
+
+RtpPacketizer::RtpPacketizer(RtpPacketRing &ring,
+                             uint32_t ssrc,
+                             uint8_t payload_type,
+                             uint16_t seq,
+                             uint32_t timestamp) :
+    m_ring(ring),
+    m_ssrc(ssrc),
+    m_payload_type(payload_type & 0x7F),
+    m_seq(seq),
+    m_timestamp(timestamp),
+    m_csrc_count(0),
+    m_ext_size(0),
+    m_header_size(0),
+    m_cur(nullptr),
+    m_cur_slot(0),
+    m_cur_header_size(0)
+{
+    buildTemplate();
+}
+
+bool RtpPacketizer::setCsrcs(const uint32_t *csrcs, std::size_t count)
+{
+    if (count > kRtpMaxCsrc) {
+        return false;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        m_csrc[i] = csrcs[i];
+    }
+    m_csrc_count = count;
+    buildTemplate();
+    return true;
+}
+
+bool RtpPacketizer::setExtension(uint8_t id, const uint8_t *data, std::size_t len)
+{
+    if (id < 1 || id > 14 || len < 1 || len > 16) {
+        return false;
+    }
+    // 查找已有元素
+    std::size_t pos = 0;
+    while (pos < m_ext_size) {
+        uint8_t cur_id = m_ext[pos] >> 4;
+        std::size_t cur_len = (m_ext[pos] & 0x0F) + 1u;
+        if (cur_id == id) {
+            if (cur_len == len) {
+                std::memcpy(m_ext + pos + 1, data, len);
+                // 模板中扩展数据紧跟在 4 字节扩展头之后
+                std::size_t ext_off = kRtpHeaderSize + 4 * m_csrc_count + 4;
+                std::memcpy(m_template + ext_off + pos + 1, data, len);
+                return true;
+            }
+            std::memmove(m_ext + pos, m_ext + pos + 1 + cur_len, m_ext_size - pos - 1 - cur_len);
+            m_ext_size -= 1 + cur_len;
+            break;
+        }
+        pos += 1 + cur_len;
+    }
+    if (m_ext_size + 1 + len > kMaxExtSize) {
+        buildTemplate();
+        return false;
+    }
+    m_ext[m_ext_size] = static_cast<uint8_t>((id << 4) | (len - 1));
+    std::memcpy(m_ext + m_ext_size + 1, data, len);
+    m_ext_size += 1 + len;
+    buildTemplate();
+    return true;
+}
+
+void RtpPacketizer::clearExtensions()
+{
+    m_ext_size = 0;
+    buildTemplate();
+}
+
+uint8_t *RtpPacketizer::payload()
+{
+    if (!m_cur) {
+        m_cur = m_ring.acquire(m_cur_slot);
+        if (!m_cur) {
+            return nullptr;
+        }
+        std::memcpy(m_cur, m_template, m_header_size);
+        m_cur_header_size = m_header_size;
+    }
+    return m_cur + m_cur_header_size;
+}
+
+RtpPacket RtpPacketizer::commit(std::size_t payload_size, uint32_t samples, bool marker)
+{
+    RtpPacket pkt {m_cur, 0, m_cur_slot};
+    if (!m_cur) {
+        return pkt;
+    }
+    m_cur[1] = static_cast<uint8_t>((marker ? 0x80 : 0x00) | m_payload_type);
+    rtpWrite16(m_cur + 2, m_seq);
+    rtpWrite32(m_cur + 4, m_timestamp);
+    pkt.size = m_cur_header_size + payload_size;
+    ++m_seq;
+    m_timestamp += samples;
+    m_cur = nullptr;
+    return pkt;
+}
+
+void RtpPacketizer::abort()
+{
+    if (m_cur) {
+        m_ring.release(m_cur_slot);
+        m_cur = nullptr;
+    }
+}
+
+void RtpPacketizer::buildTemplate()
+{
+    uint8_t *p = m_template;
+    p[0] = static_cast<uint8_t>(0x80 | (m_ext_size ? 0x10 : 0x00) | m_csrc_count);
+    p[1] = m_payload_type;
+    rtpWrite32(p + 8, m_ssrc);
+    p += kRtpHeaderSize;
+    for (std::size_t i = 0; i < m_csrc_count; ++i, p += 4) {
+        rtpWrite32(p, m_csrc[i]);
+    }
+    if (m_ext_size) {
+        std::size_t words = (m_ext_size + 3) / 4;
+        rtpWrite16(p, kRtpOneByteExtProfile);
+        rtpWrite16(p + 2, static_cast<uint16_t>(words));
+        std::memcpy(p + 4, m_ext, m_ext_size);
+        // 不足 4 字节的部分用 0 (padding 元素) 补齐
+        std::memset(p + 4 + m_ext_size, 0, words * 4 - m_ext_size);
+        p += 4 + words * 4;
+    }
+    m_header_size = static_cast<std::size_t>(p - m_template);
+}
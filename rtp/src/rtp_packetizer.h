@@ -0,0 +1,149 @@
+#ifndef _RTP_PACKETIZER_H_
+#define _RTP_PACKETIZER_H_
+
+#include "rtp_packet.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 一个 RTP 包在 RtpPacketRing 中的位置
+ *
+ * data 指向槽内存, 发送方用完后调用 RtpPacketRing::release(slot)
+ */
+struct RtpPacket {
+    uint8_t *data;
+    std::size_t size;
+    std::size_t slot;
+};
+
+/**
+ * @brief 预分配的 RTP 包环形缓冲
+ *
+ * 所有槽一次性分配在连续内存上, 按顺序循环使用;
+ * 单生产者 acquire, release 可以在发送完成的其他线程调用
+ */
+class RtpPacketRing
+{
+public:
+    explicit RtpPacketRing(std::size_t slots, std::size_t slot_size = kRtpMaxPacket);
+
+    RtpPacketRing(const RtpPacketRing &) = delete;
+    RtpPacketRing &operator=(const RtpPacketRing &) = delete;
+
+    // 下一个槽仍在发送中 (环已满) 时返回 nullptr
+    uint8_t *acquire(std::size_t &slot);
+    void release(std::size_t slot);
+
+    void release(const RtpPacket &pkt)
+    {
+        release(pkt.slot);
+    }
+
+    std::size_t slotSize() const
+    {
+        return m_slot_size;
+    }
+
+    std::size_t slots() const
+    {
+        return m_slots;
+    }
+
+private:
+    std::size_t m_slots;
+    std::size_t m_slot_size;
+    std::size_t m_next;
+    std::vector<uint8_t> m_storage;
+    std::unique_ptr<std::atomic<bool>[]> m_busy;
+};
+
+/**
+ * @brief 原地组包的 RTP 打包器
+ *
+ * 固定头 + CSRC + 扩展头预先写好一份模板, 每个包只拷贝模板并回填
+ * seq / timestamp / marker; 负载由调用方 (如 opus_encode) 直接写进槽内
+ *
+ *     uint8_t *payload = packetizer.payload();
+ *     int n = opus_encode(enc, pcm, 960, payload, packetizer.payloadCapacity());
+ *     RtpPacket pkt = packetizer.commit(n, 960);
+ *     send(pkt.data, pkt.size);
+ *     ring.release(pkt);
+ */
+class RtpPacketizer
+{
+public:
+    // RFC 8285 one-byte 扩展: 每个元素最多 16 字节, 元素总长对齐到 4 字节
+    static const std::size_t kMaxExtSize = 64;
+
+    RtpPacketizer(RtpPacketRing &ring,
+                  uint32_t ssrc,
+                  uint8_t payload_type,
+                  uint16_t seq = 0,
+                  uint32_t timestamp = 0);
+
+    bool setCsrcs(const uint32_t *csrcs, std::size_t count);
+
+    // 添加或替换 id 对应的扩展元素 (id 1..14, len 1..16), 长度不变时只改模板里的数据
+    bool setExtension(uint8_t id, const uint8_t *data, std::size_t len);
+    void clearExtensions();
+
+    // 取一个槽并写好头部, 返回负载起始位置; 环满时返回 nullptr
+    uint8_t *payload();
+
+    std::size_t payloadCapacity() const
+    {
+        return m_ring.slotSize() - m_header_size;
+    }
+
+    // 完成当前包: 回填 seq / timestamp / marker, 然后 seq 加一, timestamp 前进 samples
+    RtpPacket commit(std::size_t payload_size, uint32_t samples, bool marker = false);
+
+    // 放弃当前包 (例如编码失败), 槽立即归还
+    void abort();
+
+    // 不发包地推进时间戳 (静音 / DTX), 下一个包应带 marker
+    void skip(uint32_t samples)
+    {
+        m_timestamp += samples;
+    }
+
+    uint16_t seq() const
+    {
+        return m_seq;
+    }
+
+    uint32_t timestamp() const
+    {
+        return m_timestamp;
+    }
+
+    uint32_t ssrc() const
+    {
+        return m_ssrc;
+    }
+
+private:
+    void buildTemplate();
+
+private:
+    RtpPacketRing &m_ring;
+    uint32_t m_ssrc;
+    uint8_t m_payload_type;
+    uint16_t m_seq;
+    uint32_t m_timestamp;
+
+    uint32_t m_csrc[kRtpMaxCsrc];
+    std::size_t m_csrc_count;
+    uint8_t m_ext[kMaxExtSize]; // 未对齐的扩展元素序列
+    std::size_t m_ext_size;
+
+    uint8_t m_template[kRtpHeaderSize + 4 * kRtpMaxCsrc + 4 + kMaxExtSize];
+    std::size_t m_header_size;
+
+    uint8_t *m_cur;
+    std::size_t m_cur_slot;
+    std::size_t m_cur_header_size; // CSRC / 扩展的修改从下一个包开始生效
+};
+
+#endif // _RTP_PACKETIZER_H_
@@ -0,0 +1,241 @@
+#include "rtp_stats.h"
+#include <cmath>
+
+// RFC 3550 A.1
+static const uint32_t kMaxDropout = 3000;
+static const uint32_t kMaxMisorder = 100;
+static const uint32_t kSeqMod = 1u << 16;
+// 小于它的抖动 (时间戳单位) 直接当 0
+static const double kMinJitter = 1e-9;
+
+RtpStatsTable::RtpStatsTable(std::size_t capacity, uint32_t clock_rate) :
+    m_capacity(1),
+    m_clock_rate(clock_rate),
+    m_last_ssrc(0),
+    m_last_index(-1)
+{
+    while (m_capacity < capacity) {
+        m_capacity <<= 1;
+    }
+    m_mask = m_capacity - 1;
+    m_slots.reset(new Slot[m_capacity]);
+    for (std::size_t i = 0; i < m_capacity; ++i) {
+        Slot &slot = m_slots[i];
+        slot.version.store(0, std::memory_order_relaxed);
+        slot.state.store(kFree, std::memory_order_relaxed);
+        slot.ssrc.store(0, std::memory_order_relaxed);
+        slot.received.store(0, std::memory_order_relaxed);
+        slot.expected.store(0, std::memory_order_relaxed);
+        slot.reordered.store(0, std::memory_order_relaxed);
+        slot.ext_max_seq.store(0, std::memory_order_relaxed);
+        slot.jitter_us.store(0, std::memory_order_relaxed);
+        slot.rtt_us.store(-1, std::memory_order_relaxed);
+    }
+}
+
+int RtpStatsTable::onRtp(uint32_t ssrc, uint16_t seq, uint32_t timestamp, double arrival_s, bool &is_new)
+{
+    is_new = false;
+    int index = (m_last_index >= 0 && m_last_ssrc == ssrc) ? m_last_index : find(ssrc);
+    if (index < 0) {
+        index = insert(ssrc, seq);
+        if (index < 0) {
+            return -1;
+        }
+        is_new = true;
+    }
+    m_last_ssrc = ssrc;
+    m_last_index = index;
+
+    Slot &slot = m_slots[index];
+    Source &src = slot.src;
+    updateSeq(src, seq);
+
+    // A.8: 传输时延之差的平滑绝对值, 用时间戳单位计算
+    uint32_t arrival = static_cast<uint32_t>(static_cast<int64_t>(arrival_s * m_clock_rate));
+    int64_t transit = static_cast<int32_t>(arrival - timestamp);
+    if (src.have_transit) {
+        double d = std::fabs(static_cast<double>(static_cast<int32_t>(transit - src.transit)));
+        src.jitter += (d - src.jitter) / 16.0;
+        // 传输时延恒定时抖动按 15/16 衰减, 会落进次正规数, 之后每次浮点运算都很慢
+        if (src.jitter < kMinJitter) {
+            src.jitter = 0;
+        }
+    }
+    src.transit = transit;
+    src.have_transit = true;
+
+    publish(slot);
+    return index;
+}
+
+void RtpStatsTable::onRtt(uint32_t ssrc, double rtt_ms)
+{
+    int index = find(ssrc);
+    if (index < 0) {
+        return;
+    }
+    Slot &slot = m_slots[index];
+    uint32_t v = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.rtt_us.store(static_cast<int64_t>(rtt_ms * 1000), std::memory_order_relaxed);
+    slot.version.store(v + 2, std::memory_order_release);
+}
+
+void RtpStatsTable::remove(uint32_t ssrc)
+{
+    int index = find(ssrc);
+    if (index < 0) {
+        return;
+    }
+    Slot &slot = m_slots[index];
+    uint32_t v = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.state.store(kDeleted, std::memory_order_relaxed);
+    slot.version.store(v + 2, std::memory_order_release);
+    if (m_last_index == index) {
+        m_last_index = -1;
+    }
+}
+
+std::size_t RtpStatsTable::snapshot(std::vector<Snapshot> &out) const
+{
+    out.clear();
+    for (std::size_t i = 0; i < m_capacity; ++i) {
+        const Slot &slot = m_slots[i];
+        for (;;) {
+            uint32_t v1 = slot.version.load(std::memory_order_acquire);
+            if (v1 & 1) {
+                continue;
+            }
+            if (slot.state.load(std::memory_order_relaxed) != kUsed) {
+                break;
+            }
+            Snapshot s;
+            s.ssrc = slot.ssrc.load(std::memory_order_relaxed);
+            s.received = slot.received.load(std::memory_order_relaxed);
+            s.expected = slot.expected.load(std::memory_order_relaxed);
+            s.reordered = slot.reordered.load(std::memory_order_relaxed);
+            s.ext_max_seq = slot.ext_max_seq.load(std::memory_order_relaxed);
+            uint64_t jitter_us = slot.jitter_us.load(std::memory_order_relaxed);
+            int64_t rtt_us = slot.rtt_us.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.version.load(std::memory_order_relaxed) != v1) {
+                continue;
+            }
+            s.lost = static_cast<int64_t>(s.expected) - static_cast<int64_t>(s.received);
+            s.jitter_ms = jitter_us / 1000.0;
+            s.rtt_ms = rtt_us < 0 ? -1.0 : rtt_us / 1000.0;
+            out.push_back(s);
+            break;
+        }
+    }
+    return out.size();
+}
+
+double RtpStatsTable::rttFromReport(uint32_t arrival_ntp_mid, uint32_t lsr, uint32_t dlsr)
+{
+    if (lsr == 0) {
+        return -1;
+    }
+    int32_t rtt = static_cast<int32_t>(arrival_ntp_mid - lsr - dlsr);
+    if (rtt < 0) {
+        return -1;
+    }
+    return rtt * 1000.0 / 65536.0;
+}
+
+int RtpStatsTable::find(uint32_t ssrc) const
+{
+    std::size_t i = hash(ssrc);
+    for (std::size_t n = 0; n < m_capacity; ++n, i = (i + 1) & m_mask) {
+        const Slot &slot = m_slots[i];
+        uint32_t state = slot.state.load(std::memory_order_relaxed);
+        if (state == kFree) {
+            return -1;
+        }
+        if (state == kUsed && slot.ssrc.load(std::memory_order_relaxed) == ssrc) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int RtpStatsTable::insert(uint32_t ssrc, uint16_t seq)
+{
+    std::size_t i = hash(ssrc);
+    for (std::size_t n = 0; n < m_capacity; ++n, i = (i + 1) & m_mask) {
+        Slot &slot = m_slots[i];
+        if (slot.state.load(std::memory_order_relaxed) == kUsed) {
+            continue;
+        }
+        // A.1 init_seq
+        Source &src = slot.src;
+        src.max_seq = seq;
+        src.cycles = 0;
+        src.base_seq = seq;
+        src.bad_seq = kSeqMod + 1;
+        src.received = 0;
+        src.reordered = 0;
+        src.have_transit = false;
+        src.transit = 0;
+        src.jitter = 0;
+
+        uint32_t v = slot.version.load(std::memory_order_relaxed);
+        slot.version.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.ssrc.store(ssrc, std::memory_order_relaxed);
+        slot.rtt_us.store(-1, std::memory_order_relaxed);
+        slot.state.store(kUsed, std::memory_order_relaxed);
+        slot.version.store(v + 2, std::memory_order_release);
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void RtpStatsTable::updateSeq(Source &src, uint16_t seq)
+{
+    uint16_t udelta = static_cast<uint16_t>(seq - src.max_seq);
+    if (udelta < kMaxDropout) {
+        if (seq < src.max_seq) {
+            src.cycles += kSeqMod;
+        }
+        src.max_seq = seq;
+    }
+    else if (udelta <= kSeqMod - kMaxMisorder) {
+        // 大跳变: 连续两个包都这样才认为对端重启了序号
+        if (seq == src.bad_seq) {
+            src.max_seq = seq;
+            src.cycles = 0;
+            src.base_seq = seq;
+            src.bad_seq = kSeqMod + 1;
+            src.received = 0;
+            src.reordered = 0;
+        }
+        else {
+            src.bad_seq = (seq + 1u) & (kSeqMod - 1);
+            return;
+        }
+    }
+    else if (udelta != 0) {
+        ++src.reordered;
+    }
+    ++src.received;
+}
+
+void RtpStatsTable::publish(Slot &slot)
+{
+    const Source &src = slot.src;
+    uint64_t expected = static_cast<uint64_t>(src.cycles) + src.max_seq - src.base_seq + 1;
+    uint32_t v = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.received.store(src.received, std::memory_order_relaxed);
+    slot.expected.store(expected, std::memory_order_relaxed);
+    slot.reordered.store(src.reordered, std::memory_order_relaxed);
+    slot.ext_max_seq.store(src.cycles + src.max_seq, std::memory_order_relaxed);
+    slot.jitter_us.store(static_cast<uint64_t>(src.jitter * 1e6 / m_clock_rate), std::memory_order_relaxed);
+    slot.version.store(v + 2, std::memory_order_release);
+}
@@ -0,0 +1,108 @@
+#ifndef _RTP_STATS_H_
+#define _RTP_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief 按 SSRC 统计的 RTP 接收质量 (RFC 3550 6.4.1 / A.1 / A.3 / A.8)
+ *
+ * 写端只有一个线程 (RTP 接收线程): 每个源的计数状态私有,
+ * 每收到一个包把结果发布到该源的槽里; 槽用 seqlock 保护,
+ * 报告线程可以随时无锁地读取快照, 不会阻塞接收线程
+ */
+class RtpStatsTable
+{
+public:
+    struct Snapshot {
+        uint32_t ssrc;
+        uint64_t received;
+        uint64_t expected;
+        int64_t lost;         // expected - received, 有重复包时可能为负
+        uint64_t reordered;   // 比已收到的最大 seq 小的包
+        uint32_t ext_max_seq; // 扩展后的最大 seq (回绕次数 << 16 | seq)
+        double jitter_ms;     // 到达间隔抖动
+        double rtt_ms;        // 由对端 SR/RR 的 LSR/DLSR 计算, 未知时为 -1
+    };
+
+    explicit RtpStatsTable(std::size_t capacity = 256, uint32_t clock_rate = 48000);
+
+    RtpStatsTable(const RtpStatsTable &) = delete;
+    RtpStatsTable &operator=(const RtpStatsTable &) = delete;
+
+    // 写端: arrival_s 为本地到达时间 (秒); 返回源所在的槽, 表满时返回 -1
+    // is_new 为 true 表示第一次见到这个源
+    int onRtp(uint32_t ssrc, uint16_t seq, uint32_t timestamp, double arrival_s, bool &is_new);
+    void onRtt(uint32_t ssrc, double rtt_ms);
+    void remove(uint32_t ssrc);
+
+    // 读端: 任意线程, 返回当前所有源的一致快照
+    std::size_t snapshot(std::vector<Snapshot> &out) const;
+
+    std::size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    // RTT = A - LSR - DLSR (RFC 3550 6.4.1), 单位都是 NTP 中间 32 位 (1/65536 秒)
+    // 返回毫秒, LSR 为 0 (对端还没收到过我们的 SR) 或结果不合理时返回 -1
+    static double rttFromReport(uint32_t arrival_ntp_mid, uint32_t lsr, uint32_t dlsr);
+
+private:
+    enum SlotState {
+        kFree,
+        kUsed,
+        kDeleted,
+    };
+
+    // 写线程私有的 A.1 序号状态和 A.8 抖动状态
+    struct Source {
+        uint16_t max_seq;
+        uint32_t cycles;
+        uint32_t base_seq;
+        uint32_t bad_seq;
+        uint64_t received;
+        uint64_t reordered;
+        bool have_transit;
+        int64_t transit;
+        double jitter;        // 时间戳单位
+    };
+
+    struct Slot {
+        std::atomic<uint32_t> version; // 奇数表示正在写
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> ssrc;
+        std::atomic<uint64_t> received;
+        std::atomic<uint64_t> expected;
+        std::atomic<uint64_t> reordered;
+        std::atomic<uint32_t> ext_max_seq;
+        std::atomic<uint64_t> jitter_us;
+        std::atomic<int64_t> rtt_us;
+        Source src;
+    };
+
+    int find(uint32_t ssrc) const;
+    int insert(uint32_t ssrc, uint16_t seq);
+    void updateSeq(Source &src, uint16_t seq);
+    void publish(Slot &slot);
+
+    std::size_t hash(uint32_t ssrc) const
+    {
+        return (ssrc * 2654435761u) & m_mask;
+    }
+
+private:
+    std::size_t m_capacity;
+    std::size_t m_mask;
+    uint32_t m_clock_rate;
+    std::unique_ptr<Slot[]> m_slots;
+
+    // 写线程的单项缓存, 大多数包来自同一个源
+    uint32_t m_last_ssrc;
+    int m_last_index;
+};
+
+#endif // _RTP_STATS_H_
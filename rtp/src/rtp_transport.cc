@@ -0,0 +1,462 @@
+#include "rtp_transport.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace asio = boost::asio;
+using asio::ip::udp;
+
+// RFC 3550 6
+static const uint8_t kRtcpSr = 200;
+static const uint8_t kRtcpRr = 201;
+static const uint8_t kRtcpSdes = 202;
+static const uint8_t kRtcpBye = 203;
+static const uint8_t kSdesCname = 1;
+static const std::size_t kMaxReportBlocks = 31;
+static const std::size_t kReportBlockSize = 24;
+// 1900-01-01 到 1970-01-01 的秒数
+static const uint64_t kNtpEpochOffset = 2208988800ULL;
+// 收包缓冲用完时多久后重试
+static const int kRetryMs = 1;
+
+static uint32_t randomSsrc()
+{
+    std::random_device rd;
+    uint32_t ssrc = 0;
+    while (ssrc == 0) {
+        ssrc = rd();
+    }
+    return ssrc;
+}
+
+static void writeRtcpHeader(uint8_t *p, uint8_t count, uint8_t type, std::size_t size)
+{
+    p[0] = static_cast<uint8_t>(0x80 | count);
+    p[1] = type;
+    rtpWrite16(p + 2, static_cast<uint16_t>(size / 4 - 1));
+}
+
+RtpTransport::Sptr RtpTransport::create(asio::io_context &ioc)
+{
+    return create(ioc, Config());
+}
+
+RtpTransport::Sptr RtpTransport::create(asio::io_context &ioc, const Config &cfg)
+{
+    return Sptr(new RtpTransport(ioc, cfg));
+}
+
+RtpTransport::RtpTransport(asio::io_context &ioc, const Config &cfg) :
+    m_socket(ioc),
+    m_rtcp_timer(ioc),
+    m_retry_timer(ioc),
+    m_cfg(cfg),
+    m_ssrc(cfg.ssrc ? cfg.ssrc : randomSsrc()),
+    m_rand(m_ssrc),
+    m_has_remote(false),
+    m_open(false),
+    m_pool(RtpBufferPool::create(cfg.pool_size)),
+    m_stats(cfg.max_sources, cfg.clock_rate),
+    m_ring(cfg.send_slots),
+    m_packetizer(m_ring, m_ssrc, cfg.payload_type, static_cast<uint16_t>(m_rand()), m_rand()),
+    m_octets_sent(0),
+    m_sent_since_report(false),
+    m_last_ts(0),
+    m_rtp_sent(0),
+    m_rtp_received(0),
+    m_rtcp_sent(0),
+    m_rtcp_received(0),
+    m_send_dropped(0),
+    m_pool_exhausted(0)
+{
+    if (m_cfg.cname.empty()) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%08x", m_ssrc);
+        m_cfg.cname = buf;
+    }
+}
+
+RtpTransport::~RtpTransport()
+{
+    boost::system::error_code ec;
+    m_socket.close(ec);
+}
+
+bool RtpTransport::open(const std::string &ip, uint16_t port)
+{
+    boost::system::error_code ec;
+    asio::ip::address addr = ip.empty() ? asio::ip::address(asio::ip::address_v4::any())
+                                        : asio::ip::make_address(ip, ec);
+    if (ec) {
+        return false;
+    }
+    udp::endpoint local(addr, port);
+    m_socket.open(local.protocol(), ec);
+    if (!ec) {
+        m_socket.bind(local, ec);
+    }
+    if (ec) {
+        m_socket.close(ec);
+        return false;
+    }
+    m_open = true;
+    return true;
+}
+
+bool RtpTransport::connect(const std::string &ip, uint16_t port)
+{
+    boost::system::error_code ec;
+    asio::ip::address addr = asio::ip::make_address(ip, ec);
+    if (ec) {
+        return false;
+    }
+    m_remote = udp::endpoint(addr, port);
+    m_has_remote = true;
+    return true;
+}
+
+void RtpTransport::start()
+{
+    if (!m_open) {
+        return;
+    }
+    receive();
+    scheduleRtcp();
+}
+
+void RtpTransport::close()
+{
+    if (!m_open) {
+        return;
+    }
+    sendRtcp(true);
+    m_open = false;
+    boost::system::error_code ec;
+    m_rtcp_timer.cancel(ec);
+    m_retry_timer.cancel(ec);
+    m_socket.close(ec);
+}
+
+uint8_t *RtpTransport::payload()
+{
+    uint8_t *p = m_packetizer.payload();
+    if (!p) {
+        m_send_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+bool RtpTransport::commit(std::size_t payload_size, uint32_t samples, bool marker)
+{
+    if (!m_open || !m_has_remote) {
+        m_packetizer.abort();
+        return false;
+    }
+    uint32_t ts = m_packetizer.timestamp();
+    RtpPacket pkt = m_packetizer.commit(payload_size, samples, marker);
+    m_last_ts = ts;
+    m_last_ts_time = Clock::now();
+    m_octets_sent += payload_size;
+    m_sent_since_report = true;
+    m_rtp_sent.fetch_add(1, std::memory_order_relaxed);
+    sendRaw(pkt.data, pkt.size, pkt.slot);
+    return true;
+}
+
+bool RtpTransport::send(const uint8_t *data, std::size_t size, uint32_t samples, bool marker)
+{
+    if (size > payloadCapacity()) {
+        return false;
+    }
+    uint8_t *p = payload();
+    if (!p) {
+        return false;
+    }
+    std::memcpy(p, data, size);
+    return commit(size, samples, marker);
+}
+
+uint16_t RtpTransport::localPort() const
+{
+    boost::system::error_code ec;
+    udp::endpoint local = m_socket.local_endpoint(ec);
+    return ec ? 0 : local.port();
+}
+
+RtpTransport::Stats RtpTransport::stats() const
+{
+    Stats s;
+    s.rtp_sent = m_rtp_sent.load(std::memory_order_relaxed);
+    s.rtp_received = m_rtp_received.load(std::memory_order_relaxed);
+    s.rtcp_sent = m_rtcp_sent.load(std::memory_order_relaxed);
+    s.rtcp_received = m_rtcp_received.load(std::memory_order_relaxed);
+    s.send_dropped = m_send_dropped.load(std::memory_order_relaxed);
+    s.pool_exhausted = m_pool_exhausted.load(std::memory_order_relaxed);
+    return s;
+}
+
+void RtpTransport::receive()
+{
+    if (!m_rx) {
+        m_rx = m_pool->acquire();
+        if (!m_rx) {
+            // 上层持有的缓冲太多, 稍后再收, 这段时间的包留在内核缓冲里
+            m_pool_exhausted.fetch_add(1, std::memory_order_relaxed);
+            auto self = shared_from_this();
+            m_retry_timer.expires_after(std::chrono::milliseconds(kRetryMs));
+            m_retry_timer.async_wait([self](const boost::system::error_code &ec) {
+                if (!ec && self->m_open) {
+                    self->receive();
+                }
+            });
+            return;
+        }
+    }
+    auto self = shared_from_this();
+    m_socket.async_receive_from(asio::buffer(m_rx.data(), m_rx.capacity()), m_rx_from,
+                                [self](const boost::system::error_code &ec, std::size_t size) {
+                                    self->onReceive(ec, size);
+                                });
+}
+
+void RtpTransport::onReceive(const boost::system::error_code &ec, std::size_t size)
+{
+    if (ec == asio::error::operation_aborted || !m_open) {
+        return;
+    }
+    // ICMP 端口不可达等错误不影响后续收包
+    if (!ec) {
+        const uint8_t *data = m_rx.data();
+        if (isRtcpPacket(data, size)) {
+            m_rtcp_received.fetch_add(1, std::memory_order_relaxed);
+            onRtcp(data, size);
+        }
+        else {
+            RtpHeader hdr;
+            if (parseRtpHeader(data, size, hdr)) {
+                if (!m_has_remote) {
+                    m_remote = m_rx_from;
+                    m_has_remote = true;
+                }
+                m_rtp_received.fetch_add(1, std::memory_order_relaxed);
+                double arrival = std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+                bool is_new;
+                m_stats.onRtp(hdr.ssrc, hdr.seq, hdr.timestamp, arrival, is_new);
+                if (m_on_rtp) {
+                    m_rx.resize(size);
+                    m_on_rtp(hdr, m_rx);
+                }
+            }
+        }
+    }
+    receive();
+}
+
+void RtpTransport::onRtcp(const uint8_t *data, std::size_t size)
+{
+    // 复合包: 逐个子包按长度字段前进
+    while (size >= 8) {
+        if ((data[0] & 0xC0) != 0x80) {
+            return;
+        }
+        std::size_t len = (static_cast<std::size_t>(rtpRead16(data + 2)) + 1) * 4;
+        if (len > size) {
+            return;
+        }
+        uint8_t count = data[0] & 0x1F;
+        uint32_t sender = rtpRead32(data + 4);
+        switch (data[1]) {
+        case kRtcpSr:
+            if (len >= 28) {
+                // 没见过的 SSRC 受 max_sources 限制, 伪造的 SR 不能让 m_peers 无限增长
+                auto found = m_peers.find(sender);
+                if (found == m_peers.end() && m_peers.size() < m_cfg.max_sources) {
+                    found = m_peers.emplace(sender, Peer()).first;
+                }
+                if (found != m_peers.end()) {
+                    Peer &peer = found->second;
+                    peer.lsr = static_cast<uint32_t>(((static_cast<uint64_t>(rtpRead32(data + 8)) << 32)
+                                                      | rtpRead32(data + 12)) >> 16);
+                    peer.sr_time = Clock::now();
+                }
+                onReportBlocks(sender, data + 28, std::min<std::size_t>(count, (len - 28) / kReportBlockSize));
+            }
+            break;
+        case kRtcpRr:
+            if (len >= 8) {
+                onReportBlocks(sender, data + 8, std::min<std::size_t>(count, (len - 8) / kReportBlockSize));
+            }
+            break;
+        case kRtcpBye:
+            for (std::size_t i = 0; i < count && 4 + i * 4 + 4 <= len; ++i) {
+                uint32_t ssrc = rtpRead32(data + 4 + i * 4);
+                m_stats.remove(ssrc);
+                m_peers.erase(ssrc);
+                if (m_on_bye) {
+                    m_on_bye(ssrc);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+        data += len;
+        size -= len;
+    }
+}
+
+void RtpTransport::onReportBlocks(uint32_t sender, const uint8_t *p, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i, p += kReportBlockSize) {
+        if (rtpRead32(p) != m_ssrc) {
+            continue;
+        }
+        // A 为收到报告时 NTP 的中间 32 位, RTT = A - LSR - DLSR (RFC 3550 6.4.1)
+        uint32_t arrival = static_cast<uint32_t>(ntpNow() >> 16);
+        double rtt = RtpStatsTable::rttFromReport(arrival, rtpRead32(p + 16), rtpRead32(p + 20));
+        if (rtt >= 0) {
+            m_stats.onRtt(sender, rtt);
+        }
+    }
+}
+
+void RtpTransport::scheduleRtcp()
+{
+    std::uniform_real_distribution<double> factor(0.5, 1.5);
+    auto delay = std::chrono::microseconds(static_cast<int64_t>(m_cfg.rtcp_interval_ms * 1000.0 * factor(m_rand)));
+    m_rtcp_timer.expires_after(delay);
+    auto self = shared_from_this();
+    m_rtcp_timer.async_wait([self](const boost::system::error_code &ec) {
+        if (ec || !self->m_open) {
+            return;
+        }
+        self->sendRtcp(false);
+        self->scheduleRtcp();
+    });
+}
+
+void RtpTransport::sendRtcp(bool bye)
+{
+    if (!m_has_remote) {
+        return;
+    }
+    std::size_t slot;
+    uint8_t *buf = m_ring.acquire(slot);
+    if (!buf) {
+        m_send_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::size_t cap = m_ring.slotSize();
+    std::size_t size = buildReport(buf, cap);
+    size += buildSdes(buf + size, cap - size);
+    if (bye && size + 8 <= cap) {
+        writeRtcpHeader(buf + size, 1, kRtcpBye, 8);
+        rtpWrite32(buf + size + 4, m_ssrc);
+        size += 8;
+    }
+    m_rtcp_sent.fetch_add(1, std::memory_order_relaxed);
+    if (bye) {
+        // 马上要关闭 socket, 异步发送会被取消, 这里直接发
+        boost::system::error_code ec;
+        m_socket.send_to(asio::buffer(buf, size), m_remote, 0, ec);
+        m_ring.release(slot);
+        return;
+    }
+    sendRaw(buf, size, slot);
+}
+
+std::size_t RtpTransport::buildReport(uint8_t *p, std::size_t cap)
+{
+    std::vector<RtpStatsTable::Snapshot> &sources = m_snapshot;
+    m_stats.snapshot(sources);
+    std::size_t blocks = std::min(sources.size(), kMaxReportBlocks);
+    bool sender = m_sent_since_report;
+    std::size_t head = sender ? 28 : 8;
+    while (blocks > 0 && head + blocks * kReportBlockSize > cap / 2) {
+        --blocks;
+    }
+
+    uint8_t *b = p + head;
+    for (std::size_t i = 0; i < blocks; ++i, b += kReportBlockSize) {
+        const RtpStatsTable::Snapshot &s = sources[i];
+        Peer &peer = m_peers[s.ssrc];
+        // 上次报告以来的丢包比例 (RFC 3550 A.3)
+        int64_t expected_interval = static_cast<int64_t>(s.expected - peer.expected_prior);
+        int64_t received_interval = static_cast<int64_t>(s.received - peer.received_prior);
+        int64_t lost_interval = expected_interval - received_interval;
+        uint8_t fraction = 0;
+        if (expected_interval > 0 && lost_interval > 0) {
+            fraction = static_cast<uint8_t>(std::min<int64_t>((lost_interval << 8) / expected_interval, 255));
+        }
+        peer.expected_prior = s.expected;
+        peer.received_prior = s.received;
+        // 累计丢包是 24 位有符号数
+        int64_t lost = std::max<int64_t>(std::min<int64_t>(s.lost, 0x7FFFFF), -0x800000);
+        uint32_t dlsr = 0;
+        if (peer.lsr) {
+            double delay = std::chrono::duration<double>(Clock::now() - peer.sr_time).count();
+            dlsr = static_cast<uint32_t>(delay * 65536);
+        }
+
+        rtpWrite32(b, s.ssrc);
+        b[4] = fraction;
+        uint32_t lost24 = static_cast<uint32_t>(lost) & 0xFFFFFF;
+        b[5] = static_cast<uint8_t>(lost24 >> 16);
+        b[6] = static_cast<uint8_t>(lost24 >> 8);
+        b[7] = static_cast<uint8_t>(lost24);
+        rtpWrite32(b + 8, s.ext_max_seq);
+        rtpWrite32(b + 12, static_cast<uint32_t>(s.jitter_ms * m_cfg.clock_rate / 1000));
+        rtpWrite32(b + 16, peer.lsr);
+        rtpWrite32(b + 20, dlsr);
+    }
+
+    std::size_t size = head + blocks * kReportBlockSize;
+    rtpWrite32(p + 4, m_ssrc);
+    if (sender) {
+        uint64_t ntp = ntpNow();
+        double elapsed = std::chrono::duration<double>(Clock::now() - m_last_ts_time).count();
+        rtpWrite32(p + 8, static_cast<uint32_t>(ntp >> 32));
+        rtpWrite32(p + 12, static_cast<uint32_t>(ntp));
+        rtpWrite32(p + 16, m_last_ts + static_cast<uint32_t>(elapsed * m_cfg.clock_rate));
+        rtpWrite32(p + 20, static_cast<uint32_t>(m_rtp_sent.load(std::memory_order_relaxed)));
+        rtpWrite32(p + 24, static_cast<uint32_t>(m_octets_sent));
+    }
+    writeRtcpHeader(p, static_cast<uint8_t>(blocks), sender ? kRtcpSr : kRtcpRr, size);
+    m_sent_since_report = false;
+    return size;
+}
+
+std::size_t RtpTransport::buildSdes(uint8_t *p, std::size_t cap)
+{
+    std::size_t cname_len = std::min<std::size_t>(m_cfg.cname.size(), 255);
+    // 头 4 + SSRC 4 + 类型 1 + 长度 1 + CNAME + 结束符, 对齐到 4 字节
+    std::size_t size = (4 + 4 + 2 + cname_len + 1 + 3) & ~static_cast<std::size_t>(3);
+    if (size > cap) {
+        return 0;
+    }
+    std::memset(p, 0, size);
+    rtpWrite32(p + 4, m_ssrc);
+    p[8] = kSdesCname;
+    p[9] = static_cast<uint8_t>(cname_len);
+    std::memcpy(p + 10, m_cfg.cname.data(), cname_len);
+    writeRtcpHeader(p, 1, kRtcpSdes, size);
+    return size;
+}
+
+void RtpTransport::sendRaw(const uint8_t *data, std::size_t size, std::size_t slot)
+{
+    auto self = shared_from_this();
+    m_socket.async_send_to(asio::buffer(data, size), m_remote,
+                           [self, slot](const boost::system::error_code &, std::size_t) {
+                               self->m_ring.release(slot);
+                           });
+}
+
+uint64_t RtpTransport::ntpNow()
+{
+    auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(since_epoch).count();
+    uint64_t sec = us / 1000000 + kNtpEpochOffset;
+    uint64_t frac = ((us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
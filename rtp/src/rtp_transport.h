@@ -0,0 +1,186 @@
+#ifndef _RTP_TRANSPORT_H_
+#define _RTP_TRANSPORT_H_
+
+#include "rtp_buffer_pool.h"
+#include "rtp_packetizer.h"
+#include "rtp_stats.h"
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 跑在 io_context 上的 RTP/RTCP 传输 (rtcp-mux, 单个 UDP socket)
+ *
+ * 收包用 async_receive_from 完成回调, 每个包收进 RtpBufferPool 的缓冲;
+ * 发包由 RtpPacketizer 在 RtpPacketRing 的槽里原地组包, async_send_to 完成后归还槽
+ * 远端源的序号 / 丢包 / 抖动由 RtpStatsTable 跟踪, RTCP SR/RR + SDES 由 steady_timer
+ * 按 [0.5, 1.5] 倍间隔随机调度 (RFC 3550 6.3.1), 不需要额外的线程或 Poll
+ *
+ * 除 sources / stats 外的接口都要在 io_context 的线程里调用 (其他线程用 asio::post)
+ */
+class RtpTransport : public std::enable_shared_from_this<RtpTransport>
+{
+public:
+    using Sptr = std::shared_ptr<RtpTransport>;
+    using Buffer = RtpBufferPool::Buffer;
+    using Endpoint = boost::asio::ip::udp::endpoint;
+
+    // hdr 的指针指向 buf; 回调可以把 buf 移走长期持有, 否则缓冲直接用于下一次收包
+    using OnRtp = std::function<void(const RtpHeader &hdr, Buffer &buf)>;
+    using OnBye = std::function<void(uint32_t ssrc)>;
+
+    struct Config {
+        uint32_t clock_rate = 48000;
+        uint8_t payload_type = 111;
+        uint32_t ssrc = 0;              // 0 时随机生成
+        uint32_t rtcp_interval_ms = 5000;
+        std::size_t pool_size = 64;     // 收包缓冲个数
+        std::size_t send_slots = 64;    // 发送中的包最多这么多个
+        std::size_t max_sources = 64;
+        std::string cname;
+    };
+
+    struct Stats {
+        uint64_t rtp_sent;
+        uint64_t rtp_received;
+        uint64_t rtcp_sent;
+        uint64_t rtcp_received;
+        uint64_t send_dropped;   // 发送槽用完
+        uint64_t pool_exhausted; // 收包缓冲用完, 暂停收包
+    };
+
+    static Sptr create(boost::asio::io_context &ioc);
+    static Sptr create(boost::asio::io_context &ioc, const Config &cfg);
+    ~RtpTransport();
+
+    RtpTransport(const RtpTransport &) = delete;
+    RtpTransport &operator=(const RtpTransport &) = delete;
+
+    // ip 为空时绑定 0.0.0.0; port 为 0 时由系统分配
+    bool open(const std::string &ip, uint16_t port);
+    // 不调用时把第一个发来 RTP 的地址当作远端 (对称 RTP)
+    bool connect(const std::string &ip, uint16_t port);
+
+    void setOnRtp(OnRtp cb)
+    {
+        m_on_rtp = std::move(cb);
+    }
+
+    void setOnBye(OnBye cb)
+    {
+        m_on_bye = std::move(cb);
+    }
+
+    // 开始收包和 RTCP 调度
+    void start();
+    // 发送 BYE 后关闭 socket, 未完成的回调以 operation_aborted 结束
+    void close();
+
+    // 原地组包: 负载直接写进发送槽, 再 commit 发出; 槽用完时返回 nullptr
+    uint8_t *payload();
+    std::size_t payloadCapacity() const
+    {
+        return m_packetizer.payloadCapacity();
+    }
+    bool commit(std::size_t payload_size, uint32_t samples, bool marker = false);
+    void abort()
+    {
+        m_packetizer.abort();
+    }
+
+    // 拷贝 data 作为负载发送一个包
+    bool send(const uint8_t *data, std::size_t size, uint32_t samples, bool marker = false);
+
+    // 静音 / DTX 时只推进时间戳
+    void skip(uint32_t samples)
+    {
+        m_packetizer.skip(samples);
+    }
+
+    uint32_t ssrc() const
+    {
+        return m_ssrc;
+    }
+
+    uint16_t localPort() const;
+
+    // 远端源的接收统计, 可以在任意线程调用
+    std::size_t sources(std::vector<RtpStatsTable::Snapshot> &out) const
+    {
+        return m_stats.snapshot(out);
+    }
+
+    Stats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 每个远端源上一份报告的状态
+    struct Peer {
+        uint64_t expected_prior;
+        uint64_t received_prior;
+        uint32_t lsr;               // 最近一个 SR 的 NTP 中间 32 位
+        Clock::time_point sr_time;  // 收到它的时间
+    };
+
+    RtpTransport(boost::asio::io_context &ioc, const Config &cfg);
+
+    void receive();
+    void onReceive(const boost::system::error_code &ec, std::size_t size);
+    void onRtcp(const uint8_t *data, std::size_t size);
+    void onReportBlocks(uint32_t sender, const uint8_t *p, std::size_t count);
+
+    void scheduleRtcp();
+    void sendRtcp(bool bye);
+    std::size_t buildReport(uint8_t *p, std::size_t cap);
+    std::size_t buildSdes(uint8_t *p, std::size_t cap);
+    void sendRaw(const uint8_t *data, std::size_t size, std::size_t slot);
+
+    // 当前时间的 NTP 格式 (RFC 3550 4)
+    static uint64_t ntpNow();
+
+private:
+    boost::asio::ip::udp::socket m_socket;
+    boost::asio::steady_timer m_rtcp_timer;
+    boost::asio::steady_timer m_retry_timer;
+    Config m_cfg;
+    uint32_t m_ssrc;
+    std::minstd_rand m_rand;
+
+    Endpoint m_remote;
+    bool m_has_remote;
+    bool m_open;
+
+    // 接收
+    RtpBufferPool::Sptr m_pool;
+    Buffer m_rx;
+    Endpoint m_rx_from;
+    RtpStatsTable m_stats;
+    std::unordered_map<uint32_t, Peer> m_peers;
+    std::vector<RtpStatsTable::Snapshot> m_snapshot; // 组 RR 时复用
+    OnRtp m_on_rtp;
+    OnBye m_on_bye;
+
+    // 发送
+    RtpPacketRing m_ring;
+    RtpPacketizer m_packetizer;
+    uint64_t m_octets_sent;
+    bool m_sent_since_report;
+    uint32_t m_last_ts;               // 最近一个包的 RTP 时间戳
+    Clock::time_point m_last_ts_time; // 以及它的发送时间, 用于推算 SR 里的时间戳
+
+    std::atomic<uint64_t> m_rtp_sent;
+    std::atomic<uint64_t> m_rtp_received;
+    std::atomic<uint64_t> m_rtcp_sent;
+    std::atomic<uint64_t> m_rtcp_received;
+    std::atomic<uint64_t> m_send_dropped;
+    std::atomic<uint64_t> m_pool_exhausted;
+};
+
+#endif // _RTP_TRANSPORT_H_
@@ -0,0 +1,412 @@
+#include "udp_batch_socket.h"
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// 内核 UDP_MAX_SEGMENTS
+static const std::size_t kGsoMaxSegments = 64;
+// 一个 GSO 消息的负载上限, 留出 IP / UDP 头
+static const std::size_t kGsoMaxBytes = 65000;
+// GRO 时每个接收槽要能放下合并后的整个消息
+static const std::size_t kGroSlots = 16;
+static const std::size_t kGroSlotSize = 65535;
+static const std::size_t kSendCtrlSize = CMSG_SPACE(sizeof(uint16_t));
+static const std::size_t kRecvCtrlSize = CMSG_SPACE(sizeof(int));
+
+UdpBatchSocket::UdpBatchSocket(std::size_t batch, std::size_t buf_size, bool offload) :
+    m_fd(-1),
+    m_batch(batch),
+    m_buf_size(buf_size),
+    m_offload(offload),
+    m_gso(false),
+    m_gro(false),
+    m_recv_slots(0),
+    m_recv_slot_size(0),
+    m_send_buf(batch * buf_size),
+    m_send_addr(batch),
+    m_send_iov(batch),
+    m_send_msgs(batch),
+    m_send_count(0),
+    m_order(batch),
+    m_grouped(batch),
+    m_gso_iov(batch),
+    m_gso_msgs(batch),
+    m_gso_first(batch),
+    m_gso_segs(batch),
+    m_gso_ctrl(batch * kSendCtrlSize),
+    m_plain_msgs(batch),
+    m_recv_calls(0),
+    m_recv_packets(0),
+    m_send_calls(0),
+    m_send_packets(0),
+    m_send_dropped(0),
+    m_gso_messages(0),
+    m_gro_messages(0)
+{
+    for (std::size_t i = 0; i < batch; ++i) {
+        m_send_iov[i].iov_base = m_send_buf.data() + i * buf_size;
+        m_send_iov[i].iov_len = 0;
+        std::memset(&m_send_msgs[i], 0, sizeof(mmsghdr));
+        m_send_msgs[i].msg_hdr.msg_name = &m_send_addr[i];
+        m_send_msgs[i].msg_hdr.msg_iov = &m_send_iov[i];
+        m_send_msgs[i].msg_hdr.msg_iovlen = 1;
+        std::memset(&m_gso_msgs[i], 0, sizeof(mmsghdr));
+    }
+    setupRecv(batch, buf_size);
+}
+
+UdpBatchSocket::~UdpBatchSocket()
+{
+    close();
+}
+
+bool UdpBatchSocket::open(const std::string &ip, uint16_t port, bool reuse_port)
+{
+    sockaddr_storage addr;
+    std::memset(&addr, 0, sizeof(addr));
+    socklen_t addr_len;
+    auto *v4 = reinterpret_cast<sockaddr_in *>(&addr);
+    auto *v6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+    if (ip.empty() || inet_pton(AF_INET, ip.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        addr_len = sizeof(sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, ip.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        addr_len = sizeof(sockaddr_in6);
+    }
+    else {
+        return false;
+    }
+
+    m_fd = socket(addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        return false;
+    }
+    int on = 1;
+    if (reuse_port) {
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+    // 多路会话共用一个 socket, 缓冲区加大以吸收突发
+    int buf = 4 * 1024 * 1024;
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    if (bind(m_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) < 0) {
+        close();
+        return false;
+    }
+
+    m_gso = false;
+    m_gro = false;
+    if (m_offload) {
+        // 老内核没有这两个选项, 探测失败就保持逐包收发
+        int segment = 0;
+        socklen_t len = sizeof(segment);
+        m_gso = getsockopt(m_fd, SOL_UDP, UDP_SEGMENT, &segment, &len) == 0;
+        m_gro = setsockopt(m_fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+    }
+    if (m_gro) {
+        setupRecv(kGroSlots, kGroSlotSize);
+    }
+    else if (m_recv_slots != m_batch || m_recv_slot_size != m_buf_size) {
+        setupRecv(m_batch, m_buf_size);
+    }
+    return true;
+}
+
+void UdpBatchSocket::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+uint16_t UdpBatchSocket::localPort() const
+{
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (m_fd < 0 || getsockname(m_fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<sockaddr_in *>(&addr)->sin_port);
+}
+
+int UdpBatchSocket::recv()
+{
+    for (std::size_t i = 0; i < m_recv_slots; ++i) {
+        msghdr &hdr = m_recv_msgs[i].msg_hdr;
+        hdr.msg_name = &m_recv_addr[i];
+        hdr.msg_namelen = sizeof(sockaddr_storage);
+        hdr.msg_iov = &m_recv_iov[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = m_gro ? m_recv_ctrl.data() + i * kRecvCtrlSize : nullptr;
+        hdr.msg_controllen = m_gro ? kRecvCtrlSize : 0;
+        hdr.msg_flags = 0;
+    }
+    int n = recvmmsg(m_fd, m_recv_msgs.data(), static_cast<unsigned>(m_recv_slots), MSG_DONTWAIT, nullptr);
+    m_recv_calls.fetch_add(1, std::memory_order_relaxed);
+    if (n <= 0) {
+        return 0;
+    }
+    std::size_t count = 0;
+    for (int i = 0; i < n; ++i) {
+        msghdr &hdr = m_recv_msgs[i].msg_hdr;
+        const uint8_t *data = static_cast<const uint8_t *>(m_recv_iov[i].iov_base);
+        std::size_t size = m_recv_msgs[i].msg_len;
+        std::size_t segment = size;
+        if (m_gro) {
+            for (cmsghdr *cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int value;
+                    std::memcpy(&value, CMSG_DATA(cm), sizeof(value));
+                    if (value > 0) {
+                        segment = static_cast<std::size_t>(value);
+                    }
+                }
+            }
+            if (segment < size) {
+                m_gro_messages.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (segment == 0) {
+            continue;
+        }
+        // 按段长拆回原来的包, 最后一段可能更短
+        for (std::size_t off = 0; off < size && count < m_datagrams.size(); off += segment) {
+            Datagram &d = m_datagrams[count++];
+            d.data = data + off;
+            d.size = std::min(segment, size - off);
+            d.addr = reinterpret_cast<const sockaddr *>(&m_recv_addr[i]);
+            d.addr_len = hdr.msg_namelen;
+        }
+    }
+    m_recv_packets.fetch_add(count, std::memory_order_relaxed);
+    return static_cast<int>(count);
+}
+
+bool UdpBatchSocket::queue(const sockaddr *addr, socklen_t addr_len, const uint8_t *data, std::size_t size)
+{
+    return queue(addr, addr_len, nullptr, 0, data, size);
+}
+
+bool UdpBatchSocket::queue(const sockaddr *addr,
+                           socklen_t addr_len,
+                           const uint8_t *head,
+                           std::size_t head_size,
+                           const uint8_t *data,
+                           std::size_t size)
+{
+    if (head_size + size > m_buf_size || addr_len > sizeof(sockaddr_storage)) {
+        m_send_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_send_mtx);
+    if (m_send_count == m_batch) {
+        flushLocked();
+    }
+    std::size_t i = m_send_count++;
+    uint8_t *buf = static_cast<uint8_t *>(m_send_iov[i].iov_base);
+    if (head_size) {
+        std::memcpy(buf, head, head_size);
+    }
+    std::memcpy(buf + head_size, data, size);
+    m_send_iov[i].iov_len = head_size + size;
+    std::memcpy(&m_send_addr[i], addr, addr_len);
+    m_send_msgs[i].msg_hdr.msg_namelen = addr_len;
+    return true;
+}
+
+int UdpBatchSocket::flush()
+{
+    std::lock_guard<std::mutex> lock(m_send_mtx);
+    return flushLocked();
+}
+
+UdpBatchSocket::Stats UdpBatchSocket::stats()
+{
+    Stats s;
+    s.recv_calls = m_recv_calls.load(std::memory_order_relaxed);
+    s.recv_packets = m_recv_packets.load(std::memory_order_relaxed);
+    s.send_calls = m_send_calls.load(std::memory_order_relaxed);
+    s.send_packets = m_send_packets.load(std::memory_order_relaxed);
+    s.send_dropped = m_send_dropped.load(std::memory_order_relaxed);
+    s.gso_messages = m_gso_messages.load(std::memory_order_relaxed);
+    s.gro_messages = m_gro_messages.load(std::memory_order_relaxed);
+    return s;
+}
+
+void UdpBatchSocket::setupRecv(std::size_t slots, std::size_t slot_size)
+{
+    m_recv_slots = slots;
+    m_recv_slot_size = slot_size;
+    m_recv_buf.assign(slots * slot_size, 0);
+    m_recv_addr.resize(slots);
+    m_recv_iov.resize(slots);
+    m_recv_msgs.resize(slots);
+    m_recv_ctrl.assign(slots * kRecvCtrlSize, 0);
+    // GRO 合并的消息最多 kGsoMaxSegments 段
+    m_datagrams.resize(m_gro ? slots * kGsoMaxSegments : slots);
+    for (std::size_t i = 0; i < slots; ++i) {
+        m_recv_iov[i].iov_base = m_recv_buf.data() + i * slot_size;
+        m_recv_iov[i].iov_len = slot_size;
+        std::memset(&m_recv_msgs[i], 0, sizeof(mmsghdr));
+    }
+}
+
+int UdpBatchSocket::flushLocked()
+{
+    std::size_t count = m_send_count;
+    m_send_count = 0;
+    if (count == 0) {
+        return 0;
+    }
+    std::size_t sent = 0;
+    if (!m_gso) {
+        sent = sendMsgs(m_send_msgs.data(), count);
+    }
+    else {
+        std::size_t msgs = buildGso(count);
+        std::size_t msg = 0;
+        bool fallback = false;
+        while (msg < msgs) {
+            int n = sendmmsg(m_fd, m_gso_msgs.data() + msg, static_cast<unsigned>(msgs - msg), 0);
+            m_send_calls.fetch_add(1, std::memory_order_relaxed);
+            if (n > 0) {
+                for (std::size_t k = msg; k < msg + static_cast<std::size_t>(n); ++k) {
+                    sent += m_gso_segs[k];
+                    if (m_gso_segs[k] > 1) {
+                        m_gso_messages.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                msg += static_cast<std::size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            // 网卡或路径不支持分段时内核返回 EIO / EINVAL, 之后不再尝试 GSO
+            if (n < 0 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)) {
+                m_gso = false;
+                fallback = true;
+            }
+            break;
+        }
+        if (msg < msgs) {
+            std::size_t rest = m_gso_first[msg];
+            if (fallback) {
+                for (std::size_t i = rest; i < count; ++i) {
+                    m_plain_msgs[i - rest] = m_send_msgs[m_order[i]];
+                }
+                sent += sendMsgs(m_plain_msgs.data(), count - rest);
+            }
+            else {
+                m_send_dropped.fetch_add(count - rest, std::memory_order_relaxed);
+            }
+        }
+    }
+    m_send_packets.fetch_add(sent, std::memory_order_relaxed);
+    return static_cast<int>(sent);
+}
+
+std::size_t UdpBatchSocket::buildGso(std::size_t count)
+{
+    std::fill(m_grouped.begin(), m_grouped.begin() + count, 0);
+    std::size_t pos = 0;
+    std::size_t msgs = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (m_grouped[i]) {
+            continue;
+        }
+        // 同一目的地址的包放在一起, 组内保持原来的顺序
+        std::size_t group_begin = pos;
+        socklen_t addr_len = m_send_msgs[i].msg_hdr.msg_namelen;
+        for (std::size_t j = i; j < count; ++j) {
+            if (!m_grouped[j] && m_send_msgs[j].msg_hdr.msg_namelen == addr_len &&
+                std::memcmp(&m_send_addr[j], &m_send_addr[i], addr_len) == 0) {
+                m_grouped[j] = 1;
+                m_order[pos++] = static_cast<uint32_t>(j);
+            }
+        }
+        // 组内切成段长相同的消息, 只有最后一段可以更短
+        std::size_t k = group_begin;
+        while (k < pos) {
+            std::size_t segment = m_send_iov[m_order[k]].iov_len;
+            std::size_t total = segment;
+            std::size_t segs = 1;
+            while (k + segs < pos && segs < kGsoMaxSegments) {
+                std::size_t next = m_send_iov[m_order[k + segs]].iov_len;
+                if (next > segment || total + next > kGsoMaxBytes) {
+                    break;
+                }
+                total += next;
+                ++segs;
+                if (next < segment) {
+                    break;
+                }
+            }
+            for (std::size_t s = 0; s < segs; ++s) {
+                m_gso_iov[k + s] = m_send_iov[m_order[k + s]];
+            }
+            msghdr &hdr = m_gso_msgs[msgs].msg_hdr;
+            hdr.msg_name = &m_send_addr[m_order[k]];
+            hdr.msg_namelen = addr_len;
+            hdr.msg_iov = &m_gso_iov[k];
+            hdr.msg_iovlen = segs;
+            hdr.msg_flags = 0;
+            if (segs > 1) {
+                hdr.msg_control = m_gso_ctrl.data() + msgs * kSendCtrlSize;
+                hdr.msg_controllen = kSendCtrlSize;
+                cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t value = static_cast<uint16_t>(segment);
+                std::memcpy(CMSG_DATA(cm), &value, sizeof(value));
+            }
+            else {
+                hdr.msg_control = nullptr;
+                hdr.msg_controllen = 0;
+            }
+            m_gso_first[msgs] = static_cast<uint32_t>(k);
+            m_gso_segs[msgs] = static_cast<uint32_t>(segs);
+            ++msgs;
+            k += segs;
+        }
+    }
+    return msgs;
+}
+
+std::size_t UdpBatchSocket::sendMsgs(mmsghdr *msgs, std::size_t count)
+{
+    std::size_t sent = 0;
+    while (sent < count) {
+        int n = sendmmsg(m_fd, msgs + sent, static_cast<unsigned>(count - sent), 0);
+        m_send_calls.fetch_add(1, std::memory_order_relaxed);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            // EAGAIN 等: 这一批剩下的丢掉, 实时媒体不值得重试
+            m_send_dropped.fetch_add(count - sent, std::memory_order_relaxed);
+            break;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return sent;
+}
@@ -0,0 +1,144 @@
+#ifndef _UDP_BATCH_SOCKET_H_
+#define _UDP_BATCH_SOCKET_H_
+
+#include "rtp_packet.h"
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 用 recvmmsg / sendmmsg 批量收发的非阻塞 UDP socket
+ *
+ * 收发缓冲在 open 时一次性分配; recv 一次系统调用最多收 batch 个包,
+ * 发送先 queue 拷进发送批次, 由 flush 一次 sendmmsg 发出 (批次满时 queue 内部也会 flush)
+ * queue / flush 可以在多个线程调用, recv 只能在一个线程调用
+ *
+ * offload 打开且内核支持时:
+ * - 发送 (UDP_SEGMENT / GSO): 批次内发往同一地址、长度相同的连续包合成一个 GSO 消息,
+ *   内核只走一次 UDP 协议栈; 失败时关闭 GSO, 回落为逐包 sendmmsg
+ * - 接收 (UDP_GRO): 内核把同一流的包合并交付, recv 按段长拆回单个包
+ */
+class UdpBatchSocket
+{
+public:
+    struct Datagram {
+        const uint8_t *data;
+        std::size_t size;
+        const sockaddr *addr;
+        socklen_t addr_len;
+    };
+
+    struct Stats {
+        uint64_t recv_calls;
+        uint64_t recv_packets;
+        uint64_t send_calls;
+        uint64_t send_packets;
+        uint64_t send_dropped;
+        uint64_t gso_messages; // 携带多个段的发送消息
+        uint64_t gro_messages; // 内核合并过的接收消息
+    };
+
+    explicit UdpBatchSocket(std::size_t batch = 64, std::size_t buf_size = kRtpMaxPacket, bool offload = true);
+    ~UdpBatchSocket();
+
+    UdpBatchSocket(const UdpBatchSocket &) = delete;
+    UdpBatchSocket &operator=(const UdpBatchSocket &) = delete;
+
+    // ip 为空时绑定 0.0.0.0; port 为 0 时由系统分配
+    bool open(const std::string &ip, uint16_t port, bool reuse_port = false);
+    void close();
+
+    int fd() const
+    {
+        return m_fd;
+    }
+
+    bool gso() const
+    {
+        return m_gso;
+    }
+
+    bool gro() const
+    {
+        return m_gro;
+    }
+
+    uint16_t localPort() const;
+
+    // 一次 recvmmsg, 返回拆分后的包数 (没有数据时为 0); 结果在下一次 recv 前有效
+    int recv();
+
+    const Datagram &datagram(int i) const
+    {
+        return m_datagrams[i];
+    }
+
+    bool queue(const sockaddr *addr, socklen_t addr_len, const uint8_t *data, std::size_t size);
+    // 先拷 head 再拷 data, 用于给转发的负载加头 (如 TURN ChannelData) 而不必先拼到临时缓冲
+    bool queue(const sockaddr *addr,
+               socklen_t addr_len,
+               const uint8_t *head,
+               std::size_t head_size,
+               const uint8_t *data,
+               std::size_t size);
+    int flush();
+
+    Stats stats();
+
+private:
+    void setupRecv(std::size_t slots, std::size_t slot_size);
+    int flushLocked();
+    std::size_t buildGso(std::size_t count);
+    std::size_t sendMsgs(mmsghdr *msgs, std::size_t count);
+
+private:
+    int m_fd;
+    std::size_t m_batch;
+    std::size_t m_buf_size;
+    bool m_offload;
+    bool m_gso;
+    bool m_gro;
+
+    // 接收
+    std::size_t m_recv_slots;
+    std::size_t m_recv_slot_size;
+    std::vector<uint8_t> m_recv_buf;
+    std::vector<sockaddr_storage> m_recv_addr;
+    std::vector<iovec> m_recv_iov;
+    std::vector<mmsghdr> m_recv_msgs;
+    std::vector<uint8_t> m_recv_ctrl;
+    std::vector<Datagram> m_datagrams;
+
+    // 发送
+    std::mutex m_send_mtx;
+    std::vector<uint8_t> m_send_buf;
+    std::vector<sockaddr_storage> m_send_addr;
+    std::vector<iovec> m_send_iov;
+    std::vector<mmsghdr> m_send_msgs;
+    std::size_t m_send_count;
+
+    // GSO 组包用的临时数组, 大小都是 batch
+    std::vector<uint32_t> m_order;      // 按目的地址分组后的包下标
+    std::vector<uint8_t> m_grouped;
+    std::vector<iovec> m_gso_iov;
+    std::vector<mmsghdr> m_gso_msgs;
+    std::vector<uint32_t> m_gso_first;  // 每个消息在 m_order 中的起始位置
+    std::vector<uint32_t> m_gso_segs;
+    std::vector<uint8_t> m_gso_ctrl;
+    std::vector<mmsghdr> m_plain_msgs;
+
+    std::atomic<uint64_t> m_recv_calls;
+    std::atomic<uint64_t> m_recv_packets;
+    std::atomic<uint64_t> m_send_calls;
+    std::atomic<uint64_t> m_send_packets;
+    std::atomic<uint64_t> m_send_dropped;
+    std::atomic<uint64_t> m_gso_messages;
+    std::atomic<uint64_t> m_gro_messages;
+};
+
+#endif // _UDP_BATCH_SOCKET_H_
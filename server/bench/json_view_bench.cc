@@ -0,0 +1,157 @@
+#include "json_view.h"
+#include "signal_message.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+ * 信令解析的单线程吞吐, JsonView 与 jsoncpp 对比, 消息取 WsSession 实际转发的几种:
+ * candidate、end-of-candidates、带 channel 的 answer、约 2 KB 的 offer
+ * parse 一栏是解析 + 取 type / channel (WsSession 判断怎么转发需要的全部信息),
+ * relay 一栏再加上给 robot 连接打 channel 号重新生成消息 (make_channel_signal)
+ * 每项反复跑直到累计约 seconds 秒; 用法 json_view_bench [seconds], 默认 0.5 s
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static volatile std::size_t g_sink; // 防止结果被优化掉
+
+struct Sample {
+    const char *name;
+    std::string msg;
+};
+
+// 和浏览器 / robot 发来的 offer 差不多大小的 SDP
+static std::string make_sdp()
+{
+    std::string sdp = "v=0\\r\\no=- 4611731400430051336 2 IN IP4 127.0.0.1\\r\\ns=-\\r\\nt=0 0\\r\\n"
+                      "a=group:BUNDLE 0\\r\\na=msid-semantic: WMS\\r\\n"
+                      "m=audio 9 UDP/TLS/RTP/SAVPF 111 63 9 0 8 13 110 126\\r\\nc=IN IP4 0.0.0.0\\r\\n"
+                      "a=rtcp:9 IN IP4 0.0.0.0\\r\\na=ice-ufrag:Hk3e\\r\\na=ice-pwd:f1nYvI8wq9Xl9P3Zr0ZkEw7k\\r\\n"
+                      "a=ice-options:trickle\\r\\n"
+                      "a=fingerprint:sha-256 3B:1F:9C:A0:44:5E:7D:21:90:C8:AF:12:6E:3D:58:0B:77:E1:4C:9A:2D:"
+                      "B6:F0:83:15:C4:6A:99:0E:D2:7B:35\\r\\na=setup:actpass\\r\\na=mid:0\\r\\n"
+                      "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\\r\\n"
+                      "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\\r\\n"
+                      "a=sendrecv\\r\\na=rtcp-mux\\r\\na=rtpmap:111 opus/48000/2\\r\\na=rtcp-fb:111 transport-cc\\r\\n"
+                      "a=fmtp:111 minptime=10;useinbandfec=1\\r\\na=rtpmap:63 red/48000/2\\r\\n"
+                      "a=fmtp:63 111/111\\r\\na=rtpmap:9 G722/8000\\r\\na=rtpmap:0 PCMU/8000\\r\\n"
+                      "a=rtpmap:8 PCMA/8000\\r\\na=rtpmap:13 CN/8000\\r\\na=rtpmap:110 telephone-event/48000\\r\\n"
+                      "a=rtpmap:126 telephone-event/8000\\r\\n";
+    for (int i = 0; i < 8; ++i) {
+        sdp += "a=ssrc:1001" + std::to_string(i) + " cname:lAudio" + std::to_string(i) + "xYz\\r\\n";
+    }
+    return sdp;
+}
+
+static std::vector<Sample> make_samples()
+{
+    std::vector<Sample> samples;
+    samples.push_back({"candidate",
+                       "{\"type\":\"candidate\",\"candidate\":\"candidate:1 1 UDP 2122252543 192.168.1.20 54321 typ "
+                       "host\",\"mid\":\"0\"}"});
+    samples.push_back({"end-of-cand", "{\"type\":\"end-of-candidates\"}"});
+    samples.push_back({"answer+chan", "{\"channel\":7,\"type\":\"answer\",\"sdp\":\"" + make_sdp() + "\"}"});
+    samples.push_back({"offer", "{\"type\":\"offer\",\"sdp\":\"" + make_sdp() + "\"}"});
+    return samples;
+}
+
+// 跑 fn 直到累计约 seconds 秒, 返回每条消息的 ns
+template <typename Fn>
+static double measure(double seconds, Fn fn)
+{
+    for (int i = 0; i < 1000; ++i) {
+        fn();
+    }
+    uint64_t msgs = 0;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end;
+    do {
+        for (int i = 0; i < 1000; ++i) {
+            fn();
+        }
+        msgs += 1000;
+        end = Clock::now();
+    } while (end - begin < std::chrono::duration<double>(seconds));
+    return std::chrono::duration<double, std::nano>(end - begin).count() / msgs;
+}
+
+static void jsoncpp_parse(const std::string &msg)
+{
+    Json::Value root;
+    SignalType type = parse_signal(msg, root);
+    g_sink += type + signal_channel(root);
+}
+
+static void view_parse(const std::string &msg)
+{
+    JsonView view;
+    SignalType type = kSignalUnknown;
+    if (view.parse(msg) && parse_signal(view, type)) {
+        g_sink += type + signal_channel(view);
+    }
+}
+
+static void jsoncpp_relay(const std::string &msg)
+{
+    Json::Value root;
+    SignalType type = parse_signal(msg, root);
+    g_sink += type + make_channel_signal(root, 3).size();
+}
+
+static void view_relay(const std::string &msg)
+{
+    JsonView view;
+    SignalType type = kSignalUnknown;
+    if (view.parse(msg) && parse_signal(view, type)) {
+        g_sink += type + make_channel_signal(view, 3).size();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 0.5;
+    if (seconds <= 0) {
+        seconds = 0.5;
+    }
+    std::vector<Sample> samples = make_samples();
+
+    // 两边对同一条消息的判断必须一致, 否则比的不是同一件事
+    for (const Sample &s : samples) {
+        Json::Value root;
+        JsonView view;
+        SignalType fast = kSignalUnknown;
+        if (!view.parse(s.msg) || !parse_signal(view, fast) || fast != parse_signal(s.msg, root)
+            || signal_channel(view) != signal_channel(root)) {
+            std::printf("%s: JsonView and jsoncpp disagree\n", s.name);
+            return 1;
+        }
+    }
+
+    std::printf("ns per message on one core (MB/s in brackets)\n");
+    std::printf("%-12s %6s %22s %22s %9s %22s %22s %9s\n", "message", "bytes", "jsoncpp parse", "JsonView parse",
+                "speedup", "jsoncpp relay", "JsonView relay", "speedup");
+    for (const Sample &s : samples) {
+        const std::string &msg = s.msg;
+        double jp = measure(seconds, [&]() {
+            jsoncpp_parse(msg);
+        });
+        double vp = measure(seconds, [&]() {
+            view_parse(msg);
+        });
+        double jr = measure(seconds, [&]() {
+            jsoncpp_relay(msg);
+        });
+        double vr = measure(seconds, [&]() {
+            view_relay(msg);
+        });
+        auto mbps = [&](double ns) {
+            return msg.size() / ns * 1e3;
+        };
+        std::printf("%-12s %6zu %10.0f (%8.1f) %10.0f (%8.1f) %8.1fx %10.0f (%8.1f) %10.0f (%8.1f) %8.1fx\n", s.name,
+                    msg.size(), jp, mbps(jp), vp, mbps(vp), jp / vp, jr, mbps(jr), vr, mbps(vr), jr / vr);
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "tls_stream.h"
+#include "logger.h"
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <time.h>
+#include <unistd.h>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * TlsStream 写路径在回环上的吞吐, 用户态 TLS 与 kTLS 对比:
+ * 服务端 TlsStream 反复 async_write {WebSocket 帧头, payload} 两个 buffer (和 WsSession 写媒体帧一样),
+ * 客户端线程用 OpenSSL 阻塞读并丢弃; 每种模式、每个 payload 跑 seconds 秒,
+ * 以写线程的 CPU 时间 (含内核态, kTLS 的加密算在这里) 折算每核吞吐
+ * 证书在进程内临时生成; 内核没有 tls ULP 时 kTLS 一栏标为不可用
+ * 用法 tls_stream_bench [seconds] [payload...]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    bool ktls_send;  // 握手后实际启用了 kTLS 发送
+    double msgs_per_s;
+    double mb_per_s;
+    double cpu_ratio; // 写线程 CPU 时间 / 墙钟时间
+};
+
+static double thread_cpu_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 自签名 P-256 证书写到临时目录, 返回是否成功
+static bool make_cert(const std::string &cert_file, const std::string &key_file)
+{
+    EVP_PKEY *pkey = nullptr;
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    bool generated = pctx && EVP_PKEY_keygen_init(pctx) > 0
+                     && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) > 0
+                     && EVP_PKEY_keygen(pctx, &pkey) > 0;
+    EVP_PKEY_CTX_free(pctx);
+    if (!generated) {
+        return false;
+    }
+    X509 *x509 = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    X509_NAME *name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("localhost"), -1, -1,
+                               0);
+    X509_set_issuer_name(x509, name);
+    bool ok = X509_sign(x509, pkey, EVP_sha256()) > 0;
+    FILE *f = std::fopen(cert_file.c_str(), "w");
+    ok = ok && f && PEM_write_X509(f, x509);
+    if (f) {
+        std::fclose(f);
+    }
+    f = std::fopen(key_file.c_str(), "w");
+    ok = ok && f && PEM_write_PrivateKey(f, pkey, nullptr, nullptr, 0, nullptr, nullptr);
+    if (f) {
+        std::fclose(f);
+    }
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+static bool run_one(const TlsContext &ctx, std::size_t payload, double seconds, Result &result)
+{
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    unsigned short port = acceptor.local_endpoint().port();
+    std::thread client([port]() {
+        net::io_context client_ioc;
+        tcp::socket socket(client_ioc);
+        socket.connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port));
+        SSL_CTX *client_ctx = SSL_CTX_new(TLS_client_method());
+        SSL *ssl = SSL_new(client_ctx);
+        SSL_set_fd(ssl, socket.native_handle());
+        if (SSL_connect(ssl) == 1) {
+            std::vector<char> buf(1 << 16);
+            while (SSL_read(ssl, buf.data(), static_cast<int>(buf.size())) > 0) {
+            }
+        }
+        SSL_free(ssl);
+        SSL_CTX_free(client_ctx);
+    });
+
+    TlsStream stream(acceptor.accept());
+    stream.set_tls(ctx);
+    bool handshake_ok = false;
+    stream.async_handshake([&](beast::error_code ec) {
+        handshake_ok = !ec;
+    });
+    ioc.run();
+    ioc.restart();
+    if (!handshake_ok) {
+        beast::error_code ec;
+        stream.next_layer().socket().close(ec);
+        client.join();
+        return false;
+    }
+    result.ktls_send = stream.is_ktls_send();
+
+    // 二进制帧, 16 位扩展长度的帧头
+    char header[4] = {static_cast<char>(0x82), 126, 0, 0};
+    std::vector<char> data(payload, 'x');
+    std::array<net::const_buffer, 2> buffers {net::buffer(header), net::buffer(data)};
+    uint64_t msgs = 0;
+    Clock::time_point begin = Clock::now();
+    double cpu_begin = thread_cpu_s();
+    std::function<void()> write_next = [&]() {
+        net::async_write(stream, buffers, [&](beast::error_code ec, std::size_t) {
+            if (ec) {
+                std::printf("write: %s\n", ec.message().c_str());
+                return;
+            }
+            ++msgs;
+            if (Clock::now() - begin < std::chrono::duration<double>(seconds)) {
+                write_next();
+            }
+        });
+    };
+    write_next();
+    ioc.run();
+    double cpu = thread_cpu_s() - cpu_begin;
+    double wall = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    stream.shutdown_tls();
+    beast::error_code ec;
+    stream.next_layer().socket().close(ec);
+    client.join();
+
+    result.msgs_per_s = msgs / wall;
+    result.mb_per_s = msgs * (payload + sizeof(header)) / wall / 1e6;
+    result.cpu_ratio = cpu / wall;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    if (seconds <= 0) {
+        seconds = 2.0;
+    }
+    std::vector<std::size_t> payloads;
+    for (int i = 2; i < argc; ++i) {
+        payloads.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+    if (payloads.empty()) {
+        // 20 ms 的 Opus 帧, 一个 MTU, 一个整记录, 多个记录
+        payloads = {160, 1400, 16384, 65535};
+    }
+
+    Logger::init();
+    char dir[] = "/tmp/tls_stream_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::printf("mkdtemp failed\n");
+        return 1;
+    }
+    std::string cert_file = std::string(dir) + "/cert.pem";
+    std::string key_file = std::string(dir) + "/key.pem";
+    if (!make_cert(cert_file, key_file)) {
+        std::printf("generate certificate failed\n");
+        return 1;
+    }
+    TlsContext::Sptr user_ctx = TlsContext::create(cert_file, key_file, false);
+    TlsContext::Sptr ktls_ctx = TlsContext::create(cert_file, key_file, true);
+    std::remove(cert_file.c_str());
+    std::remove(key_file.c_str());
+    rmdir(dir);
+    if (!user_ctx || !ktls_ctx) {
+        std::printf("create tls context failed\n");
+        return 1;
+    }
+
+    std::printf("%8s %10s %12s %10s %8s %14s\n", "payload", "mode", "msg/s", "MB/s", "cpu", "MB/s per core");
+    for (std::size_t payload : payloads) {
+        const TlsContext *contexts[] = {user_ctx.get(), ktls_ctx.get()};
+        for (const TlsContext *ctx : contexts) {
+            const char *mode = ctx == user_ctx.get() ? "userspace" : "ktls";
+            Result r = {};
+            if (!run_one(*ctx, payload, seconds, r)) {
+                std::printf("%8zu %10s handshake failed\n", payload, mode);
+                continue;
+            }
+            // kTLS 上下文在内核不支持时会退回用户态, 这时的数字不能当 kTLS 的
+            if (ctx == ktls_ctx.get() && !r.ktls_send) {
+                std::printf("%8zu %10s unavailable (kernel tls ULP not enabled, fell back to userspace)\n", payload,
+                            mode);
+                continue;
+            }
+            std::printf("%8zu %10s %12.0f %10.1f %7.0f%% %14.1f\n", payload, mode, r.msgs_per_s, r.mb_per_s,
+                        r.cpu_ratio * 100, r.cpu_ratio > 0 ? r.mb_per_s / r.cpu_ratio : 0.0);
+        }
+    }
+    return 0;
+}
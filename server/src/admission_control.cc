@@ -0,0 +1,179 @@
+#include "admission_control.h"
+#include "ws_session_mgr.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cstdio>
+
+void TokenBucket::reset(double rate, double burst)
+{
+    m_rate = rate;
+    m_burst = std::max(burst, 1.0);
+    m_tokens = m_burst;
+    m_last_us = 0;
+}
+
+bool TokenBucket::take(uint64_t now_us, uint64_t &wait_us)
+{
+    if (m_last_us != 0 && now_us > m_last_us) {
+        m_tokens = std::min(m_burst, m_tokens + m_rate * (now_us - m_last_us) / 1e6);
+    }
+    m_last_us = now_us;
+    if (m_tokens >= 1) {
+        m_tokens -= 1;
+        return true;
+    }
+    wait_us = m_rate > 0 ? static_cast<uint64_t>((1 - m_tokens) / m_rate * 1e6) : UINT64_MAX;
+    return false;
+}
+
+AdmissionTicket::AdmissionTicket(std::atomic<std::size_t> *pending) :
+    m_pending(pending)
+{
+    m_pending->fetch_add(1, std::memory_order_relaxed);
+}
+
+AdmissionTicket::~AdmissionTicket()
+{
+    release();
+}
+
+AdmissionTicket::AdmissionTicket(AdmissionTicket &&other) noexcept :
+    m_pending(other.m_pending)
+{
+    other.m_pending = nullptr;
+}
+
+AdmissionTicket &AdmissionTicket::operator=(AdmissionTicket &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_pending = other.m_pending;
+        other.m_pending = nullptr;
+    }
+    return *this;
+}
+
+void AdmissionTicket::release()
+{
+    if (m_pending) {
+        m_pending->fetch_sub(1, std::memory_order_relaxed);
+        m_pending = nullptr;
+    }
+}
+
+static const char *kVerdictNames[AdmissionControl::kVerdicts] = {
+    "admitted",
+    "loop_lag",
+    "sessions",
+    "pending",
+    "rate",
+    "robot",
+};
+
+AdmissionControl::AdmissionControl() :
+    m_rng(std::random_device()()),
+    m_pending(0),
+    m_loop_lag_us(0)
+{
+    for (auto &count : m_verdicts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    configure(Config());
+}
+
+void AdmissionControl::configure(const Config &cfg)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_cfg = cfg;
+    m_handshakes.reset(cfg.handshake_rate, cfg.handshake_burst);
+    m_robots.reset(cfg.robot_rate, cfg.robot_burst);
+    m_robot_retry_us = 0;
+}
+
+uint32_t AdmissionControl::admit_connection(AdmissionTicket &ticket)
+{
+    uint64_t lag_us = m_loop_lag_us.load(std::memory_order_relaxed);
+    std::size_t pending = m_pending.load(std::memory_order_relaxed);
+    // 快照最多落后一个发布周期, 握手中的连接另算
+    RegistrySnapshot::Sptr snap = WsSessionMgr::getInstance()->snapshot();
+    std::size_t sessions = snap->voip_count() + snap->robot_count() + pending;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    uint64_t max_lag_us = static_cast<uint64_t>(m_cfg.max_loop_lag_ms) * 1000;
+    if (max_lag_us != 0 && lag_us > max_lag_us) {
+        // 延迟是上限的几倍就让客户端隔几秒再来
+        return reject(kRejectLag, lag_us / max_lag_us * 1000000);
+    }
+    if (sessions >= m_cfg.max_sessions) {
+        return reject(kRejectSessions, kSessionsRetryAfterS * 1000000ULL);
+    }
+    if (pending >= m_cfg.max_pending) {
+        return reject(kRejectPending, 1000000);
+    }
+    uint64_t wait_us = 0;
+    if (!m_handshakes.take(steady_us(), wait_us)) {
+        return reject(kRejectRate, wait_us);
+    }
+    m_verdicts[kAdmit].fetch_add(1, std::memory_order_relaxed);
+    ticket = AdmissionTicket(&m_pending);
+    return 0;
+}
+
+uint32_t AdmissionControl::admit_robot()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    uint64_t now = steady_us();
+    uint64_t wait_us = 0;
+    if (m_robots.take(now, wait_us)) {
+        return 0;
+    }
+    // 排在上一个被推迟的 robot 之后 1 / rate 秒
+    uint64_t slot_us = static_cast<uint64_t>(1e6 / std::max(m_robots.rate(), 1e-3));
+    uint64_t max_retry_s = std::max<uint32_t>(m_cfg.max_retry_after_s, 1);
+    uint64_t limit_us = now + max_retry_s * 1000000;
+    uint64_t retry_us = std::max(m_robot_retry_us, now + wait_us) + slot_us;
+    if (retry_us > limit_us) {
+        // 排到上限之外的不再往后排 (否则都会被截成同一个 Retry-After 一起回来), 在整个窗口里随机挑一秒
+        m_robot_retry_us = limit_us;
+        std::uniform_int_distribution<uint64_t> pick(1, max_retry_s);
+        return reject(kDeferRobot, pick(m_rng) * 1000000);
+    }
+    m_robot_retry_us = retry_us;
+    return reject(kDeferRobot, retry_us - now);
+}
+
+uint32_t AdmissionControl::reject(Verdict verdict, uint64_t retry_us)
+{
+    m_verdicts[verdict].fetch_add(1, std::memory_order_relaxed);
+    // Retry-After 只能是整秒, 向上取整, 至少 1 s
+    uint64_t retry_s = std::max<uint64_t>(1, (retry_us + 999999) / 1000000);
+    return static_cast<uint32_t>(std::min<uint64_t>(retry_s, std::max<uint32_t>(m_cfg.max_retry_after_s, 1)));
+}
+
+void AdmissionControl::on_loop_lag(uint64_t lag_us)
+{
+    // 平滑系数 1/4, 单次抖动不会触发拒绝, 持续几次 (几百 ms) 才会
+    uint64_t prev = m_loop_lag_us.load(std::memory_order_relaxed);
+    m_loop_lag_us.store(prev - prev / 4 + lag_us / 4, std::memory_order_relaxed);
+}
+
+std::string AdmissionControl::metrics() const
+{
+    std::string out;
+    char line[128];
+    out += "# TYPE laudio_loop_lag_seconds gauge\n";
+    snprintf(line, sizeof(line), "laudio_loop_lag_seconds %.6f\n", loop_lag_us() / 1e6);
+    out += line;
+    out += "# TYPE laudio_pending_handshakes gauge\n";
+    out += "laudio_pending_handshakes " + std::to_string(m_pending.load(std::memory_order_relaxed)) + "\n";
+    out += "# TYPE laudio_admission_total counter\n";
+    for (int verdict = 0; verdict < kVerdicts; ++verdict) {
+        snprintf(line,
+                 sizeof(line),
+                 "laudio_admission_total{verdict=\"%s\"} %llu\n",
+                 kVerdictNames[verdict],
+                 static_cast<unsigned long long>(m_verdicts[verdict].load(std::memory_order_relaxed)));
+        out += line;
+    }
+    return out;
+}
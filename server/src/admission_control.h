@@ -0,0 +1,126 @@
+#ifndef _ADMISSION_CONTROL_H_
+#define _ADMISSION_CONTROL_H_
+
+#include "singleton.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+
+/**
+ * @brief 令牌桶, 不加锁, 由使用者保证互斥
+ */
+class TokenBucket
+{
+public:
+    void reset(double rate, double burst);
+    // 取一个令牌; 没有时返回 false, wait_us 为攒够一个令牌还要多久
+    bool take(uint64_t now_us, uint64_t &wait_us);
+
+    double rate() const
+    {
+        return m_rate;
+    }
+
+private:
+    double m_rate = 0;
+    double m_burst = 0;
+    double m_tokens = 0;
+    uint64_t m_last_us = 0;
+};
+
+/**
+ * @brief 握手中的一个连接, 析构或 release 时从握手中的连接数里减掉
+ */
+class AdmissionTicket
+{
+public:
+    AdmissionTicket() = default;
+    explicit AdmissionTicket(std::atomic<std::size_t> *pending);
+    ~AdmissionTicket();
+
+    AdmissionTicket(AdmissionTicket &&other) noexcept;
+    AdmissionTicket &operator=(AdmissionTicket &&other) noexcept;
+    AdmissionTicket(const AdmissionTicket &) = delete;
+    AdmissionTicket &operator=(const AdmissionTicket &) = delete;
+
+    void release();
+
+private:
+    std::atomic<std::size_t> *m_pending = nullptr;
+};
+
+/**
+ * @brief 接入控制: 过载时在 WebSocket 升级之前就拒绝新连接, 保住已有呼叫的时延
+ *
+ * 新连接按 IO 线程事件循环延迟、会话数 (已登录 + 握手中)、握手速率 (令牌桶) 决定放不放行,
+ * 被拒的连接回 503 + Retry-After, 不做升级也不进会话表;
+ * robot 上线另有一个令牌桶, 整个 robot 集群重启时被推迟的 robot 按令牌速率排队,
+ * 各自的 Retry-After 相隔 1 / rate 秒, 回来时不会再同时涌进来
+ */
+class AdmissionControl : public Singleton<AdmissionControl>
+{
+    friend class Singleton<AdmissionControl>;
+
+public:
+    struct Config {
+        double handshake_rate = 500;    // 每秒新连接
+        double handshake_burst = 1000;
+        double robot_rate = 20;         // 每秒 robot 上线
+        double robot_burst = 50;
+        uint32_t max_loop_lag_ms = 50;  // 事件循环延迟超过时拒绝新连接
+        std::size_t max_sessions = 50000;
+        std::size_t max_pending = 512;  // 同时在握手的连接数
+        uint32_t max_retry_after_s = 60;
+    };
+
+    enum Verdict {
+        kAdmit,
+        kRejectLag,
+        kRejectSessions,
+        kRejectPending,
+        kRejectRate,
+        kDeferRobot,
+        kVerdicts,
+    };
+
+    static constexpr int kLoopProbeMs = 100;
+    // 会话数满时让客户端隔多久再来
+    static constexpr uint32_t kSessionsRetryAfterS = 5;
+
+    void configure(const Config &cfg);
+
+    // 刚 accept 的连接: 放行时返回 0 并发一张握手中的票, 否则返回 Retry-After 秒数
+    uint32_t admit_connection(AdmissionTicket &ticket);
+    // 请求路径是 /robot 的连接: 放行时返回 0, 否则返回 Retry-After 秒数
+    uint32_t admit_robot();
+
+    // IO 线程上的探测定时器比预定晚了多少 (us), 每 kLoopProbeMs 一次
+    void on_loop_lag(uint64_t lag_us);
+    uint64_t loop_lag_us() const
+    {
+        return m_loop_lag_us.load(std::memory_order_relaxed);
+    }
+
+    // Prometheus 文本格式
+    std::string metrics() const;
+
+private:
+    AdmissionControl();
+
+    uint32_t reject(Verdict verdict, uint64_t retry_us);
+
+private:
+    Config m_cfg;
+    std::mutex m_mtx; // 保护两个令牌桶、m_robot_retry_us 和 m_rng
+    TokenBucket m_handshakes;
+    TokenBucket m_robots;
+    uint64_t m_robot_retry_us = 0; // 最后一个被推迟的 robot 约好回来的时刻, 不超过 now + max_retry_after_s
+    std::minstd_rand m_rng;        // 排满后随机分散 Retry-After
+    std::atomic<std::size_t> m_pending;
+    std::atomic<uint64_t> m_loop_lag_us; // 平滑后的事件循环延迟
+    std::atomic<uint64_t> m_verdicts[kVerdicts];
+};
+
+#endif // _ADMISSION_CONTROL_H_
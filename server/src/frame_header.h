@@ -0,0 +1,91 @@
+#ifndef _FRAME_HEADER_H_
+#define _FRAME_HEADER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief WebSocket 二进制帧的定长帧头, 解析和构造都只读写调用方给的内存, 不分配
+ *
+ *   0     1      2        4        8             16
+ *   +-----+------+--------+--------+-------------+---------
+ *   | ver | type | stream |  seq   | capture_us  | payload
+ *   +-----+------+--------+--------+-------------+---------
+ *
+ * 全部大端; stream 在多路复用 robot 连接上是通道号, 其余连接为 0;
+ * seq 由帧的发送方按 stream 递增, 中间缺号说明丢帧; capture_us 是采集时刻
+ * (发送方时钟, 微秒), 0 表示未知; type 为 media 时 payload 是一个 Opus 包,
+ * 为 control 时是一条 JSON 信令 (和文本帧的信令相同, 通道号取 stream)
+ *
+ * 多路复用的 robot 连接总是带帧头, voip 和单路 robot 以 framing=1 登录时带帧头;
+ * 服务器内部转发的媒体帧也是这个格式, 不带帧头的连接在收发时补上 / 去掉
+ */
+const std::size_t kFrameHeaderSize = 16;
+const uint8_t kFrameVersion = 1;
+
+enum FrameType : uint8_t {
+    kFrameMedia = 0,
+    kFrameControl = 1,
+};
+
+struct FrameHeader {
+    uint8_t type = kFrameMedia;
+    uint16_t stream = 0;
+    uint32_t seq = 0;
+    uint64_t capture_us = 0;
+};
+
+// 帧太短 / 版本或类型不认识时返回 false
+inline bool parse_frame_header(const char *data, std::size_t size, FrameHeader &hdr)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    if (size < kFrameHeaderSize || p[0] != kFrameVersion || p[1] > kFrameControl) {
+        return false;
+    }
+    hdr.type = p[1];
+    hdr.stream = static_cast<uint16_t>(p[2] << 8 | p[3]);
+    hdr.seq = static_cast<uint32_t>(p[4]) << 24 | static_cast<uint32_t>(p[5]) << 16 | static_cast<uint32_t>(p[6]) << 8
+              | p[7];
+    hdr.capture_us = 0;
+    for (int i = 8; i < 16; ++i) {
+        hdr.capture_us = hdr.capture_us << 8 | p[i];
+    }
+    return true;
+}
+
+// out 至少 kFrameHeaderSize 字节
+inline void write_frame_header(const FrameHeader &hdr, char *out)
+{
+    uint8_t *p = reinterpret_cast<uint8_t *>(out);
+    p[0] = kFrameVersion;
+    p[1] = hdr.type;
+    p[2] = static_cast<uint8_t>(hdr.stream >> 8);
+    p[3] = static_cast<uint8_t>(hdr.stream);
+    for (int i = 0; i < 4; ++i) {
+        p[4 + i] = static_cast<uint8_t>(hdr.seq >> (24 - 8 * i));
+    }
+    for (int i = 0; i < 8; ++i) {
+        p[8 + i] = static_cast<uint8_t>(hdr.capture_us >> (56 - 8 * i));
+    }
+}
+
+// 转发时原地改写通道号, frame 必须是已经校验过的带帧头的帧
+inline void set_frame_stream(std::string &frame, uint16_t stream)
+{
+    frame[2] = static_cast<char>(stream >> 8);
+    frame[3] = static_cast<char>(stream & 0xFF);
+}
+
+// 帧头和 payload 一次拼好, 只分配一次
+inline std::string make_frame(const FrameHeader &hdr, const char *payload, std::size_t size)
+{
+    std::string frame(kFrameHeaderSize + size, '\0');
+    write_frame_header(hdr, &frame[0]);
+    if (size > 0) {
+        std::memcpy(&frame[kFrameHeaderSize], payload, size);
+    }
+    return frame;
+}
+
+#endif // _FRAME_HEADER_H_
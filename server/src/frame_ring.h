@@ -0,0 +1,74 @@
+#ifndef _FRAME_RING_H_
+#define _FRAME_RING_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief 定长的媒体帧环形缓冲, 满了覆盖最旧的一帧
+ *
+ * 等待配对的 voip 用它保留最近的一段音频 (pre-roll), 配上 robot 后一次发出;
+ * 槽里的 string 复用容量, 预热后 push 不再分配内存
+ */
+class FrameRing
+{
+public:
+    explicit FrameRing(std::size_t slots = 0) :
+        m_slots(slots),
+        m_head(0),
+        m_size(0)
+    {
+    }
+
+    // 第一次等待时才分配槽, 不等待的 voip 不占内存
+    void reserve(std::size_t slots)
+    {
+        if (m_slots.size() != slots) {
+            m_slots.assign(slots, std::string());
+            m_head = 0;
+            m_size = 0;
+        }
+    }
+
+    // 返回 false 表示覆盖了最旧的一帧
+    bool push(const std::string &frame)
+    {
+        if (m_slots.empty()) {
+            return false;
+        }
+        bool kept = true;
+        std::size_t tail = (m_head + m_size) % m_slots.size();
+        if (m_size == m_slots.size()) {
+            m_head = (m_head + 1) % m_slots.size();
+            kept = false;
+        }
+        else {
+            ++m_size;
+        }
+        m_slots[tail].assign(frame);
+        return kept;
+    }
+
+    // 从旧到新依次交给 func, 之后清空
+    template <typename Func>
+    void drain(Func &&func)
+    {
+        for (std::size_t i = 0; i < m_size; ++i) {
+            func(m_slots[(m_head + i) % m_slots.size()]);
+        }
+        m_head = 0;
+        m_size = 0;
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    std::vector<std::string> m_slots;
+    std::size_t m_head;
+    std::size_t m_size;
+};
+
+#endif // _FRAME_RING_H_
@@ -0,0 +1,75 @@
+#include "hash_ring.h"
+#include <algorithm>
+
+void HashRing::add(const std::string &node, uint32_t weight)
+{
+    if (m_nodes.find(node) != m_nodes.end()) {
+        remove(node);
+    }
+    uint32_t count = virtual_nodes(weight);
+    m_nodes[node] = count;
+    for (uint32_t i = 0; i < count; ++i) {
+        // 位置冲突时先到的节点保留, 少一个虚拟节点不影响分布
+        m_ring.emplace(hash(node + "#" + std::to_string(i)), node);
+    }
+}
+
+void HashRing::remove(const std::string &node)
+{
+    auto it = m_nodes.find(node);
+    if (it == m_nodes.end()) {
+        return;
+    }
+    for (uint32_t i = 0; i < it->second; ++i) {
+        auto pos = m_ring.find(hash(node + "#" + std::to_string(i)));
+        if (pos != m_ring.end() && pos->second == node) {
+            m_ring.erase(pos);
+        }
+    }
+    m_nodes.erase(it);
+}
+
+std::string HashRing::walk(const std::string &key,
+                           std::size_t max_nodes,
+                           const std::function<bool(const std::string &node)> &visit) const
+{
+    if (m_ring.empty()) {
+        return std::string();
+    }
+    max_nodes = std::min(max_nodes, m_nodes.size());
+    std::unordered_set<std::string> seen;
+    auto it = m_ring.lower_bound(hash(key));
+    for (std::size_t steps = 0; steps < m_ring.size() && seen.size() < max_nodes; ++steps, ++it) {
+        if (it == m_ring.end()) {
+            it = m_ring.begin();
+        }
+        if (!seen.insert(it->second).second) {
+            continue;
+        }
+        if (visit(it->second)) {
+            return it->second;
+        }
+    }
+    return std::string();
+}
+
+uint64_t HashRing::hash(const std::string &key)
+{
+    // FNV-1a, 再用 murmur3 的 fmix64 打散, 相近的 id 也能均匀落在环上
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint32_t HashRing::virtual_nodes(uint32_t weight)
+{
+    return std::min(std::max(weight, 1u) * kVirtualNodesPerWeight, kMaxVirtualNodes);
+}
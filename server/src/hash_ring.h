@@ -0,0 +1,46 @@
+#ifndef _HASH_RING_H_
+#define _HASH_RING_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_set>
+
+/**
+ * @brief 一致性哈希环, 每个节点按权重放若干个虚拟节点
+ *
+ * 节点加入 / 离开只增删自己的虚拟节点, 其余 key 的归属不变 (约 1/n 的 key 迁移);
+ * walk 从 key 的位置顺时针依次访问不同的节点, 由调用方决定接受哪一个 (有界负载)
+ */
+class HashRing
+{
+public:
+    // 每个节点的虚拟节点数 = 权重 * kVirtualNodesPerWeight, 上限 kMaxVirtualNodes
+    static constexpr uint32_t kVirtualNodesPerWeight = 8;
+    static constexpr uint32_t kMaxVirtualNodes = 512;
+
+    void add(const std::string &node, uint32_t weight);
+    void remove(const std::string &node);
+
+    // 顺时针访问最多 max_nodes 个不同节点, visit 返回 true 时停止并返回该节点; 都不接受时返回空串
+    std::string walk(const std::string &key,
+                     std::size_t max_nodes,
+                     const std::function<bool(const std::string &node)> &visit) const;
+
+    std::size_t nodes() const
+    {
+        return m_nodes.size();
+    }
+
+    static uint64_t hash(const std::string &key);
+
+private:
+    static uint32_t virtual_nodes(uint32_t weight);
+
+private:
+    std::map<uint64_t, std::string> m_ring;  // <位置, 节点>
+    std::map<std::string, uint32_t> m_nodes; // <节点, 虚拟节点数>
+};
+
+#endif // _HASH_RING_H_
@@ -0,0 +1,127 @@
+#ifndef _INDEXED_HEAP_H_
+#define _INDEXED_HEAP_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 带下标的二叉最小堆, 元素的键变化后可以原地调整
+ *
+ * 堆里存指针, 元素自己的 heap_index 成员记录当前位置,
+ * 所以 erase / update 不需要查找, 都是 O(log n)
+ *
+ * @tparam T    含 std::size_t heap_index 成员
+ * @tparam Less bool(const T *, const T *), 为 true 时前者更靠近堆顶
+ */
+template <typename T, typename Less>
+class IndexedHeap
+{
+public:
+    static constexpr std::size_t kNpos = static_cast<std::size_t>(-1);
+
+    bool empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    std::size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    T *top() const
+    {
+        return m_nodes.empty() ? nullptr : m_nodes.front();
+    }
+
+    void push(T *node)
+    {
+        node->heap_index = m_nodes.size();
+        m_nodes.push_back(node);
+        sift_up(node->heap_index);
+    }
+
+    void erase(T *node)
+    {
+        std::size_t i = node->heap_index;
+        if (i >= m_nodes.size() || m_nodes[i] != node) {
+            return;
+        }
+        std::size_t last = m_nodes.size() - 1;
+        if (i != last) {
+            place(i, m_nodes[last]);
+        }
+        m_nodes.pop_back();
+        node->heap_index = kNpos;
+        if (i != last) {
+            update_at(i);
+        }
+    }
+
+    // 元素的键变了 (变大变小都可以)
+    void update(T *node)
+    {
+        if (node->heap_index < m_nodes.size() && m_nodes[node->heap_index] == node) {
+            update_at(node->heap_index);
+        }
+    }
+
+private:
+    void place(std::size_t i, T *node)
+    {
+        m_nodes[i] = node;
+        node->heap_index = i;
+    }
+
+    void update_at(std::size_t i)
+    {
+        if (i > 0 && m_less(m_nodes[i], m_nodes[(i - 1) / 2])) {
+            sift_up(i);
+        }
+        else {
+            sift_down(i);
+        }
+    }
+
+    void sift_up(std::size_t i)
+    {
+        T *node = m_nodes[i];
+        while (i > 0) {
+            std::size_t parent = (i - 1) / 2;
+            if (!m_less(node, m_nodes[parent])) {
+                break;
+            }
+            place(i, m_nodes[parent]);
+            i = parent;
+        }
+        place(i, node);
+    }
+
+    void sift_down(std::size_t i)
+    {
+        T *node = m_nodes[i];
+        std::size_t n = m_nodes.size();
+        while (true) {
+            std::size_t child = 2 * i + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n && m_less(m_nodes[child + 1], m_nodes[child])) {
+                ++child;
+            }
+            if (!m_less(m_nodes[child], node)) {
+                break;
+            }
+            place(i, m_nodes[child]);
+            i = child;
+        }
+        place(i, node);
+    }
+
+private:
+    std::vector<T *> m_nodes;
+    Less m_less;
+};
+
+#endif // _INDEXED_HEAP_H_
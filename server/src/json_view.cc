@@ -0,0 +1,286 @@
+#include "json_view.h"
+
+bool JsonView::parse(std::string_view doc)
+{
+    m_doc = doc;
+    m_pos = 0;
+    m_count = 0;
+    skip_ws();
+    if (m_pos >= m_doc.size() || m_doc[m_pos] != '{') {
+        return false;
+    }
+    ++m_pos;
+    skip_ws();
+    if (m_pos < m_doc.size() && m_doc[m_pos] == '}') {
+        ++m_pos;
+    }
+    else {
+        while (true) {
+            if (m_count == kMaxMembers) {
+                return false;
+            }
+            Member &m = m_members[m_count];
+            std::size_t key_begin = m_pos + 1;
+            bool key_escaped = false;
+            if (!parse_string(key_escaped) || key_escaped) {
+                return false;
+            }
+            m.key = m_doc.substr(key_begin, m_pos - 1 - key_begin);
+            if (find(m.key)) {
+                return false;
+            }
+            skip_ws();
+            if (m_pos >= m_doc.size() || m_doc[m_pos] != ':') {
+                return false;
+            }
+            ++m_pos;
+            skip_ws();
+            std::size_t value_begin = m_pos;
+            if (!parse_value(1, m.kind, m.escaped)) {
+                return false;
+            }
+            m.value = m_doc.substr(value_begin, m_pos - value_begin);
+            ++m_count;
+            skip_ws();
+            if (m_pos >= m_doc.size()) {
+                return false;
+            }
+            if (m_doc[m_pos] == '}') {
+                ++m_pos;
+                break;
+            }
+            if (m_doc[m_pos] != ',') {
+                return false;
+            }
+            ++m_pos;
+            skip_ws();
+        }
+    }
+    // 对象后面只能是空白
+    skip_ws();
+    return m_pos == m_doc.size();
+}
+
+const JsonView::Member *JsonView::find(std::string_view key) const
+{
+    for (std::size_t i = 0; i < m_count; ++i) {
+        if (m_members[i].key == key) {
+            return &m_members[i];
+        }
+    }
+    return nullptr;
+}
+
+bool JsonView::get_string(std::string_view key, std::string_view &out) const
+{
+    const Member *m = find(key);
+    if (!m || m->kind != kString || m->escaped) {
+        return false;
+    }
+    out = m->value.substr(1, m->value.size() - 2);
+    return true;
+}
+
+bool JsonView::get_uint(std::string_view key, uint32_t &out) const
+{
+    const Member *m = find(key);
+    if (!m || m->kind != kNumber || m->value.empty() || m->value.size() > 10) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (char c : m->value) {
+        // 负数 / 小数 / 指数都不算无符号整数
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        v = v * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (v > UINT32_MAX) {
+        return false;
+    }
+    out = static_cast<uint32_t>(v);
+    return true;
+}
+
+void JsonView::skip_ws()
+{
+    while (m_pos < m_doc.size()) {
+        char c = m_doc[m_pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+        ++m_pos;
+    }
+}
+
+bool JsonView::parse_value(int depth, Kind &kind, bool &escaped)
+{
+    escaped = false;
+    if (m_pos >= m_doc.size()) {
+        return false;
+    }
+    switch (m_doc[m_pos]) {
+        case '"': {
+            kind = kString;
+            return parse_string(escaped);
+        }
+        case '{': {
+            kind = kObject;
+            return parse_container(depth + 1, '}');
+        }
+        case '[': {
+            kind = kArray;
+            return parse_container(depth + 1, ']');
+        }
+        case 't': {
+            kind = kBool;
+            return parse_literal("true");
+        }
+        case 'f': {
+            kind = kBool;
+            return parse_literal("false");
+        }
+        case 'n': {
+            kind = kNull;
+            return parse_literal("null");
+        }
+        default: {
+            kind = kNumber;
+            return parse_number();
+        }
+    }
+}
+
+bool JsonView::parse_string(bool &escaped)
+{
+    if (m_pos >= m_doc.size() || m_doc[m_pos] != '"') {
+        return false;
+    }
+    ++m_pos;
+    while (m_pos < m_doc.size()) {
+        unsigned char c = static_cast<unsigned char>(m_doc[m_pos++]);
+        if (c == '"') {
+            return true;
+        }
+        if (c < 0x20) {
+            return false;
+        }
+        if (c != '\\') {
+            continue;
+        }
+        escaped = true;
+        if (m_pos >= m_doc.size()) {
+            return false;
+        }
+        char e = m_doc[m_pos++];
+        if (e == 'u') {
+            for (int i = 0; i < 4; ++i, ++m_pos) {
+                char h = m_pos < m_doc.size() ? m_doc[m_pos] : '\0';
+                bool hex = (h >= '0' && h <= '9') || (h >= 'a' && h <= 'f') || (h >= 'A' && h <= 'F');
+                if (!hex) {
+                    return false;
+                }
+            }
+        }
+        else if (e != '"' && e != '\\' && e != '/' && e != 'b' && e != 'f' && e != 'n' && e != 'r' && e != 't') {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool JsonView::parse_number()
+{
+    auto digit = [this]() {
+        return m_pos < m_doc.size() && m_doc[m_pos] >= '0' && m_doc[m_pos] <= '9';
+    };
+    auto digits = [&]() {
+        if (!digit()) {
+            return false;
+        }
+        while (digit()) {
+            ++m_pos;
+        }
+        return true;
+    };
+    if (m_pos < m_doc.size() && m_doc[m_pos] == '-') {
+        ++m_pos;
+    }
+    // 整数部分不能有前导 0
+    if (m_pos < m_doc.size() && m_doc[m_pos] == '0') {
+        ++m_pos;
+    }
+    else if (!digits()) {
+        return false;
+    }
+    if (m_pos < m_doc.size() && m_doc[m_pos] == '.') {
+        ++m_pos;
+        if (!digits()) {
+            return false;
+        }
+    }
+    if (m_pos < m_doc.size() && (m_doc[m_pos] == 'e' || m_doc[m_pos] == 'E')) {
+        ++m_pos;
+        if (m_pos < m_doc.size() && (m_doc[m_pos] == '+' || m_doc[m_pos] == '-')) {
+            ++m_pos;
+        }
+        if (!digits()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonView::parse_literal(std::string_view word)
+{
+    if (m_doc.substr(m_pos, word.size()) != word) {
+        return false;
+    }
+    m_pos += word.size();
+    return true;
+}
+
+bool JsonView::parse_container(int depth, char close)
+{
+    if (depth > kMaxDepth) {
+        return false;
+    }
+    ++m_pos;
+    skip_ws();
+    if (m_pos < m_doc.size() && m_doc[m_pos] == close) {
+        ++m_pos;
+        return true;
+    }
+    while (true) {
+        bool escaped = false;
+        if (close == '}') {
+            // 嵌套对象的成员只校验, 不记录
+            if (!parse_string(escaped)) {
+                return false;
+            }
+            skip_ws();
+            if (m_pos >= m_doc.size() || m_doc[m_pos] != ':') {
+                return false;
+            }
+            ++m_pos;
+            skip_ws();
+        }
+        Kind kind;
+        if (!parse_value(depth, kind, escaped)) {
+            return false;
+        }
+        skip_ws();
+        if (m_pos >= m_doc.size()) {
+            return false;
+        }
+        if (m_doc[m_pos] == close) {
+            ++m_pos;
+            return true;
+        }
+        if (m_doc[m_pos] != ',') {
+            return false;
+        }
+        ++m_pos;
+        skip_ws();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef _JSON_VIEW_H_
+#define _JSON_VIEW_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief 只读的 JSON 扫描器: 在原文上校验整篇文档, 记下顶层对象的成员, 不分配内存
+ *
+ * 信令转发只需要 "type" 和 "channel" 两个字段, 其余原文照转, 不值得建一棵 Json::Value;
+ * 成员的值以原文的 string_view 给出, 字符串含转义时 get_string 返回 false,
+ * 调用方遇到 parse / get 失败时退回 jsoncpp
+ */
+class JsonView
+{
+public:
+    static constexpr std::size_t kMaxMembers = 16;
+    static constexpr int kMaxDepth = 32;
+
+    enum Kind {
+        kNull,
+        kBool,
+        kNumber,
+        kString,
+        kArray,
+        kObject,
+    };
+
+    struct Member {
+        std::string_view key;   // 不含引号, 原文 (不处理转义)
+        std::string_view value; // 原文, 字符串含引号
+        Kind kind;
+        bool escaped;           // 字符串值里有转义
+    };
+
+    // 整篇是合法 JSON, 顶层是对象且成员不超过 kMaxMembers 时返回 true;
+    // 顶层键有重复或带转义时也返回 false (jsoncpp 取重复键的最后一个, 这里不去猜)
+    bool parse(std::string_view doc);
+
+    // 同名成员取第一个; 没有时返回 nullptr
+    const Member *find(std::string_view key) const;
+    // 不含转义的字符串成员, out 为去掉引号的内容
+    bool get_string(std::string_view key, std::string_view &out) const;
+    bool get_uint(std::string_view key, uint32_t &out) const;
+
+    bool has_kind(std::string_view key, Kind kind) const
+    {
+        const Member *m = find(key);
+        return m && m->kind == kind;
+    }
+
+    std::string_view doc() const
+    {
+        return m_doc;
+    }
+
+    std::size_t size() const
+    {
+        return m_count;
+    }
+
+private:
+    void skip_ws();
+    bool parse_value(int depth, Kind &kind, bool &escaped);
+    bool parse_string(bool &escaped);
+    bool parse_number();
+    bool parse_literal(std::string_view word);
+    bool parse_container(int depth, char close);
+
+private:
+    std::string_view m_doc;
+    std::size_t m_pos = 0;
+    Member m_members[kMaxMembers];
+    std::size_t m_count = 0;
+};
+
+#endif // _JSON_VIEW_H_
@@ -0,0 +1,230 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram() :
+    m_total(0),
+    m_sum(0),
+    m_max(0)
+{
+    for (auto &count : m_counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(uint64_t us)
+{
+    m_counts[index_of(us)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (us > max && !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+std::size_t LatencyHistogram::index_of(uint64_t us)
+{
+    uint64_t v = std::min(us, kMaxValue);
+    // 第 0 段 64 格精确到 1 us, 之后每段范围翻倍、格宽翻倍, 只用上半的 32 格
+    int log2 = 63 - __builtin_clzll(v | (2 * kSubBucketHalf - 1));
+    int bucket = log2 - (kSubBucketBits - 1);
+    return static_cast<std::size_t>(bucket) * kSubBucketHalf + static_cast<std::size_t>(v >> bucket);
+}
+
+uint64_t LatencyHistogram::highest_value(std::size_t index)
+{
+    if (index < 2 * kSubBucketHalf) {
+        return index;
+    }
+    std::size_t bucket = index / kSubBucketHalf - 1;
+    uint64_t sub = index - bucket * kSubBucketHalf;
+    return (sub << bucket) + (1ULL << bucket) - 1;
+}
+
+void LatencySnapshot::add(const LatencyHistogram &hist)
+{
+    for (std::size_t i = 0; i < LatencyHistogram::kCounts; ++i) {
+        counts[i] += hist.m_counts[i].load(std::memory_order_relaxed);
+    }
+    total += hist.m_total.load(std::memory_order_relaxed);
+    sum += hist.m_sum.load(std::memory_order_relaxed);
+    max = std::max(max, hist.m_max.load(std::memory_order_relaxed));
+}
+
+uint64_t LatencySnapshot::quantile(double q) const
+{
+    // 各格的计数和 total 不是同一时刻读的, 以各格之和为准
+    uint64_t n = 0;
+    for (uint64_t c : counts) {
+        n += c;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * n + 0.5));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(LatencyHistogram::highest_value(i), max);
+        }
+    }
+    return max;
+}
+
+static const char *kLatencyNames[kLatencyKinds] = {
+    "relay",
+    "uplink",
+    "mouth_to_ear",
+};
+
+RelayLatency::RelayLatency() :
+    m_used(0)
+{
+    for (auto &slot : m_slots) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+RelayLatency::~RelayLatency()
+{
+    for (auto &slot : m_slots) {
+        delete slot.load(std::memory_order_acquire);
+    }
+}
+
+void RelayLatency::record(LatencyKind kind, uint64_t us)
+{
+    local()->hist[kind].record(us);
+}
+
+RelayLatency::ThreadHistograms *RelayLatency::local()
+{
+    static thread_local ThreadHistograms *hists = nullptr;
+    if (hists) {
+        return hists;
+    }
+    std::size_t index = std::min(m_used.fetch_add(1, std::memory_order_relaxed), kMaxThreads - 1);
+    ThreadHistograms *fresh = new ThreadHistograms();
+    ThreadHistograms *expected = nullptr;
+    // 线程退出后槽位和计数都保留, 之后的快照仍然算上它
+    if (m_slots[index].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+        hists = fresh;
+    }
+    else {
+        delete fresh;
+        hists = expected;
+    }
+    return hists;
+}
+
+LatencySnapshot RelayLatency::snapshot(LatencyKind kind) const
+{
+    LatencySnapshot snap;
+    for (const auto &slot : m_slots) {
+        const ThreadHistograms *hists = slot.load(std::memory_order_acquire);
+        if (hists) {
+            snap.add(hists->hist[kind]);
+        }
+    }
+    return snap;
+}
+
+std::string RelayLatency::metrics() const
+{
+    std::string out;
+    char line[128];
+    for (int kind = 0; kind < kLatencyKinds; ++kind) {
+        LatencySnapshot snap = snapshot(static_cast<LatencyKind>(kind));
+        std::string name = std::string("laudio_") + kLatencyNames[kind] + "_latency_seconds";
+        out += "# TYPE " + name + " summary\n";
+        for (double q : {0.5, 0.9, 0.99, 0.999, 1.0}) {
+            snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.6f\n", name.c_str(), q, snap.quantile(q) / 1e6);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_sum %.6f\n", name.c_str(), snap.sum / 1e6);
+        out += line;
+        out += name + "_count " + std::to_string(snap.total) + "\n";
+    }
+    return out;
+}
+
+SessionLatency::SessionLatency()
+{
+    for (auto &hist : m_hist) {
+        hist.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+SessionLatency::~SessionLatency()
+{
+    for (auto &hist : m_hist) {
+        delete hist.load(std::memory_order_acquire);
+    }
+}
+
+void SessionLatency::on_sent(uint64_t ingress_us, uint64_t capture_us)
+{
+    if (ingress_us != 0) {
+        uint64_t now = steady_us();
+        record(kLatencyRelay, now > ingress_us ? now - ingress_us : 0);
+    }
+    if (capture_us != 0) {
+        // 客户端时钟比服务器快时差值为负, 这种样本没有意义, 丢掉
+        uint64_t now = wall_us();
+        if (now >= capture_us) {
+            record(kLatencyMouthToEar, now - capture_us);
+        }
+    }
+}
+
+void SessionLatency::on_received(uint64_t capture_us)
+{
+    uint64_t now = wall_us();
+    if (capture_us != 0 && now >= capture_us) {
+        record(kLatencyUplink, now - capture_us);
+    }
+}
+
+void SessionLatency::record(LatencyKind kind, uint64_t us)
+{
+    LatencyHistogram *hist = m_hist[kind].load(std::memory_order_acquire);
+    if (!hist) {
+        // 大多数会话只会有 relay 一类, 用到哪类才分配哪类
+        LatencyHistogram *fresh = new LatencyHistogram();
+        if (m_hist[kind].compare_exchange_strong(hist, fresh, std::memory_order_acq_rel)) {
+            hist = fresh;
+        }
+        else {
+            delete fresh;
+        }
+    }
+    hist->record(us);
+    RelayLatency::getInstance()->record(kind, us);
+}
+
+std::string SessionLatency::summary() const
+{
+    std::string out;
+    char line[160];
+    for (int kind = 0; kind < kLatencyKinds; ++kind) {
+        const LatencyHistogram *hist = m_hist[kind].load(std::memory_order_acquire);
+        if (!hist || hist->count() == 0) {
+            continue;
+        }
+        LatencySnapshot snap;
+        snap.add(*hist);
+        snprintf(line,
+                 sizeof(line),
+                 "%s%s n=%llu p50=%lluus p90=%lluus p99=%lluus max=%lluus",
+                 out.empty() ? "" : "; ",
+                 kLatencyNames[kind],
+                 static_cast<unsigned long long>(snap.total),
+                 static_cast<unsigned long long>(snap.quantile(0.5)),
+                 static_cast<unsigned long long>(snap.quantile(0.9)),
+                 static_cast<unsigned long long>(snap.quantile(0.99)),
+                 static_cast<unsigned long long>(snap.max));
+        out += line;
+    }
+    return out;
+}
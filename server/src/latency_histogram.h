@@ -0,0 +1,140 @@
+#ifndef _LATENCY_HISTOGRAM_H_
+#define _LATENCY_HISTOGRAM_H_
+
+#include "singleton.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief HDR 直方图 (微秒), 对数分段, 每段 32 格线性, 相对误差不超过 1/32
+ *
+ * 计数都是原子的, 记录和读取不加锁; 1 us ~ 16.7 s, 更大的值记在最后一格
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBucketBits = 6;
+    static constexpr uint32_t kSubBucketHalf = 1u << (kSubBucketBits - 1);
+    static constexpr int kMaxValueBits = 24;
+    static constexpr uint64_t kMaxValue = (1ULL << kMaxValueBits) - 1;
+    static constexpr std::size_t kCounts = (kMaxValueBits - kSubBucketBits + 2) * kSubBucketHalf;
+
+    LatencyHistogram();
+
+    void record(uint64_t us);
+
+    uint64_t count() const
+    {
+        return m_total.load(std::memory_order_relaxed);
+    }
+
+    static std::size_t index_of(uint64_t us);
+    // 这一格能表示的最大值, 分位数按它报
+    static uint64_t highest_value(std::size_t index);
+
+private:
+    friend struct LatencySnapshot;
+
+    std::atomic<uint64_t> m_counts[kCounts];
+    std::atomic<uint64_t> m_total;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+};
+
+/**
+ * @brief 若干个直方图合并后的快照
+ */
+struct LatencySnapshot {
+    std::vector<uint64_t> counts = std::vector<uint64_t>(LatencyHistogram::kCounts);
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    void add(const LatencyHistogram &hist);
+    uint64_t quantile(double q) const;
+};
+
+enum LatencyKind {
+    kLatencyRelay,      // 服务器收完一帧 -> 对端写完这一帧
+    kLatencyUplink,     // 客户端采集时刻 -> 服务器收完 (含两端时钟差)
+    kLatencyMouthToEar, // 客户端采集时刻 -> 对端写完 (含两端时钟差)
+    kLatencyKinds,
+};
+
+/**
+ * @brief 全局的转发时延, 每个线程写自己的一组直方图, 读的时候合并
+ *
+ * 线程第一次记录时从固定的槽位里原子地领一个, 之后记录和合并都不加锁;
+ * 线程数超过槽位时多出来的线程共用最后一个槽 (计数仍是原子的)
+ */
+class RelayLatency : public Singleton<RelayLatency>
+{
+    friend class Singleton<RelayLatency>;
+
+public:
+    static constexpr std::size_t kMaxThreads = 64;
+
+    ~RelayLatency();
+
+    void record(LatencyKind kind, uint64_t us);
+    LatencySnapshot snapshot(LatencyKind kind) const;
+    // Prometheus 文本格式的 summary
+    std::string metrics() const;
+
+private:
+    RelayLatency();
+
+    struct ThreadHistograms {
+        LatencyHistogram hist[kLatencyKinds];
+    };
+
+    ThreadHistograms *local();
+
+private:
+    std::atomic<ThreadHistograms *> m_slots[kMaxThreads];
+    std::atomic<std::size_t> m_used;
+};
+
+/**
+ * @brief 一个会话的时延直方图, 第一次记录时才分配, 同时记进全局的 RelayLatency
+ *
+ * 会话关闭时用 summary 打日志
+ */
+class SessionLatency
+{
+public:
+    SessionLatency();
+    ~SessionLatency();
+
+    // 发给这个会话的一帧写完: ingress_us 为服务器收完这一帧的时刻 (steady_us), capture_us 为帧头里的
+    // 采集时刻 (wall_us, 客户端时钟); 都是 0 表示没有 (提示音 / pre-roll 等)
+    void on_sent(uint64_t ingress_us, uint64_t capture_us);
+    // 这个会话发来一帧带采集时刻的帧
+    void on_received(uint64_t capture_us);
+
+    // "relay n=.. p50=..us ..." 各类以 "; " 分隔, 没有记录时返回空串
+    std::string summary() const;
+
+private:
+    void record(LatencyKind kind, uint64_t us);
+
+private:
+    std::atomic<LatencyHistogram *> m_hist[kLatencyKinds];
+};
+
+inline uint64_t steady_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+inline uint64_t wall_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+#endif // _LATENCY_HISTOGRAM_H_
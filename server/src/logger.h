@@ -1,6 +1,7 @@
 #ifndef _LOGGER_H_
 #define _LOGGER_H_
 
+#include "trace.h"
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
@@ -72,6 +73,7 @@ public:
     static void debug(const spdlog::source_loc &loc, fmt::format_string<Args...> fmt, Args &&...args)
     {
         // get()->debug(std::forward<Args>(args)...);
+        TRACE_SCOPE("log");
         get()->log(loc, spdlog::level::debug, fmt, std::forward<Args>(args)...);
     }
 
@@ -79,6 +81,7 @@ public:
     static void info(const spdlog::source_loc &loc, fmt::format_string<Args...> fmt, Args &&...args)
     {
         // get()->info(std::forward<Args>(args)...);
+        TRACE_SCOPE("log");
         get()->log(loc, spdlog::level::info, fmt, std::forward<Args>(args)...);
     }
 
@@ -86,6 +89,7 @@ public:
     static void warn(const spdlog::source_loc &loc, fmt::format_string<Args...> fmt, Args &&...args)
     {
         // get()->warn(std::forward<Args>(args)...);
+        TRACE_SCOPE("log");
         get()->log(loc, spdlog::level::warn, fmt, std::forward<Args>(args)...);
     }
 
@@ -93,6 +97,7 @@ public:
     static void error(const spdlog::source_loc &loc, fmt::format_string<Args...> fmt, Args &&...args)
     {
         // get()->error(std::forward<Args>(args)...);
+        TRACE_SCOPE("log");
         get()->log(loc, spdlog::level::err, fmt, std::forward<Args>(args)...);
     }
 
@@ -100,6 +105,7 @@ public:
     static void critical(const spdlog::source_loc &loc, fmt::format_string<Args...> fmt, Args &&...args)
     {
         // get()->critical(std::forward<Args>(args)...);
+        TRACE_SCOPE("log");
         get()->log(loc, spdlog::level::critical, fmt, std::forward<Args>(args)...);
     }
 
@@ -1,12 +1,84 @@
 #include "ws_server.h"
 #include "logger.h"
+#include "rtp_ingress.h"
+#include "ws_session_mgr.h"
+#include "prompt_cache.h"
+#include "trace.h"
+#include "admission_control.h"
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// --rtp 的参数 [ip:]port_begin[-port_end], IPv6 地址写成 [addr]:port_begin-port_end
+static bool parse_rtp_bind(const std::string &text, RtpIngress::Config &cfg)
+{
+    std::string ports = text;
+    std::size_t colon = text.rfind(':');
+    if (colon != std::string::npos) {
+        cfg.ip = text.substr(0, colon);
+        if (cfg.ip.size() >= 2 && cfg.ip.front() == '[' && cfg.ip.back() == ']') {
+            cfg.ip = cfg.ip.substr(1, cfg.ip.size() - 2);
+        }
+        ports = text.substr(colon + 1);
+    }
+    char *end = nullptr;
+    unsigned long begin = std::strtoul(ports.c_str(), &end, 10);
+    unsigned long last = begin;
+    if (*end == '-') {
+        last = std::strtoul(end + 1, &end, 10);
+    }
+    if (*end != '\0' || begin == 0 || last < begin || last > 65535) {
+        return false;
+    }
+    cfg.port_begin = static_cast<uint16_t>(begin);
+    cfg.port_end = static_cast<uint16_t>(last);
+    return true;
+}
 
 int main(int argc, char *argv[])
 {
-    (void)argc;
-    (void)argv;
     try {
         Logger::init();
+        // server [cert.pem key.pem] [--rtp [ip:]port_begin-port_end] [--rtp-allow ip[/prefix]]... [--affinity epsilon]
+        // 提供证书时监听 wss://; 给了 --rtp 才开 SIP 中继的 RTP 接入, --rtp-allow 限定 PBX 的源地址;
+        // --affinity 打开 robot 亲和配对, 不给时按负载最低配对
+        std::vector<std::string> positional;
+        bool rtp_enabled = false;
+        RtpIngress::Config rtp_cfg;
+        double affinity_epsilon = -1;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--rtp") == 0 && i + 1 < argc) {
+                if (!parse_rtp_bind(argv[++i], rtp_cfg)) {
+                    LOG_ERROR("invalid --rtp {}, expected [ip:]port_begin-port_end", argv[i]);
+                    return 1;
+                }
+                rtp_enabled = true;
+            }
+            else if (std::strcmp(argv[i], "--rtp-allow") == 0 && i + 1 < argc) {
+                rtp_cfg.allow.push_back(argv[++i]);
+            }
+            else if (std::strcmp(argv[i], "--affinity") == 0 && i + 1 < argc) {
+                char *end = nullptr;
+                affinity_epsilon = std::strtod(argv[++i], &end);
+                if (*end != '\0' || !(affinity_epsilon >= 0)) {
+                    LOG_ERROR("invalid --affinity {}, expected epsilon >= 0 (e.g. 0.25)", argv[i]);
+                    return 1;
+                }
+            }
+            else {
+                positional.push_back(argv[i]);
+            }
+        }
+        TlsContext::Sptr tls;
+        if (positional.size() >= 2) {
+            tls = TlsContext::create(positional[0], positional[1]);
+        }
         net::io_context ioc {1};
         net::signal_set signals(ioc, SIGINT, SIGTERM);
         signals.async_wait([&ioc](boost::system::error_code ec, int signal_num) {
@@ -16,9 +88,95 @@ int main(int argc, char *argv[])
             }
             ioc.stop();
         });
-        auto ws_server = std::make_shared<WsServer>(ioc, "0.0.0.0", 8001);
+        // robot 在内存里保留来电方的上下文时, 用 --affinity 让同一个 voip id 尽量回到同一个 robot
+        if (affinity_epsilon >= 0) {
+            WsSessionMgr::getInstance()->set_affinity(affinity_epsilon);
+            LOG_INFO("robot affinity on, epsilon {}", affinity_epsilon);
+        }
+        // 等待音乐 / 欢迎语: prompts/*.opus 映射一次全部会话共享, 每 5 s 检查一次文件有没有被替换
+        net::steady_timer prompt_timer(ioc);
+        std::function<void()> refresh_prompts = [&]() {
+            prompt_timer.expires_after(std::chrono::seconds(5));
+            prompt_timer.async_wait([&](boost::system::error_code ec) {
+                if (!ec) {
+                    PromptCache::getInstance()->refresh();
+                    refresh_prompts();
+                }
+            });
+        };
+        if (PromptCache::getInstance()->load_dir("prompts")) {
+            refresh_prompts();
+        }
+#ifdef LAUDIO_TRACE
+        // kill -USR1 <pid>: 把各线程最近的 span 写成 trace-<pid>-<unix 秒>.json, 用 ui.perfetto.dev 打开
+        net::signal_set trace_signals(ioc, SIGUSR1);
+        std::function<void()> wait_trace = [&]() {
+            trace_signals.async_wait([&](boost::system::error_code ec, int) {
+                if (ec) {
+                    return;
+                }
+                std::string path = "trace-" + std::to_string(::getpid()) + "-" + std::to_string(std::time(nullptr)) + ".json";
+                if (Tracer::getInstance()->dump_file(path)) {
+                    LOG_INFO("trace dumped: {}", path);
+                }
+                else {
+                    LOG_ERROR("trace dump failed: {}", path);
+                }
+                wait_trace();
+            });
+        };
+        wait_trace();
+#endif
+        // 管理接口读的会话表快照, 有变更时定期发布一版
+        net::steady_timer snapshot_timer(ioc);
+        std::function<void()> publish_snapshot = [&]() {
+            snapshot_timer.expires_after(std::chrono::milliseconds(WsSessionMgr::kSnapshotIntervalMs));
+            snapshot_timer.async_wait([&](boost::system::error_code ec) {
+                if (!ec) {
+                    WsSessionMgr::getInstance()->publish_snapshot();
+                    publish_snapshot();
+                }
+            });
+        };
+        publish_snapshot();
+        // 事件循环延迟: 探测定时器实际比预定晚了多少, 接入控制据此在过载时拒绝新连接
+        net::steady_timer lag_timer(ioc);
+        std::function<void()> probe_loop_lag = [&]() {
+            auto expected = std::chrono::steady_clock::now() + std::chrono::milliseconds(AdmissionControl::kLoopProbeMs);
+            lag_timer.expires_at(expected);
+            lag_timer.async_wait([&, expected](boost::system::error_code ec) {
+                if (!ec) {
+                    auto lag = std::max(std::chrono::steady_clock::now() - expected, std::chrono::steady_clock::duration::zero());
+                    AdmissionControl::getInstance()->on_loop_lag(
+                        std::chrono::duration_cast<std::chrono::microseconds>(lag).count());
+                    probe_loop_lag();
+                }
+            });
+        };
+        probe_loop_lag();
+        auto ws_server = std::make_shared<WsServer>(ioc, "0.0.0.0", 8001, tls);
+#ifdef LAUDIO_WEBRTC
+        // 浏览器以 /voip?id=&media=webrtc 登录时, 音频走 WebRTC
+        WebRtcIngress::Config webrtc_cfg;
+        webrtc_cfg.ice_servers.push_back("stun:stun.l.google.com:19302");
+        ws_server->set_webrtc_config(webrtc_cfg);
+#endif
+        // 管理接口 (/admin/) 默认只对本机开放, 设置 LAUDIO_ADMIN_TOKEN 后远程可以带令牌访问
+        if (const char *admin_token = std::getenv("LAUDIO_ADMIN_TOKEN")) {
+            ws_server->set_admin_token(admin_token);
+        }
+        // SIP 中继的 RTP 直接进来, 不再经过外部的 RTP -> WebSocket 转换; 默认不开, 不监听任何 UDP 端口
+        std::unique_ptr<RtpIngress> rtp_ingress;
+        if (rtp_enabled) {
+            rtp_ingress.reset(new RtpIngress(rtp_cfg));
+            if (!rtp_ingress->start()) {
+                LOG_ERROR("rtp ingress start failed");
+                return 1;
+            }
+        }
         LOG_INFO("Ws Server Start ...");
         ioc.run();
+        PromptPlayer::getInstance()->shutdown();
     }
     catch (const std::exception &e) {
         LOG_ERROR("Exception: {}", e.what());
@@ -0,0 +1,396 @@
+#include "prompt_cache.h"
+#include "logger.h"
+#include <opus/opus.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+
+static const char kPromptSuffix[] = ".opus";
+
+static uint32_t read_le32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16
+           | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// Ogg 页校验: CRC-32, 多项式 0x04c11db7, 不反转, 初值 0, 计算时 CRC 字段按 0 处理
+static uint32_t ogg_crc(const uint8_t *page, std::size_t size)
+{
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t r = i << 24;
+            for (int k = 0; k < 8; ++k) {
+                r = r & 0x80000000u ? (r << 1) ^ 0x04c11db7u : r << 1;
+            }
+            t[i] = r;
+        }
+        return t;
+    }();
+    uint32_t crc = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        uint8_t byte = i >= 22 && i < 26 ? 0 : page[i];
+        crc = (crc << 8) ^ table[((crc >> 24) ^ byte) & 0xff];
+    }
+    return crc;
+}
+
+static int64_t mtime_ns(const struct stat &st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+Prompt::Sptr Prompt::load(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("open prompt {}: {}", path, std::strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        LOG_ERROR("empty prompt {}", path);
+        return nullptr;
+    }
+    std::shared_ptr<Prompt> prompt(new Prompt());
+    prompt->m_path = path;
+    prompt->m_size = static_cast<std::size_t>(st.st_size);
+    prompt->m_dev = st.st_dev;
+    prompt->m_ino = st.st_ino;
+    prompt->m_mtime_ns = mtime_ns(st);
+    void *addr = ::mmap(nullptr, prompt->m_size, PROT_READ, MAP_SHARED, fd, 0);
+    // 映射建立后 fd 就不需要了
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("mmap prompt {}: {}", path, std::strerror(errno));
+        return nullptr;
+    }
+    prompt->m_addr = addr;
+    // 提示音会被反复顺序读, 先让内核把页读进来
+    ::madvise(addr, prompt->m_size, MADV_WILLNEED);
+    if (!prompt->parse()) {
+        LOG_ERROR("not a valid ogg opus prompt: {}", path);
+        return nullptr;
+    }
+    return prompt;
+}
+
+Prompt::~Prompt()
+{
+    if (m_addr) {
+        ::munmap(m_addr, m_size);
+    }
+}
+
+bool Prompt::same_file(const struct stat &st) const
+{
+    return m_dev == st.st_dev && m_ino == st.st_ino && m_size == static_cast<std::size_t>(st.st_size)
+           && m_mtime_ns == mtime_ns(st);
+}
+
+bool Prompt::parse()
+{
+    const uint8_t *base = static_cast<const uint8_t *>(m_addr);
+    std::size_t pos = 0;
+    uint32_t serial = 0;
+    std::size_t packet_index = 0;
+    // 当前包在映射里的各段 <offset, size>, 只有跨页的包会有多段
+    std::vector<std::pair<std::size_t, std::size_t>> pieces;
+    bool continued = false;
+    while (pos < m_size) {
+        const uint8_t *page = base + pos;
+        if (m_size - pos < 27 || std::memcmp(page, "OggS", 4) != 0 || page[4] != 0) {
+            return false;
+        }
+        uint8_t flags = page[5];
+        if (pos == 0) {
+            serial = read_le32(page + 14);
+        }
+        else if (read_le32(page + 14) != serial) {
+            LOG_ERROR("multiplexed ogg stream is not supported");
+            return false;
+        }
+        std::size_t segments = page[26];
+        std::size_t header = 27 + segments;
+        if (m_size - pos < header) {
+            return false;
+        }
+        std::size_t body = 0;
+        for (std::size_t i = 0; i < segments; ++i) {
+            body += page[27 + i];
+        }
+        if (m_size - pos - header < body || ogg_crc(page, header + body) != read_le32(page + 22)) {
+            return false;
+        }
+        // 0x01: 本页以上一页没结束的包开头
+        if (((flags & 0x01) != 0) != continued) {
+            return false;
+        }
+        std::size_t offset = pos + header;
+        for (std::size_t i = 0; i < segments; ++i) {
+            std::size_t lace = page[27 + i];
+            if (pieces.empty() || pieces.back().first + pieces.back().second != offset) {
+                pieces.emplace_back(offset, 0);
+            }
+            pieces.back().second += lace;
+            offset += lace;
+            // lacing 值小于 255 表示包在这一段结束
+            if (lace < 255) {
+                if (!add_packet(packet_index++, pieces)) {
+                    return false;
+                }
+                pieces.clear();
+            }
+        }
+        continued = !pieces.empty();
+        pos += header + body;
+    }
+    return !continued && !m_frames.empty();
+}
+
+bool Prompt::add_packet(std::size_t index, const std::vector<std::pair<std::size_t, std::size_t>> &pieces)
+{
+    const uint8_t *base = static_cast<const uint8_t *>(m_addr);
+    const uint8_t *data = base + pieces.front().first;
+    std::size_t size = pieces.front().second;
+    if (pieces.size() > 1) {
+        std::string packet;
+        for (const auto &piece : pieces) {
+            packet.append(reinterpret_cast<const char *>(base + piece.first), piece.second);
+        }
+        m_spill.push_back(std::move(packet));
+        data = reinterpret_cast<const uint8_t *>(m_spill.back().data());
+        size = m_spill.back().size();
+    }
+    // 第一个包是 OpusHead, 第二个是 OpusTags, 之后才是音频
+    if (index == 0) {
+        // 只发原样的 Opus 包, 多声道映射 (family != 0) 的包对端解不了
+        return size >= 19 && std::memcmp(data, "OpusHead", 8) == 0 && data[9] <= 2 && data[18] == 0;
+    }
+    if (index == 1) {
+        return size >= 8 && std::memcmp(data, "OpusTags", 8) == 0;
+    }
+    if (size == 0) {
+        return true;
+    }
+    int samples = opus_packet_get_nb_samples(data, static_cast<opus_int32>(size), 48000);
+    if (samples <= 0) {
+        return false;
+    }
+    m_frames.push_back(Frame {data, static_cast<uint32_t>(size), static_cast<uint32_t>(samples)});
+    return true;
+}
+
+PromptCache::PromptCache() :
+    m_prompts(std::make_shared<const PromptMap>())
+{
+}
+
+bool PromptCache::load_dir(const std::string &dir)
+{
+    struct stat st;
+    if (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_dir = dir;
+    }
+    refresh();
+    LOG_INFO("prompt dir {}: {} prompts", dir, std::atomic_load(&m_prompts)->size());
+    return true;
+}
+
+std::size_t PromptCache::refresh()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_dir.empty()) {
+        return 0;
+    }
+    std::shared_ptr<const PromptMap> current = std::atomic_load(&m_prompts);
+    auto next = std::make_shared<PromptMap>();
+    std::size_t changed = 0;
+    DIR *dir = ::opendir(m_dir.c_str());
+    if (!dir) {
+        LOG_ERROR("open prompt dir {}: {}", m_dir, std::strerror(errno));
+        return 0;
+    }
+    const std::size_t suffix_len = sizeof(kPromptSuffix) - 1;
+    while (struct dirent *entry = ::readdir(dir)) {
+        std::string file = entry->d_name;
+        if (file.size() <= suffix_len || file.compare(file.size() - suffix_len, suffix_len, kPromptSuffix) != 0) {
+            continue;
+        }
+        std::string name = file.substr(0, file.size() - suffix_len);
+        std::string path = m_dir + "/" + file;
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        auto it = current->find(name);
+        if (it != current->end() && it->second->same_file(st)) {
+            (*next)[name] = it->second;
+            continue;
+        }
+        Prompt::Sptr prompt = Prompt::load(path);
+        if (!prompt) {
+            // 新文件有问题时保留旧版本, 不让提示音消失
+            if (it != current->end()) {
+                (*next)[name] = it->second;
+            }
+            continue;
+        }
+        LOG_INFO("prompt {} loaded: {} frames, {} bytes", name, prompt->frames().size(), prompt->mapped_bytes());
+        (*next)[name] = prompt;
+        ++changed;
+    }
+    ::closedir(dir);
+    for (const auto &kv : *current) {
+        if (next->find(kv.first) == next->end()) {
+            LOG_INFO("prompt {} removed", kv.first);
+            ++changed;
+        }
+    }
+    if (changed > 0) {
+        std::atomic_store(&m_prompts, std::shared_ptr<const PromptMap>(std::move(next)));
+    }
+    return changed;
+}
+
+Prompt::Sptr PromptCache::get(const std::string &name) const
+{
+    std::shared_ptr<const PromptMap> prompts = std::atomic_load(&m_prompts);
+    auto it = prompts->find(name);
+    return it == prompts->end() ? nullptr : it->second;
+}
+
+std::size_t PromptCache::mapped_bytes() const
+{
+    std::shared_ptr<const PromptMap> prompts = std::atomic_load(&m_prompts);
+    std::size_t bytes = 0;
+    for (const auto &kv : *prompts) {
+        bytes += kv.second->mapped_bytes();
+    }
+    return bytes;
+}
+
+PromptPlayer::PromptPlayer() :
+    m_running(false)
+{
+}
+
+PromptPlayer::~PromptPlayer()
+{
+    shutdown();
+}
+
+bool PromptPlayer::play(const Session::Sptr &session, const std::vector<std::string> &names, bool loop_last)
+{
+    Playback playback;
+    playback.session = session;
+    playback.loop_last = loop_last;
+    auto cache = PromptCache::getInstance();
+    for (const auto &name : names) {
+        Prompt::Sptr prompt = cache->get(name);
+        if (prompt) {
+            playback.names.push_back(name);
+            playback.prompts.push_back(std::move(prompt));
+        }
+    }
+    if (playback.prompts.empty()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_playbacks[session.get()] = std::move(playback);
+    // 第一次播放时才起线程, 没有提示音目录的部署不多一个线程
+    if (!m_running.exchange(true)) {
+        m_thread = std::thread(&PromptPlayer::run, this);
+    }
+    return true;
+}
+
+void PromptPlayer::stop(const Session *session)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_playbacks.erase(session);
+}
+
+std::size_t PromptPlayer::playing()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_playbacks.size();
+}
+
+void PromptPlayer::shutdown()
+{
+    if (m_running.exchange(false) && m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void PromptPlayer::run()
+{
+    const auto period = std::chrono::milliseconds(20);
+    auto next = std::chrono::steady_clock::now() + period;
+    while (m_running.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_until(next);
+        tick();
+        next += period;
+        // 落后太多 (进程被挂起等) 时重新对齐, 不一次补发一大串帧
+        auto now = std::chrono::steady_clock::now();
+        if (now > next + 5 * period) {
+            next = now + period;
+        }
+    }
+}
+
+void PromptPlayer::tick()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (auto it = m_playbacks.begin(); it != m_playbacks.end();) {
+        Session::Sptr session = it->second.session.lock();
+        if (!session || !advance(*session, it->second)) {
+            it = m_playbacks.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+bool PromptPlayer::advance(Session &session, Playback &playback)
+{
+    // 每 tick 到期 20 ms, 10 ms 的帧一次发两个, 40 / 60 ms 的帧隔几个 tick 发一个
+    playback.credit += 960;
+    while (playback.prompt_index < playback.prompts.size()) {
+        const Prompt::Sptr &prompt = playback.prompts[playback.prompt_index];
+        const auto &frames = prompt->frames();
+        if (playback.frame_index >= frames.size()) {
+            bool last = playback.prompt_index + 1 == playback.prompts.size();
+            if (last && playback.loop_last) {
+                playback.frame_index = 0;
+                Prompt::Sptr latest = PromptCache::getInstance()->get(playback.names.back());
+                if (latest) {
+                    playback.prompts.back() = std::move(latest);
+                }
+            }
+            else {
+                ++playback.prompt_index;
+                playback.frame_index = 0;
+            }
+            continue;
+        }
+        const Prompt::Frame &frame = frames[playback.frame_index];
+        if (playback.credit < frame.samples) {
+            return true;
+        }
+        playback.credit -= frame.samples;
+        ++playback.frame_index;
+        session.send_media_ref(frame.data, frame.size, prompt);
+    }
+    return false;
+}
@@ -0,0 +1,150 @@
+#ifndef _PROMPT_CACHE_H_
+#define _PROMPT_CACHE_H_
+
+#include "singleton.hpp"
+#include "session.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 一个预先编码好的提示音 (Ogg Opus 文件)
+ *
+ * 文件整体只读映射, frames 里每一帧直接指向映射的页, 发送时不拷贝;
+ * 所有会话共享同一份映射, 最后一个引用释放时才 munmap
+ */
+class Prompt
+{
+public:
+    using Sptr = std::shared_ptr<const Prompt>;
+
+    struct Frame {
+        const uint8_t *data;
+        uint32_t size;
+        uint32_t samples; // 48 kHz 下的采样数, 20 ms 为 960
+    };
+
+    // 映射并解析文件, 不是单路 Ogg Opus 或校验失败时返回空
+    static Sptr load(const std::string &path);
+
+    ~Prompt();
+
+    const std::vector<Frame> &frames() const
+    {
+        return m_frames;
+    }
+
+    std::size_t mapped_bytes() const
+    {
+        return m_size;
+    }
+
+    // 文件没变时 (设备 / inode / 大小 / 修改时间都相同) 不重新映射
+    bool same_file(const struct stat &st) const;
+
+private:
+    Prompt() = default;
+    bool parse();
+    bool add_packet(std::size_t index, const std::vector<std::pair<std::size_t, std::size_t>> &pieces);
+
+private:
+    std::string m_path;
+    void *m_addr = nullptr;
+    std::size_t m_size = 0;
+    dev_t m_dev = 0;
+    ino_t m_ino = 0;
+    int64_t m_mtime_ns = 0;
+    std::vector<Frame> m_frames;
+    std::deque<std::string> m_spill; // 跨页的包拼起来放这里 (deque 追加时地址不变), 同样只存一份
+};
+
+/**
+ * @brief 提示音目录的缓存, 按去掉 .opus 后缀的文件名查找
+ *
+ * 读者拿到的是不可变的 <name, Prompt> 表的快照 (原子 shared_ptr), 不加锁;
+ * refresh 重新扫描目录, 有变化的文件映射成新的 Prompt 后整表替换,
+ * 正在播放旧版本的会话继续持有旧映射直到播完
+ *
+ * 更新提示音时先写临时文件再 rename 覆盖, 不要原地改写已映射的文件
+ */
+class PromptCache : public Singleton<PromptCache>
+{
+    friend class Singleton<PromptCache>;
+
+public:
+    using PromptMap = std::unordered_map<std::string, Prompt::Sptr>;
+
+    // 加载目录下全部 .opus 文件, 目录不存在时返回 false
+    bool load_dir(const std::string &dir);
+    // 重新扫描 load_dir 的目录, 返回新增 / 替换 / 删除的文件数
+    std::size_t refresh();
+
+    Prompt::Sptr get(const std::string &name) const;
+    // 当前表里全部提示音映射的字节数 (被替换但仍在播放的旧版本不算)
+    std::size_t mapped_bytes() const;
+
+private:
+    PromptCache();
+
+private:
+    std::mutex m_mtx; // 串行化 load_dir / refresh, 读者不需要
+    std::string m_dir;
+    std::shared_ptr<const PromptMap> m_prompts;
+};
+
+/**
+ * @brief 按 20 ms 节奏把提示音逐帧送进会话
+ *
+ * 一个线程每 20 ms tick 一次, 每个播放中的会话按累计的时长发出到期的帧,
+ * 帧以 send_media_ref 交给会话, WebSocket 会话的写队列直接引用映射的页;
+ * 同一个会话同时只有一个播放, 新的 play 替换旧的; 循环播放每一轮开头重新取缓存里的版本,
+ * 替换过的提示音下一轮就生效
+ */
+class PromptPlayer : public Singleton<PromptPlayer>
+{
+    friend class Singleton<PromptPlayer>;
+
+public:
+    ~PromptPlayer();
+
+    // 依次播放 names 里的提示音 (不存在的跳过), loop_last 时最后一个循环到 stop 为止; 全都不存在时返回 false
+    bool play(const Session::Sptr &session, const std::vector<std::string> &names, bool loop_last);
+    void stop(const Session *session);
+
+    std::size_t playing();
+    void shutdown();
+
+private:
+    PromptPlayer();
+
+    struct Playback {
+        std::weak_ptr<Session> session;
+        std::vector<std::string> names;
+        std::vector<Prompt::Sptr> prompts;
+        std::size_t prompt_index = 0;
+        std::size_t frame_index = 0;
+        uint32_t credit = 0; // 已到期还没发出的采样数
+        bool loop_last = false;
+    };
+
+    void run();
+    void tick();
+    // 发出到期的帧, 播完返回 false
+    static bool advance(Session &session, Playback &playback);
+
+private:
+    std::mutex m_mtx; // 保护 m_playbacks
+    std::unordered_map<const Session *, Playback> m_playbacks;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+};
+
+#endif // _PROMPT_CACHE_H_
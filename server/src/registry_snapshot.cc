@@ -0,0 +1,191 @@
+#include "registry_snapshot.h"
+#include <json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <utility>
+
+// 分片内按 (id, type) 排序, 同一个 id 的 voip 排在 robot 前面
+static bool key_less(const WsSessionId &a_id, WsSessionType a_type, const WsSessionId &b_id, WsSessionType b_type)
+{
+    int cmp = a_id.compare(b_id);
+    return cmp != 0 ? cmp < 0 : a_type < b_type;
+}
+
+static bool key_equal(const SessionRecord &a, const SessionRecord &b)
+{
+    return a.type == b.type && a.id == b.id;
+}
+
+static void count_shard(RegistrySnapshot::Shard &shard)
+{
+    shard.voip = 0;
+    shard.robot = 0;
+    shard.waiting = 0;
+    for (const auto &record : shard.records) {
+        if (record.type == kVoip) {
+            ++shard.voip;
+            shard.waiting += record.waiting ? 1 : 0;
+        }
+        else {
+            ++shard.robot;
+        }
+    }
+}
+
+RegistrySnapshot::RegistrySnapshot() :
+    m_epoch(0),
+    m_published_ms(0),
+    m_voip(0),
+    m_robot(0),
+    m_waiting(0)
+{
+    auto empty = std::make_shared<const Shard>();
+    m_shards.fill(empty);
+}
+
+std::size_t RegistrySnapshot::shard_of(const WsSessionId &id)
+{
+    return std::hash<WsSessionId>()(id) % kShards;
+}
+
+RegistrySnapshot::Sptr RegistrySnapshot::apply(const Sptr &prev, std::vector<SessionRecord> changes)
+{
+    // 复制的只是分片指针, 分片本身和上一版共享
+    auto next = std::make_shared<RegistrySnapshot>(*prev);
+    next->m_epoch = prev->m_epoch + 1;
+    next->m_published_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+
+    // 变更按 (分片, id, type) 排序, 每个有变更的分片和旧分片归并一次
+    std::vector<std::pair<std::size_t, SessionRecord *>> order;
+    order.reserve(changes.size());
+    for (auto &change : changes) {
+        order.emplace_back(shard_of(change.id), &change);
+    }
+    std::sort(order.begin(), order.end(), [](const auto &a, const auto &b) {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        return key_less(a.second->id, a.second->type, b.second->id, b.second->type);
+    });
+
+    for (std::size_t i = 0; i < order.size();) {
+        std::size_t index = order[i].first;
+        std::size_t end = i;
+        while (end < order.size() && order[end].first == index) {
+            ++end;
+        }
+        const auto &old_records = prev->m_shards[index]->records;
+        auto shard = std::make_shared<Shard>();
+        auto &records = shard->records;
+        records.reserve(old_records.size() + (end - i));
+        auto it = old_records.begin();
+        for (; i < end; ++i) {
+            SessionRecord &change = *order[i].second;
+            for (; it != old_records.end() && key_less(it->id, it->type, change.id, change.type); ++it) {
+                records.push_back(*it);
+            }
+            // 旧记录被变更替换或删除
+            if (it != old_records.end() && key_equal(*it, change)) {
+                ++it;
+            }
+            if (!change.removed) {
+                records.push_back(std::move(change));
+            }
+        }
+        records.insert(records.end(), it, old_records.end());
+        count_shard(*shard);
+        next->m_shards[index] = std::move(shard);
+    }
+
+    next->m_voip = 0;
+    next->m_robot = 0;
+    next->m_waiting = 0;
+    for (const auto &shard : next->m_shards) {
+        next->m_voip += shard->voip;
+        next->m_robot += shard->robot;
+        next->m_waiting += shard->waiting;
+    }
+    return next;
+}
+
+static Json::Value record_json(const SessionRecord &record, bool latency)
+{
+    Json::Value item(Json::objectValue);
+    item["id"] = record.id;
+    if (record.type == kVoip) {
+        item["type"] = "voip";
+        if (!record.robot_id.empty()) {
+            item["status"] = "paired";
+            item["robot"] = record.robot_id;
+            if (record.channel >= 0) {
+                item["channel"] = record.channel;
+            }
+        }
+        else {
+            item["status"] = record.waiting ? "waiting" : "idle";
+        }
+    }
+    else {
+        item["type"] = "robot";
+        item["status"] = record.load == 0 ? "idle" : (record.load < record.capacity ? "busy" : "full");
+        item["load"] = record.load;
+        item["capacity"] = record.capacity;
+    }
+    if (latency) {
+        // 时延直方图都是原子计数, 读的时候不用锁
+        Session::Sptr session = record.session.lock();
+        std::string summary = session ? session->latency_summary() : std::string();
+        if (!summary.empty()) {
+            item["latency"] = summary;
+        }
+    }
+    return item;
+}
+
+std::string RegistrySnapshot::page(const std::string &after,
+                                   WsSessionType after_type,
+                                   std::size_t limit,
+                                   const std::string &type,
+                                   bool latency) const
+{
+    Json::Value root(Json::objectValue);
+    root["epoch"] = Json::UInt64(m_epoch);
+    root["published_ms"] = Json::UInt64(m_published_ms);
+    root["voip"] = Json::UInt64(m_voip);
+    root["robot"] = Json::UInt64(m_robot);
+    root["waiting"] = Json::UInt64(m_waiting);
+    Json::Value &sessions = root["sessions"] = Json::Value(Json::arrayValue);
+
+    limit = std::min(std::max<std::size_t>(limit, 1), kMaxPage);
+    bool more = false;
+    std::size_t first = after.empty() ? 0 : shard_of(after);
+    for (std::size_t index = first; index < kShards && !more; ++index) {
+        const auto &records = m_shards[index]->records;
+        auto it = records.begin();
+        if (index == first && !after.empty()) {
+            it = std::upper_bound(records.begin(), records.end(), after, [after_type](const WsSessionId &id, const SessionRecord &record) {
+                return key_less(id, after_type, record.id, record.type);
+            });
+        }
+        for (; it != records.end(); ++it) {
+            if ((type == "voip" && it->type != kVoip) || (type == "robot" && it->type != kRobot)) {
+                continue;
+            }
+            if (sessions.size() == limit) {
+                more = true;
+                break;
+            }
+            sessions.append(record_json(*it, latency));
+        }
+    }
+    // 没有下一页时为 null; 游标是最后一条的 (id, type)
+    root["next"] = more ? sessions[sessions.size() - 1]["id"] : Json::Value();
+    root["next_type"] = more ? sessions[sessions.size() - 1]["type"] : Json::Value();
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, root);
+}
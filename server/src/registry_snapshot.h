@@ -0,0 +1,113 @@
+#ifndef _REGISTRY_SNAPSHOT_H_
+#define _REGISTRY_SNAPSHOT_H_
+
+#include "types.h"
+#include "session.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 会话表里一个会话的状态, 给管理接口看的
+ */
+struct SessionRecord {
+    WsSessionId id;
+    WsSessionType type = kVoip;
+    bool removed = false; // 只出现在变更里: 会话已经离开
+
+    // voip
+    WsSessionId robot_id; // 空串为未配对
+    int channel = -1;     // 在多路复用 robot 上的通道号, 单路为 -1
+    bool waiting = false;
+
+    // robot
+    uint32_t capacity = 0;
+    uint32_t load = 0;
+
+    // 不延长会话的生命周期, 只在要时延摘要时取一下
+    std::weak_ptr<Session> session;
+};
+
+/**
+ * @brief 会话表的只读快照, 发布后不再修改, 读的一方不需要任何锁
+ *
+ * 会话按 id 的哈希分到 kShards 个分片, 分片内按 (id, type) 升序, voip 和 robot 同名也是两条; 新版本只复制有变更的分片,
+ * 其余分片和上一版共享, 发布代价和变更数成正比而不是和会话总数成正比;
+ * 分页用 (id, type) 做游标, 不同版本之间翻页也不会重复或跳过没变的会话
+ */
+class RegistrySnapshot
+{
+public:
+    using Sptr = std::shared_ptr<const RegistrySnapshot>;
+
+    static constexpr std::size_t kShards = 1024;
+    static constexpr std::size_t kDefaultPage = 100;
+    static constexpr std::size_t kMaxPage = 1000;
+
+    struct Shard {
+        std::vector<SessionRecord> records; // 按 (id, type) 升序
+        std::size_t voip = 0;
+        std::size_t robot = 0;
+        std::size_t waiting = 0;
+    };
+
+    RegistrySnapshot();
+
+    // prev 上应用一批变更 (同一个 (id, type) 最多一条) 得到下一版, epoch 加一
+    static Sptr apply(const Sptr &prev, std::vector<SessionRecord> changes);
+
+    uint64_t epoch() const
+    {
+        return m_epoch;
+    }
+
+    std::size_t voip_count() const
+    {
+        return m_voip;
+    }
+
+    std::size_t robot_count() const
+    {
+        return m_robot;
+    }
+
+    std::size_t waiting_count() const
+    {
+        return m_waiting;
+    }
+
+    // 按分片顺序遍历全部会话, fn 返回 false 时停止
+    template <typename Fn>
+    void for_each(Fn &&fn) const
+    {
+        for (const auto &shard : m_shards) {
+            for (const auto &record : shard->records) {
+                if (!fn(record)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // (after, after_type) 之后的最多 limit (1 ~ kMaxPage) 个会话的 JSON, after 为空从头开始;
+    // type 为 "voip" / "robot" 时只列这一类; latency 为 true 时带上各会话的时延摘要
+    std::string page(const std::string &after,
+                     WsSessionType after_type,
+                     std::size_t limit,
+                     const std::string &type,
+                     bool latency) const;
+
+    static std::size_t shard_of(const WsSessionId &id);
+
+private:
+    uint64_t m_epoch;
+    uint64_t m_published_ms; // 发布时刻, unix 毫秒
+    std::size_t m_voip;
+    std::size_t m_robot;
+    std::size_t m_waiting;
+    std::array<std::shared_ptr<const Shard>, kShards> m_shards;
+};
+
+#endif // _REGISTRY_SNAPSHOT_H_
@@ -0,0 +1,498 @@
+#include "rtp_ingress.h"
+#include "logger.h"
+#include "ws_session_mgr.h"
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// 发回 PBX 的包只在 send_media 里短暂占用槽
+static const std::size_t kSendSlots = 8;
+// G.711 20 ms, 还没推算出步长时使用
+static const uint32_t kDefaultTsStep = 160;
+static const int kMaxEvents = 64;
+static const int kWaitMs = 100;
+static const int kMaxRecvRounds = 16;
+static const uint64_t kSweepMs = 1000;
+static const uint8_t kRtcpBye = 203;
+
+RtpCallSession::RtpCallSession(const std::string &id,
+                               UdpBatchSocket &socket,
+                               const sockaddr *remote,
+                               socklen_t remote_len) :
+    m_id(id),
+    m_socket(socket),
+    m_remote_len(remote_len),
+    m_ring(kSendSlots),
+    m_payload_type(0),
+    m_ts_step(kDefaultTsStep),
+    m_have_seq(false),
+    m_last_seq(0),
+    m_ext_seq(0),
+    m_last_ts(0),
+    m_last_recv_ms(0),
+    m_packets_out(0)
+{
+    std::memcpy(&m_remote, remote, remote_len);
+}
+
+void RtpCallSession::send(const std::string &msg, bool binary)
+{
+    if (binary) {
+        send_media(msg);
+        return;
+    }
+    LOG_INFO("rtp call {}: {}", m_id, msg);
+}
+
+void RtpCallSession::send_media(const std::string &frame, uint64_t ingress_us)
+{
+    FrameHeader hdr;
+    if (!parse_frame_header(frame.data(), frame.size(), hdr) || frame.size() == kFrameHeaderSize) {
+        return;
+    }
+    send_media_ref(reinterpret_cast<const uint8_t *>(frame.data()) + kFrameHeaderSize,
+                   frame.size() - kFrameHeaderSize,
+                   nullptr);
+    // sendmmsg 已经返回, 包交给了内核
+    m_latency.on_sent(ingress_us, hdr.capture_us);
+}
+
+void RtpCallSession::send_media_ref(const uint8_t *data, std::size_t size, std::shared_ptr<const void>)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_packetizer) {
+        std::random_device rd;
+        m_packetizer.reset(new RtpPacketizer(m_ring, rd(), m_payload_type, rd(), rd()));
+    }
+    uint8_t *payload = m_packetizer->payload();
+    if (!payload) {
+        return;
+    }
+    if (size > m_packetizer->payloadCapacity()) {
+        m_packetizer->abort();
+        return;
+    }
+    std::memcpy(payload, data, size);
+    RtpPacket pkt = m_packetizer->commit(size, m_ts_step);
+    // 从收包的端口发回去, PBX 的对称 RTP 认得这个源地址
+    if (m_socket.queue(reinterpret_cast<const sockaddr *>(&m_remote), m_remote_len, pkt.data, pkt.size)) {
+        m_packets_out.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_ring.release(pkt);
+    m_socket.flush();
+}
+
+bool RtpCallSession::is_remote(const sockaddr *addr, socklen_t addr_len) const
+{
+    if (addr_len != m_remote_len || addr->sa_family != m_remote.ss_family) {
+        return false;
+    }
+    if (addr->sa_family == AF_INET) {
+        auto *a = reinterpret_cast<const sockaddr_in *>(addr);
+        auto *b = reinterpret_cast<const sockaddr_in *>(&m_remote);
+        return a->sin_port == b->sin_port && a->sin_addr.s_addr == b->sin_addr.s_addr;
+    }
+    if (addr->sa_family == AF_INET6) {
+        auto *a = reinterpret_cast<const sockaddr_in6 *>(addr);
+        auto *b = reinterpret_cast<const sockaddr_in6 *>(&m_remote);
+        return a->sin6_port == b->sin6_port && std::memcmp(&a->sin6_addr, &b->sin6_addr, sizeof(in6_addr)) == 0;
+    }
+    return false;
+}
+
+bool RtpCallSession::on_rtp(const RtpHeader &hdr, uint64_t now_ms)
+{
+    m_last_recv_ms = now_ms;
+    if (!m_have_seq) {
+        m_have_seq = true;
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_payload_type = hdr.payload_type;
+        m_packetizer.reset();
+        m_ext_seq = hdr.seq;
+    }
+    else {
+        // robot 按到达顺序解码, 迟到的包直接丢掉
+        int16_t delta = static_cast<int16_t>(hdr.seq - m_last_seq);
+        if (delta <= 0) {
+            return false;
+        }
+        // 连续的两个包推算每包的采样数, 发回去的包沿用同样的步长
+        uint32_t step = hdr.timestamp - m_last_ts;
+        if (delta == 1 && step > 0 && step <= 48000 && step != m_ts_step) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_ts_step = step;
+        }
+        m_ext_seq += static_cast<uint32_t>(delta);
+    }
+    m_last_seq = hdr.seq;
+    m_last_ts = hdr.timestamp;
+    return true;
+}
+
+RtpIngress::RtpIngress() :
+    RtpIngress(Config())
+{
+}
+
+RtpIngress::RtpIngress(const Config &cfg) :
+    m_cfg(cfg),
+    m_epoll_fd(-1),
+    m_running(false),
+    m_packets_in(0),
+    m_bytes_in(0),
+    m_unpaired(0),
+    m_late(0),
+    m_invalid(0),
+    m_rejected(0),
+    m_closed_packets_out(0)
+{
+}
+
+RtpIngress::~RtpIngress()
+{
+    stop();
+}
+
+bool RtpIngress::start()
+{
+    if (m_running.load()) {
+        return true;
+    }
+    m_allow.clear();
+    for (auto &text : m_cfg.allow) {
+        AllowRule rule;
+        if (!parse_allow(text, rule)) {
+            LOG_ERROR("rtp ingress allow: invalid address {}", text);
+            return false;
+        }
+        m_allow.push_back(rule);
+    }
+    if (m_allow.empty()) {
+        LOG_WARN("rtp ingress accepts rtp from any source");
+    }
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        LOG_ERROR("epoll_create1");
+        return false;
+    }
+    m_ports.clear();
+    m_ports.reserve(m_cfg.port_end - m_cfg.port_begin + 1);
+    for (uint32_t p = m_cfg.port_begin; p <= m_cfg.port_end; ++p) {
+        Port port;
+        port.port = static_cast<uint16_t>(p);
+        // 每路呼叫一个源地址, GRO 合并不了多少, 关掉 offload 逐包收
+        port.socket.reset(new UdpBatchSocket(m_cfg.batch, kRtpMaxPacket, false));
+        if (!port.socket->open(m_cfg.ip, port.port)) {
+            LOG_ERROR("rtp ingress open port {}", p);
+            stop();
+            return false;
+        }
+        m_ports.push_back(std::move(port));
+    }
+    // m_ports 不再扩容, 元素地址可以放进 epoll
+    for (auto &port : m_ports) {
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &port;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, port.socket->fd(), &ev);
+    }
+    m_running.store(true);
+    m_thread = std::thread([this]() {
+        run();
+    });
+    LOG_INFO("rtp ingress on udp {}:{}-{}, {} allowed sources",
+             m_cfg.ip.empty() ? "0.0.0.0" : m_cfg.ip, m_cfg.port_begin, m_cfg.port_end, m_allow.size());
+    return true;
+}
+
+void RtpIngress::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        while (!m_calls.empty()) {
+            close_call(m_calls.begin()->first);
+        }
+    }
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    m_ports.clear();
+}
+
+void RtpIngress::bind_call(uint16_t port, const std::string &call_id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (call_id.empty()) {
+        m_call_ids.erase(port);
+    }
+    else {
+        m_call_ids[port] = call_id;
+    }
+}
+
+RtpIngress::Stats RtpIngress::stats() const
+{
+    Stats s;
+    s.packets_out = m_closed_packets_out.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        s.calls = m_calls.size();
+        for (auto &it : m_calls) {
+            s.packets_out += it.second->packets_out();
+        }
+    }
+    s.packets_in = m_packets_in.load(std::memory_order_relaxed);
+    s.bytes_in = m_bytes_in.load(std::memory_order_relaxed);
+    s.unpaired = m_unpaired.load(std::memory_order_relaxed);
+    s.late = m_late.load(std::memory_order_relaxed);
+    s.invalid = m_invalid.load(std::memory_order_relaxed);
+    s.rejected = m_rejected.load(std::memory_order_relaxed);
+    return s;
+}
+
+void RtpIngress::run()
+{
+    epoll_event events[kMaxEvents];
+    uint64_t next_sweep = now_ms() + kSweepMs;
+    while (m_running.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(m_epoll_fd, events, kMaxEvents, kWaitMs);
+        uint64_t now = now_ms();
+        std::lock_guard<std::mutex> lock(m_mtx);
+        for (int i = 0; i < n; ++i) {
+            Port &port = *static_cast<Port *>(events[i].data.ptr);
+            for (int round = 0; round < kMaxRecvRounds; ++round) {
+                int count = port.socket->recv();
+                if (count == 0) {
+                    break;
+                }
+                // 一批包同一个收到时刻, 转发时延从这里算起
+                uint64_t ingress_us = steady_us();
+                for (int k = 0; k < count; ++k) {
+                    on_packet(port, port.socket->datagram(k), now, ingress_us);
+                }
+            }
+        }
+        if (now >= next_sweep) {
+            sweep(now);
+            next_sweep = now + kSweepMs;
+        }
+    }
+}
+
+void RtpIngress::on_packet(Port &port, const UdpBatchSocket::Datagram &d, uint64_t now_ms, uint64_t ingress_us)
+{
+    if (!allowed(d.addr)) {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (isRtcpPacket(d.data, d.size)) {
+        on_rtcp(port, d);
+        return;
+    }
+    RtpHeader hdr;
+    if (!parseRtpHeader(d.data, d.size, hdr)) {
+        m_invalid.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_packets_in.fetch_add(1, std::memory_order_relaxed);
+    m_bytes_in.fetch_add(d.size, std::memory_order_relaxed);
+
+    RtpCallSession::Sptr call;
+    auto it = m_calls.find(call_key(port.port, hdr.ssrc));
+    if (it != m_calls.end()) {
+        call = it->second;
+        // 同一端口同一 SSRC 但换了源地址: 不是这路呼叫的 PBX, 不让它注入媒体
+        if (!call->is_remote(d.addr, d.addr_len)) {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    else {
+        call = open_call(port, hdr.ssrc, d);
+        if (!call) {
+            return;
+        }
+    }
+    if (!call->on_rtp(hdr, now_ms)) {
+        m_late.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (hdr.payload_size == 0) {
+        return;
+    }
+    // 和 /voip 的二进制帧一样转给配对的 robot, 帧头的序号沿用 RTP 序号
+    FrameHeader frame_hdr;
+    frame_hdr.seq = call->m_ext_seq;
+    std::string frame = make_frame(frame_hdr, reinterpret_cast<const char *>(hdr.payload), hdr.payload_size);
+    if (!WsSessionMgr::getInstance()->forward_media(kVoip, call->getId(), std::move(frame), ingress_us)) {
+        m_unpaired.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RtpIngress::on_rtcp(Port &port, const UdpBatchSocket::Datagram &d)
+{
+    // 复合包里逐个找 BYE, 每个 SSRC 的呼叫结束; 只认呼叫自己的源地址发来的 BYE
+    const uint8_t *p = d.data;
+    const uint8_t *end = d.data + d.size;
+    while (end - p >= 4) {
+        std::size_t len = (static_cast<std::size_t>(rtpRead16(p + 2)) + 1) * 4;
+        if (static_cast<std::size_t>(end - p) < len) {
+            break;
+        }
+        if (p[1] == kRtcpBye) {
+            int count = p[0] & 0x1F;
+            for (int i = 0; i < count && 4 + (i + 1) * 4 <= static_cast<int>(len); ++i) {
+                uint64_t key = call_key(port.port, rtpRead32(p + 4 + i * 4));
+                auto it = m_calls.find(key);
+                if (it == m_calls.end()) {
+                    continue;
+                }
+                if (!it->second->is_remote(d.addr, d.addr_len)) {
+                    m_rejected.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                close_call(key);
+            }
+        }
+        p += len;
+    }
+}
+
+RtpCallSession::Sptr RtpIngress::open_call(Port &port, uint32_t ssrc, const UdpBatchSocket::Datagram &d)
+{
+    std::string id;
+    auto bound = m_call_ids.find(port.port);
+    if (bound != m_call_ids.end()) {
+        id = bound->second;
+    }
+    else {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "rtp-%u-%08x", port.port, ssrc);
+        id = buf;
+    }
+    auto call = std::make_shared<RtpCallSession>(id, *port.socket, d.addr, d.addr_len);
+    // join_session 里已经为它找空闲的 robot 配对
+    if (!WsSessionMgr::getInstance()->join_session(kVoip, id, call)) {
+        // id 已被占用 (例如同一个呼叫 id 上来了第二个 SSRC)
+        m_invalid.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    m_calls[call_key(port.port, ssrc)] = call;
+    LOG_INFO("rtp call {} from port {}", id, port.port);
+    return call;
+}
+
+void RtpIngress::close_call(uint64_t key)
+{
+    auto it = m_calls.find(key);
+    if (it == m_calls.end()) {
+        return;
+    }
+    LOG_INFO("rtp call {} closed, latency: {}", it->second->getId(), it->second->latency().summary());
+    m_closed_packets_out.fetch_add(it->second->packets_out(), std::memory_order_relaxed);
+    WsSessionMgr::getInstance()->leave_session(kVoip, it->second->getId());
+    m_calls.erase(it);
+}
+
+void RtpIngress::sweep(uint64_t now_ms)
+{
+    std::vector<uint64_t> idle;
+    for (auto &it : m_calls) {
+        if (now_ms - it.second->m_last_recv_ms >= m_cfg.idle_timeout_ms) {
+            idle.push_back(it.first);
+        }
+    }
+    for (uint64_t key : idle) {
+        close_call(key);
+    }
+}
+
+bool RtpIngress::allowed(const sockaddr *addr) const
+{
+    if (m_allow.empty()) {
+        return true;
+    }
+    int family = addr->sa_family;
+    const uint8_t *ip = nullptr;
+    if (family == AF_INET) {
+        ip = reinterpret_cast<const uint8_t *>(&reinterpret_cast<const sockaddr_in *>(addr)->sin_addr);
+    }
+    else if (family == AF_INET6) {
+        ip = reinterpret_cast<const uint8_t *>(&reinterpret_cast<const sockaddr_in6 *>(addr)->sin6_addr);
+        // 双栈 socket 上的 IPv4 对端是 ::ffff:a.b.c.d, 按 IPv4 规则匹配
+        if (IN6_IS_ADDR_V4MAPPED(reinterpret_cast<const in6_addr *>(ip))) {
+            family = AF_INET;
+            ip += 12;
+        }
+    }
+    else {
+        return false;
+    }
+    for (auto &rule : m_allow) {
+        if (rule.family != family) {
+            continue;
+        }
+        int full = rule.prefix / 8;
+        int rest = rule.prefix % 8;
+        if (std::memcmp(rule.addr, ip, full) != 0) {
+            continue;
+        }
+        if (rest != 0) {
+            uint8_t mask = static_cast<uint8_t>(0xFF << (8 - rest));
+            if ((rule.addr[full] & mask) != (ip[full] & mask)) {
+                continue;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool RtpIngress::parse_allow(const std::string &text, AllowRule &rule)
+{
+    std::string ip = text;
+    int max_prefix = 0;
+    rule.prefix = -1;
+    std::size_t slash = text.find('/');
+    if (slash != std::string::npos) {
+        ip = text.substr(0, slash);
+        char *end = nullptr;
+        long prefix = std::strtol(text.c_str() + slash + 1, &end, 10);
+        if (slash + 1 == text.size() || *end != '\0' || prefix < 0) {
+            return false;
+        }
+        rule.prefix = static_cast<int>(prefix);
+    }
+    std::memset(rule.addr, 0, sizeof(rule.addr));
+    if (inet_pton(AF_INET, ip.c_str(), rule.addr) == 1) {
+        rule.family = AF_INET;
+        max_prefix = 32;
+    }
+    else if (inet_pton(AF_INET6, ip.c_str(), rule.addr) == 1) {
+        rule.family = AF_INET6;
+        max_prefix = 128;
+    }
+    else {
+        return false;
+    }
+    if (rule.prefix < 0) {
+        rule.prefix = max_prefix;
+    }
+    return rule.prefix <= max_prefix;
+}
+
+uint64_t RtpIngress::now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
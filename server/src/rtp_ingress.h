@@ -0,0 +1,191 @@
+#ifndef _RTP_INGRESS_H_
+#define _RTP_INGRESS_H_
+
+#include "session.h"
+#include "latency_histogram.h"
+#include "rtp_packetizer.h"
+#include "udp_batch_socket.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 直接进来的一路 RTP 呼叫, 作为 voip 会话参与配对
+ *
+ * 对端 (robot) 转来的媒体帧打成 RTP 从收包的端口发回 PBX;
+ * 负载格式不做转换, 时间戳步长按收到的流推算
+ */
+class RtpCallSession :
+    public Session
+{
+    friend class RtpIngress;
+
+public:
+    using Sptr = std::shared_ptr<RtpCallSession>;
+
+    RtpCallSession(const std::string &id, UdpBatchSocket &socket, const sockaddr *remote, socklen_t remote_len);
+
+    // 没有信令通道, 文本消息 (paired / bye) 只记日志, 二进制帧当媒体发出
+    void send(const std::string &msg, bool binary = false) override;
+    void send_media(const std::string &frame, uint64_t ingress_us = 0) override;
+    // 载荷本来就要拷进 RTP 包, 直接从 data 拷, 不先转成 string
+    void send_media_ref(const uint8_t *data, std::size_t size, std::shared_ptr<const void> owner) override;
+
+    std::string latency_summary() const override
+    {
+        return m_latency.summary();
+    }
+
+    WsSessionType getType() const override
+    {
+        return kVoip;
+    }
+
+    std::string getId() const override
+    {
+        return m_id;
+    }
+
+    // 包是不是从呼叫建立时的源地址 (PBX 的 RTP 端口) 来的
+    bool is_remote(const sockaddr *addr, socklen_t addr_len) const;
+
+    const SessionLatency &latency() const
+    {
+        return m_latency;
+    }
+
+    uint64_t packets_out() const
+    {
+        return m_packets_out.load(std::memory_order_relaxed);
+    }
+
+private:
+    // 收包线程调用: 记下 PT 和时间戳步长, 返回 false 表示重复或迟到的包
+    bool on_rtp(const RtpHeader &hdr, uint64_t now_ms);
+
+private:
+    std::string m_id;
+    UdpBatchSocket &m_socket;
+    sockaddr_storage m_remote;
+    socklen_t m_remote_len;
+
+    std::mutex m_mtx; // 保护发送端打包状态
+    RtpPacketRing m_ring;
+    std::unique_ptr<RtpPacketizer> m_packetizer;
+    uint8_t m_payload_type;
+    uint32_t m_ts_step;
+
+    // 只在收包线程访问
+    bool m_have_seq;
+    uint16_t m_last_seq;
+    uint32_t m_ext_seq; // 扩展到 32 位的序号, 填进转发帧的帧头
+    uint32_t m_last_ts;
+    uint64_t m_last_recv_ms;
+
+    std::atomic<uint64_t> m_packets_out;
+    SessionLatency m_latency;
+};
+
+/**
+ * @brief SIP 中继媒体的 RTP/UDP 接入, 取代外部的 RTP -> WebSocket 转换进程
+ *
+ * 一个线程用 epoll 管理端口范围内的全部 UdpBatchSocket, recvmmsg 批量收包;
+ * 每个 (端口, SSRC) 注册成一个 voip 会话交给 WsSessionMgr 配对,
+ * 负载直接转给配对的 robot; 端口事先由信令绑定了呼叫 id 时用呼叫 id 作会话 id
+ * 收到 RTCP BYE 或超过 idle_timeout_ms 没有包时会话离开
+ * 源地址不在 allow 里的包直接丢弃; 已有呼叫的 RTP / BYE 只认建立呼叫时的源地址,
+ * 别人猜中 SSRC 也注入不了媒体、挂不断呼叫
+ */
+class RtpIngress
+{
+public:
+    struct Config {
+        std::string ip;                  // 为空时为 0.0.0.0
+        uint16_t port_begin = 40000;
+        uint16_t port_end = 40009;       // 包含
+        std::vector<std::string> allow;  // 允许的源地址 "ip" 或 "ip/前缀长度", 为空时不限制
+        std::size_t batch = 64;
+        uint32_t idle_timeout_ms = 10000;
+    };
+
+    struct Stats {
+        uint64_t calls;                  // 当前呼叫数
+        uint64_t packets_in;
+        uint64_t bytes_in;
+        uint64_t packets_out;
+        uint64_t unpaired;               // 还没有配对的 robot 而丢弃的包
+        uint64_t late;
+        uint64_t invalid;
+        uint64_t rejected;               // 源地址不在 allow 里, 或不是呼叫的源地址
+    };
+
+    RtpIngress();
+    explicit RtpIngress(const Config &cfg);
+    ~RtpIngress();
+
+    RtpIngress(const RtpIngress &) = delete;
+    RtpIngress &operator=(const RtpIngress &) = delete;
+
+    bool start();
+    void stop();
+
+    // 信令给端口分配了呼叫 id, 之后这个端口上的新流用它注册; id 为空时解除
+    void bind_call(uint16_t port, const std::string &call_id);
+
+    Stats stats() const;
+
+private:
+    struct Port {
+        uint16_t port;
+        std::unique_ptr<UdpBatchSocket> socket;
+    };
+
+    struct AllowRule {
+        int family;
+        uint8_t addr[16];
+        int prefix;
+    };
+
+    void run();
+    void on_packet(Port &port, const UdpBatchSocket::Datagram &d, uint64_t now_ms, uint64_t ingress_us);
+    void on_rtcp(Port &port, const UdpBatchSocket::Datagram &d);
+    RtpCallSession::Sptr open_call(Port &port, uint32_t ssrc, const UdpBatchSocket::Datagram &d);
+    void close_call(uint64_t key);
+    void sweep(uint64_t now_ms);
+    bool allowed(const sockaddr *addr) const;
+
+    static bool parse_allow(const std::string &text, AllowRule &rule);
+
+    static uint64_t call_key(uint16_t port, uint32_t ssrc)
+    {
+        return static_cast<uint64_t>(port) << 32 | ssrc;
+    }
+
+    static uint64_t now_ms();
+
+private:
+    Config m_cfg;
+    std::vector<Port> m_ports;
+    std::vector<AllowRule> m_allow;
+    int m_epoll_fd;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+
+    mutable std::mutex m_mtx; // 保护下面两个表, 收包线程每批处理期间持有
+    std::unordered_map<uint64_t, RtpCallSession::Sptr> m_calls; // <port << 32 | ssrc, call>
+    std::unordered_map<uint16_t, std::string> m_call_ids;      // <port, call id>
+
+    std::atomic<uint64_t> m_packets_in;
+    std::atomic<uint64_t> m_bytes_in;
+    std::atomic<uint64_t> m_unpaired;
+    std::atomic<uint64_t> m_late;
+    std::atomic<uint64_t> m_invalid;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<uint64_t> m_closed_packets_out; // 已结束呼叫发出的包
+};
+
+#endif // _RTP_INGRESS_H_
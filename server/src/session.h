@@ -0,0 +1,46 @@
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include "types.h"
+#include "frame_header.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * @brief WsSessionMgr 里配对的一端, 可以是 WebSocket 连接, 也可以是直接进来的 RTP 呼叫
+ *
+ * send 发信令 (文本) 或原样的二进制帧, send_media 发对端转来的媒体帧 (带 frame_header.h 的帧头),
+ * 各实现自己决定用什么方式送出 (WebSocket 二进制帧 / WebRTC / RTP);
+ * send_media_ref 发的是别人持有的一个 Opus 包 (如映射的提示音, 不带帧头), owner 保证发完之前内存有效
+ */
+class Session
+{
+public:
+    using Sptr = std::shared_ptr<Session>;
+
+    virtual ~Session()
+    {
+    }
+
+    virtual void send(const std::string &msg, bool binary = false) = 0;
+    // ingress_us 为服务器收完这一帧的时刻 (steady_us), 帧写出去后记进转发时延; 0 表示不记
+    virtual void send_media(const std::string &frame, uint64_t ingress_us = 0) = 0;
+    // 默认拷贝一份后走 send_media, 能直接引用这块内存的实现自己覆盖
+    virtual void send_media_ref(const uint8_t *data, std::size_t size, std::shared_ptr<const void> owner)
+    {
+        (void)owner;
+        send_media(make_frame(FrameHeader(), reinterpret_cast<const char *>(data), size));
+    }
+
+    // 发给这个会话的帧的时延摘要 (SessionLatency::summary), 没有统计时为空串
+    virtual std::string latency_summary() const
+    {
+        return std::string();
+    }
+
+    virtual WsSessionType getType() const = 0;
+    virtual std::string getId() const = 0;
+};
+
+#endif // _SESSION_H_
@@ -0,0 +1,195 @@
+#include "signal_message.h"
+#include <memory>
+
+static const char *kSignalNames[] = {
+    "",
+    "offer",
+    "answer",
+    "candidate",
+    "end-of-candidates",
+    "paired",
+    "bye",
+    "error",
+};
+
+static SignalType signal_type(std::string_view name)
+{
+    for (int i = kSignalOffer; i <= kSignalError; ++i) {
+        if (name == kSignalNames[i]) {
+            return static_cast<SignalType>(i);
+        }
+    }
+    return kSignalUnknown;
+}
+
+static std::string write_signal(const Json::Value &root)
+{
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, root);
+}
+
+SignalType parse_signal(const std::string &msg, Json::Value &root)
+{
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(msg.data(), msg.data() + msg.size(), &root, nullptr) || !root.isObject()
+        || !root["type"].isString()) {
+        return kSignalUnknown;
+    }
+    SignalType type = signal_type(root["type"].asString());
+    switch (type) {
+        case kSignalOffer:
+        case kSignalAnswer: {
+            return root["sdp"].isString() ? type : kSignalUnknown;
+        }
+        case kSignalCandidate: {
+            return root["candidate"].isString() ? type : kSignalUnknown;
+        }
+        default: {
+            return type;
+        }
+    }
+}
+
+bool parse_signal(const JsonView &view, SignalType &type)
+{
+    std::string_view name;
+    if (!view.get_string("type", name)) {
+        return false;
+    }
+    type = signal_type(name);
+    switch (type) {
+        case kSignalOffer:
+        case kSignalAnswer: {
+            type = view.has_kind("sdp", JsonView::kString) ? type : kSignalUnknown;
+            break;
+        }
+        case kSignalCandidate: {
+            type = view.has_kind("candidate", JsonView::kString) ? type : kSignalUnknown;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    return true;
+}
+
+const char *signal_type_name(SignalType type)
+{
+    return kSignalNames[type];
+}
+
+bool is_relayed_signal(SignalType type)
+{
+    return type == kSignalOffer || type == kSignalAnswer || type == kSignalCandidate
+           || type == kSignalEndOfCandidates;
+}
+
+int signal_channel(const Json::Value &root)
+{
+    const Json::Value &channel = root["channel"];
+    if (!channel.isUInt() || channel.asUInt() > 0xFFFF) {
+        return -1;
+    }
+    return static_cast<int>(channel.asUInt());
+}
+
+int signal_channel(const JsonView &view)
+{
+    uint32_t channel = 0;
+    if (!view.get_uint("channel", channel) || channel > 0xFFFF) {
+        return -1;
+    }
+    return static_cast<int>(channel);
+}
+
+std::string make_channel_signal(const Json::Value &root, int channel)
+{
+    Json::Value tagged = root;
+    tagged["channel"] = channel;
+    return write_signal(tagged);
+}
+
+std::string make_channel_signal(const JsonView &view, int channel)
+{
+    std::string_view doc = view.doc();
+    std::string value = std::to_string(channel);
+    std::string out;
+    const JsonView::Member *member = view.find("channel");
+    if (member) {
+        std::size_t begin = static_cast<std::size_t>(member->value.data() - doc.data());
+        out.reserve(doc.size() + value.size());
+        out.append(doc.substr(0, begin));
+        out.append(value);
+        out.append(doc.substr(begin + member->value.size()));
+        return out;
+    }
+    // 插在 '{' 后面, 作为第一个成员
+    std::size_t brace = doc.find('{') + 1;
+    out.reserve(doc.size() + value.size() + 12);
+    out.append(doc.substr(0, brace));
+    out.append("\"channel\":");
+    out.append(value);
+    if (view.size() > 0) {
+        out.push_back(',');
+    }
+    out.append(doc.substr(brace));
+    return out;
+}
+
+std::string make_paired_signal(const WsSessionId &peer, bool offerer, int channel)
+{
+    Json::Value root;
+    root["type"] = kSignalNames[kSignalPaired];
+    root["peer"] = peer;
+    root["role"] = offerer ? "offerer" : "answerer";
+    if (channel >= 0) {
+        root["channel"] = channel;
+    }
+    return write_signal(root);
+}
+
+std::string make_bye_signal(const WsSessionId &peer, int channel)
+{
+    Json::Value root;
+    root["type"] = kSignalNames[kSignalBye];
+    root["peer"] = peer;
+    if (channel >= 0) {
+        root["channel"] = channel;
+    }
+    return write_signal(root);
+}
+
+std::string make_error_signal(const std::string &reason)
+{
+    Json::Value root;
+    root["type"] = kSignalNames[kSignalError];
+    root["reason"] = reason;
+    return write_signal(root);
+}
+
+std::string make_description_signal(SignalType type, const std::string &sdp)
+{
+    Json::Value root;
+    root["type"] = kSignalNames[type];
+    root["sdp"] = sdp;
+    return write_signal(root);
+}
+
+std::string make_candidate_signal(const std::string &candidate, const std::string &mid)
+{
+    Json::Value root;
+    root["type"] = kSignalNames[kSignalCandidate];
+    root["candidate"] = candidate;
+    root["mid"] = mid;
+    return write_signal(root);
+}
+
+std::string make_end_of_candidates_signal()
+{
+    Json::Value root;
+    root["type"] = kSignalNames[kSignalEndOfCandidates];
+    return write_signal(root);
+}
@@ -0,0 +1,56 @@
+#ifndef _SIGNAL_MESSAGE_H_
+#define _SIGNAL_MESSAGE_H_
+
+#include "types.h"
+#include "json_view.h"
+#include <json/json.h>
+#include <string>
+
+/**
+ * @brief WebSocket 文本帧上的信令消息, JSON 对象, "type" 字段区分类型
+ *
+ * 客户端之间转发: offer / answer {sdp}, candidate {candidate, mid}, end-of-candidates
+ * 服务器下发: paired {peer, role}, bye {peer}, error {reason}
+ * 多路复用的 robot 连接上, 除 error 外每条信令都带 "channel" 字段指明是哪一路呼叫
+ * 二进制帧是媒体数据, 不经过这里
+ */
+enum SignalType {
+    kSignalUnknown,
+    kSignalOffer,
+    kSignalAnswer,
+    kSignalCandidate,
+    kSignalEndOfCandidates,
+    kSignalPaired,
+    kSignalBye,
+    kSignalError,
+};
+
+// 解析并检查必需字段, 失败返回 kSignalUnknown
+SignalType parse_signal(const std::string &msg, Json::Value &root);
+// 快速路径: 在 parse 过的 view 上判断类型, 规则同上; "type" 含转义等判断不了时返回 false, 调用方改用 jsoncpp
+bool parse_signal(const JsonView &view, SignalType &type);
+
+const char *signal_type_name(SignalType type);
+
+// 客户端只能发送需要转发给对端的类型
+bool is_relayed_signal(SignalType type);
+
+// 没有 "channel" 字段或不是无符号整数时返回 -1
+int signal_channel(const Json::Value &root);
+int signal_channel(const JsonView &view);
+// 加上 "channel" 字段后重新序列化, 转发给多路复用的 robot 连接
+std::string make_channel_signal(const Json::Value &root, int channel);
+// 同上, 在原文里替换或插入 "channel" 成员, 其余字节不动
+std::string make_channel_signal(const JsonView &view, int channel);
+
+// 配对成功后通知双方, voip 一方发起 offer; channel 为 -1 时不带通道号
+std::string make_paired_signal(const WsSessionId &peer, bool offerer, int channel = -1);
+std::string make_bye_signal(const WsSessionId &peer, int channel = -1);
+std::string make_error_signal(const std::string &reason);
+
+// 服务器自己作为一端 (如 WebRTC 接入) 时下发的 answer / 候选
+std::string make_description_signal(SignalType type, const std::string &sdp);
+std::string make_candidate_signal(const std::string &candidate, const std::string &mid);
+std::string make_end_of_candidates_signal();
+
+#endif // _SIGNAL_MESSAGE_H_
@@ -0,0 +1,243 @@
+#include "tls_stream.h"
+#include "logger.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+static std::atomic<uint64_t> s_handshakes {0};
+static std::atomic<uint64_t> s_ktls_send {0};
+static std::atomic<uint64_t> s_ktls_recv {0};
+
+TlsContext::Sptr TlsContext::create(const std::string &cert_file,
+                                    const std::string &key_file,
+                                    bool ktls)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        throw std::runtime_error {"SSL_CTX_new failed"};
+    }
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    // ktls 只支持 AEAD 套件, 优先 AES-GCM
+    SSL_CTX_set_cipher_list(ctx, "ECDHE+AESGCM:ECDHE+CHACHA20");
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_ENABLE_KTLS
+    if (ktls) {
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    }
+#else
+    ktls = false;
+#endif
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1
+        || SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(ctx) != 1) {
+        SSL_CTX_free(ctx);
+        throw std::runtime_error {"load tls cert/key failed"};
+    }
+    LOG_INFO("tls context ready, ktls: {}", ktls);
+    return Sptr(new TlsContext(ctx, ktls));
+}
+
+TlsContext::~TlsContext()
+{
+    SSL_CTX_free(m_ctx);
+}
+
+bool TlsStream::set_tls(const TlsContext &ctx)
+{
+    beast::error_code ec;
+    auto &socket = m_stream.socket();
+    socket.non_blocking(true, ec);
+    if (ec) {
+        LOG_ERROR("non_blocking: {}", ec.message());
+        return false;
+    }
+    m_ssl = SSL_new(ctx.native_handle());
+    if (!m_ssl) {
+        return false;
+    }
+    SSL_set_fd(m_ssl, static_cast<int>(socket.native_handle()));
+    SSL_set_accept_state(m_ssl);
+    return true;
+}
+
+bool TlsStream::is_ktls_send() const
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return m_ssl && BIO_get_ktls_send(SSL_get_wbio(m_ssl));
+#else
+    return false;
+#endif
+}
+
+bool TlsStream::is_ktls_recv() const
+{
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return m_ssl && BIO_get_ktls_recv(SSL_get_rbio(m_ssl));
+#else
+    return false;
+#endif
+}
+
+TlsStream::Stats TlsStream::stats()
+{
+    Stats stats;
+    stats.handshakes = s_handshakes.load(std::memory_order_relaxed);
+    stats.ktls_send = s_ktls_send.load(std::memory_order_relaxed);
+    stats.ktls_recv = s_ktls_recv.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string TlsStream::metrics()
+{
+    Stats stats = TlsStream::stats();
+    std::string out;
+    out += "# TYPE laudio_tls_handshakes_total counter\n";
+    out += "laudio_tls_handshakes_total " + std::to_string(stats.handshakes) + "\n";
+    out += "# TYPE laudio_tls_ktls_total counter\n";
+    out += "laudio_tls_ktls_total{direction=\"send\"} " + std::to_string(stats.ktls_send) + "\n";
+    out += "laudio_tls_ktls_total{direction=\"recv\"} " + std::to_string(stats.ktls_recv) + "\n";
+    return out;
+}
+
+void TlsStream::on_handshake_done()
+{
+    m_ktls_send = is_ktls_send();
+    s_handshakes.fetch_add(1, std::memory_order_relaxed);
+    if (m_ktls_send) {
+        s_ktls_send.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (is_ktls_recv()) {
+        s_ktls_recv.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool TlsStream::write_some(const net::const_buffer *bufs,
+                           std::size_t count,
+                           std::size_t &bytes,
+                           tcp::socket::wait_type &wait,
+                           beast::error_code &ec)
+{
+    bytes = 0;
+    if (m_ktls_send) {
+        // 记录层在内核里: 帧头和负载一次 sendmsg, 内核按 16 KB 切记录, 不经过 SSL_write
+        iovec iov[kMaxWriteBuffers];
+        for (std::size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<void *>(bufs[i].data());
+            iov[i].iov_len = bufs[i].size();
+        }
+        msghdr msg {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t ret;
+        do {
+            ret = ::sendmsg(static_cast<int>(m_stream.socket().native_handle()), &msg, MSG_NOSIGNAL);
+        } while (ret < 0 && errno == EINTR);
+        if (ret >= 0) {
+            bytes = static_cast<std::size_t>(ret);
+            return false;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            wait = tcp::socket::wait_write;
+            return true;
+        }
+        ec = beast::error_code(errno, net::error::get_system_category());
+        return false;
+    }
+    // 用户态记录层: 大 buffer 按整记录原地 SSL_write, 不拷贝; 帧头这类不足一个记录的 buffer
+    // 和后面的数据拼进栈上凑满一个记录, 避免帧头单独成为一个记录多一次系统调用.
+    // 重试时 bufs 不变, 拼出的记录也不变
+    char block[kMaxRecord];
+    std::size_t i = 0;
+    std::size_t off = 0;
+    while (i < count) {
+        const char *data = static_cast<const char *>(bufs[i].data()) + off;
+        std::size_t size = std::min(bufs[i].size() - off, kMaxRecord);
+        std::size_t next = i;
+        std::size_t next_off = off + size;
+        if (size < kMaxRecord && i + 1 < count) {
+            size = 0;
+            next_off = off;
+            while (next < count && size < kMaxRecord) {
+                std::size_t n = std::min(bufs[next].size() - next_off, kMaxRecord - size);
+                std::memcpy(block + size, static_cast<const char *>(bufs[next].data()) + next_off, n);
+                size += n;
+                next_off += n;
+                if (next_off == bufs[next].size()) {
+                    ++next;
+                    next_off = 0;
+                }
+            }
+            data = block;
+        }
+        else if (next_off == bufs[i].size()) {
+            ++next;
+            next_off = 0;
+        }
+        int len = static_cast<int>(size);
+        int ret = SSL_write(m_ssl, data, len);
+        if (ret > 0) {
+            bytes += static_cast<std::size_t>(ret);
+            if (ret < len) {
+                break;
+            }
+            i = next;
+            off = next_off;
+            continue;
+        }
+        if (bytes > 0) {
+            // 先交出已经写出的部分, 下一次从这里重试 (SSL_write 要求重试时数据不变)
+            ERR_clear_error();
+            return false;
+        }
+        return want(ret, wait, ec);
+    }
+    return false;
+}
+
+void TlsStream::shutdown_tls()
+{
+    if (m_ssl && SSL_is_init_finished(m_ssl)) {
+        ERR_clear_error();
+        SSL_shutdown(m_ssl);
+    }
+}
+
+bool TlsStream::want(int ret, tcp::socket::wait_type &wait, beast::error_code &ec)
+{
+    int err = SSL_get_error(m_ssl, ret);
+    switch (err) {
+        case SSL_ERROR_WANT_READ: {
+            wait = tcp::socket::wait_read;
+            return true;
+        }
+        case SSL_ERROR_WANT_WRITE: {
+            wait = tcp::socket::wait_write;
+            return true;
+        }
+        case SSL_ERROR_ZERO_RETURN: {
+            ec = net::error::eof;
+            break;
+        }
+        case SSL_ERROR_SYSCALL: {
+            // 对端未发送 close_notify 直接断开
+            ec = (ret != 0 && errno != 0) ? beast::error_code(errno, net::error::get_system_category())
+                                          : beast::error_code(net::ssl::error::stream_truncated);
+            break;
+        }
+        default: {
+            ec = beast::error_code(static_cast<int>(ERR_get_error()), net::error::get_ssl_category());
+            break;
+        }
+    }
+    ERR_clear_error();
+    return false;
+}
+
+void teardown(beast::role_type role, TlsStream &stream, beast::error_code &ec)
+{
+    stream.shutdown_tls();
+    beast::websocket::teardown(role, stream.next_layer().socket(), ec);
+}
@@ -0,0 +1,325 @@
+#ifndef _TLS_STREAM_H_
+#define _TLS_STREAM_H_
+
+#include <boost/beast.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+/**
+ * @brief wss 服务端 SSL_CTX
+ *
+ * 握手在用户态由 OpenSSL 完成, 开启 ktls 时 OpenSSL 在握手结束后
+ * 把记录层加解密交给内核 (TCP_ULP tls), 内核不支持时自动退回用户态
+ */
+class TlsContext
+{
+public:
+    using Sptr = std::shared_ptr<TlsContext>;
+
+    static Sptr create(const std::string &cert_file,
+                       const std::string &key_file,
+                       bool ktls = true);
+
+    ~TlsContext();
+
+    SSL_CTX *native_handle() const
+    {
+        return m_ctx;
+    }
+
+    bool ktls() const
+    {
+        return m_ktls;
+    }
+
+private:
+    TlsContext(SSL_CTX *ctx, bool ktls) :
+        m_ctx(ctx),
+        m_ktls(ktls)
+    {
+    }
+
+private:
+    SSL_CTX *m_ctx;
+    bool m_ktls;
+};
+
+/**
+ * @brief WsSession 的下层流, 未设置 TlsContext 时直接透传 tcp_stream
+ *
+ * TLS 模式下 SSL 直接绑定 socket fd (不走 asio 的内存 BIO),
+ * 这样 OpenSSL 才能在握手后启用 ktls; 读写在 socket 非阻塞模式下进行,
+ * WANT_READ / WANT_WRITE 时 async_wait 等待就绪
+ *
+ * 写不拷贝: ktls 发送已启用时整组 buffer 一次 sendmsg, 由内核切记录;
+ * 否则大 buffer 按整记录原地 SSL_write, 不足一个记录的部分和相邻 buffer 拼成一个记录
+ */
+class TlsStream
+{
+public:
+    using next_layer_type = beast::tcp_stream;
+    using executor_type = next_layer_type::executor_type;
+
+    static constexpr std::size_t kMaxRecord = 16384;
+    // 一次 async_write_some 最多取这么多个 buffer, 其余的留给下一次
+    static constexpr std::size_t kMaxWriteBuffers = 16;
+
+    // 握手完成的连接数和其中启用了 ktls 的, 供 /metrics 使用
+    struct Stats {
+        uint64_t handshakes;
+        uint64_t ktls_send;
+        uint64_t ktls_recv;
+    };
+
+private:
+    using WriteBuffers = std::array<net::const_buffer, kMaxWriteBuffers>;
+
+    next_layer_type m_stream;
+    SSL *m_ssl;
+    bool m_ktls_send; // 握手完成时确定, 之后每次写不再查询 BIO
+
+public:
+    explicit TlsStream(tcp::socket &&socket) :
+        m_stream(std::move(socket)),
+        m_ssl(nullptr),
+        m_ktls_send(false)
+    {
+    }
+    ~TlsStream()
+    {
+        if (m_ssl) {
+            SSL_free(m_ssl);
+        }
+    }
+
+    TlsStream(const TlsStream &) = delete;
+    TlsStream &operator=(const TlsStream &) = delete;
+
+    executor_type get_executor() noexcept
+    {
+        return m_stream.get_executor();
+    }
+
+    next_layer_type &next_layer()
+    {
+        return m_stream;
+    }
+
+    bool set_tls(const TlsContext &ctx);
+
+    bool is_tls() const
+    {
+        return m_ssl != nullptr;
+    }
+
+    bool is_ktls_send() const;
+    bool is_ktls_recv() const;
+
+    static Stats stats();
+    // Prometheus 文本格式
+    static std::string metrics();
+
+    // 尽力发送 close_notify, 不等待对端
+    void shutdown_tls();
+
+    template <class HandshakeHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(HandshakeHandler, void(beast::error_code))
+    async_handshake(HandshakeHandler &&handler)
+    {
+        return net::async_compose<HandshakeHandler, void(beast::error_code)>(
+            HandshakeOp(*this), handler, m_stream);
+    }
+
+    template <class MutableBufferSequence, class ReadHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(ReadHandler, void(beast::error_code, std::size_t))
+    async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler)
+    {
+        if (!m_ssl) {
+            return m_stream.async_read_some(buffers, std::forward<ReadHandler>(handler));
+        }
+        return net::async_compose<ReadHandler, void(beast::error_code, std::size_t)>(
+            ReadOp(*this, beast::buffers_front(buffers)), handler, m_stream);
+    }
+
+    template <class ConstBufferSequence, class WriteHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(WriteHandler, void(beast::error_code, std::size_t))
+    async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler)
+    {
+        if (!m_ssl) {
+            return m_stream.async_write_some(buffers, std::forward<WriteHandler>(handler));
+        }
+        WriteOp op(*this);
+        for (auto it = net::buffer_sequence_begin(buffers); it != net::buffer_sequence_end(buffers); ++it) {
+            net::const_buffer b(*it);
+            if (b.size() == 0) {
+                continue;
+            }
+            if (op.count == kMaxWriteBuffers) {
+                break;
+            }
+            op.bufs[op.count++] = b;
+        }
+        return net::async_compose<WriteHandler, void(beast::error_code, std::size_t)>(
+            std::move(op), handler, m_stream);
+    }
+
+private:
+    // SSL_* 返回值 -> 需要等待的方向, 或错误码
+    bool want(int ret, tcp::socket::wait_type &wait, beast::error_code &ec);
+    // 握手成功后记下 ktls 状态
+    void on_handshake_done();
+    // 写出 bufs 的一个前缀, 字节数放在 bytes; 一个字节都没写出且要等 socket 就绪时返回 true
+    bool write_some(const net::const_buffer *bufs,
+                    std::size_t count,
+                    std::size_t &bytes,
+                    tcp::socket::wait_type &wait,
+                    beast::error_code &ec);
+
+    // 立即完成的操作需要先投递一次, 不能在发起函数里直接调用 handler
+    struct OpState {
+        bool cont = false;
+        bool done = false;
+        beast::error_code ec;
+        std::size_t bytes = 0;
+
+        template <class Self>
+        bool resume(Self &self)
+        {
+            if (!done) {
+                return false;
+            }
+            self.complete(ec, bytes);
+            return true;
+        }
+
+        template <class Self>
+        void finish(Self &self, beast::error_code e, std::size_t n)
+        {
+            done = true;
+            ec = e;
+            bytes = n;
+            if (cont) {
+                self.complete(ec, bytes);
+                return;
+            }
+            net::post(std::move(self));
+        }
+    };
+
+    struct HandshakeOp : OpState {
+        TlsStream &s;
+
+        explicit HandshakeOp(TlsStream &stream) :
+            s(stream)
+        {
+        }
+
+        template <class Self>
+        void operator()(Self &self, beast::error_code ec = {})
+        {
+            if (done) {
+                self.complete(this->ec);
+                return;
+            }
+            tcp::socket::wait_type wait;
+            if (!ec && s.want(SSL_do_handshake(s.m_ssl), wait, ec)) {
+                cont = true;
+                s.m_stream.socket().async_wait(wait, std::move(self));
+                return;
+            }
+            if (!ec) {
+                s.on_handshake_done();
+            }
+            done = true;
+            this->ec = ec;
+            if (cont) {
+                self.complete(ec);
+                return;
+            }
+            net::post(std::move(self));
+        }
+    };
+
+    struct ReadOp : OpState {
+        TlsStream &s;
+        net::mutable_buffer buf;
+
+        ReadOp(TlsStream &stream, net::mutable_buffer b) :
+            s(stream),
+            buf(b)
+        {
+        }
+
+        template <class Self>
+        void operator()(Self &self, beast::error_code ec = {})
+        {
+            if (resume(self)) {
+                return;
+            }
+            std::size_t n = 0;
+            if (!ec && buf.size() > 0) {
+                int ret = SSL_read(s.m_ssl, buf.data(), static_cast<int>(buf.size()));
+                tcp::socket::wait_type wait;
+                if (ret > 0) {
+                    n = static_cast<std::size_t>(ret);
+                }
+                else if (s.want(ret, wait, ec)) {
+                    cont = true;
+                    s.m_stream.socket().async_wait(wait, std::move(self));
+                    return;
+                }
+            }
+            finish(self, ec, n);
+        }
+    };
+
+    struct WriteOp : OpState {
+        TlsStream &s;
+        WriteBuffers bufs;
+        std::size_t count = 0;
+
+        explicit WriteOp(TlsStream &stream) :
+            s(stream)
+        {
+        }
+
+        template <class Self>
+        void operator()(Self &self, beast::error_code ec = {})
+        {
+            if (resume(self)) {
+                return;
+            }
+            std::size_t n = 0;
+            tcp::socket::wait_type wait;
+            if (!ec && count > 0 && s.write_some(bufs.data(), count, n, wait, ec)) {
+                cont = true;
+                s.m_stream.socket().async_wait(wait, std::move(self));
+                return;
+            }
+            finish(self, ec, n);
+        }
+    };
+};
+
+// websocket::stream 关闭时通过 ADL 查找
+void teardown(beast::role_type role, TlsStream &stream, beast::error_code &ec);
+
+template <class TeardownHandler>
+void async_teardown(beast::role_type role, TlsStream &stream, TeardownHandler &&handler)
+{
+    stream.shutdown_tls();
+    beast::websocket::async_teardown(role, stream.next_layer().socket(),
+                                     std::forward<TeardownHandler>(handler));
+}
+
+#endif // _TLS_STREAM_H_
@@ -0,0 +1,125 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "singleton.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+/**
+ * @brief 轻量的 span 跟踪, 导出 Chrome trace JSON (ui.perfetto.dev / chrome://tracing 打开)
+ *
+ * 每个线程写自己的环形缓冲, 满了覆盖最旧的, 记录时不加锁也不分配;
+ * dump 把各线程缓冲里还在的 span 合并成一个 JSON, 不用停下写线程
+ *
+ * 代码里只用 TRACE_SCOPE / TRACE_LOCK 两个宏: 没有定义 LAUDIO_TRACE (CMake 选项) 时
+ * TRACE_SCOPE 什么都不生成, TRACE_LOCK 就是原来的 std::unique_lock
+ */
+class Tracer : public Singleton<Tracer>
+{
+    friend class Singleton<Tracer>;
+
+public:
+    static constexpr std::size_t kMaxThreads = 64;
+    static constexpr std::size_t kRingEvents = 1 << 14; // 每个线程保留最近的 span 数
+
+    ~Tracer();
+
+    // name 必须是字符串字面量 (只存指针, 输出时不转义)
+    static void record(const char *name, uint64_t start_ns, uint64_t end_ns);
+    static uint64_t now_ns();
+
+    // Chrome trace 的 JSON (traceEvents 数组, "X" 事件)
+    std::string dump() const;
+    bool dump_file(const std::string &path) const;
+
+private:
+    Tracer();
+
+    struct Event {
+        std::atomic<const char *> name;
+        std::atomic<uint64_t> start_ns;
+        std::atomic<uint64_t> dur_ns;
+    };
+
+    struct Ring {
+        Event events[kRingEvents];
+        std::atomic<uint64_t> head {0}; // 已经写完的 span 数, 写完一条再递增
+        long tid = 0;
+    };
+
+    Ring *local();
+
+private:
+    std::atomic<Ring *> m_slots[kMaxThreads];
+    std::atomic<std::size_t> m_used;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) :
+        m_name(name),
+        m_start_ns(Tracer::now_ns())
+    {
+    }
+
+    ~TraceScope()
+    {
+        Tracer::record(m_name, m_start_ns, Tracer::now_ns());
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    uint64_t m_start_ns;
+};
+
+/**
+ * @brief 加锁时记两个 span: 等锁 (wait) 和持锁 (hold)
+ */
+template <typename Mutex>
+class TracedLock
+{
+public:
+    TracedLock(Mutex &mtx, const char *wait_name, const char *hold_name) :
+        m_mtx(mtx),
+        m_hold_name(hold_name)
+    {
+        uint64_t start_ns = Tracer::now_ns();
+        m_mtx.lock();
+        m_locked_ns = Tracer::now_ns();
+        Tracer::record(wait_name, start_ns, m_locked_ns);
+    }
+
+    ~TracedLock()
+    {
+        m_mtx.unlock();
+        Tracer::record(m_hold_name, m_locked_ns, Tracer::now_ns());
+    }
+
+    TracedLock(const TracedLock &) = delete;
+    TracedLock &operator=(const TracedLock &) = delete;
+
+private:
+    Mutex &m_mtx;
+    const char *m_hold_name;
+    uint64_t m_locked_ns;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b)      TRACE_CONCAT_IMPL(a, b)
+
+#ifdef LAUDIO_TRACE
+#define TRACE_SCOPE(name)           TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_LOCK(lock, mtx, name) TracedLock<std::decay_t<decltype(mtx)>> lock(mtx, name " wait", name " hold")
+#else
+#define TRACE_SCOPE(name)           ((void)0)
+#define TRACE_LOCK(lock, mtx, name) std::unique_lock<std::decay_t<decltype(mtx)>> lock(mtx)
+#endif
+
+#endif // _TRACE_H_
@@ -0,0 +1,220 @@
+#include "webrtc_ingress.h"
+#include "logger.h"
+#include <cstring>
+#include <random>
+
+// 发往浏览器的包只在 send_audio 里短暂占用槽, 几个就够
+static const std::size_t kSendSlots = 8;
+
+WebRtcIngress::Sptr WebRtcIngress::create(const Config &cfg, OnSignal on_signal, OnAudio on_audio)
+{
+    Sptr ingress(new WebRtcIngress(std::move(on_signal), std::move(on_audio), cfg.payload_type));
+    ingress->init(cfg);
+    return ingress;
+}
+
+WebRtcIngress::WebRtcIngress(OnSignal &&on_signal, OnAudio &&on_audio, uint8_t payload_type) :
+    m_on_signal(std::move(on_signal)),
+    m_on_audio(std::move(on_audio)),
+    m_ring(kSendSlots),
+    m_payload_type(payload_type),
+    m_have_seq(false),
+    m_last_seq(0),
+    m_closed(false),
+    m_packets_in(0),
+    m_bytes_in(0),
+    m_late(0),
+    m_lost(0),
+    m_packets_out(0),
+    m_dropped_out(0)
+{
+}
+
+WebRtcIngress::~WebRtcIngress()
+{
+    close();
+}
+
+void WebRtcIngress::init(const Config &cfg)
+{
+    rtc::Configuration config;
+    for (const auto &server : cfg.ice_servers) {
+        config.iceServers.emplace_back(server);
+    }
+    if (cfg.port_begin != 0) {
+        config.portRangeBegin = cfg.port_begin;
+        config.portRangeEnd = cfg.port_end ? cfg.port_end : cfg.port_begin;
+    }
+    m_pc = std::make_shared<rtc::PeerConnection>(config);
+
+    // 回调里只持有弱引用, 避免 PeerConnection 和 ingress 互相持有
+    std::weak_ptr<WebRtcIngress> weak = shared_from_this();
+    m_pc->onLocalDescription([weak](rtc::Description sdp) {
+        auto self = weak.lock();
+        if (self && !self->m_closed.load()) {
+            self->m_on_signal(make_description_signal(kSignalAnswer, std::string(sdp)));
+        }
+    });
+    // trickle: 候选收集到一个就发一个, 浏览器可以边收集边做连通性检查
+    m_pc->onLocalCandidate([weak](rtc::Candidate candidate) {
+        auto self = weak.lock();
+        if (self && !self->m_closed.load()) {
+            self->m_on_signal(make_candidate_signal(candidate.candidate(), candidate.mid()));
+        }
+    });
+    m_pc->onGatheringStateChange([weak](rtc::PeerConnection::GatheringState state) {
+        auto self = weak.lock();
+        if (self && !self->m_closed.load() && state == rtc::PeerConnection::GatheringState::Complete) {
+            self->m_on_signal(make_end_of_candidates_signal());
+        }
+    });
+    m_pc->onStateChange([weak](rtc::PeerConnection::State state) {
+        LOG_INFO("webrtc state: {}", (int)state);
+    });
+    m_pc->onTrack([weak](std::shared_ptr<rtc::Track> track) {
+        auto self = weak.lock();
+        if (self) {
+            self->on_track(track);
+        }
+    });
+}
+
+bool WebRtcIngress::on_signal(SignalType type, const Json::Value &root)
+{
+    if (m_closed.load()) {
+        return false;
+    }
+    switch (type) {
+        case kSignalOffer: {
+            // 自动协商: 设置 offer 后 libdatachannel 生成 answer, 经 onLocalDescription 发出
+            m_pc->setRemoteDescription(rtc::Description(root["sdp"].asString(), "offer"));
+            return true;
+        }
+        case kSignalCandidate: {
+            m_pc->addRemoteCandidate(rtc::Candidate(root["candidate"].asString(), root["mid"].asString()));
+            return true;
+        }
+        case kSignalEndOfCandidates: {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+bool WebRtcIngress::send_audio(const uint8_t *data, std::size_t size, uint32_t samples)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_track || !m_track->isOpen()) {
+        m_dropped_out.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!m_packetizer) {
+        std::random_device rd;
+        m_packetizer.reset(new RtpPacketizer(m_ring, rd(), m_payload_type, rd(), rd()));
+    }
+    uint8_t *payload = m_packetizer->payload();
+    if (!payload || size > m_packetizer->payloadCapacity()) {
+        if (payload) {
+            m_packetizer->abort();
+        }
+        m_dropped_out.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::memcpy(payload, data, size);
+    RtpPacket pkt = m_packetizer->commit(size, samples);
+    // 没有 media handler 时 send 发的是完整 RTP 包, 由 libdatachannel 做 SRTP
+    bool sent = m_track->send(reinterpret_cast<const rtc::byte *>(pkt.data), pkt.size);
+    m_ring.release(pkt);
+    if (sent) {
+        m_packets_out.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        m_dropped_out.fetch_add(1, std::memory_order_relaxed);
+    }
+    return sent;
+}
+
+void WebRtcIngress::close()
+{
+    if (m_closed.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_track.reset();
+    }
+    if (m_pc) {
+        m_pc->close();
+    }
+}
+
+WebRtcIngress::Stats WebRtcIngress::stats() const
+{
+    Stats s;
+    s.packets_in = m_packets_in.load(std::memory_order_relaxed);
+    s.bytes_in = m_bytes_in.load(std::memory_order_relaxed);
+    s.late = m_late.load(std::memory_order_relaxed);
+    s.lost = m_lost.load(std::memory_order_relaxed);
+    s.packets_out = m_packets_out.load(std::memory_order_relaxed);
+    s.dropped_out = m_dropped_out.load(std::memory_order_relaxed);
+    return s;
+}
+
+void WebRtcIngress::on_track(const std::shared_ptr<rtc::Track> &track)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_track) {
+            LOG_WARN("only one audio track is bridged");
+            return;
+        }
+        m_track = track;
+    }
+    std::weak_ptr<WebRtcIngress> weak = shared_from_this();
+    // 不挂 media handler, onMessage 收到的是解密后的完整 RTP / RTCP 包
+    track->onMessage(
+        [weak](rtc::binary data) {
+            auto self = weak.lock();
+            if (self) {
+                self->on_rtp(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+            }
+        },
+        nullptr);
+}
+
+void WebRtcIngress::on_rtp(const uint8_t *data, std::size_t size)
+{
+    RtpHeader hdr;
+    if (m_closed.load() || isRtcpPacket(data, size) || !parseRtpHeader(data, size, hdr)) {
+        return;
+    }
+    m_packets_in.fetch_add(1, std::memory_order_relaxed);
+    m_bytes_in.fetch_add(size, std::memory_order_relaxed);
+
+    if (!m_have_seq) {
+        m_have_seq = true;
+        std::lock_guard<std::mutex> lock(m_mtx);
+        // 发回浏览器用它协商出来的 PT
+        if (hdr.payload_type != m_payload_type) {
+            m_payload_type = hdr.payload_type;
+            m_packetizer.reset();
+        }
+    }
+    else {
+        // robot 那边按到达顺序解码, 迟到的包已经被 PLC 顶替, 再送过去只会打乱解码状态
+        int16_t delta = static_cast<int16_t>(hdr.seq - m_last_seq);
+        if (delta <= 0) {
+            m_late.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (delta > 1) {
+            m_lost.fetch_add(delta - 1, std::memory_order_relaxed);
+        }
+    }
+    m_last_seq = hdr.seq;
+    if (hdr.payload_size > 0) {
+        m_on_audio(hdr.payload, hdr.payload_size);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef _WEBRTC_INGRESS_H_
+#define _WEBRTC_INGRESS_H_
+
+#include "signal_message.h"
+#include "rtp_packetizer.h"
+#include <rtc/rtc.hpp>
+#include <json/json.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 浏览器 WebRTC 呼叫在服务器上的一端 (libdatachannel)
+ *
+ * 浏览器用 /voip?id=&media=webrtc 登录, WebSocket 只用来交换 offer / answer / 候选,
+ * 音频走 SRTP/UDP, 丢一个包不会像 TCP 那样卡住后面的包;
+ * 收到的 RTP 去掉包头后把 Opus 帧交给 OnAudio, 和 /voip 的二进制帧走同一条转发路径,
+ * robot 发来的 Opus 帧经 send_audio 打成 RTP 发回浏览器
+ */
+class WebRtcIngress :
+    public std::enable_shared_from_this<WebRtcIngress>
+{
+public:
+    using Sptr = std::shared_ptr<WebRtcIngress>;
+    // 要通过 WebSocket 发给浏览器的信令 (JSON 文本)
+    using OnSignal = std::function<void(const std::string &msg)>;
+    // 一个 Opus 帧, 已按序号去掉重复和迟到的包
+    using OnAudio = std::function<void(const uint8_t *data, std::size_t size)>;
+
+    struct Config {
+        std::vector<std::string> ice_servers;
+        uint16_t port_begin = 0;     // 为 0 时由 libdatachannel 决定
+        uint16_t port_end = 0;
+        uint8_t payload_type = 111;  // 浏览器还没发来 RTP 时使用的 Opus PT
+    };
+
+    struct Stats {
+        uint64_t packets_in;
+        uint64_t bytes_in;
+        uint64_t late;               // 重复或乱序迟到而丢弃的包
+        uint64_t lost;               // 按序号缺失的包
+        uint64_t packets_out;
+        uint64_t dropped_out;        // 轨道未打开或环满而没发出的包
+    };
+
+    static Sptr create(const Config &cfg, OnSignal on_signal, OnAudio on_audio);
+    ~WebRtcIngress();
+
+    WebRtcIngress(const WebRtcIngress &) = delete;
+    WebRtcIngress &operator=(const WebRtcIngress &) = delete;
+
+    // 浏览器发来的 offer / candidate / end-of-candidates, 其余类型返回 false
+    bool on_signal(SignalType type, const Json::Value &root);
+    // 一个 Opus 帧, samples 为 48 kHz 下的采样数
+    bool send_audio(const uint8_t *data, std::size_t size, uint32_t samples);
+    void close();
+
+    Stats stats() const;
+
+private:
+    WebRtcIngress(OnSignal &&on_signal, OnAudio &&on_audio, uint8_t payload_type);
+
+    void init(const Config &cfg);
+    void on_track(const std::shared_ptr<rtc::Track> &track);
+    void on_rtp(const uint8_t *data, std::size_t size);
+
+private:
+    OnSignal m_on_signal;
+    OnAudio m_on_audio;
+    std::shared_ptr<rtc::PeerConnection> m_pc;
+
+    std::mutex m_mtx; // 保护轨道和发送端打包状态
+    std::shared_ptr<rtc::Track> m_track;
+    RtpPacketRing m_ring;
+    std::unique_ptr<RtpPacketizer> m_packetizer;
+    uint8_t m_payload_type;
+
+    // 接收端状态只在 libdatachannel 的回调线程里访问
+    bool m_have_seq;
+    uint16_t m_last_seq;
+
+    std::atomic<bool> m_closed;
+    std::atomic<uint64_t> m_packets_in;
+    std::atomic<uint64_t> m_bytes_in;
+    std::atomic<uint64_t> m_late;
+    std::atomic<uint64_t> m_lost;
+    std::atomic<uint64_t> m_packets_out;
+    std::atomic<uint64_t> m_dropped_out;
+};
+
+#endif // _WEBRTC_INGRESS_H_
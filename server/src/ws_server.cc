@@ -1,12 +1,16 @@
 #include "ws_server.h"
 #include "logger.h"
+#include "ws_session.h"
 #include "ws_session_mgr.h"
+#include "admission_control.h"
 
 WsServer::WsServer(net::io_context &ioc,
                    const std::string &addr,
-                   const unsigned short port) :
+                   const unsigned short port,
+                   TlsContext::Sptr tls) :
     m_acceptor(ioc),
-    m_endpoint(net::ip::make_address(addr), port)
+    m_endpoint(net::ip::make_address(addr), port),
+    m_tls(std::move(tls))
 {
     beast::error_code ec;
     if (m_acceptor.open(m_endpoint.protocol(), ec)) {
@@ -41,6 +45,18 @@ void WsServer::send(const std::string &id, const std::string &msg)
     // sess->send(msg);
 }
 
+#ifdef LAUDIO_WEBRTC
+void WsServer::set_webrtc_config(const WebRtcIngress::Config &cfg)
+{
+    m_webrtc_cfg = std::make_shared<const WebRtcIngress::Config>(cfg);
+}
+#endif
+
+void WsServer::set_admin_token(const std::string &token)
+{
+    m_admin_token = std::make_shared<const std::string>(token);
+}
+
 void WsServer::do_accept()
 {
     m_acceptor.async_accept([this](beast::error_code ec, tcp::socket socket) {
@@ -49,14 +65,35 @@ void WsServer::do_accept()
             do_accept();
             return;
         }
-        auto session = std::make_shared<WsSession>(std::move(socket));
-        session->set_on_ready([session](WsSessionType type, const WsSessionId &id) {
+        AdmissionTicket ticket;
+        uint32_t retry_after_s = AdmissionControl::getInstance()->admit_connection(ticket);
+        // wss 要先做完 TLS 握手才能回 503, 过载时这一步就是最贵的, 直接关掉
+        if (retry_after_s != 0 && m_tls) {
+            beast::error_code close_ec;
+            socket.close(close_ec);
+            do_accept();
+            return;
+        }
+        // 信令是一串很小的帧 (offer 后紧跟多个候选), 关掉 Nagle, 否则和对端的延迟 ACK 叠加会卡 40 ms
+        beast::error_code opt_ec;
+        socket.set_option(tcp::no_delay(true), opt_ec);
+#ifdef LAUDIO_WEBRTC
+        auto session = std::make_shared<WsSession>(std::move(socket), m_tls, m_webrtc_cfg);
+#else
+        auto session = std::make_shared<WsSession>(std::move(socket), m_tls);
+#endif
+        session->set_admission(std::move(ticket), retry_after_s);
+        session->set_admin_token(m_admin_token);
+        // 只回 HTTP (503 / /metrics) 的连接不会走到 on_ready, 持有 shared_ptr 会让它们永远不析构
+        session->set_on_ready([weak = std::weak_ptr<WsSession>(session)](WsSessionType type, const WsSessionId &id) {
+            auto session = weak.lock();
+            if (!session) {
+                return;
+            }
             LOG_INFO("type: {}", (int)type);
             LOG_INFO("id: {}", id);
-            WsSessionMgr::getInstance()->join_session(type, id, session);
-            WsSessionMgr::getInstance()->match_session(type, id);
-            WsSessionMgr::getInstance()->printSession();
-            WsSessionMgr::getInstance()->printFriend();
+            // join 时就会配对
+            WsSessionMgr::getInstance()->join_session(type, id, session, session->getCapacity());
         });
         session->run();
         do_accept();
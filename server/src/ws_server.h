@@ -1,6 +1,10 @@
 #ifndef _WS_SERVER_H_
 #define _WS_SERVER_H_
 
+#include "tls_stream.h"
+#ifdef LAUDIO_WEBRTC
+#include "webrtc_ingress.h"
+#endif
 #include <boost/beast.hpp>
 #include <boost/asio.hpp>
 #include <json/json.h>
@@ -16,16 +20,29 @@ private:
     tcp::acceptor m_acceptor;
     tcp::endpoint m_endpoint;
     std::mutex m_session_mtx;
+    TlsContext::Sptr m_tls; // 为空时只接受明文 ws://
+#ifdef LAUDIO_WEBRTC
+    std::shared_ptr<const WebRtcIngress::Config> m_webrtc_cfg; // 为空时不接受 media=webrtc
+#endif
+    std::shared_ptr<const std::string> m_admin_token;          // 为空时 /admin/ 只允许本机访问
 
 public:
     WsServer(net::io_context &ioc,
              const std::string &addr,
-             const unsigned short port);
+             const unsigned short port,
+             TlsContext::Sptr tls = nullptr);
     ~WsServer();
 
     void send(const std::string &id,
               const std::string &msg);
 
+#ifdef LAUDIO_WEBRTC
+    // 开启浏览器 WebRTC 接入, 要在 io_context 运行前设置
+    void set_webrtc_config(const WebRtcIngress::Config &cfg);
+#endif
+    // 非本机访问 /admin/ 要带 Authorization: Bearer <token>, 空串表示只允许本机
+    void set_admin_token(const std::string &token);
+
 private:
     void do_accept();
 };
@@ -1,33 +1,225 @@
 #include "ws_session.h"
 #include "ws_session_mgr.h"
+#include "signal_message.h"
+#include <opus/opus.h>
+#include <openssl/crypto.h>
 
 void WsSession::on_read_ws(beast::error_code ec, std::size_t bytes)
 {
+    TRACE_SCOPE("on_read_ws");
+#ifdef LAUDIO_WEBRTC
+    if (ec && m_webrtc) {
+        m_webrtc->close();
+    }
+#endif
     if (ec == websocket::error::closed) {
         LOG_ERROR("on_read_ws: {} {}", (int)m_type, m_id);
-        WsSessionMgr::getInstance()->printSession();
         WsSessionMgr::getInstance()->leave_session(m_type, m_id);
-        WsSessionMgr::getInstance()->printSession();
         return;
     }
     if (ec) {
         LOG_ERROR("on_read_ws: {} {}", (int)m_type, m_id);
-        WsSessionMgr::getInstance()->printSession();
         WsSessionMgr::getInstance()->leave_session(m_type, m_id);
-        WsSessionMgr::getInstance()->printSession();
         return;
     }
-    std::string msg = beast::buffers_to_string(m_buffer.data());
-    m_buffer.consume(bytes);
-    // process msg
-    LOG_INFO("recv msg: {}", msg);
-    auto friend_session_ptr = WsSessionMgr::getInstance()->get_friend_session(m_type, m_id);
-    if (friend_session_ptr) {
-        friend_session_ptr->send(msg);
+    if (m_stream.got_text()) {
+        on_signal(beast::buffers_to_string(m_buffer.data()));
     }
     else {
-        LOG_WARN("no friend");
-        send("no friend");
+        on_binary(static_cast<const char *>(m_buffer.data().data()), m_buffer.size());
     }
+    m_buffer.consume(bytes);
     do_read();
-}
\ No newline at end of file
+}
+
+void WsSession::on_binary(const char *data, std::size_t size)
+{
+    // 转发时延从读完这一帧算起, 到对端写完为止
+    uint64_t ingress_us = steady_us();
+    FrameHeader hdr;
+    if (!m_framed) {
+        // 旧连接的裸 Opus 包: 补上帧头, 按收到的顺序编号
+        hdr.seq = m_recv_seq++;
+        WsSessionMgr::getInstance()->forward_media(m_type, m_id, make_frame(hdr, data, size), ingress_us);
+        return;
+    }
+    if (!parse_frame_header(data, size, hdr)) {
+        LOG_WARN("invalid frame header from {}, {} bytes", m_id, size);
+        return;
+    }
+    if (hdr.type == kFrameControl) {
+        on_signal(std::string(data + kFrameHeaderSize, size - kFrameHeaderSize), m_type == kRobot ? hdr.stream : -1);
+        return;
+    }
+    if (hdr.capture_us != 0) {
+        m_latency.on_received(hdr.capture_us);
+    }
+    // 媒体帧转给对端, 没有对端时丢弃
+    WsSessionMgr::getInstance()->forward_media(m_type, m_id, std::string(data, size), ingress_us);
+}
+
+void WsSession::on_signal(const std::string &msg, int stream)
+{
+    TRACE_SCOPE("on_signal");
+#ifdef LAUDIO_FAST_JSON
+    // 只转发的信令不建 Json::Value, 在原文上取类型和通道号; 判断不了的 (或 WebRTC 会话) 走 jsoncpp
+    if (!is_webrtc()) {
+        JsonView view;
+        SignalType type;
+        if (view.parse(msg) && parse_signal(view, type) && is_relayed_signal(type)) {
+            int channel = m_type == kRobot ? (stream >= 0 ? stream : signal_channel(view)) : -1;
+            relay_signal(type, channel, msg, nullptr, &view);
+            return;
+        }
+    }
+#endif
+    Json::Value root;
+    SignalType type = parse_signal(msg, root);
+#ifdef LAUDIO_WEBRTC
+    // WebRTC 会话的协商对端是服务器自己, 不转发
+    if (m_webrtc && m_webrtc->on_signal(type, root)) {
+        return;
+    }
+#endif
+    if (!is_relayed_signal(type)) {
+        LOG_WARN("invalid signal from {}: {}", m_id, msg);
+        send(make_error_signal("invalid signal"));
+        return;
+    }
+    // 多路复用的 robot 用 "channel" 字段 (或控制帧的 stream) 指明是哪一路
+    int channel = m_type == kRobot ? (stream >= 0 ? stream : signal_channel(root)) : -1;
+    relay_signal(type, channel, msg, &root, nullptr);
+}
+
+void WsSession::relay_signal(SignalType type,
+                             int channel,
+                             const std::string &msg,
+                             const Json::Value *root,
+                             const JsonView *view)
+{
+    LOG_INFO("signal {} from {}", signal_type_name(type), m_id);
+    auto peer = WsSessionMgr::getInstance()->get_peer(m_type, m_id, channel);
+    if (!peer.session) {
+        LOG_WARN("no friend");
+        send(make_error_signal("no peer"));
+        return;
+    }
+    // 原文转发; 发往多路复用 robot 的要补上通道号
+    if (peer.channel >= 0 && m_type == kVoip) {
+        peer.session->send(view ? make_channel_signal(*view, peer.channel) : make_channel_signal(*root, peer.channel));
+    }
+    else {
+        peer.session->send(msg);
+    }
+}
+
+void WsSession::send_http(http::status status, const std::string &content_type, std::string body, uint32_t retry_after_s)
+{
+    auto res = std::make_shared<http::response<http::string_body>>(status, m_req.version());
+    res->set(http::field::content_type, content_type);
+    if (retry_after_s != 0) {
+        res->set(http::field::retry_after, std::to_string(retry_after_s));
+    }
+    res->keep_alive(false);
+    res->body() = std::move(body);
+    res->prepare_payload();
+    http::async_write(m_stream.next_layer(), *res, [self = shared_from_this(), res](beast::error_code, std::size_t) {
+        beast::error_code ec;
+        beast::get_lowest_layer(self->m_stream).socket().shutdown(tcp::socket::shutdown_both, ec);
+    });
+}
+
+bool WsSession::admin_allowed()
+{
+    beast::error_code ec;
+    auto remote = beast::get_lowest_layer(m_stream).socket().remote_endpoint(ec);
+    if (!ec && remote.address().is_loopback()) {
+        return true;
+    }
+    if (!m_admin_token || m_admin_token->empty()) {
+        return false;
+    }
+    auto auth = m_req[http::field::authorization];
+    std::string expected = "Bearer " + *m_admin_token;
+    // 定长比较, 不从耗时里泄露令牌
+    return auth.size() == expected.size() && CRYPTO_memcmp(auth.data(), expected.data(), expected.size()) == 0;
+}
+
+void WsSession::send_media(const std::string &frame, uint64_t ingress_us)
+{
+    FrameHeader hdr;
+    if (!parse_frame_header(frame.data(), frame.size(), hdr)) {
+        return;
+    }
+    if (!is_webrtc()) {
+        WriteItem item;
+        // 不带帧头的连接只发 Opus 包
+        item.msg = m_framed ? frame : frame.substr(kFrameHeaderSize);
+        item.binary = true;
+        item.ingress_us = ingress_us;
+        item.capture_us = hdr.capture_us;
+        net::post(m_stream.get_executor(), [self = shared_from_this(), item = std::move(item)]() mutable {
+            self->push_write(std::move(item));
+        });
+        return;
+    }
+#ifdef LAUDIO_WEBRTC
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(frame.data()) + kFrameHeaderSize;
+    std::size_t size = frame.size() - kFrameHeaderSize;
+    int samples = opus_packet_get_nb_samples(data, static_cast<opus_int32>(size), 48000);
+    m_webrtc->send_audio(data, size, samples > 0 ? static_cast<uint32_t>(samples) : 960);
+    m_latency.on_sent(ingress_us, hdr.capture_us);
+#endif
+}
+
+void WsSession::send_media_ref(const uint8_t *data, std::size_t size, std::shared_ptr<const void> owner)
+{
+#ifdef LAUDIO_WEBRTC
+    if (m_webrtc) {
+        int samples = opus_packet_get_nb_samples(data, static_cast<opus_int32>(size), 48000);
+        m_webrtc->send_audio(data, size, samples > 0 ? static_cast<uint32_t>(samples) : 960);
+        return;
+    }
+#endif
+    WriteItem item;
+    item.binary = true;
+    item.ref = data;
+    item.ref_size = size;
+    item.owner = std::move(owner);
+    net::post(m_stream.get_executor(), [self = shared_from_this(), item = std::move(item)]() mutable {
+        if (self->m_framed) {
+            FrameHeader hdr;
+            hdr.seq = self->m_send_seq++;
+            write_frame_header(hdr, item.header);
+            item.header_size = kFrameHeaderSize;
+        }
+        self->push_write(std::move(item));
+    });
+}
+
+#ifdef LAUDIO_WEBRTC
+void WsSession::start_webrtc()
+{
+    std::weak_ptr<WsSession> weak = shared_from_this();
+    m_webrtc = WebRtcIngress::create(
+        *m_webrtc_cfg,
+        [weak](const std::string &msg) {
+            auto self = weak.lock();
+            if (self) {
+                self->send(msg);
+            }
+        },
+        [weak](const uint8_t *data, std::size_t size) {
+            // 和 /voip 的二进制帧一样转给配对的 robot
+            auto self = weak.lock();
+            if (self) {
+                FrameHeader hdr;
+                hdr.seq = self->m_recv_seq++;
+                WsSessionMgr::getInstance()->forward_media(self->m_type,
+                                                           self->m_id,
+                                                           make_frame(hdr, reinterpret_cast<const char *>(data), size),
+                                                           steady_us());
+            }
+        });
+}
+#endif
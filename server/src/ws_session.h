@@ -2,11 +2,25 @@
 #define _WS_SESSION_H_
 
 #include "types.h"
+#include "session.h"
+#include "frame_header.h"
 #include "logger.h"
+#include "tls_stream.h"
+#ifdef LAUDIO_WEBRTC
+#include "webrtc_ingress.h"
+#endif
+#include "ws_session_mgr.h"
+#include "signal_message.h"
+#include "latency_histogram.h"
+#include "admission_control.h"
+#include "trace.h"
 #include <boost/beast.hpp>
 #include <boost/asio.hpp>
 #include <json/json.h>
+#include <array>
+#include <chrono>
 #include <queue>
+#include <cstdlib>
 #include <memory>
 #include <functional>
 
@@ -17,6 +31,7 @@ namespace net = boost::asio;
 using tcp = net::ip::tcp;
 
 class WsSession :
+    public Session,
     public std::enable_shared_from_this<WsSession>
 {
 public:
@@ -34,62 +49,185 @@ public:
     // using Status = Status;
 
 private:
-    websocket::stream<beast::tcp_stream> m_stream;
+    // TLS 握手 + 读 HTTP 请求 + 升级的总期限
+    static constexpr std::chrono::seconds kHandshakeTimeout {10};
+
+    // 写队列的一项: 自己持有的 msg, 或引用别人的内存 (ref 非空, owner 保证发完前有效), 前面可以带帧头
+    struct WriteItem {
+        std::string msg;
+        bool binary = false;
+        char header[kFrameHeaderSize];
+        std::size_t header_size = 0;
+        const uint8_t *ref = nullptr;
+        std::size_t ref_size = 0;
+        std::shared_ptr<const void> owner;
+        uint64_t ingress_us = 0; // 转发的媒体帧: 服务器收完的时刻, 写完后记时延
+        uint64_t capture_us = 0; // 帧头里客户端的采集时刻
+    };
+
+    websocket::stream<TlsStream> m_stream;
     beast::flat_buffer m_buffer;
     http::request<http::string_body> m_req;
-    std::queue<std::string> m_write_que;
+    std::queue<WriteItem> m_write_que;
     std::function<void(WsSessionType, const std::string &)> m_on_ready;
     WsSessionType m_type;
     std::string m_id;
+    uint32_t m_capacity = 0;                                    // robot 声明的并发路数, 0 为旧的单路连接
+    bool m_framed = false;                                      // 二进制帧带帧头 (frame_header.h)
+    uint32_t m_recv_seq = 0;                                    // 给不带帧头的上行帧编号
+    uint32_t m_send_seq = 0;                                    // 给服务器自己下发的帧 (提示音) 编号
+#ifdef LAUDIO_WEBRTC
+    std::shared_ptr<const WebRtcIngress::Config> m_webrtc_cfg; // 为空时不接受 WebRTC 呼叫
+    WebRtcIngress::Sptr m_webrtc;                               // media=webrtc 的 voip 会话才有
+#endif
+    SessionLatency m_latency;                                   // 发给这个会话的帧的转发时延
+    AdmissionTicket m_ticket;                                   // 握手完成前占着握手中的连接数
+    net::steady_timer m_deadline;                               // 握手期限, 升级完成后取消
+    uint32_t m_reject_after_s = 0;                              // 非 0 时读完请求头回 503, 不升级
+    std::shared_ptr<const std::string> m_admin_token;           // 为空时 /admin/ 只允许本机访问
 
 public:
-    explicit WsSession(tcp::socket &&socket) :
-        m_stream(std::move(socket))
+#ifdef LAUDIO_WEBRTC
+    explicit WsSession(tcp::socket &&socket,
+                       const TlsContext::Sptr &tls = nullptr,
+                       std::shared_ptr<const WebRtcIngress::Config> webrtc_cfg = nullptr) :
+        m_stream(std::move(socket)),
+        m_webrtc_cfg(std::move(webrtc_cfg)),
+        m_deadline(m_stream.get_executor())
+#else
+    explicit WsSession(tcp::socket &&socket,
+                       const TlsContext::Sptr &tls = nullptr) :
+        m_stream(std::move(socket)),
+        m_deadline(m_stream.get_executor())
+#endif
     {
+        if (tls && !m_stream.next_layer().set_tls(*tls)) {
+            LOG_ERROR("set_tls");
+        }
     }
     ~WsSession()
     {
+#ifdef LAUDIO_WEBRTC
+        if (m_webrtc) {
+            m_webrtc->close();
+        }
+#endif
+        std::string latency = m_latency.summary();
+        if (!latency.empty()) {
+            LOG_INFO("session {} latency: {}", m_id, latency);
+        }
     }
 
     void run()
     {
-        beast::get_lowest_layer(m_stream).expires_never();
-        http::async_read(m_stream.next_layer(),
-                         m_buffer, m_req,
-                         beast::bind_front_handler(&WsSession::on_read_http,
-                                                   shared_from_this()));
+        start_deadline();
+        if (m_stream.next_layer().is_tls()) {
+            m_stream.next_layer().async_handshake(
+                beast::bind_front_handler(&WsSession::on_handshake,
+                                          shared_from_this()));
+            return;
+        }
+        do_read_http();
     }
 
-    void send(const std::string &msg)
+    // 文本帧是信令, 二进制帧是媒体
+    void send(const std::string &msg, bool binary = false) override
     {
         net::post(m_stream.get_executor(),
-                  [self = shared_from_this(), msg]() {
-                      bool write_processing = !self->m_write_que.empty();
-                      self->m_write_que.push(std::move(msg));
-                      if (!write_processing) {
-                          self->do_write();
-                      }
+                  [self = shared_from_this(), msg, binary]() mutable {
+                      WriteItem item;
+                      item.msg = std::move(msg);
+                      item.binary = binary;
+                      self->push_write(std::move(item));
                   });
     }
 
-    WsSessionType getType() const
+    // 对端转来的媒体帧: WebRTC 会话打成 RTP 发给浏览器, 其余走 WebSocket 二进制帧
+    void send_media(const std::string &frame, uint64_t ingress_us = 0) override;
+    // 非 WebRTC 会话的写队列直接引用 data, 不拷贝
+    void send_media_ref(const uint8_t *data, std::size_t size, std::shared_ptr<const void> owner) override;
+
+    std::string latency_summary() const override
+    {
+        return m_latency.summary();
+    }
+
+    WsSessionType getType() const override
     {
         return m_type;
     }
 
-    std::string getId() const
+    std::string getId() const override
     {
         return m_id;
     }
 
+    uint32_t getCapacity() const
+    {
+        return m_capacity;
+    }
+
     void set_on_ready(std::function<void(WsSessionType, const WsSessionId &)> &&func)
     {
         m_on_ready = func;
     }
 
+    // 非本机访问 /admin/ 时要带的令牌, 为空时只允许本机
+    void set_admin_token(std::shared_ptr<const std::string> token)
+    {
+        m_admin_token = std::move(token);
+    }
+
+    // accept 时的接入结果: reject_after_s 为 0 表示放行, ticket 在握手完成时释放
+    void set_admission(AdmissionTicket &&ticket, uint32_t reject_after_s)
+    {
+        m_ticket = std::move(ticket);
+        m_reject_after_s = reject_after_s;
+    }
+
 private:
+    // TLS 握手等可读写用的是 socket().async_wait, 不受 tcp_stream 的超时控制, 所以单独起一个定时器:
+    // 到期时释放握手名额并关掉 socket, 挂起的握手 / 读请求以 operation_aborted 结束;
+    // 只持有弱引用, 不延长只回了 HTTP 响应的连接的寿命
+    void start_deadline()
+    {
+        m_deadline.expires_after(kHandshakeTimeout);
+        m_deadline.async_wait([weak = std::weak_ptr<WsSession>(shared_from_this())](beast::error_code ec) {
+            auto self = weak.lock();
+            if (ec || !self) {
+                return;
+            }
+            LOG_ERROR("handshake timeout");
+            self->m_ticket.release();
+            beast::error_code close_ec;
+            beast::get_lowest_layer(self->m_stream).socket().close(close_ec);
+        });
+    }
+
+    void on_handshake(beast::error_code ec)
+    {
+        TRACE_SCOPE("on_handshake");
+        if (ec) {
+            LOG_ERROR("on_handshake: {}", ec.message());
+            return;
+        }
+        LOG_INFO("tls handshake done, ktls send: {}, recv: {}",
+                 m_stream.next_layer().is_ktls_send(),
+                 m_stream.next_layer().is_ktls_recv());
+        do_read_http();
+    }
+
+    void do_read_http()
+    {
+        http::async_read(m_stream.next_layer(),
+                         m_buffer, m_req,
+                         beast::bind_front_handler(&WsSession::on_read_http,
+                                                   shared_from_this()));
+    }
+
     void on_read_http(beast::error_code ec, std::size_t)
     {
+        TRACE_SCOPE("on_read_http");
         if (ec) {
             LOG_ERROR("on_read_http: {}", ec.what());
             return;
@@ -97,6 +235,36 @@ private:
 
         // /<type>?id=
         std::string target = m_req.target();
+        // 普通 HTTP 请求, 不升级 WebSocket
+        if (target == "/metrics") {
+            send_http(http::status::ok, "text/plain; version=0.0.4", WsSessionMgr::getInstance()->metrics());
+            return;
+        }
+        // 管理接口只给本机, 或带 Authorization: Bearer <LAUDIO_ADMIN_TOKEN> 的请求
+        if (target.rfind("/admin/", 0) == 0 && !admin_allowed()) {
+            send_http(http::status::forbidden, "text/plain", "forbidden\n");
+            return;
+        }
+        // /admin/sessions?after=&after_type=&limit=&type=voip|robot&latency=1, 读的是快照, 不碰会话表的锁
+        if (target.rfind("/admin/sessions", 0) == 0) {
+            std::string limit = get_query_param(target, "limit");
+            auto snapshot = WsSessionMgr::getInstance()->snapshot();
+            // 游标的类型缺省为 robot: 同名的两条都跳过, 不会重复
+            WsSessionType after_type = get_query_param(target, "after_type") == "voip" ? kVoip : kRobot;
+            send_http(http::status::ok,
+                      "application/json",
+                      snapshot->page(get_query_param(target, "after"),
+                                     after_type,
+                                     limit.empty() ? RegistrySnapshot::kDefaultPage : std::strtoul(limit.c_str(), nullptr, 10),
+                                     get_query_param(target, "type"),
+                                     get_query_param(target, "latency") == "1"));
+            return;
+        }
+        // 过载: 在升级之前回 503, 上面的 /metrics 和 /admin 仍然可以访问
+        if (m_reject_after_s != 0) {
+            send_http(http::status::service_unavailable, "text/plain", "overloaded\n", m_reject_after_s);
+            return;
+        }
         if (target.rfind("/voip", 0) == 0) {
             m_type = kVoip;
         }
@@ -105,16 +273,42 @@ private:
         }
         else {
             LOG_ERROR("rfind");
-            m_stream.next_layer().socket().shutdown(tcp::socket::shutdown_both);
+            beast::get_lowest_layer(m_stream).socket().shutdown(tcp::socket::shutdown_both);
             return;
         }
 
-        std::string id;
-        auto pos = target.find("id=");
-        if (pos != std::string::npos) {
-            id = target.substr(pos + 3);
+        // robot 集群重启时的重连按令牌桶放行, 其余的约好时间再来
+        if (m_type == kRobot) {
+            uint32_t retry_after_s = AdmissionControl::getInstance()->admit_robot();
+            if (retry_after_s != 0) {
+                send_http(http::status::service_unavailable, "text/plain", "robot reconnect deferred\n", retry_after_s);
+                return;
+            }
+        }
+
+        m_id = get_query_param(target, "id");
+        // /robot?id=&capacity=N: 一条连接服务 N 路呼叫, 二进制帧都带帧头, stream 为通道号
+        if (m_type == kRobot) {
+            m_capacity = static_cast<uint32_t>(std::strtoul(get_query_param(target, "capacity").c_str(), nullptr, 10));
+        }
+        // framing=1: 二进制帧带帧头, 可以在二进制帧里发信令; 多路复用的 robot 必须带
+        m_framed = m_capacity > 0 || get_query_param(target, "framing") == "1";
+        if (get_query_param(target, "media") == "webrtc") {
+#ifdef LAUDIO_WEBRTC
+            bool accepted = m_type == kVoip && m_webrtc_cfg;
+#else
+            bool accepted = false; // 编译时没有打开 LAUDIO_WEBRTC
+#endif
+            if (!accepted) {
+                LOG_ERROR("webrtc media not accepted: {}", target);
+                beast::error_code ec;
+                beast::get_lowest_layer(m_stream).socket().shutdown(tcp::socket::shutdown_both, ec);
+                return;
+            }
+#ifdef LAUDIO_WEBRTC
+            start_webrtc();
+#endif
         }
-        m_id = id;
 
         m_stream.async_accept(m_req,
                               beast::bind_front_handler(&WsSession::on_accept,
@@ -123,12 +317,20 @@ private:
 
     void on_accept(beast::error_code ec)
     {
+        TRACE_SCOPE("on_accept");
         if (ec) {
             LOG_ERROR("on_accept");
             return;
         }
-        if (m_on_ready) {
-            m_on_ready(m_type, m_id);
+        m_deadline.cancel();
+        m_ticket.release();
+        // 升级完成后才取消超时, 之后的读写没有期限 (呼叫可以长时间静默)
+        beast::get_lowest_layer(m_stream).expires_never();
+        // 回调只用一次, 用完就释放: WsServer 的回调持有这个会话的 shared_ptr, 留着会让会话永远不析构
+        auto on_ready = std::move(m_on_ready);
+        m_on_ready = nullptr;
+        if (on_ready) {
+            on_ready(m_type, m_id);
         }
         do_read();
     }
@@ -141,6 +343,43 @@ private:
     }
 
     void on_read_ws(beast::error_code ec, std::size_t bytes);
+    void on_binary(const char *data, std::size_t size);
+    // stream 为二进制控制帧帧头里的通道号, 文本帧为 -1 (通道号取 JSON 的 "channel" 字段)
+    void on_signal(const std::string &msg, int stream = -1);
+    // 解析好的信令转给配对的一端; root / view 二选一, 给多路复用 robot 补通道号时用
+    void relay_signal(SignalType type, int channel, const std::string &msg, const Json::Value *root, const JsonView *view);
+    // 回一个 HTTP 响应后关闭连接; retry_after_s 非 0 时带 Retry-After
+    void send_http(http::status status, const std::string &content_type, std::string body, uint32_t retry_after_s = 0);
+#ifdef LAUDIO_WEBRTC
+    void start_webrtc();
+#endif
+    // 音频走 WebRTC 的 voip 会话
+    bool is_webrtc() const
+    {
+#ifdef LAUDIO_WEBRTC
+        return m_webrtc != nullptr;
+#else
+        return false;
+#endif
+    }
+    bool admin_allowed();
+
+    // ?a=1&b=2 里取 key 对应的值, 没有时返回空串
+    static std::string get_query_param(const std::string &target, const std::string &key)
+    {
+        std::size_t pos = target.find('?');
+        while (pos != std::string::npos) {
+            std::size_t begin = pos + 1;
+            std::size_t end = target.find('&', begin);
+            std::size_t eq = target.find('=', begin);
+            if (eq != std::string::npos && (end == std::string::npos || eq < end)
+                && target.compare(begin, eq - begin, key) == 0) {
+                return target.substr(eq + 1, end == std::string::npos ? std::string::npos : end - eq - 1);
+            }
+            pos = end;
+        }
+        return std::string();
+    }
 
     // void on_read_ws(beast::error_code ec, std::size_t bytes)
     // {
@@ -158,14 +397,33 @@ private:
     //     do_read();
     // }
 
+    void push_write(WriteItem &&item)
+    {
+        bool write_processing = !m_write_que.empty();
+        m_write_que.push(std::move(item));
+        if (!write_processing) {
+            do_write();
+        }
+    }
+
     void do_write()
     {
-        m_stream.text(true);
-        m_stream.async_write(net::buffer(m_write_que.front()),
+        const WriteItem &item = m_write_que.front();
+        std::array<net::const_buffer, 2> buffers {
+            net::buffer(item.header, item.header_size),
+            item.ref ? net::buffer(item.ref, item.ref_size) : net::buffer(item.msg),
+        };
+        m_stream.binary(item.binary);
+        m_stream.async_write(buffers,
                              [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                                 TRACE_SCOPE("on_write");
                                  if (ec) {
                                      return;
                                  }
+                                 const WriteItem &done = self->m_write_que.front();
+                                 if (done.ingress_us != 0 || done.capture_us != 0) {
+                                     self->m_latency.on_sent(done.ingress_us, done.capture_us);
+                                 }
                                  self->m_write_que.pop();
                                  if (!self->m_write_que.empty()) {
                                      self->do_write();
@@ -1,9 +1,21 @@
 #include "ws_session_mgr.h"
 #include "logger.h"
+#include "signal_message.h"
+#include "frame_header.h"
+#include "prompt_cache.h"
+#include "latency_histogram.h"
+#include "admission_control.h"
+#include "tls_stream.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <string>
 
-bool WsSessionMgr::join_session(WsSessionType type, const WsSessionId &id, WsSession::Sptr ptr)
+bool WsSessionMgr::join_session(WsSessionType type, const WsSessionId &id, Session::Sptr ptr, uint32_t capacity)
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
+    TRACE_LOCK(lock, s_mtx, "s_mtx");
     if (s_voip_session.find(id) != s_voip_session.end() || s_robot_session.find(id) != s_robot_session.end()) {
         return false;
     }
@@ -11,12 +23,10 @@ bool WsSessionMgr::join_session(WsSessionType type, const WsSessionId &id, WsSes
     switch (type) {
         case kVoip: {
             res = join_voip_session(id, ptr);
-            update_voip_session_status(id, kFree);
             break;
         }
         case kRobot: {
-            res = join_robot_session(id, ptr);
-            update_robot_session_status(id, kFree);
+            res = join_robot_session(id, ptr, capacity);
             break;
         }
         default: {
@@ -29,10 +39,7 @@ bool WsSessionMgr::join_session(WsSessionType type, const WsSessionId &id, WsSes
 
 bool WsSessionMgr::leave_session(WsSessionType type, const WsSessionId &id)
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
-    if (s_voip_session.find(id) == s_voip_session.end() && s_robot_session.find(id) == s_robot_session.end()) {
-        return false;
-    }
+    TRACE_LOCK(lock, s_mtx, "s_mtx");
     bool res;
     switch (type) {
         case kVoip: {
@@ -51,257 +58,491 @@ bool WsSessionMgr::leave_session(WsSessionType type, const WsSessionId &id)
     return res;
 }
 
-WsSession::Sptr WsSessionMgr::get_friend_session(WsSessionType owner_type, const WsSessionId &id)
+WsSessionMgr::Peer WsSessionMgr::get_peer(WsSessionType owner_type, const WsSessionId &id, int channel)
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
-    if (s_voip2robot.find(id) == s_voip2robot.end() && s_robot2voip.find(id) == s_robot2voip.end()) {
-        return nullptr;
-    }
-    WsSession::Sptr friend_ptr;
+    TRACE_LOCK(lock, s_mtx, "s_mtx");
+    Peer peer;
     switch (owner_type) {
         case kVoip: {
-            friend_ptr = get_voip_friend_session(id);
+            peer = get_voip_peer(id);
             break;
         }
         case kRobot: {
-            friend_ptr = get_robot_friend_session(id);
+            peer = get_robot_peer(id, channel);
             break;
         }
         default: {
-            friend_ptr = nullptr;
             break;
         }
     }
-    return friend_ptr;
+    return peer;
+}
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
 }
 
-bool WsSessionMgr::match_session(WsSessionType owner_type, const WsSessionId &id)
+bool WsSessionMgr::forward_media(WsSessionType owner_type, const WsSessionId &id, std::string frame, uint64_t ingress_us)
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
-    if (s_voip_session.find(id) == s_voip_session.end() && s_robot_session.find(id) == s_robot_session.end()) {
+    FrameHeader hdr;
+    if (!parse_frame_header(frame.data(), frame.size(), hdr)) {
         return false;
     }
-    bool res;
-    switch (owner_type) {
-        case kVoip: {
-            res = match_robot_session(id);
-            break;
+    if (owner_type == kVoip) {
+        Peer peer;
+        {
+            TRACE_LOCK(lock, s_mtx, "s_mtx");
+            peer = get_voip_peer(id);
+            if (!peer.session) {
+                // 还在等 robot: 留进 pre-roll, 配对时一起发出
+                auto it = s_voip_session.find(id);
+                if (it != s_voip_session.end() && it->second.waiting && !it->second.preroll.push(frame)) {
+                    ++s_preroll_dropped;
+                }
+                return false;
+            }
         }
-        case kRobot: {
-            res = match_voip_session(id);
-            break;
+        // 帧头原地改成 robot 上这一路的通道号
+        set_frame_stream(frame, peer.channel >= 0 ? static_cast<uint16_t>(peer.channel) : 0);
+        peer.session->send_media(frame, ingress_us);
+        return true;
+    }
+    Peer peer = get_peer(kRobot, id, hdr.stream);
+    if (!peer.session) {
+        return false;
+    }
+    set_frame_stream(frame, 0);
+    peer.session->send_media(frame, ingress_us);
+    return true;
+}
+
+void WsSessionMgr::set_affinity(double epsilon)
+{
+    TRACE_LOCK(lock, s_mtx, "s_mtx");
+    s_affinity_epsilon = epsilon;
+}
+
+std::string WsSessionMgr::metrics()
+{
+    std::vector<uint64_t> waits;
+    std::string out;
+    {
+        TRACE_LOCK(lock, s_mtx, "s_mtx");
+        waits = s_wait_us;
+        out += "# TYPE laudio_voip_sessions gauge\n";
+        out += "laudio_voip_sessions " + std::to_string(s_voip_session.size()) + "\n";
+        out += "# TYPE laudio_robot_sessions gauge\n";
+        out += "laudio_robot_sessions " + std::to_string(s_robot_session.size()) + "\n";
+        out += "# TYPE laudio_robot_load gauge\n";
+        out += "laudio_robot_load " + std::to_string(s_total_load) + "\n";
+        out += "# TYPE laudio_robot_capacity gauge\n";
+        out += "laudio_robot_capacity " + std::to_string(s_total_capacity) + "\n";
+        out += "# TYPE laudio_waiting_voip gauge\n";
+        out += "laudio_waiting_voip " + std::to_string(s_waiting_voip.size()) + "\n";
+        out += "# TYPE laudio_preroll_frames_flushed_total counter\n";
+        out += "laudio_preroll_frames_flushed_total " + std::to_string(s_preroll_flushed) + "\n";
+        out += "# TYPE laudio_preroll_frames_dropped_total counter\n";
+        out += "laudio_preroll_frames_dropped_total " + std::to_string(s_preroll_dropped) + "\n";
+        out += "# TYPE laudio_wait_seconds summary\n";
+        out += "laudio_wait_seconds_count " + std::to_string(s_wait_count) + "\n";
+    }
+    // 分位数在锁外排序
+    std::sort(waits.begin(), waits.end());
+    for (double q : {0.5, 0.9, 0.99, 1.0}) {
+        double v = 0;
+        if (!waits.empty()) {
+            std::size_t idx = std::min(waits.size() - 1, static_cast<std::size_t>(q * waits.size()));
+            v = waits[idx] / 1e6;
         }
-        default: {
-            res = false;
-            break;
+        char line[96];
+        snprintf(line, sizeof(line), "laudio_wait_seconds{quantile=\"%g\"} %.6f\n", q, v);
+        out += line;
+    }
+    out += RelayLatency::getInstance()->metrics();
+    out += AdmissionControl::getInstance()->metrics();
+    out += TlsStream::metrics();
+    // 提示音映射只有一份, 和播放路数无关
+    out += "# TYPE laudio_prompt_playbacks gauge\n";
+    out += "laudio_prompt_playbacks " + std::to_string(PromptPlayer::getInstance()->playing()) + "\n";
+    out += "# TYPE laudio_prompt_mapped_bytes gauge\n";
+    out += "laudio_prompt_mapped_bytes " + std::to_string(PromptCache::getInstance()->mapped_bytes()) + "\n";
+    return out;
+}
+
+void WsSessionMgr::publish_snapshot()
+{
+    std::lock_guard<std::mutex> publish_lock(s_publish_mtx);
+    std::vector<SessionRecord> changes;
+    {
+        // 锁内只取有变更的会话, 和会话总数无关
+        TRACE_LOCK(lock, s_mtx, "s_mtx");
+        if (s_dirty_voip.empty() && s_dirty_robot.empty()) {
+            return;
         }
+        changes.reserve(s_dirty_voip.size() + s_dirty_robot.size());
+        for (const auto &id : s_dirty_voip) {
+            changes.push_back(make_record(kVoip, id));
+        }
+        for (const auto &id : s_dirty_robot) {
+            changes.push_back(make_record(kRobot, id));
+        }
+        s_dirty_voip.clear();
+        s_dirty_robot.clear();
     }
-    return res;
+    RegistrySnapshot::Sptr next = RegistrySnapshot::apply(std::atomic_load(&s_snapshot), std::move(changes));
+    std::atomic_store(&s_snapshot, std::move(next));
+}
+
+RegistrySnapshot::Sptr WsSessionMgr::snapshot() const
+{
+    return std::atomic_load(&s_snapshot);
 }
 
 void WsSessionMgr::printSession()
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
+    RegistrySnapshot::Sptr snap = snapshot();
     LOG_INFO("--------------------------->");
-    LOG_INFO("=== All Session ===");
-    LOG_INFO(">>> voip session");
-    for (const auto &[k, v] : s_voip_session) {
-        LOG_INFO(" * id: {}, type: {}", k, (int)v->getType());
-    }
-    LOG_INFO(">>> robot session");
-    for (const auto &[k, v] : s_robot_session) {
-        LOG_INFO(" * id: {}, type: {}", k, (int)v->getType());
-    }
+    LOG_INFO("=== All Session (epoch {}) ===", snap->epoch());
+    LOG_INFO(">>> voip session: {}", snap->voip_count());
+    snap->for_each([](const SessionRecord &record) {
+        if (record.type == kVoip) {
+            LOG_INFO(" * id: {}, type: {}", record.id, (int)record.type);
+        }
+        return true;
+    });
+    LOG_INFO(">>> robot session: {}", snap->robot_count());
+    snap->for_each([](const SessionRecord &record) {
+        if (record.type == kRobot) {
+            LOG_INFO(" * id: {}, type: {}, load: {}/{}", record.id, (int)record.type, record.load, record.capacity);
+        }
+        return true;
+    });
     LOG_INFO("<---------------------------");
 }
 
 void WsSessionMgr::printFriend()
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
+    RegistrySnapshot::Sptr snap = snapshot();
     LOG_INFO("--------------------------->");
-    LOG_INFO("=== Friend Session ===");
-    LOG_INFO(">>> robot2voip friend session");
-    for (const auto &[k, v] : s_robot2voip) {
-        LOG_INFO(" <{}: {}>", k, v);
-    }
-    LOG_INFO(">>> voip2robot friend session");
-    for (const auto &[k, v] : s_voip2robot) {
-        LOG_INFO(" <{}: {}>", k, v);
-    }
+    LOG_INFO("=== Friend Session (epoch {}) ===", snap->epoch());
+    LOG_INFO(">>> voip -> robot channel");
+    snap->for_each([](const SessionRecord &record) {
+        if (record.type == kVoip && !record.robot_id.empty()) {
+            LOG_INFO(" <{}: {}#{}>", record.id, record.robot_id, record.channel);
+        }
+        return true;
+    });
+    LOG_INFO(">>> waiting voip: {}", snap->waiting_count());
+    snap->for_each([](const SessionRecord &record) {
+        if (record.waiting) {
+            LOG_INFO(" <{}>", record.id);
+        }
+        return true;
+    });
     LOG_INFO("<---------------------------");
 }
 
-bool WsSessionMgr::join_voip_session(const WsSessionId &id, WsSession::Sptr ptr)
+bool WsSessionMgr::join_voip_session(const WsSessionId &id, Session::Sptr ptr)
 {
-    if (s_voip_session.find(id) != s_voip_session.end()) {
-        return false;
+    VoipEntry &voip = s_voip_session[id];
+    voip.session = ptr;
+    mark_dirty(kVoip, id);
+    // 队列不空说明没有空闲通道, 直接排到队尾
+    bool queued = !s_waiting_voip.empty();
+    if (queued || !match_robot_session(id)) {
+        push_waiting(id, voip, s_waiting_voip.end(), false);
     }
-    s_voip_session[id] = ptr;
-    match_robot_session(id);
     return true;
 }
 
-bool WsSessionMgr::join_robot_session(const WsSessionId &id, WsSession::Sptr ptr)
+bool WsSessionMgr::join_robot_session(const WsSessionId &id, Session::Sptr ptr, uint32_t capacity)
 {
-    if (s_robot_session.find(id) != s_robot_session.end()) {
-        return false;
-    }
-    s_robot_session[id] = ptr;
-    match_voip_session(id);
+    std::unique_ptr<RobotEntry> robot(new RobotEntry);
+    robot->id = id;
+    robot->session = ptr;
+    robot->tagged = capacity > 0;
+    robot->capacity = capacity == 0 ? 1 : std::min(capacity, kMaxRobotCapacity);
+    robot->load = 0;
+    robot->heap_index = 0;
+    robot->channels.resize(robot->capacity);
+    // 倒序压栈, 先分出去的是小通道号
+    for (uint32_t ch = robot->capacity; ch > 0; --ch) {
+        robot->free_channels.push_back(static_cast<uint16_t>(ch - 1));
+    }
+    RobotEntry *entry = robot.get();
+    s_robot_session[id] = std::move(robot);
+    s_robot_heap.push(entry);
+    s_robot_ring.add(id, entry->capacity);
+    s_total_capacity += entry->capacity;
+    mark_dirty(kRobot, id);
+    fill_robot_session(entry);
     return true;
 }
 
 bool WsSessionMgr::leave_voip_session(const WsSessionId &id)
 {
-    if (s_voip_session.find(id) == s_voip_session.end()) {
+    auto it = s_voip_session.find(id);
+    if (it == s_voip_session.end()) {
         return false;
     }
-    WsSessionId robot_id {};
-    s_voip_session.erase(id);
-    if (s_voip2robot.find(id) != s_voip2robot.end()) {
-        robot_id = s_voip2robot.at(id);
-        s_voip2robot.erase(id);
+    VoipEntry voip = std::move(it->second);
+    s_voip_session.erase(it);
+    mark_dirty(kVoip, id);
+    pop_waiting(voip);
+    if (voip.robot_id.empty()) {
+        return true;
     }
-    if (s_robot2voip.find(robot_id) != s_robot2voip.end()) {
-        s_robot2voip.erase(robot_id);
-        update_robot_session_status(robot_id, kFree);
+    auto robot_it = s_robot_session.find(voip.robot_id);
+    if (robot_it != s_robot_session.end()) {
+        RobotEntry *robot = robot_it->second.get();
+        robot->session->send(make_bye_signal(id, robot->tagged ? voip.channel : -1));
+        release_channel(robot, voip.channel);
+        fill_robot_session(robot);
     }
     return true;
 }
 
 bool WsSessionMgr::leave_robot_session(const WsSessionId &id)
 {
-    if (s_robot_session.find(id) == s_robot_session.end()) {
+    auto it = s_robot_session.find(id);
+    if (it == s_robot_session.end()) {
         return false;
     }
-    WsSessionId voip_id {};
-    s_robot_session.erase(id);
-    if (s_robot2voip.find(id) != s_robot2voip.end()) {
-        voip_id = s_robot2voip.at(id);
-        s_robot2voip.erase(id);
-    }
-    if (s_voip2robot.find(voip_id) != s_voip2robot.end()) {
-        s_voip2robot.erase(voip_id);
-        update_voip_session_status(voip_id, kFree);
+    std::unique_ptr<RobotEntry> robot = std::move(it->second);
+    s_robot_session.erase(it);
+    mark_dirty(kRobot, id);
+    s_robot_heap.erase(robot.get());
+    s_robot_ring.remove(id);
+    s_total_capacity -= robot->capacity;
+    s_total_load -= robot->load;
+    // 这个 robot 上的呼叫回到等待状态, 按通道顺序插在原来的队头之前, 先分给其他 robot
+    auto old_front = s_waiting_voip.begin();
+    for (const auto &voip_id : robot->channels) {
+        if (voip_id.empty()) {
+            continue;
+        }
+        auto voip_it = s_voip_session.find(voip_id);
+        if (voip_it == s_voip_session.end()) {
+            continue;
+        }
+        voip_it->second.robot_id.clear();
+        mark_dirty(kVoip, voip_id);
+        voip_it->second.session->send(make_bye_signal(id));
+        push_waiting(voip_id, voip_it->second, old_front, true);
     }
+    drain_waiting_voip();
     return true;
 }
 
-WsSession::Sptr WsSessionMgr::get_voip_friend_session(const WsSessionId &id)
+WsSessionMgr::Peer WsSessionMgr::get_voip_peer(const WsSessionId &id)
 {
-    if (s_voip2robot.find(id) == s_voip2robot.end()) {
-        return nullptr;
-    }
-    auto robot_id = s_voip2robot.at(id);
-    if (s_robot_session.find(robot_id) == s_robot_session.end()) {
-        LOG_ERROR("voip friend should exist");
-        return nullptr;
-    }
-    auto robot_ptr = s_robot_session.at(robot_id);
-    return robot_ptr;
+    Peer peer;
+    auto it = s_voip_session.find(id);
+    if (it == s_voip_session.end() || it->second.robot_id.empty()) {
+        return peer;
+    }
+    auto robot_it = s_robot_session.find(it->second.robot_id);
+    if (robot_it == s_robot_session.end()) {
+        return peer;
+    }
+    peer.session = robot_it->second->session;
+    peer.channel = robot_it->second->tagged ? it->second.channel : -1;
+    return peer;
 }
 
-WsSession::Sptr WsSessionMgr::get_robot_friend_session(const WsSessionId &id)
+WsSessionMgr::Peer WsSessionMgr::get_robot_peer(const WsSessionId &id, int channel)
 {
-    if (s_robot2voip.find(id) == s_robot2voip.end()) {
-        return nullptr;
+    Peer peer;
+    auto it = s_robot_session.find(id);
+    if (it == s_robot_session.end()) {
+        return peer;
     }
-    auto voip_id = s_robot2voip.at(id);
-    if (s_voip_session.find(voip_id) == s_voip_session.end()) {
-        LOG_ERROR("robot friend should exist");
-        return nullptr;
+    const RobotEntry &robot = *it->second;
+    if (!robot.tagged) {
+        channel = 0;
     }
-    auto voip_ptr = s_voip_session.at(voip_id);
-    return voip_ptr;
+    if (channel < 0 || channel >= static_cast<int>(robot.channels.size()) || robot.channels[channel].empty()) {
+        return peer;
+    }
+    auto voip_it = s_voip_session.find(robot.channels[channel]);
+    if (voip_it == s_voip_session.end()) {
+        return peer;
+    }
+    peer.session = voip_it->second.session;
+    peer.channel = robot.tagged ? channel : -1;
+    return peer;
 }
 
-bool WsSessionMgr::update_voip_session_status(const WsSessionId &id, WsSessionStatus status)
+bool WsSessionMgr::match_robot_session(const WsSessionId &voip_id)
 {
-    if (s_voip_session.find(id) == s_voip_session.end()) {
+    auto it = s_voip_session.find(voip_id);
+    if (it == s_voip_session.end()) {
         return false;
     }
-    s_voip_session_status[id] = status;
+    RobotEntry *robot = s_affinity_epsilon >= 0 ? pick_affinity_robot(voip_id) : nullptr;
+    if (!robot) {
+        // 堆顶负载率最低, 它都满了说明没有空闲通道
+        robot = s_robot_heap.top();
+        if (!robot || robot->load >= robot->capacity) {
+            return false;
+        }
+    }
+    relate_session(voip_id, it->second, robot);
     return true;
 }
 
-bool WsSessionMgr::update_robot_session_status(const WsSessionId &id, WsSessionStatus status)
+WsSessionMgr::RobotEntry *WsSessionMgr::pick_affinity_robot(const WsSessionId &voip_id)
 {
-    if (s_robot_session.find(id) == s_robot_session.end()) {
-        return false;
+    if (s_total_capacity == 0) {
+        return nullptr;
     }
-    s_robot_session_status[id] = status;
-    return true;
+    // 有界负载: 算上这一路后的平均负载率放大 (1 + epsilon) 倍, 向上取整到通道数
+    double bound_ratio = (1 + s_affinity_epsilon) * static_cast<double>(s_total_load + 1) / s_total_capacity;
+    RobotEntry *picked = nullptr;
+    s_robot_ring.walk(voip_id, kAffinityProbes, [&](const std::string &robot_id) {
+        auto robot_it = s_robot_session.find(robot_id);
+        if (robot_it == s_robot_session.end()) {
+            return false;
+        }
+        RobotEntry *robot = robot_it->second.get();
+        double bound = std::ceil(bound_ratio * robot->capacity);
+        if (robot->load >= robot->capacity || robot->load >= bound) {
+            return false;
+        }
+        picked = robot;
+        return true;
+    });
+    return picked;
 }
 
-bool WsSessionMgr::relate_session(const WsSessionId &voip_id, const WsSessionId &robot_id)
+void WsSessionMgr::fill_robot_session(RobotEntry *robot)
 {
-    if (s_voip2robot.find(voip_id) != s_voip2robot.end() || s_robot2voip.find(robot_id) != s_robot2voip.end()) {
-        return false;
+    while (robot->load < robot->capacity && !s_waiting_voip.empty()) {
+        WsSessionId voip_id = s_waiting_voip.front();
+        relate_session(voip_id, s_voip_session.at(voip_id), robot);
     }
-    s_voip2robot[voip_id] = robot_id;
-    s_robot2voip[robot_id] = voip_id;
-    return true;
 }
 
-WsSessionStatus WsSessionMgr::get_session_status(WsSessionType type, const WsSessionId &id)
+void WsSessionMgr::drain_waiting_voip()
 {
-    std::unique_lock<std::mutex> lock(s_mtx);
-    WsSessionStatus status;
-    switch (type) {
-        case kVoip: {
-            status = get_voip_session_status(id);
-            break;
-        }
-        case kRobot: {
-            status = get_robot_session_status(id);
-            break;
-        }
-        default: {
-            status = kNone;
-            break;
-        }
+    while (!s_waiting_voip.empty() && match_robot_session(s_waiting_voip.front())) {
     }
-    return status;
 }
 
-WsSessionStatus WsSessionMgr::get_voip_session_status(const WsSessionId &id)
+void WsSessionMgr::push_waiting(const WsSessionId &id, VoipEntry &voip, std::list<WsSessionId>::iterator pos, bool requeued)
 {
-    if (s_voip_session_status.find(id) == s_voip_session_status.end()) {
-        return kNone;
+    if (voip.waiting) {
+        return;
+    }
+    voip.waiting = true;
+    voip.wait_it = s_waiting_voip.insert(pos, id);
+    voip.wait_since_us = now_us();
+    mark_dirty(kVoip, id);
+    voip.preroll.reserve(kPrerollFrames);
+    // 等待期间给来电方放提示音: 新来的先放欢迎语再循环等待音乐, robot 断开回到队列的只放等待音乐
+    if (requeued) {
+        PromptPlayer::getInstance()->play(voip.session, {kHoldPrompt}, true);
+    }
+    else {
+        PromptPlayer::getInstance()->play(voip.session, {kGreetingPrompt, kHoldPrompt}, true);
     }
-    return s_voip_session_status.at(id);
 }
 
-WsSessionStatus WsSessionMgr::get_robot_session_status(const WsSessionId &id)
+void WsSessionMgr::pop_waiting(VoipEntry &voip)
 {
-    if (s_robot_session_status.find(id) == s_robot_session_status.end()) {
-        return kNone;
+    if (!voip.waiting) {
+        return;
     }
-    return s_robot_session_status.at(id);
+    s_waiting_voip.erase(voip.wait_it);
+    voip.waiting = false;
+    PromptPlayer::getInstance()->stop(voip.session.get());
 }
 
-bool WsSessionMgr::match_voip_session(const WsSessionId &robot_id)
+void WsSessionMgr::relate_session(const WsSessionId &voip_id, VoipEntry &voip, RobotEntry *robot)
 {
-    // robot to match voip session
-    for (const auto &[voip_id, _] : s_voip_session) {
-        if (get_voip_session_status(voip_id) == kFree) {
-            relate_session(voip_id, robot_id);
-            update_voip_session_status(voip_id, kUsed);
-            return true;
+    uint16_t channel = robot->free_channels.back();
+    robot->free_channels.pop_back();
+    robot->channels[channel] = voip_id;
+    ++robot->load;
+    ++s_total_load;
+    s_robot_heap.update(robot);
+
+    voip.robot_id = robot->id;
+    voip.channel = channel;
+    mark_dirty(kVoip, voip_id);
+    mark_dirty(kRobot, robot->id);
+    bool waited = voip.waiting;
+    if (waited) {
+        pop_waiting(voip);
+        if (s_wait_us.size() < kWaitSamples) {
+            s_wait_us.push_back(now_us() - voip.wait_since_us);
         }
-    }
-    return false;
+        else {
+            s_wait_us[s_wait_count % kWaitSamples] = now_us() - voip.wait_since_us;
+        }
+        ++s_wait_count;
+    }
+    // 通知双方开始协商: voip 发 offer, robot 回 answer, 候选随收集随发
+    voip.session->send(make_paired_signal(robot->id, true));
+    robot->session->send(make_paired_signal(voip_id, false, robot->tagged ? channel : -1));
+    if (!waited) {
+        return;
+    }
+    // 等待期间的音频紧跟 paired 发出; 在锁内投递, 不会被之后实时转发的帧插队
+    voip.preroll.drain([&](std::string &frame) {
+        set_frame_stream(frame, robot->tagged ? channel : 0);
+        robot->session->send_media(frame);
+        ++s_preroll_flushed;
+    });
 }
 
-bool WsSessionMgr::match_robot_session(const WsSessionId &voip_id)
+void WsSessionMgr::release_channel(RobotEntry *robot, uint16_t channel)
+{
+    robot->channels[channel].clear();
+    robot->free_channels.push_back(channel);
+    --robot->load;
+    --s_total_load;
+    s_robot_heap.update(robot);
+    mark_dirty(kRobot, robot->id);
+}
+
+void WsSessionMgr::mark_dirty(WsSessionType type, const WsSessionId &id)
 {
-    // voip to match robot session
-    for (const auto &[robot_id, _] : s_robot_session) {
-        if (get_robot_session_status(robot_id) == kFree) {
-            relate_session(voip_id, robot_id);
-            update_robot_session_status(robot_id, kUsed);
-            return true;
+    (type == kVoip ? s_dirty_voip : s_dirty_robot).insert(id);
+}
+
+SessionRecord WsSessionMgr::make_record(WsSessionType type, const WsSessionId &id) const
+{
+    SessionRecord record;
+    record.id = id;
+    record.type = type;
+    if (type == kVoip) {
+        auto voip_it = s_voip_session.find(id);
+        if (voip_it != s_voip_session.end()) {
+            const VoipEntry &voip = voip_it->second;
+            record.robot_id = voip.robot_id;
+            record.waiting = voip.waiting;
+            if (!voip.robot_id.empty()) {
+                auto robot_it = s_robot_session.find(voip.robot_id);
+                bool tagged = robot_it != s_robot_session.end() && robot_it->second->tagged;
+                record.channel = tagged ? voip.channel : -1;
+            }
+            record.session = voip.session;
+            return record;
+        }
+    }
+    else {
+        auto robot_it = s_robot_session.find(id);
+        if (robot_it != s_robot_session.end()) {
+            const RobotEntry &robot = *robot_it->second;
+            record.capacity = robot.capacity;
+            record.load = robot.load;
+            record.session = robot.session;
+            return record;
         }
     }
-    return false;
+    record.removed = true;
+    return record;
 }
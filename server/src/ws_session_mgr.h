@@ -3,52 +3,160 @@
 
 #include "singleton.hpp"
 #include "types.h"
-#include "ws_session.h"
+#include "session.h"
+#include "indexed_heap.hpp"
+#include "hash_ring.h"
+#include "frame_ring.h"
+#include "registry_snapshot.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <vector>
+#include <memory>
 #include <mutex>
 
+/**
+ * @brief voip / robot 会话表和配对关系
+ *
+ * 一个 robot 连接可以同时服务 capacity 路呼叫, 每路占一个通道号;
+ * voip 进来时从按负载率排序的下标堆里取负载最低的 robot, 配对代价和 robot 数量无关,
+ * 没有空闲通道时 voip 进 FIFO 等待队列, 期间的音频留在每路定长的 pre-roll 环里,
+ * 有 robot 加入或释放通道时按到达顺序配对, 配上后 pre-roll 紧跟 paired 一次发给 robot;
+ * 等待期间由 PromptPlayer 给来电方放欢迎语和等待音乐
+ *
+ * 开启亲和模式后, voip 优先去 voip id 在一致性哈希环上对应的 robot (同一个来电方落到同一个
+ * robot, 沿用它内存里的会话状态); 那个 robot 的负载超过平均负载率的 (1 + epsilon) 倍时
+ * 沿环顺时针找下一个, 都不满足再退回负载最低的 robot
+ *
+ * 管理接口看的是定期发布的只读快照 (RegistrySnapshot): 改动会话表时只记下哪些 id 变了,
+ * publish_snapshot 在锁内取走这些 id 的当前状态, 锁外生成新一版再原子地替换, 读快照不碰 s_mtx
+ */
 class WsSessionMgr :
     public Singleton<WsSessionMgr>
 {
 public:
-    bool join_session(WsSessionType type, const WsSessionId &id, WsSession::Sptr ptr);
+    // 配对的对端; channel 是这一路在多路复用 robot 连接上的通道号, 单路连接为 -1
+    struct Peer {
+        Session::Sptr session;
+        int channel = -1;
+    };
+
+    static constexpr uint32_t kMaxRobotCapacity = 256;
+    // 亲和模式沿哈希环最多试几个 robot, 再不行就退回负载最低的
+    static constexpr std::size_t kAffinityProbes = 8;
+    // 等待时保留的音频帧数, 20 ms 一帧即最近 1 s
+    static constexpr std::size_t kPrerollFrames = 50;
+    // 等待时长分位数取最近多少次配对
+    static constexpr std::size_t kWaitSamples = 1024;
+    // 等待时播放的提示音名 (PromptCache 目录里去掉 .opus 的文件名), 没有这个文件就不播
+    static constexpr const char *kGreetingPrompt = "greeting";
+    static constexpr const char *kHoldPrompt = "hold";
+    // 快照发布周期, 管理接口看到的状态最多落后这么久
+    static constexpr int kSnapshotIntervalMs = 200;
+
+    // capacity 只对 robot 有效: 0 为单路连接, 否则为多路复用连接的路数
+    bool join_session(WsSessionType type, const WsSessionId &id, Session::Sptr ptr, uint32_t capacity = 0);
     bool leave_session(WsSessionType type, const WsSessionId &id);
-    WsSession::Sptr get_friend_session(WsSessionType owner_type, const WsSessionId &id);
-    bool match_session(WsSessionType owner_type, const WsSessionId &id);
+    // voip 取配对的 robot 和自己的通道号; robot 取 channel 那一路的 voip (单路连接忽略 channel)
+    Peer get_peer(WsSessionType owner_type, const WsSessionId &id, int channel = -1);
+    // 带帧头的媒体帧转给对端: 发往多路复用 robot 的帧 stream 改成通道号, 从它收到的帧按 stream 找到 voip
+    bool forward_media(WsSessionType owner_type, const WsSessionId &id, std::string frame, uint64_t ingress_us = 0);
+
+    // epsilon >= 0 时开启亲和模式, 每个 robot 的负载上限为平均负载率的 (1 + epsilon) 倍; 小于 0 时关闭
+    void set_affinity(double epsilon);
 
+    // Prometheus 文本格式的会话数 / 负载 / 等待队列指标, 供 /metrics 返回
+    std::string metrics();
+
+    // 有变更时发布新一版快照, 由定时器周期调用
+    void publish_snapshot();
+    // 最近发布的快照, 不加锁
+    RegistrySnapshot::Sptr snapshot() const;
+
+    // 从快照打印, 不持有 s_mtx
     void printSession();
     void printFriend();
 
 private:
-    bool join_voip_session(const WsSessionId &id, WsSession::Sptr ptr);
-    bool join_robot_session(const WsSessionId &id, WsSession::Sptr ptr);
-
-    bool leave_voip_session(const WsSessionId &id);
-    bool leave_robot_session(const WsSessionId &id);
+    struct RobotEntry {
+        WsSessionId id;
+        Session::Sptr session;
+        uint32_t capacity;
+        uint32_t load;
+        bool tagged;
+        std::size_t heap_index;
+        std::vector<WsSessionId> channels; // <channel, voip_id>, 空串为空闲通道
+        std::vector<uint16_t> free_channels;
+    };
 
-    WsSession::Sptr get_voip_friend_session(const WsSessionId &id);
-    WsSession::Sptr get_robot_friend_session(const WsSessionId &id);
+    struct VoipEntry {
+        Session::Sptr session;
+        WsSessionId robot_id; // 空串为未配对
+        uint16_t channel = 0;
+        bool waiting = false;
+        std::list<WsSessionId>::iterator wait_it;
+        uint64_t wait_since_us = 0;
+        FrameRing preroll;
+    };
 
-    WsSessionStatus get_session_status(WsSessionType type, const WsSessionId &id);
+    // 负载率 load / capacity 低的在堆顶, 相同时剩余通道多的优先
+    struct RobotLoadLess {
+        bool operator()(const RobotEntry *a, const RobotEntry *b) const
+        {
+            uint64_t lhs = static_cast<uint64_t>(a->load) * b->capacity;
+            uint64_t rhs = static_cast<uint64_t>(b->load) * a->capacity;
+            if (lhs != rhs) {
+                return lhs < rhs;
+            }
+            return a->capacity - a->load > b->capacity - b->load;
+        }
+    };
 
-    bool update_voip_session_status(const WsSessionId &id, WsSessionStatus status);
-    bool update_robot_session_status(const WsSessionId &id, WsSessionStatus status);
+    bool join_voip_session(const WsSessionId &id, Session::Sptr ptr);
+    bool join_robot_session(const WsSessionId &id, Session::Sptr ptr, uint32_t capacity);
 
-    bool relate_session(const WsSessionId &id1, const WsSessionId &id2);
+    bool leave_voip_session(const WsSessionId &id);
+    bool leave_robot_session(const WsSessionId &id);
 
-    WsSessionStatus get_voip_session_status(const WsSessionId &id);
-    WsSessionStatus get_robot_session_status(const WsSessionId &id);
+    Peer get_voip_peer(const WsSessionId &id);
+    Peer get_robot_peer(const WsSessionId &id, int channel);
 
-    bool match_voip_session(const WsSessionId &id);
-    bool match_robot_session(const WsSessionId &id);
+    // 给等待中的 voip 找 robot: 亲和模式下先按哈希环, 否则取负载最低的
+    bool match_robot_session(const WsSessionId &voip_id);
+    RobotEntry *pick_affinity_robot(const WsSessionId &voip_id);
+    // robot 有空闲通道时从等待队列头部补满
+    void fill_robot_session(RobotEntry *robot);
+    // 有空闲通道就按队列顺序配对, 直到队列空或全部占满
+    void drain_waiting_voip();
+    // 插在 pos 之前; requeued 为 robot 断开后回到队列的呼叫 (只放等待音乐)
+    void push_waiting(const WsSessionId &id, VoipEntry &voip, std::list<WsSessionId>::iterator pos, bool requeued);
+    void pop_waiting(VoipEntry &voip);
+    void relate_session(const WsSessionId &voip_id, VoipEntry &voip, RobotEntry *robot);
+    void release_channel(RobotEntry *robot, uint16_t channel);
+    // 会话表里这个 id 的状态变了, 下次发布快照时带上
+    void mark_dirty(WsSessionType type, const WsSessionId &id);
+    SessionRecord make_record(WsSessionType type, const WsSessionId &id) const;
 
 private:
-    std::unordered_map<WsSessionId, WsSession::Sptr> s_voip_session;         // <voip_id, session>
-    std::unordered_map<WsSessionId, WsSessionStatus> s_voip_session_status;  // <voip_id, status>
-    std::unordered_map<WsSessionId, WsSession::Sptr> s_robot_session;        // <robot_id, session>
-    std::unordered_map<WsSessionId, WsSessionStatus> s_robot_session_status; // <robot_id, status>
-    std::unordered_map<WsSessionId, WsSessionId> s_robot2voip;               // <robot_id, voip_id>
-    std::unordered_map<WsSessionId, WsSessionId> s_voip2robot;               // <voip_id, robot_id>
+    std::unordered_map<WsSessionId, VoipEntry> s_voip_session;                     // <voip_id, session>
+    std::unordered_map<WsSessionId, std::unique_ptr<RobotEntry>> s_robot_session; // <robot_id, session>
+    std::list<WsSessionId> s_waiting_voip;                                         // 未配对的 voip_id, 按到达顺序
+    IndexedHeap<RobotEntry, RobotLoadLess> s_robot_heap;                           // 全部 robot, 按负载率
+    HashRing s_robot_ring;                                                         // 亲和模式用, 按 capacity 加权
+    double s_affinity_epsilon = -1;
+    uint64_t s_total_load = 0;
+    uint64_t s_total_capacity = 0;
+
+    std::vector<uint64_t> s_wait_us;   // 最近 kWaitSamples 次配对前的等待时长, 环形覆盖
+    uint64_t s_wait_count = 0;         // 等待过的呼叫数 (配上的)
+    uint64_t s_preroll_flushed = 0;
+    uint64_t s_preroll_dropped = 0;    // 等太久被覆盖掉的帧
+    std::unordered_set<WsSessionId> s_dirty_voip;  // 上次发布快照后状态变了的会话, voip 和 robot 分开记
+    std::unordered_set<WsSessionId> s_dirty_robot;
     std::mutex s_mtx;
+
+    RegistrySnapshot::Sptr s_snapshot = std::make_shared<const RegistrySnapshot>(); // atomic_load / atomic_store
+    std::mutex s_publish_mtx;                                                       // 发布者之间互斥, 和 s_mtx 无关
 };
 
-#endif // _WS_SESSION_MGR_H_
\ No newline at end of file
+#endif // _WS_SESSION_MGR_H_
@@ -0,0 +1,120 @@
+#include "json_view.h"
+#include <cstdio>
+#include <string>
+
+/**
+ * JsonView 的边界情况: 转义、重复键、嵌套深度上限、对象后的多余内容;
+ * 这些输入上 parse 失败时调用方会退回 jsoncpp, 所以要点是该拒绝的都拒绝, 接受的值原文不变
+ */
+
+static int g_failed = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        std::printf("FAIL %s\n", what);
+        ++g_failed;
+    }
+}
+
+static bool parses(const std::string &doc)
+{
+    JsonView view;
+    return view.parse(doc);
+}
+
+// 顶层对象里一个成员, 值为 depth 层嵌套的数组; 顶层对象本身算第 1 层
+static std::string nested(int depth)
+{
+    return "{\"a\":" + std::string(depth - 1, '[') + std::string(depth - 1, ']') + "}";
+}
+
+static void test_escapes()
+{
+    JsonView view;
+    std::string doc = R"({"type":"offer","sdp":"v=0\r\no=- \"x\" \\ \/ \b\f\t é😀"})";
+    check(view.parse(doc), "escaped string value parses");
+    const JsonView::Member *sdp = view.find("sdp");
+    check(sdp && sdp->kind == JsonView::kString && sdp->escaped, "escaped flag set");
+    check(sdp && sdp->value == R"("v=0\r\no=- \"x\" \\ \/ \b\f\t é😀")", "escaped value kept verbatim");
+    std::string_view out;
+    check(!view.get_string("sdp", out), "get_string refuses escaped value");
+    check(view.get_string("type", out) && out == "offer", "get_string on plain value");
+
+    // 嵌套对象 / 数组里的转义只校验
+    check(parses(R"({"a":{"k\n":["\"",{"A":"\\"}]}})"), "escapes inside nested containers");
+
+    check(!parses(R"({"a":"\x"})"), "unknown escape");
+    check(!parses(R"({"a":"\u12G4"})"), "bad hex in \\u");
+    check(!parses(R"({"a":"\u12"})"), "short \\u");
+    check(!parses("{\"a\":\"\\"), "escape at end of input");
+    check(!parses(std::string("{\"a\":\"line\nbreak\"}")), "raw control character in string");
+    // 顶层键带转义时不猜它等于哪个键
+    check(!parses(R"({"ty\u0070e":"offer"})"), "escaped top-level key");
+}
+
+static void test_duplicate_keys()
+{
+    check(!parses(R"({"type":"offer","type":"bye"})"), "duplicate top-level key");
+    check(!parses(R"({"channel":1,"sdp":"x","channel":2})"), "duplicate key after another member");
+    // 只有顶层成员被记录, 嵌套对象里的重复键不影响转发
+    check(parses(R"({"a":{"b":1,"b":2}})"), "duplicate key in nested object");
+    check(parses(R"({"a":1,"A":2})"), "keys are case sensitive");
+
+    // 成员数上限
+    std::string doc = "{";
+    for (std::size_t i = 0; i < JsonView::kMaxMembers; ++i) {
+        doc += (i ? ",\"k" : "\"k") + std::to_string(i) + "\":" + std::to_string(i);
+    }
+    check(parses(doc + "}"), "kMaxMembers members");
+    check(!parses(doc + ",\"extra\":0}"), "more than kMaxMembers members");
+}
+
+static void test_depth_limit()
+{
+    check(parses(nested(JsonView::kMaxDepth)), "kMaxDepth levels");
+    check(!parses(nested(JsonView::kMaxDepth + 1)), "kMaxDepth + 1 levels");
+    check(!parses(nested(100000)), "very deep nesting does not recurse unbounded");
+    std::string objects = "{\"a\":";
+    for (int i = 1; i < JsonView::kMaxDepth; ++i) {
+        objects += "{\"a\":";
+    }
+    objects += "1" + std::string(JsonView::kMaxDepth, '}');
+    check(parses(objects), "kMaxDepth nested objects");
+    check(!parses("{\"b\":" + objects + "}"), "kMaxDepth + 1 nested objects");
+}
+
+static void test_trailing_garbage()
+{
+    check(parses("  {\"a\":1} \r\n\t"), "surrounding whitespace");
+    check(!parses("{\"a\":1} x"), "text after the object");
+    check(!parses("{\"a\":1}{}"), "second object");
+    check(!parses(std::string("{\"a\":1}\0", 8)), "nul byte after the object");
+    check(!parses("{\"a\":1,}"), "trailing comma");
+    check(!parses("{\"a\":[1,]}"), "trailing comma in array");
+    check(!parses("{\"a\":1"), "unterminated object");
+    check(!parses("{\"a\":01}"), "leading zero");
+    check(!parses("{\"a\":tru}"), "truncated literal");
+    check(!parses("[1]"), "top level is not an object");
+    check(!parses(""), "empty document");
+
+    JsonView view;
+    uint32_t channel = 0;
+    check(view.parse("{\"channel\":65535}") && view.get_uint("channel", channel) && channel == 65535, "get_uint");
+    check(view.parse("{\"channel\":-1}") && !view.get_uint("channel", channel), "get_uint rejects negative");
+    check(view.parse("{\"channel\":4294967296}") && !view.get_uint("channel", channel), "get_uint rejects overflow");
+}
+
+int main()
+{
+    test_escapes();
+    test_duplicate_keys();
+    test_depth_limit();
+    test_trailing_garbage();
+    if (g_failed) {
+        std::printf("%d failed\n", g_failed);
+        return 1;
+    }
+    std::printf("ok\n");
+    return 0;
+}
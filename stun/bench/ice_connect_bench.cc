@@ -0,0 +1,205 @@
+#include "ice_agent_mgr.h"
+#include "stun_server.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * 回环上回调驱动的 ICE 建连耗时: 进程内起 StunServer (与 stun-binding-server 同一实现) 作为本地 STUN,
+ * 两个 IceAgentMgr 各代表一端, 每对 agent 走一遍 offer / answer, 候选在 OnCandidate 回调里直接 trickle 给对端,
+ * 等到两端的 OnStateChanged 都报 CONNECTED; 一对接一对地跑 pairs 次,
+ * 统计 IceAgent::connectMs (gather 到 CONNECTED) 的分布和整对的墙钟耗时
+ * port_a / port_b 都非 0 时两端各自 MUX 在这个端口上 (服务端的部署方式), 否则每个 agent 一个 socket
+ * 用法 ice_connect_bench [pairs] [port_a] [port_b], 默认 100 对、MUX 在 35000 / 35001
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const std::chrono::seconds kTimeout(10);
+
+static std::mutex g_mtx;
+static std::condition_variable g_cv;
+
+// 对端的 remote description 设置好之前收到的候选和 end-of-candidates 先缓存
+struct Peer {
+    IceAgent::Sptr agent;
+    juice_state_t state = JUICE_STATE_DISCONNECTED;
+    bool ready = false;
+    bool gathering_done = false;
+    std::vector<std::string> pending;
+
+    void addCandidate(const char *sdp)
+    {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        if (ready) {
+            agent->addRemoteCandidate(sdp);
+        }
+        else {
+            pending.push_back(sdp);
+        }
+    }
+
+    void remoteGatheringDone()
+    {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        gathering_done = true;
+        if (ready) {
+            agent->setRemoteGatheringDone();
+        }
+    }
+
+    void setRemoteDescription(const std::string &sdp)
+    {
+        agent->setRemoteDescription(sdp);
+        std::lock_guard<std::mutex> lock(g_mtx);
+        ready = true;
+        for (auto &candidate : pending) {
+            agent->addRemoteCandidate(candidate);
+        }
+        pending.clear();
+        if (gathering_done) {
+            agent->setRemoteGatheringDone();
+        }
+    }
+};
+
+static bool connected(juice_state_t state)
+{
+    return state == JUICE_STATE_CONNECTED || state == JUICE_STATE_COMPLETED;
+}
+
+static void wire(Peer &self, Peer &other)
+{
+    self.agent->setOnStateChanged([&self](juice_state_t state) {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        self.state = state;
+        g_cv.notify_all();
+    });
+    self.agent->setOnCandidate([&other](const char *sdp) {
+        other.addCandidate(sdp);
+    });
+    self.agent->setOnGatheringDone([&other]() {
+        other.remoteGatheringDone();
+    });
+}
+
+// 建连成功时返回整对的墙钟耗时 (ms), 失败或超时返回 -1
+static double connect_pair(IceAgentMgr &mgr_a, IceAgentMgr &mgr_b, double &connect_a, double &connect_b)
+{
+    Peer a;
+    Peer b;
+    a.agent = mgr_a.createAgent();
+    b.agent = mgr_b.createAgent();
+    if (!a.agent || !b.agent) {
+        return -1;
+    }
+    wire(a, b);
+    wire(b, a);
+
+    // a 先收集成为 controlling, b 拿到 a 的 description 后收集成为 controlled
+    Clock::time_point begin = Clock::now();
+    std::string offer = a.agent->localDescription();
+    if (!a.agent->gather()) {
+        return -1;
+    }
+    b.setRemoteDescription(offer);
+    std::string answer = b.agent->localDescription();
+    if (!b.agent->gather()) {
+        return -1;
+    }
+    a.setRemoteDescription(answer);
+
+    bool ok;
+    {
+        std::unique_lock<std::mutex> lock(g_mtx);
+        ok = g_cv.wait_for(lock, kTimeout, [&]() {
+            return (connected(a.state) && connected(b.state)) || a.state == JUICE_STATE_FAILED
+                   || b.state == JUICE_STATE_FAILED;
+        });
+        ok = ok && connected(a.state) && connected(b.state);
+    }
+    double wall = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    connect_a = a.agent->connectMs();
+    connect_b = b.agent->connectMs();
+    // 析构会等回调结束, 回调引用的 Peer 在这之后才出作用域
+    a.agent.reset();
+    b.agent.reset();
+    return ok ? wall : -1;
+}
+
+static double percentile(std::vector<double> &v, double q)
+{
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    std::size_t i = static_cast<std::size_t>(q * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+int main(int argc, char *argv[])
+{
+    int pairs = argc > 1 ? std::atoi(argv[1]) : 100;
+    uint16_t port_a = static_cast<uint16_t>(argc > 2 ? std::atoi(argv[2]) : 35000);
+    uint16_t port_b = static_cast<uint16_t>(argc > 3 ? std::atoi(argv[3]) : 35001);
+    if (pairs <= 0) {
+        pairs = 100;
+    }
+    bool mux = port_a != 0 && port_b != 0;
+
+    StunServer::Config stun_cfg;
+    stun_cfg.ip = "127.0.0.1";
+    stun_cfg.port = 0;
+    stun_cfg.threads = 1;
+    stun_cfg.pin_cpu = false;
+    StunServer stun(stun_cfg);
+    if (!stun.start()) {
+        std::printf("start stun server failed\n");
+        return 1;
+    }
+
+    IceAgentMgr::Config cfg;
+    cfg.stun_host = "127.0.0.1";
+    cfg.stun_port = stun.port();
+    cfg.bind_address = "127.0.0.1";
+    cfg.mux = mux;
+    cfg.port = mux ? port_a : 0;
+    IceAgentMgr mgr_a(cfg);
+    cfg.port = mux ? port_b : 0;
+    IceAgentMgr mgr_b(cfg);
+
+    std::vector<double> walls;
+    std::vector<double> connects;
+    int failed = 0;
+    for (int i = 0; i < pairs; ++i) {
+        double connect_a = -1;
+        double connect_b = -1;
+        double wall = connect_pair(mgr_a, mgr_b, connect_a, connect_b);
+        if (wall < 0) {
+            ++failed;
+            continue;
+        }
+        walls.push_back(wall);
+        connects.push_back(connect_a);
+        connects.push_back(connect_b);
+    }
+
+    StunServer::Stats ss = stun.stats();
+    stun.stop();
+    std::printf("%d pairs on loopback, %s, local STUN 127.0.0.1:%u answered %llu binding requests\n", pairs,
+                mux ? "mux" : "socket per agent", static_cast<unsigned>(cfg.stun_port),
+                static_cast<unsigned long long>(ss.responses));
+    std::printf("%-22s %8s %8s %8s %8s\n", "ms", "p50", "p90", "p99", "max");
+    std::printf("%-22s %8.2f %8.2f %8.2f %8.2f\n", "gather -> connected", percentile(connects, 0.5),
+                percentile(connects, 0.9), percentile(connects, 0.99), percentile(connects, 1.0));
+    std::printf("%-22s %8.2f %8.2f %8.2f %8.2f\n", "pair (offer -> both)", percentile(walls, 0.5),
+                percentile(walls, 0.9), percentile(walls, 0.99), percentile(walls, 1.0));
+    std::printf("connected %zu, failed %d\n", walls.size(), failed);
+    return failed ? 1 : 0;
+}
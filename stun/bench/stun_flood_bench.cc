@@ -0,0 +1,142 @@
+#include "stun_message.h"
+#include "udp_batch_socket.h"
+#include <arpa/inet.h>
+#include <time.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * stun-binding-server 的压测客户端: sockets 个 UDP socket 轮流用 sendmmsg 一次发 batch 个带 FINGERPRINT 的
+ * Binding 请求, 每发一批就把这个 socket 收空; 响应要是 Binding 成功响应、FINGERPRINT 正确,
+ * 且 XOR-MAPPED-ADDRESS 的端口等于发送 socket 的本地端口才算有效
+ * 打印每秒有效响应数、响应率和客户端自己的 CPU 占用 (同机压测时服务端可用的 CPU 要扣掉这部分)
+ * 用法 stun_flood_bench [ip] [port] [seconds] [sockets] [batch], 默认 127.0.0.1 3478 5 8 64
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double process_cpu_s()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 检查响应并取 XOR-MAPPED-ADDRESS 的端口
+static bool valid_response(const UdpBatchSocket::Datagram &dg, uint16_t local_port)
+{
+    StunHeader hdr;
+    if (!parseStunHeader(dg.data, dg.size, hdr) || hdr.type != kStunBindingResponse || !hdr.fingerprint
+        || !checkStunFingerprint(dg.data, hdr)) {
+        return false;
+    }
+    uint16_t len = 0;
+    const uint8_t *value = findStunAttribute(dg.data, hdr, kStunAttrXorMappedAddress, len);
+    sockaddr_storage mapped;
+    socklen_t mapped_len = 0;
+    if (!value || !readStunXorAddress(dg.data, value, len, mapped, mapped_len)) {
+        return false;
+    }
+    uint16_t port = mapped.ss_family == AF_INET6 ? reinterpret_cast<const sockaddr_in6 &>(mapped).sin6_port
+                                                 : reinterpret_cast<const sockaddr_in &>(mapped).sin_port;
+    return ntohs(port) == local_port;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string ip = argc > 1 ? argv[1] : "127.0.0.1";
+    uint16_t port = static_cast<uint16_t>(argc > 2 ? std::atoi(argv[2]) : 3478);
+    double seconds = argc > 3 ? std::atof(argv[3]) : 5.0;
+    std::size_t sockets = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 8;
+    std::size_t batch = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 64;
+    if (seconds <= 0) {
+        seconds = 5.0;
+    }
+    if (sockets == 0) {
+        sockets = 8;
+    }
+    if (batch == 0) {
+        batch = 64;
+    }
+
+    sockaddr_storage server;
+    socklen_t server_len;
+    std::memset(&server, 0, sizeof(server));
+    sockaddr_in *v4 = reinterpret_cast<sockaddr_in *>(&server);
+    sockaddr_in6 *v6 = reinterpret_cast<sockaddr_in6 *>(&server);
+    if (inet_pton(AF_INET, ip.c_str(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        server_len = sizeof(sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, ip.c_str(), &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        server_len = sizeof(sockaddr_in6);
+    }
+    else {
+        std::printf("bad address %s\n", ip.c_str());
+        return 1;
+    }
+
+    // 每个 socket 一个请求, 事务 id 里带 socket 序号
+    std::vector<std::unique_ptr<UdpBatchSocket>> socks;
+    std::vector<std::vector<uint8_t>> requests;
+    std::vector<uint16_t> local_ports;
+    for (std::size_t i = 0; i < sockets; ++i) {
+        socks.emplace_back(new UdpBatchSocket(batch, 256, false));
+        if (!socks[i]->open(server.ss_family == AF_INET6 ? "::" : "", 0)) {
+            std::printf("open failed\n");
+            return 1;
+        }
+        local_ports.push_back(socks[i]->localPort());
+        uint8_t transaction_id[12];
+        for (int k = 0; k < 12; ++k) {
+            transaction_id[k] = static_cast<uint8_t>(i * 31 + k);
+        }
+        uint8_t buf[64];
+        StunWriter writer(buf, sizeof(buf));
+        writer.begin(kStunBindingRequest, transaction_id);
+        writer.addFingerprint();
+        requests.emplace_back(writer.data(), writer.data() + writer.size());
+    }
+
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t valid = 0;
+    double cpu_begin = process_cpu_s();
+    Clock::time_point begin = Clock::now();
+    Clock::time_point end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    while (Clock::now() < end) {
+        for (std::size_t i = 0; i < sockets; ++i) {
+            UdpBatchSocket &sock = *socks[i];
+            for (std::size_t k = 0; k < batch; ++k) {
+                sock.queue(reinterpret_cast<const sockaddr *>(&server), server_len, requests[i].data(),
+                           requests[i].size());
+            }
+            sent += sock.flush();
+            int n;
+            while ((n = sock.recv()) > 0) {
+                received += n;
+                for (int k = 0; k < n; ++k) {
+                    valid += valid_response(sock.datagram(k), local_ports[i]);
+                }
+            }
+        }
+    }
+    double wall = std::chrono::duration<double>(Clock::now() - begin).count();
+    double cpu = process_cpu_s() - cpu_begin;
+
+    std::printf("%s:%u, %zu sockets x %zu per sendmmsg, %.1f s\n", ip.c_str(), static_cast<unsigned>(port), sockets,
+                batch, wall);
+    std::printf("sent %llu, responses %llu, valid %llu (%.1f%%)\n", static_cast<unsigned long long>(sent),
+                static_cast<unsigned long long>(received), static_cast<unsigned long long>(valid),
+                sent ? 100.0 * valid / sent : 0.0);
+    std::printf("%.0f valid responses/s, client cpu %.0f%%\n", valid / wall, cpu / wall * 100);
+    return valid ? 0 : 1;
+}
@@ -1,51 +1,121 @@
 // receiver.cpp (示例，重点展示如何接收并解码)
 #include "rtc/rtc.hpp"
+#include "rtp_packet.h"
+#include "jitter_buffer.h"
+#include "signaling_client.h"
 #include <opus/opus.h>
 #include <portaudio.h>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdlib>
 
-// Placeholder: implement signaling to receive offer from remote and send answer
-std::string waitForRemoteOffer() { /* your signaling */ return ""; }
-void sendAnswerToRemote(const std::string &sdp) { /* your signaling */ }
-
-int main() {
+// receiver ws_host ws_port id: 以 robot 身份登录 WsServer, 收 offer 回 answer
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " ws_host ws_port id" << std::endl;
+        return 1;
+    }
     rtc::InitLogger(rtc::LogLevel::Info, nullptr);
     rtc::Configuration config;
     config.iceServers.emplace_back("stun:stun.l.google.com:19302");
     auto pc = std::make_shared<rtc::PeerConnection>(config);
 
+    const int sampleRate = 48000;
+    const int frameSize = 960; // 20 ms @ 48kHz
+    auto now_ms = []() {
+        return std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    };
+
+    // 网络线程只把 RTP 放进抖动缓冲, 解码与播放在独立的播放线程按 20 ms 节拍进行
+    auto jitter = std::make_shared<JitterBuffer>();
+
     // When a remote track arrives:
-    pc->onTrack([&](std::shared_ptr<rtc::Track> track) {
-        // set a depacketizer / or onFrame callback
-        // The library offers Opus depacketizer helper in examples; we can use onFrame
-        // frame payload will be raw RTP payload (after depacketizing if you set a MediaHandler)
-        track->onFrame([&](rtc::binary data, rtc::FrameInfo info) {
-            // data is a full payload as provided by media handler (opus payload)
-            static OpusDecoder* dec = nullptr;
-            if (!dec) {
-                int err;
-                dec = opus_decoder_create(48000, 1, &err);
-                // init PortAudio playback
-                Pa_Initialize();
+    pc->onTrack([jitter, now_ms](std::shared_ptr<rtc::Track> track) {
+        // no media handler: onMessage delivers raw RTP (after SRTP), so seq/timestamp are available
+        track->onMessage(
+            [jitter, now_ms](rtc::binary data) {
+                const uint8_t *pkt = reinterpret_cast<const uint8_t *>(data.data());
+                RtpHeader hdr;
+                if (isRtcpPacket(pkt, data.size()) || !parseRtpHeader(pkt, data.size(), hdr)) {
+                    return;
+                }
+                jitter->push(hdr.seq, hdr.timestamp, hdr.payload, hdr.payload_size, now_ms());
+            },
+            nullptr);
+    });
+
+    std::thread playout([jitter, now_ms]() {
+        int err;
+        OpusDecoder *dec = opus_decoder_create(sampleRate, 1, &err);
+        Pa_Initialize();
+        PaStream *playStream = nullptr;
+        Pa_OpenDefaultStream(&playStream, 0, 1, paInt16, sampleRate, frameSize, nullptr, nullptr);
+        Pa_StartStream(playStream);
+
+        // preallocated, reused for every frame
+        std::vector<int16_t> pcm(frameSize);
+        while (true) {
+            JitterBuffer::Frame frame = jitter->pop(now_ms());
+            int samples = 0;
+            switch (frame.action) {
+                case JitterBuffer::kPacket:
+                    samples = opus_decode(dec, frame.payload, (opus_int32)frame.size, pcm.data(), frameSize, 0);
+                    break;
+                case JitterBuffer::kFec:
+                    // recover the lost frame from the LBRR data carried by the next packet
+                    samples = opus_decode(dec, frame.payload, (opus_int32)frame.size, pcm.data(), frameSize, 1);
+                    break;
+                case JitterBuffer::kPlc:
+                    samples = opus_decode(dec, nullptr, 0, pcm.data(), frameSize, 0);
+                    break;
+                case JitterBuffer::kNone:
+                    break;
             }
-            // decode
-            const uint8_t* payload = data.data();
-            int payload_len = (int)data.size();
-            const int frameSize = 960;
-            std::vector<int16_t> pcm(frameSize);
-            int samples = opus_decode(dec, payload, payload_len, pcm.data(), frameSize, 0);
-            if (samples > 0) {
-                // play via PortAudio blocking write (setup stream earlier in full code)
-                // Pa_WriteStream(playStream, pcm.data(), samples);
+            if (samples <= 0) {
+                std::fill(pcm.begin(), pcm.end(), 0);
             }
-        });
+            // blocking write paces the loop at one frame per 20 ms
+            Pa_WriteStream(playStream, pcm.data(), frameSize);
+        }
     });
+    playout.detach();
 
-    // Accept offer from remote and answer
-    std::string offer = waitForRemoteOffer();
-    if (!offer.empty()) {
-        pc->setRemoteDescription(rtc::Description(offer));
-        // create answer, onLocalDescription callback will be fired and you send via signaling
+    // 信令经 WsServer 转发: 收到 offer 后自动生成 answer, 候选双向 trickle
+    auto signaling = std::make_shared<SignalingClient>();
+    pc->onLocalDescription([signaling](rtc::Description sdp) {
+        signaling->sendDescription(sdp.typeString(), std::string(sdp));
+    });
+    pc->onLocalCandidate([signaling](rtc::Candidate c) {
+        signaling->sendCandidate(c.candidate(), c.mid());
+    });
+    pc->onGatheringStateChange([signaling](rtc::PeerConnection::GatheringState state) {
+        if (state == rtc::PeerConnection::GatheringState::Complete) {
+            signaling->sendEndOfCandidates();
+        }
+    });
+    signaling->setOnMessage([pc](const SignalingClient::Message &msg) {
+        switch (msg.type) {
+            case SignalingClient::kOffer:
+                pc->setRemoteDescription(rtc::Description(msg.sdp, "offer"));
+                break;
+            case SignalingClient::kCandidate:
+                pc->addRemoteCandidate(rtc::Candidate(msg.candidate, msg.mid));
+                break;
+            case SignalingClient::kBye:
+                pc->close();
+                break;
+            default:
+                break;
+        }
+    });
+    if (!signaling->connect(argv[1], static_cast<uint16_t>(atoi(argv[2])), std::string("/robot?id=") + argv[3])) {
+        std::cerr << "connect signaling server failed" << std::endl;
+        return 1;
     }
 
     // keep alive...
@@ -1,44 +1,33 @@
 #include "rtc/rtc.hpp" // libdatachannel C++ API
+#include "rtp_packetizer.h"
+#include "rtp_pacer.h"
+#include "signaling_client.h"
 #include <opus/opus.h> // libopus
 #include <portaudio.h> // PortAudio (blocking mode)
-#include <arpa/inet.h> // htonl/htons
+#include <algorithm>
 #include <random>
 #include <vector>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
+#include <iostream>
 
-std::vector<uint8_t> buildRtpPacket(const uint8_t *payload, size_t payload_len,
-                                    uint16_t seq, uint32_t ts, uint32_t ssrc, uint8_t payloadType)
-{
-    std::vector<uint8_t> pkt;
-    pkt.resize(12 + payload_len);
-    // RTP header (12 bytes)
-    pkt[0] = 0x80;               // V=2, P=0, X=0, CC=0
-    pkt[1] = payloadType & 0x7f; // M=0, PT=payloadType
-    uint16_t nseq = htons(seq);
-    memcpy(&pkt[2], &nseq, 2);
-    uint32_t nts = htonl(ts);
-    memcpy(&pkt[4], &nts, 4);
-    uint32_t nssrc = htonl(ssrc);
-    memcpy(&pkt[8], &nssrc, 4);
-    // payload
-    memcpy(pkt.data() + 12, payload, payload_len);
-    return pkt;
-}
-
-// Placeholder: implement these to send SDP/candidates to the peer
-void sendSignalingSDPToRemote(const std::string &sdp) { /* your signaling */ }
-void sendCandidateToRemote(const std::string &cand, const std::string &mid) { /* your signaling */ }
-
-int main()
+// sender ws_host ws_port id: 以 voip 身份登录 WsServer, 和配对的 robot (receiver) 交换 SDP / 候选
+int main(int argc, char *argv[])
 {
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " ws_host ws_port id" << std::endl;
+        return 1;
+    }
     // Init logger (optional)
     rtc::InitLogger(rtc::LogLevel::Info, nullptr);
 
     // 1) PeerConnection config with STUN server (example)
     rtc::Configuration config;
     config.iceServers.emplace_back("stun:stun.l.google.com:19302");
+    // offer 等配对成功后再生成
+    config.disableAutoNegotiation = true;
 
     auto pc = std::make_shared<rtc::PeerConnection>(config);
 
@@ -51,19 +40,52 @@ int main()
 
     auto track = pc->addTrack(media);
 
-    // 3) Signaling callbacks: libdatachannel will call onLocalDescription / onLocalCandidate
-    pc->onLocalDescription([&](rtc::Description sdp) {
-        // send sdp.str() to remote via your signaling
-        sendSignalingSDPToRemote(std::string(sdp));
+    // 3) 信令经 WsServer 转发: offer 生成后立即发出, 候选收集到一个发一个 (trickle),
+    // 对端可以在我们收集候选的同时就开始建立媒体
+    auto signaling = std::make_shared<SignalingClient>();
+    pc->onLocalDescription([signaling](rtc::Description sdp) {
+        signaling->sendDescription(sdp.typeString(), std::string(sdp));
+    });
+
+    pc->onLocalCandidate([signaling](rtc::Candidate c) {
+        signaling->sendCandidate(c.candidate(), c.mid());
+    });
+
+    pc->onGatheringStateChange([signaling](rtc::PeerConnection::GatheringState state) {
+        if (state == rtc::PeerConnection::GatheringState::Complete) {
+            signaling->sendEndOfCandidates();
+        }
     });
 
-    pc->onLocalCandidate([&](rtc::Candidate c) {
-        sendCandidateToRemote(c.candidate(), c.mid());
+    signaling->setOnMessage([pc](const SignalingClient::Message &msg) {
+        switch (msg.type) {
+            case SignalingClient::kPaired:
+                pc->setLocalDescription(rtc::Description::Type::Offer);
+                break;
+            case SignalingClient::kAnswer:
+                pc->setRemoteDescription(rtc::Description(msg.sdp, "answer"));
+                break;
+            case SignalingClient::kCandidate:
+                pc->addRemoteCandidate(rtc::Candidate(msg.candidate, msg.mid));
+                break;
+            case SignalingClient::kBye:
+                pc->close();
+                break;
+            default:
+                break;
+        }
     });
+    if (!signaling->connect(argv[1], static_cast<uint16_t>(atoi(argv[2])), std::string("/voip?id=") + argv[3])) {
+        std::cerr << "connect signaling server failed" << std::endl;
+        return 1;
+    }
+
+    // 4) 发送由 pacer 的定时器驱动, 不再在 libdatachannel 回调线程里阻塞读声卡
+    RtpPacer pacer;
+    pacer.start();
 
-    // 4) When track opens (DTLS/SRTP established), start capture->encode->send loop
-    track->onOpen([track]() {
-        // PortAudio init (blocking) and Opus encoder init
+    track->onOpen([track, &pacer, preferredPayloadType]() {
+        // PortAudio init and Opus encoder init
         Pa_Initialize();
         PaStream *stream = nullptr;
         PaStreamParameters inputParams;
@@ -75,7 +97,6 @@ int main()
 
         const int sampleRate = 48000; // Opus expects 48kHz
         const int frameSize = 960;    // 20 ms @ 48kHz
-        const int maxFrameBytes = 4000;
 
         Pa_OpenStream(&stream,
                       &inputParams,
@@ -87,52 +108,48 @@ int main()
                       nullptr);
         Pa_StartStream(stream);
 
-        int err;
         int opusErr;
         OpusEncoder *enc = opus_encoder_create(sampleRate, 1, OPUS_APPLICATION_VOIP, &opusErr);
         opus_encoder_ctl(enc, OPUS_SET_BITRATE(64000));
 
-        // RTP state
+        // RTP state: 包头和 opus 负载直接写在预分配的环里, 不再每帧分配/拷贝
         std::random_device rd;
-        uint32_t ssrc = rd();
-        uint16_t seq = 0;
-        uint32_t timestamp = rd(); // random start
-        const uint8_t pt = preferredPayloadType;
-
-        std::vector<int16_t> pcm(frameSize);
-        std::vector<uint8_t> opus_buf(maxFrameBytes);
-
-        while (true) {
-            // blocking read
-            Pa_ReadStream(stream, pcm.data(), frameSize);
-
-            // encode
-            int nbBytes = opus_encode(enc, pcm.data(), frameSize, opus_buf.data(), maxFrameBytes);
-            if (nbBytes < 0)
-                continue;
-
-            // build RTP (timestamp increment: frameSize samples)
-            auto pkt = buildRtpPacket(opus_buf.data(), nbBytes, seq, timestamp, ssrc, pt);
-            // send via libdatachannel track -> libdatachannel will SRTP-protect and send via libjuice/ICE
-            track->send(rtc::binary(pkt.begin(), pkt.end()));
-
-            // advance seq/timestamp
-            seq++;
-            timestamp += frameSize; // 48000Hz * 0.02s = 960
-            // small sleep if needed to pace (we already read blocking, so usually not necessary)
-        }
-
-        // cleanup (unreachable in this snippet)
-        opus_encoder_destroy(enc);
-        Pa_StopStream(stream);
-        Pa_CloseStream(stream);
-        Pa_Terminate();
+        auto ring = std::make_shared<RtpPacketRing>(8);
+        auto packetizer = std::make_shared<RtpPacketizer>(*ring, rd(), preferredPayloadType, rd(), rd()); // random ssrc/seq/timestamp
+        auto pcm = std::make_shared<std::vector<int16_t>>(frameSize);
+
+        // 每 20 ms 由 pacer 线程回调一次, 声卡里已有的整帧全部发出;
+        // 不够一帧时不等待也不推进时间戳 (时间戳只跟着读出的采样走), 晚到的帧下个 tick 照常发出
+        pacer.add(20000, [=](uint64_t) {
+            while (Pa_GetStreamReadAvailable(stream) >= frameSize) {
+                Pa_ReadStream(stream, pcm->data(), frameSize);
+
+                uint8_t *payload = packetizer->payload();
+                if (!payload) {
+                    // 采样已经读出, 丢掉这一帧也要推进时间戳
+                    packetizer->skip(frameSize);
+                    continue;
+                }
+
+                // encode straight into the packet slot
+                const int maxFrameBytes = (int)std::min<size_t>(4000, packetizer->payloadCapacity());
+                int nbBytes = opus_encode(enc, pcm->data(), frameSize, payload, maxFrameBytes);
+                if (nbBytes < 0) {
+                    packetizer->abort();
+                    packetizer->skip(frameSize);
+                    continue;
+                }
+
+                // timestamp increment: frameSize samples (48000Hz * 0.02s = 960)
+                RtpPacket pkt = packetizer->commit(nbBytes, frameSize);
+                // send via libdatachannel track -> libdatachannel will SRTP-protect and send via libjuice/ICE
+                track->send(reinterpret_cast<const rtc::byte *>(pkt.data), pkt.size);
+                ring->release(pkt);
+            }
+            return true;
+        });
     });
 
-    // TODO: exchange SDP/candidates with remote via your signaling. When done, libdatachannel will take care of DTLS/SRTP.
-    // Example: createOffer / setLocalDescription is called internally when addTrack + setLocalDescription is invoked in some patterns.
-    // For explicit flow, call pc->setLocalDescription() etc as in libdatachannel examples.
-
     // Keep process alive (in real app, your event loop)
     std::this_thread::sleep_for(std::chrono::hours(24));
     return 0;
@@ -0,0 +1,205 @@
+#include "ice_agent_mgr.h"
+#include <cstring>
+
+IceAgent::IceAgent(IceAgentMgr &mgr) :
+    m_mgr(mgr),
+    m_agent(nullptr),
+    m_connect_us(-1),
+    m_failed(false)
+{
+}
+
+IceAgent::~IceAgent()
+{
+    // juice_destroy 会等 libjuice 线程里正在执行的回调结束
+    if (m_agent) {
+        juice_destroy(m_agent);
+    }
+    m_mgr.onDestroyed();
+}
+
+bool IceAgent::gather()
+{
+    m_gather_time = std::chrono::steady_clock::now();
+    return juice_gather_candidates(m_agent) == JUICE_ERR_SUCCESS;
+}
+
+std::string IceAgent::localDescription()
+{
+    char sdp[JUICE_MAX_SDP_STRING_LEN];
+    if (juice_get_local_description(m_agent, sdp, sizeof(sdp)) != JUICE_ERR_SUCCESS) {
+        return std::string();
+    }
+    return sdp;
+}
+
+bool IceAgent::setRemoteDescription(const std::string &sdp)
+{
+    return juice_set_remote_description(m_agent, sdp.c_str()) == JUICE_ERR_SUCCESS;
+}
+
+bool IceAgent::addRemoteCandidate(const std::string &sdp)
+{
+    return juice_add_remote_candidate(m_agent, sdp.c_str()) == JUICE_ERR_SUCCESS;
+}
+
+void IceAgent::setRemoteGatheringDone()
+{
+    juice_set_remote_gathering_done(m_agent);
+}
+
+bool IceAgent::send(const char *data, std::size_t size)
+{
+    return juice_send(m_agent, data, size) == JUICE_ERR_SUCCESS;
+}
+
+juice_state_t IceAgent::state()
+{
+    return juice_get_state(m_agent);
+}
+
+bool IceAgent::selectedAddresses(std::string &local, std::string &remote)
+{
+    char local_addr[JUICE_MAX_ADDRESS_STRING_LEN];
+    char remote_addr[JUICE_MAX_ADDRESS_STRING_LEN];
+    if (juice_get_selected_addresses(m_agent, local_addr, sizeof(local_addr), remote_addr, sizeof(remote_addr))
+        != JUICE_ERR_SUCCESS) {
+        return false;
+    }
+    local = local_addr;
+    remote = remote_addr;
+    return true;
+}
+
+void IceAgent::onStateChanged(juice_agent_t *, juice_state_t state, void *user_ptr)
+{
+    IceAgent *self = static_cast<IceAgent *>(user_ptr);
+    if ((state == JUICE_STATE_CONNECTED || state == JUICE_STATE_COMPLETED) && self->m_connect_us.load() < 0) {
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()
+                                                                           - self->m_gather_time)
+                         .count();
+        self->m_connect_us.store(us);
+        self->m_mgr.onConnected(us);
+    }
+    else if (state == JUICE_STATE_FAILED && !self->m_failed) {
+        self->m_failed = true;
+        self->m_mgr.onFailed();
+    }
+    if (self->m_on_state_changed) {
+        self->m_on_state_changed(state);
+    }
+}
+
+void IceAgent::onCandidate(juice_agent_t *, const char *sdp, void *user_ptr)
+{
+    IceAgent *self = static_cast<IceAgent *>(user_ptr);
+    if (self->m_on_candidate) {
+        self->m_on_candidate(sdp);
+    }
+}
+
+void IceAgent::onGatheringDone(juice_agent_t *, void *user_ptr)
+{
+    IceAgent *self = static_cast<IceAgent *>(user_ptr);
+    if (self->m_on_gathering_done) {
+        self->m_on_gathering_done();
+    }
+}
+
+void IceAgent::onRecv(juice_agent_t *, const char *data, size_t size, void *user_ptr)
+{
+    IceAgent *self = static_cast<IceAgent *>(user_ptr);
+    if (self->m_on_recv) {
+        self->m_on_recv(data, size);
+    }
+}
+
+IceAgentMgr::IceAgentMgr() :
+    IceAgentMgr(Config())
+{
+}
+
+IceAgentMgr::IceAgentMgr(const Config &cfg) :
+    m_cfg(cfg),
+    m_agents(0),
+    m_created(0),
+    m_connected(0),
+    m_failed(0),
+    m_connect_us_sum(0),
+    m_connect_us_max(0)
+{
+}
+
+IceAgent::Sptr IceAgentMgr::createAgent()
+{
+    IceAgent::Sptr agent(new IceAgent(*this));
+    m_agents.fetch_add(1);
+    m_created.fetch_add(1);
+
+    juice_config_t cfg;
+    std::memset(&cfg, 0, sizeof(cfg));
+    cfg.concurrency_mode = m_cfg.mux ? JUICE_CONCURRENCY_MODE_MUX : JUICE_CONCURRENCY_MODE_POLL;
+    if (!m_cfg.stun_host.empty()) {
+        cfg.stun_server_host = const_cast<char *>(m_cfg.stun_host.c_str());
+        cfg.stun_server_port = m_cfg.stun_port;
+    }
+    // 对称 NAT 后面的一端拿不到可用的直连候选, 由 TURN 的 relayed 候选兜底
+    juice_turn_server_t turn;
+    if (!m_cfg.turn_host.empty()) {
+        std::memset(&turn, 0, sizeof(turn));
+        turn.host = m_cfg.turn_host.c_str();
+        turn.port = m_cfg.turn_port;
+        turn.username = m_cfg.turn_username.c_str();
+        turn.password = m_cfg.turn_password.c_str();
+        cfg.turn_servers = &turn;
+        cfg.turn_servers_count = 1;
+    }
+    if (!m_cfg.bind_address.empty()) {
+        cfg.bind_address = m_cfg.bind_address.c_str();
+    }
+    // MUX 模式下端口范围必须只有一个端口, 所有 agent 才会共用同一个 socket
+    cfg.local_port_range_begin = m_cfg.port;
+    cfg.local_port_range_end = m_cfg.port;
+    cfg.cb_state_changed = &IceAgent::onStateChanged;
+    cfg.cb_candidate = &IceAgent::onCandidate;
+    cfg.cb_gathering_done = &IceAgent::onGatheringDone;
+    cfg.cb_recv = &IceAgent::onRecv;
+    cfg.user_ptr = agent.get();
+
+    agent->m_agent = juice_create(&cfg);
+    if (!agent->m_agent) {
+        return nullptr;
+    }
+    return agent;
+}
+
+IceAgentMgr::Stats IceAgentMgr::stats() const
+{
+    Stats s;
+    s.agents = m_agents.load();
+    s.created = m_created.load();
+    s.connected = m_connected.load();
+    s.failed = m_failed.load();
+    s.connect_avg_ms = s.connected ? m_connect_us_sum.load() / 1000.0 / s.connected : 0;
+    s.connect_max_ms = m_connect_us_max.load() / 1000.0;
+    return s;
+}
+
+void IceAgentMgr::onConnected(int64_t connect_us)
+{
+    m_connected.fetch_add(1);
+    m_connect_us_sum.fetch_add(static_cast<uint64_t>(connect_us));
+    int64_t max = m_connect_us_max.load();
+    while (connect_us > max && !m_connect_us_max.compare_exchange_weak(max, connect_us)) {
+    }
+}
+
+void IceAgentMgr::onFailed()
+{
+    m_failed.fetch_add(1);
+}
+
+void IceAgentMgr::onDestroyed()
+{
+    m_agents.fetch_sub(1);
+}
@@ -0,0 +1,160 @@
+#ifndef _ICE_AGENT_MGR_H_
+#define _ICE_AGENT_MGR_H_
+
+extern "C" {
+#include <juice/juice.h>
+}
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+class IceAgentMgr;
+
+/**
+ * @brief 一个 libjuice agent 的封装, 状态 / 候选 / 数据都通过回调通知
+ *
+ * 回调在 libjuice 的线程里执行 (MUX 模式下所有 agent 共用一个线程), 不能阻塞,
+ * 也不能在回调里销毁 agent; 回调要在 gather 之前设置
+ */
+class IceAgent
+{
+public:
+    using Sptr = std::shared_ptr<IceAgent>;
+    using OnStateChanged = std::function<void(juice_state_t state)>;
+    // sdp 为 a=candidate 行, 可以直接通过信令 trickle 给对端
+    using OnCandidate = std::function<void(const char *sdp)>;
+    using OnGatheringDone = std::function<void()>;
+    using OnRecv = std::function<void(const char *data, std::size_t size)>;
+
+    ~IceAgent();
+
+    IceAgent(const IceAgent &) = delete;
+    IceAgent &operator=(const IceAgent &) = delete;
+
+    void setOnStateChanged(OnStateChanged cb)
+    {
+        m_on_state_changed = std::move(cb);
+    }
+
+    void setOnCandidate(OnCandidate cb)
+    {
+        m_on_candidate = std::move(cb);
+    }
+
+    void setOnGatheringDone(OnGatheringDone cb)
+    {
+        m_on_gathering_done = std::move(cb);
+    }
+
+    void setOnRecv(OnRecv cb)
+    {
+        m_on_recv = std::move(cb);
+    }
+
+    bool gather();
+    // gather 之后立即可取, 候选通过 OnCandidate 陆续给出
+    std::string localDescription();
+    bool setRemoteDescription(const std::string &sdp);
+    bool addRemoteCandidate(const std::string &sdp);
+    void setRemoteGatheringDone();
+
+    bool send(const char *data, std::size_t size);
+    juice_state_t state();
+    // 地址格式为 ip:port
+    bool selectedAddresses(std::string &local, std::string &remote);
+
+    // 从 gather 到第一次 CONNECTED 的耗时, 未连接时为 -1
+    double connectMs() const
+    {
+        int64_t us = m_connect_us.load();
+        return us < 0 ? -1 : us / 1000.0;
+    }
+
+private:
+    friend class IceAgentMgr;
+
+    explicit IceAgent(IceAgentMgr &mgr);
+
+    static void onStateChanged(juice_agent_t *agent, juice_state_t state, void *user_ptr);
+    static void onCandidate(juice_agent_t *agent, const char *sdp, void *user_ptr);
+    static void onGatheringDone(juice_agent_t *agent, void *user_ptr);
+    static void onRecv(juice_agent_t *agent, const char *data, size_t size, void *user_ptr);
+
+private:
+    IceAgentMgr &m_mgr;
+    juice_agent_t *m_agent;
+    std::chrono::steady_clock::time_point m_gather_time;
+    std::atomic<int64_t> m_connect_us;
+    bool m_failed;
+
+    OnStateChanged m_on_state_changed;
+    OnCandidate m_on_candidate;
+    OnGatheringDone m_on_gathering_done;
+    OnRecv m_on_recv;
+};
+
+/**
+ * @brief 创建和统计 ICE agent
+ *
+ * 默认用 libjuice 的 JUICE_CONCURRENCY_MODE_MUX: 所有 agent 共用 port 上的一个 UDP socket
+ * 和一个线程, 按 STUN 用户名分发, 成千上万个 agent 也只占一个端口;
+ * 建连完全由回调驱动, 没有固定的 sleep 或轮询
+ * 管理器要比它创建的所有 agent 活得久
+ */
+class IceAgentMgr
+{
+public:
+    struct Config {
+        std::string stun_host;
+        uint16_t stun_port = 3478;
+        std::string turn_host;      // 为空时不用 TURN 中继
+        uint16_t turn_port = 3478;
+        std::string turn_username;
+        std::string turn_password;
+        std::string bind_address;   // 为空时监听所有地址
+        uint16_t port = 0;          // MUX 模式下所有 agent 共用的端口, 要共用时必须指定
+        bool mux = true;
+    };
+
+    struct Stats {
+        uint64_t agents;       // 当前存活
+        uint64_t created;
+        uint64_t connected;
+        uint64_t failed;
+        double connect_avg_ms; // 已连接 agent 的平均建连耗时
+        double connect_max_ms;
+    };
+
+    IceAgentMgr();
+    explicit IceAgentMgr(const Config &cfg);
+
+    IceAgentMgr(const IceAgentMgr &) = delete;
+    IceAgentMgr &operator=(const IceAgentMgr &) = delete;
+
+    // 失败返回 nullptr
+    IceAgent::Sptr createAgent();
+
+    Stats stats() const;
+
+private:
+    friend class IceAgent;
+
+    void onConnected(int64_t connect_us);
+    void onFailed();
+    void onDestroyed();
+
+private:
+    Config m_cfg;
+    std::atomic<uint64_t> m_agents;
+    std::atomic<uint64_t> m_created;
+    std::atomic<uint64_t> m_connected;
+    std::atomic<uint64_t> m_failed;
+    std::atomic<uint64_t> m_connect_us_sum;
+    std::atomic<int64_t> m_connect_us_max;
+};
+
+#endif // _ICE_AGENT_MGR_H_
@@ -1,186 +1,222 @@
-// juice_jrtp_demo.cpp
+// juice_rtp_demo.cpp
 // Build example:
-// g++ juice_jrtp_demo.cpp -o juice_jrtp_demo `pkg-config --cflags --libs` -ljuice -ljrtplib -pthread
+// g++ juice_rtp_demo.cpp -o juice_rtp_demo -I../rtp/src `pkg-config --cflags --libs` -ljuice -lrtp -pthread
 //
-// Note: adjust pkg-config include flags as needed. Ensure juice/juice.h and jrtplib headers are installed.
+// Note: adjust pkg-config include flags as needed. Ensure juice/juice.h and boost headers are installed.
 
 #include <iostream>
 #include <string>
-#include <thread>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <cstring>
-#include <arpa/inet.h>
+#include <mutex>
 
-extern "C" {
-#include <juice/juice.h>
-}
-
-#include "jrtplib3/rtpsession.h"
-#include "jrtplib3/rtpudpv4transmitter.h"
-#include "jrtplib3/rtpipv4address.h"
-#include "jrtplib3/rtpsessionparams.h"
-#include "jrtplib3/rtperrors.h"
-
-using namespace jrtplib;
+#include "ice_agent_mgr.h"
+#include "rtp_transport.h"
+#include "signaling_client.h"
+#include <boost/asio.hpp>
+#include <functional>
 
-static juice_agent_t *agent = nullptr;
-
-static void print_error_and_exit(const char *msg)
+// "ip:port" 拆成 ip 和端口
+static bool split_address(const std::string &addr, std::string &ip, int &port)
 {
-    std::cerr << msg << std::endl;
-    if (agent)
-        juice_destroy(agent);
-    exit(1);
+    std::size_t pos = addr.rfind(':');
+    if (pos == std::string::npos) {
+        return false;
+    }
+    ip = addr.substr(0, pos);
+    port = atoi(addr.c_str() + pos + 1);
+    return true;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
-    // 1) 配置 libjuice agent
-    juice_config_t cfg;
-    memset(&cfg, 0, sizeof(cfg));
-    // 可选：设置 STUN 服务器（方便公网映射发现）：
-    cfg.stun_server_host = const_cast<char *>("stun.l.google.com");
-    cfg.stun_server_port = 19302;
-    // cfg.turn_servers = ... // 若需要 TURN，按 libjuice README 填写
-    // 回调可以置空（demo 将轮询状态），但你也可以设置 cb_recv/cb_state_changed 等
-    cfg.user_ptr = nullptr;
-    cfg.cb_state_changed = nullptr;
-    cfg.cb_candidate = nullptr;
-    cfg.cb_gathering_done = nullptr;
-    cfg.cb_recv = nullptr;
-
-    agent = juice_create(&cfg);
-    if (!agent)
-        print_error_and_exit("juice_create failed");
-
-    std::cout << "[libjuice] agent created\n";
-
-    // 2) 开始收集候选
-    if (juice_gather_candidates(agent) != JUICE_ERR_SUCCESS) {
-        print_error_and_exit("juice_gather_candidates failed");
+    // demo ws_host:port voip|robot id [turn_ip:port user:password]
+    std::string ws_host;
+    int ws_port = 0;
+    if (argc < 4 || !split_address(argv[1], ws_host, ws_port)
+        || (std::strcmp(argv[2], "voip") != 0 && std::strcmp(argv[2], "robot") != 0)) {
+        std::cerr << "usage: " << argv[0] << " ws_host:port voip|robot id [turn_ip:port user:password]" << std::endl;
+        return 1;
     }
 
-    // 小等一下让初次 gather 触发（生产不 rely on sleep）
-    std::this_thread::sleep_for(std::chrono::milliseconds(300));
-
-    // 3) 获取本地 description（SDP-like），打印以便通过信令发给 peer
-    char sdp[JUICE_MAX_SDP_STRING_LEN] = {0};
-    if (juice_get_local_description(agent, sdp, sizeof(sdp)) != JUICE_ERR_SUCCESS) {
-        print_error_and_exit("juice_get_local_description failed");
-    }
-    std::cout << "=== LOCAL DESCRIPTION (send this to remote peer) ===\n";
-    std::cout << sdp << "\n";
-    std::cout << "=== END ===\n\n";
-
-    // 4) 等候用户把 remote description paste 回来（在真实应用这一步通过信令自动）
-    std::cout << "Paste remote description (end with a single line containing only END), then press Enter:\n";
-    std::string remote_sdp;
-    std::string line;
-    while (true) {
-        if (!std::getline(std::cin, line))
-            break;
-        if (line == "END")
-            break;
-        remote_sdp += line + "\n";
-    }
-    if (remote_sdp.empty()) {
-        print_error_and_exit("No remote description provided");
+    // 1) 配置 ICE agent 管理器: MUX 模式, 所有 agent 共用一个 UDP 端口和一个线程
+    IceAgentMgr::Config ice_cfg;
+    // 可选：设置 STUN 服务器（方便公网映射发现）：
+    ice_cfg.stun_host = "stun.l.google.com";
+    ice_cfg.stun_port = 19302;
+    ice_cfg.port = 40000;
+    // 可选: 指定 TURN 中继 (如 turn-relay-server), 参数为 turn_ip:port user:password
+    if (argc >= 6) {
+        int turn_port = 0;
+        std::string credential = argv[5];
+        std::size_t colon = credential.find(':');
+        if (!split_address(argv[4], ice_cfg.turn_host, turn_port) || colon == std::string::npos) {
+            std::cerr << "invalid turn server: " << argv[4] << " " << argv[5] << std::endl;
+            return 1;
+        }
+        ice_cfg.turn_port = static_cast<uint16_t>(turn_port);
+        ice_cfg.turn_username = credential.substr(0, colon);
+        ice_cfg.turn_password = credential.substr(colon + 1);
     }
+    IceAgentMgr ice_mgr(ice_cfg);
 
-    // 5) 设置远端 description
-    if (juice_set_remote_description(agent, remote_sdp.c_str()) != JUICE_ERR_SUCCESS) {
-        print_error_and_exit("juice_set_remote_description failed");
+    IceAgent::Sptr agent = ice_mgr.createAgent();
+    if (!agent) {
+        std::cerr << "create ICE agent failed" << std::endl;
+        return 1;
     }
-    std::cout << "[libjuice] remote description set\n";
+    std::cout << "[libjuice] agent created\n";
 
-    // 6) 再次确保 candidates 正在收集（如果你用 trickle ICE，可在这里处理）
-    // juice_gather_candidates(agent); // optional depending on your signaling/trickle design
+    // 2) 状态和候选由回调通知, 主线程只在条件变量上等, 没有固定的 sleep / 轮询
+    std::mutex mtx;
+    std::condition_variable cv;
+    juice_state_t ice_state = JUICE_STATE_DISCONNECTED;
+    bool peer_left = false;
+    SignalingClient signaling;
+    agent->setOnStateChanged([&](juice_state_t state) {
+        std::lock_guard<std::mutex> lock(mtx);
+        ice_state = state;
+        cv.notify_all();
+    });
+    // trickle: 每个候选一出来就通过信令发给对端, 不等收集结束
+    agent->setOnCandidate([&](const char *sdp) {
+        signaling.sendCandidate(sdp, "0");
+    });
+    agent->setOnGatheringDone([&]() {
+        std::cout << "[libjuice] gathering done\n";
+        signaling.sendEndOfCandidates();
+    });
+
+    // 3) 经 WsServer 交换 description 和候选: 配对后 voip 一方发 offer, robot 回 answer;
+    // 各自先发 description 再开始收集, 保证对端先收到 description 再收到候选
+    auto start_ice = [&](const char *type) {
+        signaling.sendDescription(type, agent->localDescription());
+        if (!agent->gather()) {
+            std::cerr << "juice_gather_candidates failed" << std::endl;
+        }
+    };
+    signaling.setOnMessage([&](const SignalingClient::Message &msg) {
+        switch (msg.type) {
+            case SignalingClient::kPaired:
+                std::cout << "[signaling] paired with " << msg.peer << (msg.offerer ? ", sending offer\n" : "\n");
+                if (msg.offerer) {
+                    start_ice("offer");
+                }
+                break;
+            case SignalingClient::kOffer:
+                agent->setRemoteDescription(msg.sdp);
+                start_ice("answer");
+                break;
+            case SignalingClient::kAnswer:
+                agent->setRemoteDescription(msg.sdp);
+                break;
+            case SignalingClient::kCandidate:
+                agent->addRemoteCandidate(msg.candidate);
+                break;
+            case SignalingClient::kEndOfCandidates:
+                agent->setRemoteGatheringDone();
+                break;
+            case SignalingClient::kError:
+                std::cerr << "[signaling] error: " << msg.reason << std::endl;
+                break;
+            case SignalingClient::kBye: {
+                std::lock_guard<std::mutex> lock(mtx);
+                peer_left = true;
+                cv.notify_all();
+                break;
+            }
+            default:
+                break;
+        }
+    });
+    std::string target = std::string("/") + argv[2] + "?id=" + argv[3];
+    if (!signaling.connect(ws_host, static_cast<uint16_t>(ws_port), target)) {
+        std::cerr << "connect signaling server " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+    std::cout << "[signaling] joined as " << target << ", waiting for peer ...\n";
 
-    // 7) 等待 ICE 完成（轮询状态，或在真实项目用 cb_state_changed 回调）
+    // 6) 等待 ICE 完成: 状态回调一到就被唤醒
     std::cout << "[libjuice] waiting for ICE to complete ...\n";
-    for (int i = 0; i < 200; ++i) { // 超时约 20s
-        juice_state_t state = juice_get_state(agent);
-        if (state == JUICE_STATE_COMPLETED || state == JUICE_STATE_CONNECTED) {
-            std::cout << "[libjuice] ICE completed/connected\n";
-            break;
-        }
-        else if (state == JUICE_STATE_FAILED || state == JUICE_STATE_DISCONNECTED) {
-            print_error_and_exit("ICE failed/disconnected");
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        bool done = cv.wait_for(lock, std::chrono::seconds(60), [&]() {
+            return ice_state == JUICE_STATE_CONNECTED || ice_state == JUICE_STATE_COMPLETED
+                   || ice_state == JUICE_STATE_FAILED || peer_left;
+        });
+        if (!done || ice_state == JUICE_STATE_FAILED || peer_left) {
+            std::cerr << "ICE failed/timeout" << std::endl;
+            return 1;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+    std::cout << "[libjuice] ICE completed/connected in " << agent->connectMs() << " ms\n";
 
-    // 8) 取得选定地址（local / remote）
-    char local_ip[JUICE_MAX_ADDRESS_STRING_LEN] = {0};
-    char remote_ip[JUICE_MAX_ADDRESS_STRING_LEN] = {0};
-    int local_port = 0, remote_port = 0;
-    if (juice_get_selected_addresses(agent,
-                                     local_ip, sizeof(local_ip),
-                                     remote_ip, sizeof(remote_ip)) != JUICE_ERR_SUCCESS) {
-        print_error_and_exit("juice_get_selected_addresses failed");
+    // 7) 取得选定地址（local / remote）
+    std::string local_addr, remote_addr;
+    if (!agent->selectedAddresses(local_addr, remote_addr)) {
+        std::cerr << "juice_get_selected_addresses failed" << std::endl;
+        return 1;
     }
+    std::string local_ip, remote_ip;
+    int local_port = 0, remote_port = 0;
+    split_address(local_addr, local_ip, local_port);
+    split_address(remote_addr, remote_ip, remote_port);
 
     std::cout << "[libjuice] selected addresses:\n";
     std::cout << "  local  = " << local_ip << ":" << local_port << "\n";
     std::cout << "  remote = " << remote_ip << ":" << remote_port << "\n";
 
-    // 9) 用 jrtplib 绑定本地端口并向 remote 推 RTP
-    RTPSession sess;
-    RTPUDPv4TransmissionParams transparams;
-    RTPSessionParams sessparams;
-
-    // 设置时基（示例 8kHz 音频），以及其它参数按需调整
-    sessparams.SetOwnTimestampUnit(1.0 / 8000.0);
-    sessparams.SetAcceptOwnPackets(true);
-
-    // 注意：jrtplib 的 SetPortbase 只设置 RTP 端口，本例假设 remote_port 对应 RTP。
-    transparams.SetPortbase((uint16_t)local_port);
-
-    int status = sess.Create(sessparams, &transparams);
-    if (status < 0) {
-        std::cerr << "jrtplib Create error: " << RTPGetErrorString(status) << std::endl;
-        juice_destroy(agent);
+    // 8) 在 io_context 上打开 RTP 传输并向 remote 推 RTP
+    boost::asio::io_context ioc;
+    RtpTransport::Config rtp_cfg;
+    // 示例 8kHz 音频, 每包 160 个采样
+    rtp_cfg.clock_rate = 8000;
+    rtp_cfg.payload_type = 96;
+    RtpTransport::Sptr rtp = RtpTransport::create(ioc, rtp_cfg);
+    // 选定的本地端口被 agent 的 socket 占用, RTP 另外绑定一个端口
+    if (!rtp->open("", 0)) {
+        std::cerr << "RtpTransport open failed" << std::endl;
         return 1;
     }
-
-    // 转换 remote IP 为网络序
-    in_addr addr;
-    if (inet_aton(remote_ip, &addr) == 0) {
+    if (!rtp->connect(remote_ip, (uint16_t)remote_port)) {
         std::cerr << "Invalid remote IP: " << remote_ip << std::endl;
-        sess.BYEDestroy(RTPTime(0, 0), NULL, 0);
-        juice_destroy(agent);
-        return 1;
-    }
-    uint32_t ip_n = ntohl(addr.s_addr);
-    RTPIPv4Address dest((uint8_t *)&ip_n, (uint16_t)remote_port);
-
-    status = sess.AddDestination(dest);
-    if (status < 0) {
-        std::cerr << "AddDestination error: " << RTPGetErrorString(status) << std::endl;
-        sess.BYEDestroy(RTPTime(0, 0), NULL, 0);
-        juice_destroy(agent);
         return 1;
     }
-
-    std::cout << "[jrtplib] started. Sending 20 RTP packets to " << remote_ip << ":" << remote_port << "\n";
-
-    // 10) 发送 RTP 包（示例 payload），真实场景把编码后音频帧塞入
-    for (int i = 0; i < 20; ++i) {
-        const char payload[] = "libjuice+jrtplib demo payload";
-        int send_status = sess.SendPacket((void *)payload, (int)strlen(payload), /*pt=*/96, /*mark=*/false, /*timestamp_inc=*/160);
-        if (send_status < 0) {
-            std::cerr << "SendPacket error: " << RTPGetErrorString(send_status) << std::endl;
-            break;
+    rtp->start();
+
+    std::cout << "[rtp] started. Sending 20 RTP packets to " << remote_ip << ":" << remote_port << "\n";
+
+    // 9) 定时器驱动发送 RTP 包（示例 payload），真实场景把编码后音频帧塞入
+    boost::asio::steady_timer timer(ioc);
+    int sent = 0;
+    std::function<void()> send_next = [&]() {
+        const char payload[] = "libjuice+rtp demo payload";
+        if (!rtp->send((const uint8_t *)payload, strlen(payload), /*timestamp_inc=*/160)) {
+            std::cerr << "send RTP packet failed" << std::endl;
+            rtp->close();
+            return;
         }
-        RTPTime::Wait(RTPTime(0, 200000)); // 200ms
-    }
-
-    sess.BYEDestroy(RTPTime(3, 0), NULL, 0);
-    std::cout << "[jrtplib] finished sending, session closed\n";
-
-    // 11) cleanup libjuice
-    juice_destroy(agent);
-    agent = nullptr;
+        if (++sent == 20) {
+            rtp->close();
+            return;
+        }
+        timer.expires_after(std::chrono::milliseconds(200));
+        timer.async_wait([&](const boost::system::error_code &ec) {
+            if (!ec) {
+                send_next();
+            }
+        });
+    };
+    send_next();
+    ioc.run();
+
+    std::cout << "[rtp] finished sending, session closed\n";
+
+    // 10) 先停信令线程 (它的回调会用到 agent), 再在 agent 析构时销毁 libjuice agent
+    signaling.close();
+    agent.reset();
 
     return 0;
 }
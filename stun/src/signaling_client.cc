@@ -0,0 +1,311 @@
+#include "signaling_client.h"
+#include <cstdio>
+#include <cstring>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+using tcp = boost::asio::ip::tcp;
+
+static const char *kTypeNames[] = {
+    "",
+    "offer",
+    "answer",
+    "candidate",
+    "end-of-candidates",
+    "paired",
+    "bye",
+    "error",
+};
+
+static void appendString(std::string &out, const std::string &s)
+{
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+static void skipSpace(const std::string &s, std::size_t &i)
+{
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) {
+        ++i;
+    }
+}
+
+// 读一个 JSON 字符串, \u 只处理 BMP 内的字符
+static bool readString(const std::string &s, std::size_t &i, std::string &out)
+{
+    if (i >= s.size() || s[i] != '"') {
+        return false;
+    }
+    out.clear();
+    for (++i; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '"') {
+            ++i;
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++i >= s.size()) {
+            return false;
+        }
+        switch (s[i]) {
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'u': {
+                if (i + 4 >= s.size()) {
+                    return false;
+                }
+                unsigned cp = static_cast<unsigned>(strtoul(s.substr(i + 1, 4).c_str(), nullptr, 16));
+                i += 4;
+                if (cp < 0x80) {
+                    out += static_cast<char>(cp);
+                }
+                else if (cp < 0x800) {
+                    out += static_cast<char>(0xC0 | (cp >> 6));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                else {
+                    out += static_cast<char>(0xE0 | (cp >> 12));
+                    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            default:
+                out += s[i];
+        }
+    }
+    return false;
+}
+
+// 跳过非字符串的值 (数字 / true / false / null)
+static void skipValue(const std::string &s, std::size_t &i)
+{
+    while (i < s.size() && s[i] != ',' && s[i] != '}') {
+        ++i;
+    }
+}
+
+SignalingClient::SignalingClient() :
+    m_ws(m_ioc),
+    m_open(false)
+{
+}
+
+SignalingClient::~SignalingClient()
+{
+    close();
+}
+
+void SignalingClient::setOnMessage(OnMessage cb)
+{
+    m_on_message = std::move(cb);
+}
+
+void SignalingClient::setOnClose(OnClose cb)
+{
+    m_on_close = std::move(cb);
+}
+
+bool SignalingClient::connect(const std::string &host, uint16_t port, const std::string &target)
+{
+    beast::error_code ec;
+    tcp::resolver resolver(m_ioc);
+    auto results = resolver.resolve(host, std::to_string(port), ec);
+    if (ec) {
+        return false;
+    }
+    boost::asio::connect(m_ws.next_layer(), results.begin(), results.end(), ec);
+    if (ec) {
+        return false;
+    }
+    // 信令消息很小, 关掉 Nagle 避免候选在内核里攒包
+    m_ws.next_layer().set_option(tcp::no_delay(true), ec);
+    m_ws.handshake(host + ":" + std::to_string(port), target, ec);
+    if (ec) {
+        return false;
+    }
+    m_ws.text(true);
+    m_open.store(true);
+    m_thread = std::thread([this]() {
+        run();
+    });
+    return true;
+}
+
+void SignalingClient::close()
+{
+    if (m_open.exchange(false)) {
+        // 关闭 socket 让阻塞的 read 返回, 服务器按断线处理并通知对端 bye
+        beast::error_code ec;
+        m_ws.next_layer().shutdown(tcp::socket::shutdown_both, ec);
+    }
+    if (m_thread.joinable() && m_thread.get_id() != std::this_thread::get_id()) {
+        m_thread.join();
+    }
+}
+
+bool SignalingClient::sendDescription(const std::string &type, const std::string &sdp)
+{
+    std::string msg = "{\"type\":";
+    appendString(msg, type);
+    msg += ",\"sdp\":";
+    appendString(msg, sdp);
+    msg += '}';
+    return sendText(msg);
+}
+
+bool SignalingClient::sendCandidate(const std::string &candidate, const std::string &mid)
+{
+    std::string msg = "{\"type\":\"candidate\",\"candidate\":";
+    appendString(msg, candidate);
+    msg += ",\"mid\":";
+    appendString(msg, mid);
+    msg += '}';
+    return sendText(msg);
+}
+
+bool SignalingClient::sendEndOfCandidates()
+{
+    return sendText("{\"type\":\"end-of-candidates\"}");
+}
+
+bool SignalingClient::sendText(const std::string &msg)
+{
+    if (!m_open.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_write_mtx);
+    beast::error_code ec;
+    m_ws.write(boost::asio::buffer(msg), ec);
+    return !ec;
+}
+
+bool SignalingClient::parse(const std::string &json, Message &msg)
+{
+    msg = Message();
+    std::size_t i = 0;
+    skipSpace(json, i);
+    if (i >= json.size() || json[i++] != '{') {
+        return false;
+    }
+    std::string key, value;
+    while (true) {
+        skipSpace(json, i);
+        if (i < json.size() && json[i] == '}') {
+            break;
+        }
+        if (!readString(json, i, key)) {
+            return false;
+        }
+        skipSpace(json, i);
+        if (i >= json.size() || json[i++] != ':') {
+            return false;
+        }
+        skipSpace(json, i);
+        value.clear();
+        if (i < json.size() && json[i] == '"') {
+            if (!readString(json, i, value)) {
+                return false;
+            }
+        }
+        else {
+            skipValue(json, i);
+        }
+        if (key == "type") {
+            for (int t = kOffer; t <= kError; ++t) {
+                if (value == kTypeNames[t]) {
+                    msg.type = static_cast<Type>(t);
+                }
+            }
+        }
+        else if (key == "sdp") {
+            msg.sdp = value;
+        }
+        else if (key == "candidate") {
+            msg.candidate = value;
+        }
+        else if (key == "mid") {
+            msg.mid = value;
+        }
+        else if (key == "peer") {
+            msg.peer = value;
+        }
+        else if (key == "role") {
+            msg.offerer = value == "offerer";
+        }
+        else if (key == "reason") {
+            msg.reason = value;
+        }
+        skipSpace(json, i);
+        if (i < json.size() && json[i] == ',') {
+            ++i;
+        }
+    }
+    return msg.type != kUnknown;
+}
+
+void SignalingClient::run()
+{
+    beast::flat_buffer buffer;
+    Message msg;
+    while (m_open.load()) {
+        beast::error_code ec;
+        m_ws.read(buffer, ec);
+        if (ec) {
+            break;
+        }
+        // 二进制帧是媒体数据, 信令只看文本帧
+        if (m_ws.got_text() && parse(beast::buffers_to_string(buffer.data()), msg) && m_on_message) {
+            m_on_message(msg);
+        }
+        buffer.consume(buffer.size());
+    }
+    m_open.store(false);
+    if (m_on_close) {
+        m_on_close();
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef _SIGNALING_CLIENT_H_
+#define _SIGNALING_CLIENT_H_
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief 连接 WsServer 的信令客户端, 用于 demo 之间交换 SDP 和 trickle 候选
+ *
+ * 以 /voip?id= 或 /robot?id= 登录, 服务器配对后下发 paired, voip 一方为 offerer;
+ * 之后 offer / answer / candidate / end-of-candidates 由服务器原样转给对端
+ * 收消息在内部线程里阻塞读, 回调也在这个线程里执行; 发送可以在任意线程
+ */
+class SignalingClient
+{
+public:
+    enum Type {
+        kUnknown,
+        kOffer,
+        kAnswer,
+        kCandidate,
+        kEndOfCandidates,
+        kPaired,
+        kBye,
+        kError,
+    };
+
+    struct Message {
+        Type type = kUnknown;
+        std::string sdp;       // offer / answer
+        std::string candidate; // candidate
+        std::string mid;
+        std::string peer;      // paired / bye
+        bool offerer = false;  // paired
+        std::string reason;    // error
+    };
+
+    using OnMessage = std::function<void(const Message &msg)>;
+    using OnClose = std::function<void()>;
+
+    SignalingClient();
+    ~SignalingClient();
+
+    SignalingClient(const SignalingClient &) = delete;
+    SignalingClient &operator=(const SignalingClient &) = delete;
+
+    // 回调要在 connect 之前设置
+    void setOnMessage(OnMessage cb);
+    void setOnClose(OnClose cb);
+
+    // 阻塞完成 WebSocket 握手后启动收消息线程; target 如 "/voip?id=1"
+    bool connect(const std::string &host, uint16_t port, const std::string &target);
+    void close();
+
+    // type 为 "offer" 或 "answer"
+    bool sendDescription(const std::string &type, const std::string &sdp);
+    bool sendCandidate(const std::string &candidate, const std::string &mid);
+    bool sendEndOfCandidates();
+
+    // 只处理信令用到的扁平 JSON 对象
+    static bool parse(const std::string &json, Message &msg);
+
+private:
+    bool sendText(const std::string &msg);
+    void run();
+
+private:
+    boost::asio::io_context m_ioc;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> m_ws;
+    std::mutex m_write_mtx;
+    std::thread m_thread;
+    std::atomic<bool> m_open;
+    OnMessage m_on_message;
+    OnClose m_on_close;
+};
+
+#endif // _SIGNALING_CLIENT_H_
@@ -0,0 +1,288 @@
+#include "stun_message.h"
+#include "rtp_packet.h"
+#include <netinet/in.h>
+#include <cstring>
+
+// FINGERPRINT = CRC-32 ^ 0x5354554e (RFC 5389 15.5)
+static const uint32_t kFingerprintXor = 0x5354554e;
+
+struct Crc32Table {
+    uint32_t v[256];
+
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            v[i] = c;
+        }
+    }
+};
+
+static const Crc32Table kCrc32Table;
+
+static std::size_t padded(std::size_t len)
+{
+    return (len + 3) & ~static_cast<std::size_t>(3);
+}
+
+bool parseStunHeader(const uint8_t *data, std::size_t size, StunHeader &hdr)
+{
+    // 前两位必须为 0, 长度是 4 的倍数且与包长一致
+    if (size < kStunHeaderSize || (data[0] & 0xC0) != 0) {
+        return false;
+    }
+    hdr.type = rtpRead16(data);
+    hdr.length = rtpRead16(data + 2);
+    if ((hdr.length & 3) != 0 || kStunHeaderSize + hdr.length != size
+        || rtpRead32(data + 4) != kStunMagicCookie) {
+        return false;
+    }
+    hdr.transaction_id = data + 8;
+    hdr.integrity = nullptr;
+    hdr.fingerprint = nullptr;
+
+    const uint8_t *p = data + kStunHeaderSize;
+    const uint8_t *end = data + size;
+    while (end - p >= 4) {
+        uint16_t type = rtpRead16(p);
+        uint16_t len = rtpRead16(p + 2);
+        if (static_cast<std::size_t>(end - p - 4) < padded(len)) {
+            return false;
+        }
+        // FINGERPRINT 必须是最后一个属性
+        if (type == kStunAttrFingerprint) {
+            if (len != 4 || p + 8 != end) {
+                return false;
+            }
+            hdr.fingerprint = p + 4;
+        }
+        else if (type == kStunAttrMessageIntegrity && !hdr.integrity) {
+            if (len != kStunIntegritySize) {
+                return false;
+            }
+            hdr.integrity = p + 4;
+        }
+        p += 4 + padded(len);
+    }
+    return p == end;
+}
+
+const uint8_t *nextStunAttribute(const uint8_t *data,
+                                 const StunHeader &hdr,
+                                 const uint8_t *prev,
+                                 uint16_t &type,
+                                 uint16_t &len)
+{
+    // parseStunHeader 已检查过边界; MESSAGE-INTEGRITY 之后的属性 (FINGERPRINT 除外, 它通过 hdr 访问)
+    // 不在完整性保护范围内, 必须忽略 (RFC 5389 15.4), 遍历到 MESSAGE-INTEGRITY 为止
+    const uint8_t *p = prev ? prev + padded(rtpRead16(prev - 2)) : data + kStunHeaderSize;
+    const uint8_t *end = hdr.integrity ? hdr.integrity + kStunIntegritySize : data + kStunHeaderSize + hdr.length;
+    if (end - p < 4) {
+        return nullptr;
+    }
+    type = rtpRead16(p);
+    len = rtpRead16(p + 2);
+    return p + 4;
+}
+
+const uint8_t *findStunAttribute(const uint8_t *data, const StunHeader &hdr, uint16_t type, uint16_t &len)
+{
+    uint16_t t;
+    for (const uint8_t *v = nextStunAttribute(data, hdr, nullptr, t, len); v;
+         v = nextStunAttribute(data, hdr, v, t, len)) {
+        if (t == type) {
+            return v;
+        }
+    }
+    return nullptr;
+}
+
+bool readStunXorAddress(const uint8_t *data,
+                        const uint8_t *value,
+                        uint16_t len,
+                        sockaddr_storage &addr,
+                        socklen_t &addr_len)
+{
+    if (len < 8) {
+        return false;
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    uint16_t port = static_cast<uint16_t>(rtpRead16(value + 2) ^ (kStunMagicCookie >> 16));
+    // 异或用的 16 字节: cookie + 事务 id, 正好是消息的第 4 ~ 20 字节
+    if (value[1] == 0x01 && len == 8) {
+        auto *v4 = reinterpret_cast<sockaddr_in *>(&addr);
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(port);
+        auto *ip = reinterpret_cast<uint8_t *>(&v4->sin_addr);
+        for (int i = 0; i < 4; ++i) {
+            ip[i] = value[4 + i] ^ data[4 + i];
+        }
+        addr_len = sizeof(sockaddr_in);
+        return true;
+    }
+    if (value[1] == 0x02 && len == 20) {
+        auto *v6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(port);
+        auto *ip = reinterpret_cast<uint8_t *>(&v6->sin6_addr);
+        for (int i = 0; i < 16; ++i) {
+            ip[i] = value[4 + i] ^ data[4 + i];
+        }
+        addr_len = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+uint32_t stunCrc32(const uint8_t *data, std::size_t size)
+{
+    uint32_t c = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < size; ++i) {
+        c = kCrc32Table.v[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+bool checkStunFingerprint(const uint8_t *data, const StunHeader &hdr)
+{
+    if (!hdr.fingerprint) {
+        return true;
+    }
+    // CRC 覆盖 FINGERPRINT 属性之前的全部内容, 头里的长度已包含 FINGERPRINT
+    std::size_t covered = static_cast<std::size_t>(hdr.fingerprint - 4 - data);
+    return (stunCrc32(data, covered) ^ kFingerprintXor) == rtpRead32(hdr.fingerprint);
+}
+
+StunWriter::StunWriter(uint8_t *buf, std::size_t cap) :
+    m_buf(buf),
+    m_cap(cap),
+    m_size(0),
+    m_ok(cap >= kStunHeaderSize)
+{
+}
+
+void StunWriter::begin(uint16_t type, const uint8_t *transaction_id)
+{
+    if (!m_ok) {
+        return;
+    }
+    rtpWrite16(m_buf, type);
+    rtpWrite16(m_buf + 2, 0);
+    rtpWrite32(m_buf + 4, kStunMagicCookie);
+    std::memcpy(m_buf + 8, transaction_id, 12);
+    m_size = kStunHeaderSize;
+}
+
+uint8_t *StunWriter::reserve(uint16_t type, std::size_t len)
+{
+    if (!m_ok || m_size + 4 + padded(len) > m_cap || len > 0xFFFF) {
+        m_ok = false;
+        return nullptr;
+    }
+    uint8_t *p = m_buf + m_size;
+    rtpWrite16(p, type);
+    rtpWrite16(p + 2, static_cast<uint16_t>(len));
+    // 填充字节清零
+    std::memset(p + 4 + len, 0, padded(len) - len);
+    m_size += 4 + padded(len);
+    rtpWrite16(m_buf + 2, static_cast<uint16_t>(m_size - kStunHeaderSize));
+    return p + 4;
+}
+
+void StunWriter::addAttribute(uint16_t type, const void *value, std::size_t len)
+{
+    uint8_t *p = reserve(type, len);
+    if (p && len) {
+        std::memcpy(p, value, len);
+    }
+}
+
+void StunWriter::addU32(uint16_t type, uint32_t value)
+{
+    uint8_t *p = reserve(type, 4);
+    if (p) {
+        rtpWrite32(p, value);
+    }
+}
+
+void StunWriter::addXorAddress(uint16_t type, const sockaddr *addr)
+{
+    const uint8_t *ip;
+    std::size_t ip_len;
+    uint16_t port;
+    uint8_t family;
+    if (addr->sa_family == AF_INET) {
+        const auto *v4 = reinterpret_cast<const sockaddr_in *>(addr);
+        ip = reinterpret_cast<const uint8_t *>(&v4->sin_addr);
+        ip_len = 4;
+        port = ntohs(v4->sin_port);
+        family = 0x01;
+    }
+    else if (addr->sa_family == AF_INET6) {
+        const auto *v6 = reinterpret_cast<const sockaddr_in6 *>(addr);
+        ip = reinterpret_cast<const uint8_t *>(&v6->sin6_addr);
+        ip_len = 16;
+        port = ntohs(v6->sin6_port);
+        family = 0x02;
+    }
+    else {
+        m_ok = false;
+        return;
+    }
+    uint8_t *p = reserve(type, 4 + ip_len);
+    if (!p) {
+        return;
+    }
+    // 端口异或 cookie 高 16 位, 地址异或 cookie (+ 事务 id)
+    p[0] = 0;
+    p[1] = family;
+    rtpWrite16(p + 2, static_cast<uint16_t>(port ^ (kStunMagicCookie >> 16)));
+    for (std::size_t i = 0; i < ip_len; ++i) {
+        p[4 + i] = ip[i] ^ m_buf[4 + i];
+    }
+}
+
+void StunWriter::addErrorCode(int code, const char *reason)
+{
+    std::size_t reason_len = std::strlen(reason);
+    uint8_t *p = reserve(kStunAttrErrorCode, 4 + reason_len);
+    if (!p) {
+        return;
+    }
+    p[0] = 0;
+    p[1] = 0;
+    p[2] = static_cast<uint8_t>(code / 100);
+    p[3] = static_cast<uint8_t>(code % 100);
+    std::memcpy(p + 4, reason, reason_len);
+}
+
+uint8_t *StunWriter::reserveIntegrity()
+{
+    return reserve(kStunAttrMessageIntegrity, kStunIntegritySize);
+}
+
+void StunWriter::addFingerprint()
+{
+    uint8_t *p = reserve(kStunAttrFingerprint, 4);
+    if (p) {
+        rtpWrite32(p, stunCrc32(m_buf, m_size - 8) ^ kFingerprintXor);
+    }
+}
+
+std::size_t buildStunBindingResponse(const StunHeader &req,
+                                     const sockaddr *from,
+                                     uint8_t *out,
+                                     std::size_t cap,
+                                     bool fingerprint)
+{
+    StunWriter writer(out, cap);
+    writer.begin(kStunBindingResponse, req.transaction_id);
+    writer.addXorAddress(kStunAttrXorMappedAddress, from);
+    if (fingerprint) {
+        writer.addFingerprint();
+    }
+    return writer.ok() ? writer.size() : 0;
+}
@@ -0,0 +1,141 @@
+#ifndef _STUN_MESSAGE_H_
+#define _STUN_MESSAGE_H_
+
+#include <sys/socket.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief STUN (RFC 5389) / TURN (RFC 5766) 消息的解析与组包, 只读写调用方给的缓冲, 不分配内存
+ */
+
+const std::size_t kStunHeaderSize = 20;
+const std::size_t kStunIntegritySize = 20; // HMAC-SHA1
+const uint32_t kStunMagicCookie = 0x2112A442;
+
+enum StunMessageType {
+    kStunBindingRequest = 0x0001,
+    kStunBindingIndication = 0x0011,
+    kStunBindingResponse = 0x0101,
+    kStunAllocateRequest = 0x0003,
+    kStunRefreshRequest = 0x0004,
+    kStunSendIndication = 0x0016,
+    kStunDataIndication = 0x0017,
+    kStunCreatePermissionRequest = 0x0008,
+    kStunChannelBindRequest = 0x0009,
+};
+
+enum StunAttribute {
+    kStunAttrUsername = 0x0006,
+    kStunAttrMessageIntegrity = 0x0008,
+    kStunAttrErrorCode = 0x0009,
+    kStunAttrChannelNumber = 0x000C,
+    kStunAttrLifetime = 0x000D,
+    kStunAttrXorPeerAddress = 0x0012,
+    kStunAttrData = 0x0013,
+    kStunAttrRealm = 0x0014,
+    kStunAttrNonce = 0x0015,
+    kStunAttrXorRelayedAddress = 0x0016,
+    kStunAttrRequestedTransport = 0x0019,
+    kStunAttrXorMappedAddress = 0x0020,
+    kStunAttrFingerprint = 0x8028,
+};
+
+// 请求类型对应的成功 / 错误响应类型
+inline uint16_t stunSuccessType(uint16_t request)
+{
+    return static_cast<uint16_t>((request & 0x3EEF) | 0x0100);
+}
+
+inline uint16_t stunErrorType(uint16_t request)
+{
+    return static_cast<uint16_t>((request & 0x3EEF) | 0x0110);
+}
+
+struct StunHeader {
+    uint16_t type;
+    uint16_t length;               // 属性部分的长度
+    const uint8_t *transaction_id; // 12 字节, 指向原消息
+    const uint8_t *integrity;      // MESSAGE-INTEGRITY 属性的值, 没有时为 nullptr
+    const uint8_t *fingerprint;    // FINGERPRINT 属性的值, 没有时为 nullptr
+};
+
+// 只接受带 magic cookie 的 RFC 5389 消息; 检查属性边界并定位 MESSAGE-INTEGRITY / FINGERPRINT
+bool parseStunHeader(const uint8_t *data, std::size_t size, StunHeader &hdr);
+
+// 遍历属性: prev 为 nullptr 时返回第一个, 否则返回 prev 之后的一个; 结束时返回 nullptr
+// 有 MESSAGE-INTEGRITY 时遍历到它为止, 之后的属性被忽略
+const uint8_t *nextStunAttribute(const uint8_t *data,
+                                 const StunHeader &hdr,
+                                 const uint8_t *prev,
+                                 uint16_t &type,
+                                 uint16_t &len);
+
+// 返回第一个 type 属性的值, 范围同 nextStunAttribute
+const uint8_t *findStunAttribute(const uint8_t *data, const StunHeader &hdr, uint16_t type, uint16_t &len);
+
+// 解析 XOR-*-ADDRESS 属性值, data 为整个消息 (用到 cookie 和事务 id)
+bool readStunXorAddress(const uint8_t *data,
+                        const uint8_t *value,
+                        uint16_t len,
+                        sockaddr_storage &addr,
+                        socklen_t &addr_len);
+
+// FINGERPRINT 用的 CRC-32 (与 zlib 相同的多项式)
+uint32_t stunCrc32(const uint8_t *data, std::size_t size);
+
+// 消息带 FINGERPRINT 时校验它, 不带时返回 true
+bool checkStunFingerprint(const uint8_t *data, const StunHeader &hdr);
+
+/**
+ * @brief 在调用方的缓冲里组 STUN 消息, 空间不够时后续写入都失败, ok() 返回 false
+ */
+class StunWriter
+{
+public:
+    StunWriter(uint8_t *buf, std::size_t cap);
+
+    void begin(uint16_t type, const uint8_t *transaction_id);
+    void addAttribute(uint16_t type, const void *value, std::size_t len);
+    void addU32(uint16_t type, uint32_t value);
+    void addXorAddress(uint16_t type, const sockaddr *addr);
+    void addErrorCode(int code, const char *reason);
+
+    // 预留 MESSAGE-INTEGRITY 并把头里的长度改成包含它, 返回 HMAC 的写入位置;
+    // HMAC 覆盖 [0, size() - kStunIntegritySize - 4)
+    uint8_t *reserveIntegrity();
+    void addFingerprint();
+
+    const uint8_t *data() const
+    {
+        return m_buf;
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+private:
+    uint8_t *reserve(uint16_t type, std::size_t len);
+
+private:
+    uint8_t *m_buf;
+    std::size_t m_cap;
+    std::size_t m_size;
+    bool m_ok;
+};
+
+// 按请求和对端地址写 Binding 成功响应 (XOR-MAPPED-ADDRESS [+ FINGERPRINT]), 返回长度, 空间不够返回 0
+std::size_t buildStunBindingResponse(const StunHeader &req,
+                                     const sockaddr *from,
+                                     uint8_t *out,
+                                     std::size_t cap,
+                                     bool fingerprint);
+
+#endif // _STUN_MESSAGE_H_
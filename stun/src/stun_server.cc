@@ -0,0 +1,159 @@
+#include "stun_server.h"
+#include "stun_message.h"
+#include <poll.h>
+#include <pthread.h>
+#include <algorithm>
+#include <cstring>
+
+// 没有请求时多久检查一次是否要退出
+static const int kPollTimeoutMs = 100;
+// 一次唤醒最多连续收多少轮, 之后先把响应发出去
+static const int kMaxRecvRounds = 16;
+// XOR-MAPPED-ADDRESS (IPv6) + FINGERPRINT 的响应
+static const std::size_t kMaxResponse = 64;
+
+StunServer::StunServer() :
+    StunServer(Config())
+{
+}
+
+StunServer::StunServer(const Config &cfg) :
+    m_cfg(cfg),
+    m_running(false)
+{
+    if (m_cfg.threads == 0) {
+        m_cfg.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+StunServer::~StunServer()
+{
+    stop();
+}
+
+bool StunServer::start()
+{
+    if (m_running.load()) {
+        return true;
+    }
+    uint16_t port = m_cfg.port;
+    for (std::size_t i = 0; i < m_cfg.threads; ++i) {
+        std::unique_ptr<Worker> worker(new Worker());
+        // 响应目的地址各不相同, GSO / GRO 合并不了, 关掉 offload 保持逐包批量收发
+        worker->socket.reset(new UdpBatchSocket(m_cfg.batch, kRtpMaxPacket, false));
+        if (!worker->socket->open(m_cfg.ip, port, true)) {
+            m_workers.clear();
+            return false;
+        }
+        // 端口为 0 时, 后面的线程复用第一个 socket 分到的端口
+        port = worker->socket->localPort();
+        worker->requests.store(0);
+        worker->responses.store(0);
+        worker->invalid.store(0);
+        worker->bad_fingerprint.store(0);
+        m_workers.push_back(std::move(worker));
+    }
+    m_running.store(true);
+    unsigned cpus = std::thread::hardware_concurrency();
+    for (std::size_t i = 0; i < m_workers.size(); ++i) {
+        Worker &worker = *m_workers[i];
+        worker.thread = std::thread([this, &worker]() {
+            run(worker);
+        });
+        if (m_cfg.pin_cpu && cpus > 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % cpus, &set);
+            pthread_setaffinity_np(worker.thread.native_handle(), sizeof(set), &set);
+        }
+    }
+    return true;
+}
+
+void StunServer::stop()
+{
+    m_running.store(false);
+    for (auto &worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    m_workers.clear();
+}
+
+uint16_t StunServer::port() const
+{
+    return m_workers.empty() ? 0 : m_workers[0]->socket->localPort();
+}
+
+StunServer::Stats StunServer::stats() const
+{
+    Stats total;
+    std::memset(&total, 0, sizeof(total));
+    for (auto &worker : m_workers) {
+        total.requests += worker->requests.load(std::memory_order_relaxed);
+        total.responses += worker->responses.load(std::memory_order_relaxed);
+        total.invalid += worker->invalid.load(std::memory_order_relaxed);
+        total.bad_fingerprint += worker->bad_fingerprint.load(std::memory_order_relaxed);
+        UdpBatchSocket::Stats s = worker->socket->stats();
+        total.recv_calls += s.recv_calls;
+        total.send_calls += s.send_calls;
+    }
+    return total;
+}
+
+void StunServer::run(Worker &worker)
+{
+    UdpBatchSocket &socket = *worker.socket;
+    pollfd pfd;
+    pfd.fd = socket.fd();
+    pfd.events = POLLIN;
+    uint8_t response[kMaxResponse];
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t invalid = 0;
+    uint64_t bad_fingerprint = 0;
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        if (poll(&pfd, 1, kPollTimeoutMs) <= 0) {
+            continue;
+        }
+        for (int round = 0; round < kMaxRecvRounds; ++round) {
+            int count = socket.recv();
+            if (count == 0) {
+                break;
+            }
+            for (int i = 0; i < count; ++i) {
+                const UdpBatchSocket::Datagram &d = socket.datagram(i);
+                StunHeader hdr;
+                if (!parseStunHeader(d.data, d.size, hdr)) {
+                    ++invalid;
+                    continue;
+                }
+                if (hdr.type != kStunBindingRequest) {
+                    // Binding Indication 只用于保活, 不需要响应
+                    if (hdr.type != kStunBindingIndication) {
+                        ++invalid;
+                    }
+                    continue;
+                }
+                ++requests;
+                if (m_cfg.check_fingerprint && !checkStunFingerprint(d.data, hdr)) {
+                    ++bad_fingerprint;
+                    continue;
+                }
+                std::size_t size = buildStunBindingResponse(hdr, d.addr, response, sizeof(response),
+                                                            m_cfg.fingerprint);
+                if (size > 0 && socket.queue(d.addr, d.addr_len, response, size)) {
+                    ++responses;
+                }
+            }
+        }
+        socket.flush();
+        // 每批更新一次计数, 避免每个包都做原子操作
+        worker.requests.store(requests, std::memory_order_relaxed);
+        worker.responses.store(responses, std::memory_order_relaxed);
+        worker.invalid.store(invalid, std::memory_order_relaxed);
+        worker.bad_fingerprint.store(bad_fingerprint, std::memory_order_relaxed);
+    }
+}
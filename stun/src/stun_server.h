@@ -0,0 +1,74 @@
+#ifndef _STUN_SERVER_H_
+#define _STUN_SERVER_H_
+
+#include "udp_batch_socket.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief STUN Binding 服务器
+ *
+ * 每个工作线程一个绑定到同一端口的 SO_REUSEPORT socket, 由内核按四元组把客户端
+ * 分到各线程; 线程用 recvmmsg 批量收请求, 在栈上组响应后排进 sendmmsg 批次,
+ * 收完一轮统一发出, 稳态下不分配内存
+ */
+class StunServer
+{
+public:
+    struct Config {
+        std::string ip;              // 为空时监听 0.0.0.0
+        uint16_t port = 3478;
+        std::size_t threads = 0;     // 0 时每个核一个
+        std::size_t batch = 64;
+        bool pin_cpu = true;         // 第 i 个线程绑到第 i 个核
+        bool check_fingerprint = false; // 请求带 FINGERPRINT 时校验, 不对就丢弃
+        bool fingerprint = true;     // 响应带 FINGERPRINT
+    };
+
+    struct Stats {
+        uint64_t requests;
+        uint64_t responses;
+        uint64_t invalid;          // 不是 STUN 或不是 Binding 请求
+        uint64_t bad_fingerprint;
+        uint64_t recv_calls;
+        uint64_t send_calls;
+    };
+
+    StunServer();
+    explicit StunServer(const Config &cfg);
+    ~StunServer();
+
+    StunServer(const StunServer &) = delete;
+    StunServer &operator=(const StunServer &) = delete;
+
+    bool start();
+    void stop();
+
+    // 实际监听的端口 (配置为 0 时由系统分配)
+    uint16_t port() const;
+
+    Stats stats() const;
+
+private:
+    struct Worker {
+        std::unique_ptr<UdpBatchSocket> socket;
+        std::thread thread;
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> responses;
+        std::atomic<uint64_t> invalid;
+        std::atomic<uint64_t> bad_fingerprint;
+    };
+
+    void run(Worker &worker);
+
+private:
+    Config m_cfg;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_running;
+};
+
+#endif // _STUN_SERVER_H_
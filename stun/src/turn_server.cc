@@ -0,0 +1,778 @@
+#include "turn_server.h"
+#include <arpa/inet.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+// RFC 5766 8 / 11
+static const uint64_t kPermissionMs = 300 * 1000;
+static const uint64_t kChannelMs = 600 * 1000;
+static const uint16_t kChannelMin = 0x4000;
+static const uint16_t kChannelMax = 0x7FFF;
+static const uint8_t kTransportUdp = 17;
+
+static const int kMaxEvents = 64;
+static const int kWaitMs = 100;
+static const int kMaxRecvRounds = 16;
+static const uint64_t kSweepMs = 1000;
+// 控制消息和 Data indication 在栈上组包
+static const std::size_t kMaxMessage = kRtpMaxPacket + 64;
+// 签发时间 8 位 + HMAC 前 12 字节 24 位, 都是十六进制
+static const std::size_t kNonceStampSize = 8;
+static const std::size_t kNonceMacSize = 12;
+static const std::size_t kNonceSize = kNonceStampSize + kNonceMacSize * 2;
+
+// HMAC-SHA1, 覆盖 msg 的前 size 字节 (头里的长度要事先改好)
+static bool hmacSha1(const uint8_t *key, const uint8_t *msg, std::size_t size, uint8_t *out)
+{
+    unsigned int len = 0;
+    return HMAC(EVP_sha1(), key, 16, msg, size, out, &len) != nullptr && len == kStunIntegritySize;
+}
+
+static bool checkIntegrity(const uint8_t *data, const StunHeader &hdr, const uint8_t *key)
+{
+    // 覆盖 MESSAGE-INTEGRITY 之前的内容, 但头里的长度要算到 MESSAGE-INTEGRITY 结束为止
+    std::size_t covered = static_cast<std::size_t>(hdr.integrity - 4 - data);
+    uint8_t buf[kMaxMessage];
+    if (covered > sizeof(buf)) {
+        return false;
+    }
+    std::memcpy(buf, data, covered);
+    rtpWrite16(buf + 2, static_cast<uint16_t>(covered + 4 + kStunIntegritySize - kStunHeaderSize));
+    uint8_t mac[kStunIntegritySize];
+    return hmacSha1(key, buf, covered, mac) && CRYPTO_memcmp(mac, hdr.integrity, sizeof(mac)) == 0;
+}
+
+TurnServer::TurnServer() :
+    TurnServer(Config())
+{
+}
+
+TurnServer::TurnServer(const Config &cfg) :
+    m_cfg(cfg),
+    m_epoll_fd(-1),
+    m_running(false),
+    m_rng(std::random_device()()),
+    m_requests(0),
+    m_auth_failures(0),
+    m_channel_data(0),
+    m_send_indications(0),
+    m_data_indications(0),
+    m_no_permission(0)
+{
+    if (m_cfg.relay_ip.empty()) {
+        m_cfg.relay_ip = m_cfg.ip.empty() ? "127.0.0.1" : m_cfg.ip;
+    }
+}
+
+TurnServer::~TurnServer()
+{
+    stop();
+}
+
+bool TurnServer::start()
+{
+    if (m_running.load()) {
+        return true;
+    }
+    // 长期凭据的 key = MD5(username:realm:password)
+    m_keys.clear();
+    for (auto &user : m_cfg.users) {
+        std::string s = user.first + ":" + m_cfg.realm + ":" + user.second;
+        std::vector<uint8_t> key(16);
+        unsigned int len = 0;
+        EVP_Digest(s.data(), s.size(), key.data(), &len, EVP_md5(), nullptr);
+        m_keys[user.first] = key;
+    }
+    if (RAND_bytes(m_nonce_key, sizeof(m_nonce_key)) != 1) {
+        return false;
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        return false;
+    }
+    m_socket.reset(new UdpBatchSocket());
+    if (!m_socket->open(m_cfg.ip, m_cfg.port)) {
+        stop();
+        return false;
+    }
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_socket->fd(), &ev);
+    m_dirty.reserve(m_cfg.max_allocations);
+
+    m_running.store(true);
+    m_thread = std::thread([this]() {
+        run();
+    });
+    return true;
+}
+
+void TurnServer::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_allocations.clear();
+    m_dirty.clear();
+    m_retired.clear();
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    m_socket.reset();
+}
+
+uint16_t TurnServer::port() const
+{
+    return m_socket ? m_socket->localPort() : 0;
+}
+
+TurnServer::Stats TurnServer::stats() const
+{
+    Stats s;
+    s.allocations = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        s.allocations = m_allocations.size();
+    }
+    s.requests = m_requests.load(std::memory_order_relaxed);
+    s.auth_failures = m_auth_failures.load(std::memory_order_relaxed);
+    s.channel_data = m_channel_data.load(std::memory_order_relaxed);
+    s.send_indications = m_send_indications.load(std::memory_order_relaxed);
+    s.data_indications = m_data_indications.load(std::memory_order_relaxed);
+    s.no_permission = m_no_permission.load(std::memory_order_relaxed);
+    return s;
+}
+
+std::size_t TurnServer::allocations(std::vector<AllocationStats> &out)
+{
+    out.clear();
+    uint64_t now = nowMs();
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (auto &it : m_allocations) {
+        const Allocation &alloc = *it.second;
+        AllocationStats s;
+        char ip[INET6_ADDRSTRLEN] = {0};
+        uint16_t port;
+        if (alloc.client.ss_family == AF_INET) {
+            const auto *v4 = reinterpret_cast<const sockaddr_in *>(&alloc.client);
+            inet_ntop(AF_INET, &v4->sin_addr, ip, sizeof(ip));
+            port = ntohs(v4->sin_port);
+        }
+        else {
+            const auto *v6 = reinterpret_cast<const sockaddr_in6 *>(&alloc.client);
+            inet_ntop(AF_INET6, &v6->sin6_addr, ip, sizeof(ip));
+            port = ntohs(v6->sin6_port);
+        }
+        s.client = std::string(ip) + ":" + std::to_string(port);
+        s.relay_port = alloc.relay->localPort();
+        s.lifetime_left = alloc.expire_ms > now ? static_cast<uint32_t>((alloc.expire_ms - now) / 1000) : 0;
+        s.permissions = alloc.permissions.size();
+        s.channels = alloc.channels.size();
+        s.packets_to_peer = alloc.packets_to_peer.load(std::memory_order_relaxed);
+        s.bytes_to_peer = alloc.bytes_to_peer.load(std::memory_order_relaxed);
+        s.packets_to_client = alloc.packets_to_client.load(std::memory_order_relaxed);
+        s.bytes_to_client = alloc.bytes_to_client.load(std::memory_order_relaxed);
+        out.push_back(s);
+    }
+    return out.size();
+}
+
+void TurnServer::run()
+{
+    epoll_event events[kMaxEvents];
+    uint64_t next_sweep = nowMs() + kSweepMs;
+    while (m_running.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(m_epoll_fd, events, kMaxEvents, kWaitMs);
+        uint64_t now = nowMs();
+        std::lock_guard<std::mutex> lock(m_mtx);
+        for (int i = 0; i < n; ++i) {
+            auto *alloc = static_cast<Allocation *>(events[i].data.ptr);
+            UdpBatchSocket &socket = alloc ? *alloc->relay : *m_socket;
+            for (int round = 0; round < kMaxRecvRounds; ++round) {
+                int count = socket.recv();
+                if (count == 0) {
+                    break;
+                }
+                for (int k = 0; k < count; ++k) {
+                    if (alloc) {
+                        onRelayPacket(*alloc, socket.datagram(k), now);
+                    }
+                    else {
+                        onClientPacket(socket.datagram(k), now);
+                    }
+                }
+            }
+        }
+        // 发往客户端的都在主 socket 上, 发往对端的在各自的中继 socket 上
+        m_socket->flush();
+        for (Allocation *alloc : m_dirty) {
+            alloc->dirty = false;
+            alloc->relay->flush();
+        }
+        m_dirty.clear();
+        m_retired.clear();
+        // 删除只在这里做, 保证上面处理事件时 allocation 指针都有效
+        if (now >= next_sweep) {
+            sweep(now);
+            next_sweep = now + kSweepMs;
+        }
+    }
+}
+
+void TurnServer::onClientPacket(const UdpBatchSocket::Datagram &d, uint64_t now_ms)
+{
+    // ChannelData 的前两位是 01, STUN 的是 00 (RFC 5766 11)
+    if (d.size >= 4 && (d.data[0] & 0xC0) == 0x40) {
+        auto it = m_allocations.find(addrKey(d.addr, true));
+        if (it != m_allocations.end() && it->second->expire_ms > now_ms) {
+            onChannelData(*it->second, d, now_ms);
+        }
+        return;
+    }
+    onStunMessage(d, now_ms);
+}
+
+void TurnServer::onChannelData(Allocation &alloc, const UdpBatchSocket::Datagram &d, uint64_t now_ms)
+{
+    uint16_t number = rtpRead16(d.data);
+    std::size_t len = rtpRead16(d.data + 2);
+    if (4 + len > d.size) {
+        return;
+    }
+    auto it = alloc.channels.find(number);
+    if (it == alloc.channels.end() || it->second.expire_ms <= now_ms) {
+        return;
+    }
+    m_channel_data.fetch_add(1, std::memory_order_relaxed);
+    const Channel &channel = it->second;
+    if (alloc.relay->queue(reinterpret_cast<const sockaddr *>(&channel.peer), channel.peer_len, d.data + 4, len)) {
+        alloc.packets_to_peer.fetch_add(1, std::memory_order_relaxed);
+        alloc.bytes_to_peer.fetch_add(len, std::memory_order_relaxed);
+    }
+    if (!alloc.dirty) {
+        alloc.dirty = true;
+        m_dirty.push_back(&alloc);
+    }
+}
+
+void TurnServer::onRelayPacket(Allocation &alloc, const UdpBatchSocket::Datagram &d, uint64_t now_ms)
+{
+    if (alloc.expire_ms <= now_ms) {
+        return;
+    }
+    if (!hasPermission(alloc, d.addr, now_ms)) {
+        m_no_permission.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const sockaddr *client = reinterpret_cast<const sockaddr *>(&alloc.client);
+    bool queued;
+    auto it = alloc.channel_by_peer.find(addrKey(d.addr, true));
+    auto ch = it != alloc.channel_by_peer.end() ? alloc.channels.find(it->second) : alloc.channels.end();
+    if (ch != alloc.channels.end() && ch->second.expire_ms > now_ms) {
+        // 绑定了通道: 加 4 字节 ChannelData 头后直接排进发送批次
+        uint8_t head[4];
+        rtpWrite16(head, it->second);
+        rtpWrite16(head + 2, static_cast<uint16_t>(d.size));
+        queued = m_socket->queue(client, alloc.client_len, head, sizeof(head), d.data, d.size);
+    }
+    else {
+        uint8_t buf[kMaxMessage];
+        uint8_t tid[12];
+        for (int i = 0; i < 12; i += 4) {
+            uint32_t r = m_rng();
+            std::memcpy(tid + i, &r, 4);
+        }
+        StunWriter writer(buf, sizeof(buf));
+        writer.begin(kStunDataIndication, tid);
+        writer.addXorAddress(kStunAttrXorPeerAddress, d.addr);
+        writer.addAttribute(kStunAttrData, d.data, d.size);
+        queued = writer.ok() && m_socket->queue(client, alloc.client_len, writer.data(), writer.size());
+        m_data_indications.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (queued) {
+        alloc.packets_to_client.fetch_add(1, std::memory_order_relaxed);
+        alloc.bytes_to_client.fetch_add(d.size, std::memory_order_relaxed);
+    }
+}
+
+void TurnServer::onStunMessage(const UdpBatchSocket::Datagram &d, uint64_t now_ms)
+{
+    StunHeader hdr;
+    if (!parseStunHeader(d.data, d.size, hdr)) {
+        return;
+    }
+    if (hdr.type == kStunBindingRequest) {
+        uint8_t buf[64];
+        std::size_t size = buildStunBindingResponse(hdr, d.addr, buf, sizeof(buf), true);
+        if (size > 0) {
+            m_socket->queue(d.addr, d.addr_len, buf, size);
+        }
+        return;
+    }
+    if (hdr.type == kStunAllocateRequest) {
+        m_requests.fetch_add(1, std::memory_order_relaxed);
+        handleAllocate(d, hdr, now_ms);
+        return;
+    }
+
+    auto it = m_allocations.find(addrKey(d.addr, true));
+    Allocation *alloc = (it != m_allocations.end() && it->second->expire_ms > now_ms) ? it->second.get() : nullptr;
+    if (hdr.type == kStunSendIndication) {
+        if (alloc) {
+            handleSend(*alloc, d, hdr, now_ms);
+        }
+        return;
+    }
+    // 其余只处理请求
+    if ((hdr.type & 0x0110) != 0) {
+        return;
+    }
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+    if (hdr.type != kStunRefreshRequest && hdr.type != kStunCreatePermissionRequest
+        && hdr.type != kStunChannelBindRequest) {
+        sendError(d, hdr, 400, "Bad Request", false);
+        return;
+    }
+    if (!alloc) {
+        sendError(d, hdr, 437, "Allocation Mismatch", false);
+        return;
+    }
+    if (!authenticate(d, hdr, alloc->key, now_ms)) {
+        return;
+    }
+    if (hdr.type == kStunRefreshRequest) {
+        handleRefresh(*alloc, d, hdr, now_ms);
+    }
+    else if (hdr.type == kStunCreatePermissionRequest) {
+        handleCreatePermission(*alloc, d, hdr, now_ms);
+    }
+    else {
+        handleChannelBind(*alloc, d, hdr, now_ms);
+    }
+}
+
+void TurnServer::handleAllocate(const UdpBatchSocket::Datagram &d, const StunHeader &hdr, uint64_t now_ms)
+{
+    std::string username;
+    const uint8_t *key = userKey(d.data, hdr, username);
+    if (!hdr.integrity) {
+        // 第一次请求不带凭据, 回 401 告诉客户端 realm 和 nonce
+        sendError(d, hdr, 401, "Unauthorized", true);
+        return;
+    }
+    if (!key) {
+        m_auth_failures.fetch_add(1, std::memory_order_relaxed);
+        sendError(d, hdr, 401, "Unauthorized", true);
+        return;
+    }
+    if (!authenticate(d, hdr, key, now_ms)) {
+        return;
+    }
+
+    AddrKey client_key = addrKey(d.addr, true);
+    auto it = m_allocations.find(client_key);
+    if (it != m_allocations.end() && it->second->expire_ms > now_ms) {
+        Allocation &alloc = *it->second;
+        if (std::memcmp(alloc.allocate_tid, hdr.transaction_id, 12) != 0) {
+            sendError(d, hdr, 437, "Allocation Mismatch", false);
+            return;
+        }
+    }
+    else {
+        uint16_t len;
+        const uint8_t *transport = findStunAttribute(d.data, hdr, kStunAttrRequestedTransport, len);
+        if (!transport || len != 4) {
+            sendError(d, hdr, 400, "Bad Request", false);
+            return;
+        }
+        if (transport[0] != kTransportUdp) {
+            sendError(d, hdr, 442, "Unsupported Transport Protocol", false);
+            return;
+        }
+        if (it == m_allocations.end() && m_allocations.size() >= m_cfg.max_allocations) {
+            sendError(d, hdr, 486, "Allocation Quota Reached", false);
+            return;
+        }
+
+        AllocationSptr alloc = std::make_shared<Allocation>();
+        alloc->relay.reset(new UdpBatchSocket(m_cfg.relay_batch, kRtpMaxPacket, false));
+        if (!alloc->relay->open(m_cfg.relay_ip, 0)) {
+            sendError(d, hdr, 508, "Insufficient Capacity", false);
+            return;
+        }
+        alloc->client_key = client_key;
+        std::memcpy(&alloc->client, d.addr, d.addr_len);
+        alloc->client_len = d.addr_len;
+        alloc->username = username;
+        std::memcpy(alloc->key, key, 16);
+        std::memcpy(alloc->allocate_tid, hdr.transaction_id, 12);
+        std::memset(&alloc->relay_addr, 0, sizeof(alloc->relay_addr));
+        auto *v4 = reinterpret_cast<sockaddr_in *>(&alloc->relay_addr);
+        auto *v6 = reinterpret_cast<sockaddr_in6 *>(&alloc->relay_addr);
+        if (inet_pton(AF_INET, m_cfg.relay_ip.c_str(), &v4->sin_addr) == 1) {
+            v4->sin_family = AF_INET;
+            v4->sin_port = htons(alloc->relay->localPort());
+        }
+        else {
+            inet_pton(AF_INET6, m_cfg.relay_ip.c_str(), &v6->sin6_addr);
+            v6->sin6_family = AF_INET6;
+            v6->sin6_port = htons(alloc->relay->localPort());
+        }
+        alloc->dirty = false;
+        alloc->packets_to_peer.store(0);
+        alloc->bytes_to_peer.store(0);
+        alloc->packets_to_client.store(0);
+        alloc->bytes_to_client.store(0);
+
+        uint32_t lifetime = m_cfg.default_lifetime;
+        const uint8_t *requested = findStunAttribute(d.data, hdr, kStunAttrLifetime, len);
+        if (requested && len == 4) {
+            lifetime = std::min(std::max(rtpRead32(requested), m_cfg.default_lifetime), m_cfg.max_lifetime);
+        }
+        alloc->expire_ms = now_ms + lifetime * 1000ULL;
+
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = alloc.get();
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, alloc->relay->fd(), &ev);
+        // 同一客户端地址过期未清理的旧 allocation 在这里替换
+        // 本批次的事件和 m_dirty 里可能还指向它, 批次结束后再释放
+        if (it != m_allocations.end()) {
+            removeAllocation(it->second);
+            m_retired.push_back(it->second);
+        }
+        m_allocations[client_key] = alloc;
+        it = m_allocations.find(client_key);
+    }
+
+    Allocation &alloc = *it->second;
+    uint8_t buf[kMaxMessage];
+    StunWriter writer(buf, sizeof(buf));
+    writer.begin(stunSuccessType(hdr.type), hdr.transaction_id);
+    writer.addXorAddress(kStunAttrXorRelayedAddress, reinterpret_cast<const sockaddr *>(&alloc.relay_addr));
+    writer.addU32(kStunAttrLifetime, static_cast<uint32_t>((alloc.expire_ms - now_ms) / 1000));
+    writer.addXorAddress(kStunAttrXorMappedAddress, d.addr);
+    sendResponse(d, writer, alloc.key);
+}
+
+void TurnServer::handleRefresh(Allocation &alloc, const UdpBatchSocket::Datagram &d, const StunHeader &hdr,
+                               uint64_t now_ms)
+{
+    uint32_t lifetime = m_cfg.default_lifetime;
+    uint16_t len;
+    const uint8_t *requested = findStunAttribute(d.data, hdr, kStunAttrLifetime, len);
+    if (requested && len == 4) {
+        lifetime = rtpRead32(requested);
+        if (lifetime) {
+            lifetime = std::min(std::max(lifetime, m_cfg.default_lifetime), m_cfg.max_lifetime);
+        }
+    }
+    // lifetime 为 0 表示删除, 由 sweep 统一回收
+    alloc.expire_ms = lifetime ? now_ms + lifetime * 1000ULL : 0;
+
+    uint8_t buf[kMaxMessage];
+    StunWriter writer(buf, sizeof(buf));
+    writer.begin(stunSuccessType(hdr.type), hdr.transaction_id);
+    writer.addU32(kStunAttrLifetime, lifetime);
+    sendResponse(d, writer, alloc.key);
+}
+
+void TurnServer::handleCreatePermission(Allocation &alloc, const UdpBatchSocket::Datagram &d,
+                                        const StunHeader &hdr, uint64_t now_ms)
+{
+    // 一个请求可以带多个 XOR-PEER-ADDRESS, 先全部检查再安装
+    std::size_t peers = 0;
+    uint16_t type, len;
+    for (const uint8_t *v = nextStunAttribute(d.data, hdr, nullptr, type, len); v;
+         v = nextStunAttribute(d.data, hdr, v, type, len)) {
+        if (type != kStunAttrXorPeerAddress) {
+            continue;
+        }
+        sockaddr_storage peer;
+        socklen_t peer_len;
+        if (!readStunXorAddress(d.data, v, len, peer, peer_len)) {
+            sendError(d, hdr, 400, "Bad Request", false);
+            return;
+        }
+        if (peer.ss_family != alloc.relay_addr.ss_family) {
+            sendError(d, hdr, 443, "Peer Address Family Mismatch", false);
+            return;
+        }
+        ++peers;
+    }
+    if (peers == 0) {
+        sendError(d, hdr, 400, "Bad Request", false);
+        return;
+    }
+    for (const uint8_t *v = nextStunAttribute(d.data, hdr, nullptr, type, len); v;
+         v = nextStunAttribute(d.data, hdr, v, type, len)) {
+        sockaddr_storage peer;
+        socklen_t peer_len;
+        if (type == kStunAttrXorPeerAddress && readStunXorAddress(d.data, v, len, peer, peer_len)) {
+            alloc.permissions[addrKey(reinterpret_cast<const sockaddr *>(&peer), false)] = now_ms + kPermissionMs;
+        }
+    }
+
+    uint8_t buf[kMaxMessage];
+    StunWriter writer(buf, sizeof(buf));
+    writer.begin(stunSuccessType(hdr.type), hdr.transaction_id);
+    sendResponse(d, writer, alloc.key);
+}
+
+void TurnServer::handleChannelBind(Allocation &alloc, const UdpBatchSocket::Datagram &d, const StunHeader &hdr,
+                                   uint64_t now_ms)
+{
+    uint16_t len;
+    const uint8_t *number_attr = findStunAttribute(d.data, hdr, kStunAttrChannelNumber, len);
+    uint16_t number = (number_attr && len == 4) ? rtpRead16(number_attr) : 0;
+    const uint8_t *peer_attr = findStunAttribute(d.data, hdr, kStunAttrXorPeerAddress, len);
+    sockaddr_storage peer;
+    socklen_t peer_len;
+    if (number < kChannelMin || number > kChannelMax || !peer_attr
+        || !readStunXorAddress(d.data, peer_attr, len, peer, peer_len)) {
+        sendError(d, hdr, 400, "Bad Request", false);
+        return;
+    }
+    if (peer.ss_family != alloc.relay_addr.ss_family) {
+        sendError(d, hdr, 443, "Peer Address Family Mismatch", false);
+        return;
+    }
+    // 通道号和对端地址必须一一对应
+    const sockaddr *peer_sa = reinterpret_cast<const sockaddr *>(&peer);
+    AddrKey peer_key = addrKey(peer_sa, true);
+    auto by_number = alloc.channels.find(number);
+    if (by_number != alloc.channels.end()
+        && !(addrKey(reinterpret_cast<const sockaddr *>(&by_number->second.peer), true) == peer_key)) {
+        sendError(d, hdr, 400, "Bad Request", false);
+        return;
+    }
+    auto by_peer = alloc.channel_by_peer.find(peer_key);
+    if (by_peer != alloc.channel_by_peer.end() && by_peer->second != number) {
+        sendError(d, hdr, 400, "Bad Request", false);
+        return;
+    }
+
+    Channel &channel = alloc.channels[number];
+    std::memcpy(&channel.peer, &peer, peer_len);
+    channel.peer_len = peer_len;
+    channel.expire_ms = now_ms + kChannelMs;
+    alloc.channel_by_peer[peer_key] = number;
+    alloc.permissions[addrKey(peer_sa, false)] = now_ms + kPermissionMs;
+
+    uint8_t buf[kMaxMessage];
+    StunWriter writer(buf, sizeof(buf));
+    writer.begin(stunSuccessType(hdr.type), hdr.transaction_id);
+    sendResponse(d, writer, alloc.key);
+}
+
+void TurnServer::handleSend(Allocation &alloc, const UdpBatchSocket::Datagram &d, const StunHeader &hdr,
+                            uint64_t now_ms)
+{
+    uint16_t peer_len16, data_len;
+    const uint8_t *peer_attr = findStunAttribute(d.data, hdr, kStunAttrXorPeerAddress, peer_len16);
+    const uint8_t *data = findStunAttribute(d.data, hdr, kStunAttrData, data_len);
+    sockaddr_storage peer;
+    socklen_t peer_len;
+    if (!peer_attr || !data || !readStunXorAddress(d.data, peer_attr, peer_len16, peer, peer_len)) {
+        return;
+    }
+    m_send_indications.fetch_add(1, std::memory_order_relaxed);
+    const sockaddr *peer_sa = reinterpret_cast<const sockaddr *>(&peer);
+    if (!hasPermission(alloc, peer_sa, now_ms)) {
+        m_no_permission.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (alloc.relay->queue(peer_sa, peer_len, data, data_len)) {
+        alloc.packets_to_peer.fetch_add(1, std::memory_order_relaxed);
+        alloc.bytes_to_peer.fetch_add(data_len, std::memory_order_relaxed);
+    }
+    if (!alloc.dirty) {
+        alloc.dirty = true;
+        m_dirty.push_back(&alloc);
+    }
+}
+
+bool TurnServer::authenticate(const UdpBatchSocket::Datagram &d, const StunHeader &hdr, const uint8_t *key,
+                              uint64_t now_ms)
+{
+    if (!hdr.integrity) {
+        sendError(d, hdr, 401, "Unauthorized", true);
+        return false;
+    }
+    uint16_t len;
+    const uint8_t *nonce = findStunAttribute(d.data, hdr, kStunAttrNonce, len);
+    if (!nonce || !checkNonce(nonce, len, d.addr, now_ms)) {
+        sendError(d, hdr, 438, "Stale Nonce", true);
+        return false;
+    }
+    if (!checkIntegrity(d.data, hdr, key)) {
+        m_auth_failures.fetch_add(1, std::memory_order_relaxed);
+        sendError(d, hdr, 401, "Unauthorized", true);
+        return false;
+    }
+    return true;
+}
+
+void TurnServer::makeNonce(const sockaddr *client, uint32_t issued, char *out) const
+{
+    AddrKey addr = addrKey(client, true);
+    uint8_t msg[4 + sizeof(addr.ip) + 3];
+    rtpWrite32(msg, issued);
+    std::memcpy(msg + 4, addr.ip, sizeof(addr.ip));
+    std::memcpy(msg + 4 + sizeof(addr.ip), &addr.port, 2);
+    msg[sizeof(msg) - 1] = addr.family;
+    uint8_t mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+    HMAC(EVP_sha1(), m_nonce_key, sizeof(m_nonce_key), msg, sizeof(msg), mac, &mac_len);
+    static const char kHex[] = "0123456789abcdef";
+    for (std::size_t i = 0; i < kNonceStampSize; ++i) {
+        out[i] = kHex[(issued >> (28 - 4 * i)) & 0xF];
+    }
+    for (std::size_t i = 0; i < kNonceMacSize; ++i) {
+        out[kNonceStampSize + 2 * i] = kHex[mac[i] >> 4];
+        out[kNonceStampSize + 2 * i + 1] = kHex[mac[i] & 0xF];
+    }
+}
+
+bool TurnServer::checkNonce(const uint8_t *nonce, uint16_t len, const sockaddr *client, uint64_t now_ms) const
+{
+    if (len != kNonceSize) {
+        return false;
+    }
+    uint32_t issued = 0;
+    for (std::size_t i = 0; i < kNonceStampSize; ++i) {
+        uint8_t c = nonce[i];
+        uint32_t v;
+        if (c >= '0' && c <= '9') {
+            v = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            v = c - 'a' + 10;
+        }
+        else {
+            return false;
+        }
+        issued = issued << 4 | v;
+    }
+    uint32_t now = static_cast<uint32_t>(now_ms / 1000);
+    if (issued > now || now - issued > m_cfg.nonce_lifetime) {
+        return false;
+    }
+    char expected[kNonceSize];
+    makeNonce(client, issued, expected);
+    return CRYPTO_memcmp(expected, nonce, kNonceSize) == 0;
+}
+
+const uint8_t *TurnServer::userKey(const uint8_t *data, const StunHeader &hdr, std::string &username)
+{
+    uint16_t len;
+    const uint8_t *value = findStunAttribute(data, hdr, kStunAttrUsername, len);
+    if (!value) {
+        return nullptr;
+    }
+    username.assign(reinterpret_cast<const char *>(value), len);
+    auto it = m_keys.find(username);
+    return it == m_keys.end() ? nullptr : it->second.data();
+}
+
+void TurnServer::sendError(const UdpBatchSocket::Datagram &d, const StunHeader &hdr, int code, const char *reason,
+                           bool with_nonce)
+{
+    uint8_t buf[kMaxMessage];
+    StunWriter writer(buf, sizeof(buf));
+    writer.begin(stunErrorType(hdr.type), hdr.transaction_id);
+    writer.addErrorCode(code, reason);
+    if (with_nonce) {
+        char nonce[kNonceSize];
+        makeNonce(d.addr, static_cast<uint32_t>(nowMs() / 1000), nonce);
+        writer.addAttribute(kStunAttrRealm, m_cfg.realm.data(), m_cfg.realm.size());
+        writer.addAttribute(kStunAttrNonce, nonce, sizeof(nonce));
+    }
+    sendResponse(d, writer, nullptr);
+}
+
+void TurnServer::sendResponse(const UdpBatchSocket::Datagram &d, StunWriter &writer, const uint8_t *key)
+{
+    if (key) {
+        // 预留之后头里的长度已包含 MESSAGE-INTEGRITY, 直接对前面的内容算 HMAC
+        uint8_t *mac = writer.reserveIntegrity();
+        if (mac) {
+            hmacSha1(key, writer.data(), static_cast<std::size_t>(mac - 4 - writer.data()), mac);
+        }
+    }
+    writer.addFingerprint();
+    if (writer.ok()) {
+        m_socket->queue(d.addr, d.addr_len, writer.data(), writer.size());
+    }
+}
+
+bool TurnServer::hasPermission(Allocation &alloc, const sockaddr *peer, uint64_t now_ms)
+{
+    auto it = alloc.permissions.find(addrKey(peer, false));
+    return it != alloc.permissions.end() && it->second > now_ms;
+}
+
+void TurnServer::removeAllocation(const AllocationSptr &alloc)
+{
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, alloc->relay->fd(), nullptr);
+}
+
+void TurnServer::sweep(uint64_t now_ms)
+{
+    for (auto it = m_allocations.begin(); it != m_allocations.end();) {
+        Allocation &alloc = *it->second;
+        if (alloc.expire_ms <= now_ms) {
+            removeAllocation(it->second);
+            it = m_allocations.erase(it);
+            continue;
+        }
+        for (auto p = alloc.permissions.begin(); p != alloc.permissions.end();) {
+            p = p->second <= now_ms ? alloc.permissions.erase(p) : std::next(p);
+        }
+        for (auto c = alloc.channels.begin(); c != alloc.channels.end();) {
+            if (c->second.expire_ms <= now_ms) {
+                alloc.channel_by_peer.erase(addrKey(reinterpret_cast<const sockaddr *>(&c->second.peer), true));
+                c = alloc.channels.erase(c);
+            }
+            else {
+                ++c;
+            }
+        }
+        ++it;
+    }
+}
+
+TurnServer::AddrKey TurnServer::addrKey(const sockaddr *addr, bool with_port)
+{
+    AddrKey key;
+    std::memset(&key, 0, sizeof(key));
+    key.family = static_cast<uint8_t>(addr->sa_family);
+    if (addr->sa_family == AF_INET) {
+        const auto *v4 = reinterpret_cast<const sockaddr_in *>(addr);
+        std::memcpy(key.ip, &v4->sin_addr, 4);
+        key.port = with_port ? v4->sin_port : 0;
+    }
+    else if (addr->sa_family == AF_INET6) {
+        const auto *v6 = reinterpret_cast<const sockaddr_in6 *>(addr);
+        std::memcpy(key.ip, &v6->sin6_addr, 16);
+        key.port = with_port ? v6->sin6_port : 0;
+    }
+    return key;
+}
+
+uint64_t TurnServer::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
@@ -0,0 +1,190 @@
+#ifndef _TURN_SERVER_H_
+#define _TURN_SERVER_H_
+
+#include "stun_message.h"
+#include "udp_batch_socket.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief UDP TURN 中继 (RFC 5766): Allocate / Refresh / CreatePermission / ChannelBind,
+ * Send / Data indication 和 ChannelData
+ *
+ * 一个线程用 epoll 管理客户端端口和每个 allocation 的中继 socket, 都是 UdpBatchSocket;
+ * 一次唤醒里收到的包查表后直接拷进对端 socket 的发送批次, 最后统一 sendmmsg,
+ * ChannelData 转发路径上没有内存分配
+ * 认证用长期凭据 (RFC 5389 10.2), 也顺带回答 Binding 请求
+ */
+class TurnServer
+{
+public:
+    struct Config {
+        std::string ip;                 // 客户端端口监听的地址, 为空时为 0.0.0.0
+        uint16_t port = 3478;
+        std::string relay_ip;           // 中继 socket 绑定并通告的地址, 为空时用 ip, 都为空时用 127.0.0.1
+        std::string realm = "laudio";
+        std::map<std::string, std::string> users; // 用户名 -> 密码
+        uint32_t nonce_lifetime = 600;  // 秒, 过期的 nonce 回 438 并下发新的
+        uint32_t default_lifetime = 600;
+        uint32_t max_lifetime = 3600;
+        std::size_t max_allocations = 1024;
+        std::size_t relay_batch = 16;   // 每个中继 socket 的收发批次
+    };
+
+    struct Stats {
+        uint64_t allocations;      // 当前数量
+        uint64_t requests;
+        uint64_t auth_failures;
+        uint64_t channel_data;     // 客户端发来的 ChannelData
+        uint64_t send_indications;
+        uint64_t data_indications;
+        uint64_t no_permission;    // 对端没有权限被丢弃的包
+    };
+
+    // 每个 allocation 的带宽计数
+    struct AllocationStats {
+        std::string client;        // ip:port
+        uint16_t relay_port;
+        uint32_t lifetime_left;    // 秒
+        std::size_t permissions;
+        std::size_t channels;
+        uint64_t packets_to_peer;
+        uint64_t bytes_to_peer;
+        uint64_t packets_to_client;
+        uint64_t bytes_to_client;
+    };
+
+    TurnServer();
+    explicit TurnServer(const Config &cfg);
+    ~TurnServer();
+
+    TurnServer(const TurnServer &) = delete;
+    TurnServer &operator=(const TurnServer &) = delete;
+
+    bool start();
+    void stop();
+
+    uint16_t port() const;
+    Stats stats() const;
+    std::size_t allocations(std::vector<AllocationStats> &out);
+
+private:
+    // 地址做 key: 不分配内存的定长结构
+    struct AddrKey {
+        uint8_t ip[16];
+        uint16_t port;
+        uint8_t family;
+
+        bool operator==(const AddrKey &other) const
+        {
+            return family == other.family && port == other.port && std::memcmp(ip, other.ip, 16) == 0;
+        }
+    };
+
+    struct AddrKeyHash {
+        std::size_t operator()(const AddrKey &key) const
+        {
+            uint64_t a, b;
+            std::memcpy(&a, key.ip, 8);
+            std::memcpy(&b, key.ip + 8, 8);
+            uint64_t h = (a * 0x9E3779B97F4A7C15ULL) ^ (b + 0xC2B2AE3D27D4EB4FULL) ^ (key.port << 8 | key.family);
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    struct Channel {
+        sockaddr_storage peer;
+        socklen_t peer_len;
+        uint64_t expire_ms;
+    };
+
+    struct Allocation {
+        AddrKey client_key;
+        sockaddr_storage client;
+        socklen_t client_len;
+        std::string username;
+        uint8_t key[16];
+        uint8_t allocate_tid[12];  // 重传的 Allocate 请求直接回成功
+        std::unique_ptr<UdpBatchSocket> relay;
+        sockaddr_storage relay_addr;
+        uint64_t expire_ms;
+        std::unordered_map<AddrKey, uint64_t, AddrKeyHash> permissions; // 对端 ip (port 为 0) -> 过期时间
+        std::unordered_map<uint16_t, Channel> channels;
+        std::unordered_map<AddrKey, uint16_t, AddrKeyHash> channel_by_peer;
+        bool dirty;
+
+        std::atomic<uint64_t> packets_to_peer;
+        std::atomic<uint64_t> bytes_to_peer;
+        std::atomic<uint64_t> packets_to_client;
+        std::atomic<uint64_t> bytes_to_client;
+    };
+    using AllocationSptr = std::shared_ptr<Allocation>;
+
+    void run();
+    void onClientPacket(const UdpBatchSocket::Datagram &d, uint64_t now_ms);
+    void onRelayPacket(Allocation &alloc, const UdpBatchSocket::Datagram &d, uint64_t now_ms);
+    void onChannelData(Allocation &alloc, const UdpBatchSocket::Datagram &d, uint64_t now_ms);
+    void onStunMessage(const UdpBatchSocket::Datagram &d, uint64_t now_ms);
+
+    void handleAllocate(const UdpBatchSocket::Datagram &d, const StunHeader &hdr, uint64_t now_ms);
+    void handleRefresh(Allocation &alloc, const UdpBatchSocket::Datagram &d, const StunHeader &hdr,
+                       uint64_t now_ms);
+    void handleCreatePermission(Allocation &alloc, const UdpBatchSocket::Datagram &d,
+                                const StunHeader &hdr, uint64_t now_ms);
+    void handleChannelBind(Allocation &alloc, const UdpBatchSocket::Datagram &d, const StunHeader &hdr,
+                           uint64_t now_ms);
+    void handleSend(Allocation &alloc, const UdpBatchSocket::Datagram &d, const StunHeader &hdr,
+                    uint64_t now_ms);
+
+    // 校验 NONCE 和 MESSAGE-INTEGRITY; 失败时已回错误响应
+    bool authenticate(const UdpBatchSocket::Datagram &d, const StunHeader &hdr, const uint8_t *key,
+                      uint64_t now_ms);
+    // nonce = 8 位十六进制的签发时间 (秒) + HMAC(签发时间, 客户端地址) 前 12 字节的十六进制,
+    // 不用存状态; 换了源地址或超过 nonce_lifetime 都失效, 截获的请求不能从别处重放
+    void makeNonce(const sockaddr *client, uint32_t issued, char *out) const;
+    bool checkNonce(const uint8_t *nonce, uint16_t len, const sockaddr *client, uint64_t now_ms) const;
+    const uint8_t *userKey(const uint8_t *data, const StunHeader &hdr, std::string &username);
+    void sendError(const UdpBatchSocket::Datagram &d, const StunHeader &hdr, int code, const char *reason,
+                   bool with_nonce);
+    void sendResponse(const UdpBatchSocket::Datagram &d, StunWriter &writer, const uint8_t *key);
+
+    bool hasPermission(Allocation &alloc, const sockaddr *peer, uint64_t now_ms);
+    void removeAllocation(const AllocationSptr &alloc);
+    void sweep(uint64_t now_ms);
+
+    static AddrKey addrKey(const sockaddr *addr, bool with_port);
+    static uint64_t nowMs();
+
+private:
+    Config m_cfg;
+    std::unique_ptr<UdpBatchSocket> m_socket;
+    int m_epoll_fd;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    uint8_t m_nonce_key[16]; // start 时随机生成, 重启后旧 nonce 全部失效
+    std::mt19937 m_rng;      // Data indication 的事务 id, 只在收发线程使用
+    std::map<std::string, std::vector<uint8_t>> m_keys; // 用户名 -> MD5(user:realm:pass)
+
+    mutable std::mutex m_mtx; // 保护 allocation 表, 收发线程每批处理期间持有
+    std::unordered_map<AddrKey, AllocationSptr, AddrKeyHash> m_allocations;
+    std::vector<Allocation *> m_dirty;
+    std::vector<AllocationSptr> m_retired; // 批处理中被替换的 allocation, 批次结束后释放
+
+    std::atomic<uint64_t> m_requests;
+    std::atomic<uint64_t> m_auth_failures;
+    std::atomic<uint64_t> m_channel_data;
+    std::atomic<uint64_t> m_send_indications;
+    std::atomic<uint64_t> m_data_indications;
+    std::atomic<uint64_t> m_no_permission;
+};
+
+#endif // _TURN_SERVER_H_
@@ -0,0 +1,227 @@
+#include "ice_agent_mgr.h"
+#include "turn_server.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * 回环上的 TURN 端到端测试: 进程内起 TurnServer (与 turn-relay-server 同一实现),
+ * 两个 IceAgent 都经它分配 relayed 候选, 互相只 trickle typ relay 的候选, 迫使连通性检查走中继;
+ * 建连后 a 发 kMessages 条消息, b 原样回送, 检查两端选中的对端地址都是中继地址,
+ * 并且 TurnServer 的 allocation 上确实有双向转发
+ */
+
+static const int kMessages = 50;
+static const std::chrono::seconds kTimeout(15);
+
+static std::mutex g_mtx;
+static std::condition_variable g_cv;
+
+// 对端的 remote description 设置好之前收到的候选和 end-of-candidates 先缓存
+struct Peer {
+    IceAgent::Sptr agent;
+    bool ready = false;
+    bool gathering_done = false;
+    std::vector<std::string> pending;
+    int relay_candidates = 0;
+
+    void addCandidate(const char *sdp)
+    {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        ++relay_candidates;
+        if (ready) {
+            agent->addRemoteCandidate(sdp);
+        }
+        else {
+            pending.push_back(sdp);
+        }
+    }
+
+    void remoteGatheringDone()
+    {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        gathering_done = true;
+        if (ready) {
+            agent->setRemoteGatheringDone();
+        }
+    }
+
+    void setRemoteDescription(const std::string &sdp)
+    {
+        agent->setRemoteDescription(sdp);
+        std::lock_guard<std::mutex> lock(g_mtx);
+        ready = true;
+        for (auto &candidate : pending) {
+            agent->addRemoteCandidate(candidate);
+        }
+        pending.clear();
+        if (gathering_done) {
+            agent->setRemoteGatheringDone();
+        }
+    }
+};
+
+static bool connected(juice_state_t state)
+{
+    return state == JUICE_STATE_CONNECTED || state == JUICE_STATE_COMPLETED;
+}
+
+static int fail(const char *what)
+{
+    std::printf("FAIL %s\n", what);
+    return 1;
+}
+
+int main()
+{
+    TurnServer::Config turn_cfg;
+    turn_cfg.ip = "127.0.0.1";
+    turn_cfg.port = 0;
+    turn_cfg.users["test"] = "secret";
+    TurnServer turn(turn_cfg);
+    if (!turn.start()) {
+        return fail("start turn server");
+    }
+
+    IceAgentMgr::Config ice_cfg;
+    ice_cfg.turn_host = "127.0.0.1";
+    ice_cfg.turn_port = turn.port();
+    ice_cfg.turn_username = "test";
+    ice_cfg.turn_password = "secret";
+    ice_cfg.bind_address = "127.0.0.1";
+    // 每个 agent 各自的 socket 和线程, 两端不共用端口
+    ice_cfg.mux = false;
+    IceAgentMgr mgr(ice_cfg);
+
+    Peer a;
+    Peer b;
+    a.agent = mgr.createAgent();
+    b.agent = mgr.createAgent();
+    if (!a.agent || !b.agent) {
+        return fail("create agents");
+    }
+
+    juice_state_t state_a = JUICE_STATE_DISCONNECTED;
+    juice_state_t state_b = JUICE_STATE_DISCONNECTED;
+    int echoed = 0;
+    a.agent->setOnStateChanged([&](juice_state_t state) {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        state_a = state;
+        g_cv.notify_all();
+    });
+    b.agent->setOnStateChanged([&](juice_state_t state) {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        state_b = state;
+        g_cv.notify_all();
+    });
+    // 只把 relayed 候选交给对端, host / srflx 候选丢掉
+    a.agent->setOnCandidate([&](const char *sdp) {
+        if (std::strstr(sdp, " typ relay")) {
+            b.addCandidate(sdp);
+        }
+    });
+    b.agent->setOnCandidate([&](const char *sdp) {
+        if (std::strstr(sdp, " typ relay")) {
+            a.addCandidate(sdp);
+        }
+    });
+    a.agent->setOnGatheringDone([&]() {
+        b.remoteGatheringDone();
+    });
+    b.agent->setOnGatheringDone([&]() {
+        a.remoteGatheringDone();
+    });
+    b.agent->setOnRecv([&](const char *data, std::size_t size) {
+        b.agent->send(data, size);
+    });
+    a.agent->setOnRecv([&](const char *, std::size_t) {
+        std::lock_guard<std::mutex> lock(g_mtx);
+        ++echoed;
+        g_cv.notify_all();
+    });
+
+    // a 先收集成为 controlling, b 拿到 a 的 description 后收集成为 controlled
+    std::string offer = a.agent->localDescription();
+    if (!a.agent->gather()) {
+        return fail("gather a");
+    }
+    b.setRemoteDescription(offer);
+    std::string answer = b.agent->localDescription();
+    if (!b.agent->gather()) {
+        return fail("gather b");
+    }
+    a.setRemoteDescription(answer);
+
+    {
+        std::unique_lock<std::mutex> lock(g_mtx);
+        if (!g_cv.wait_for(lock, kTimeout, [&]() {
+                return (connected(state_a) && connected(state_b)) || state_a == JUICE_STATE_FAILED
+                       || state_b == JUICE_STATE_FAILED;
+            })
+            || !connected(state_a) || !connected(state_b)) {
+            return fail("ice did not connect over the relay");
+        }
+    }
+    std::printf("connected via relay in %.1f / %.1f ms, relay candidates %d / %d\n", a.agent->connectMs(),
+                b.agent->connectMs(), a.relay_candidates, b.relay_candidates);
+
+    // 两端选中的对端地址都必须是 TurnServer 的中继地址
+    std::vector<TurnServer::AllocationStats> allocations;
+    turn.allocations(allocations);
+    std::set<std::string> relays;
+    for (auto &alloc : allocations) {
+        relays.insert("127.0.0.1:" + std::to_string(alloc.relay_port));
+    }
+    std::string local, remote;
+    if (!a.agent->selectedAddresses(local, remote) || !relays.count(remote)) {
+        return fail("a did not select a relayed remote candidate");
+    }
+    std::printf("a: %s -> %s\n", local.c_str(), remote.c_str());
+    if (!b.agent->selectedAddresses(local, remote) || !relays.count(remote)) {
+        return fail("b did not select a relayed remote candidate");
+    }
+    std::printf("b: %s -> %s\n", local.c_str(), remote.c_str());
+
+    char message[32];
+    for (int i = 0; i < kMessages; ++i) {
+        int len = std::snprintf(message, sizeof(message), "relay message %d", i);
+        a.agent->send(message, static_cast<std::size_t>(len));
+    }
+    {
+        std::unique_lock<std::mutex> lock(g_mtx);
+        g_cv.wait_for(lock, kTimeout, [&]() {
+            return echoed >= kMessages;
+        });
+    }
+    // UDP 上允许个别丢包, 但回环上应当基本全部回来
+    if (echoed < kMessages * 9 / 10) {
+        return fail("echo over the relay");
+    }
+
+    turn.allocations(allocations);
+    uint64_t to_peer = 0;
+    uint64_t to_client = 0;
+    for (auto &alloc : allocations) {
+        to_peer += alloc.packets_to_peer;
+        to_client += alloc.packets_to_client;
+    }
+    std::printf("echoed %d/%d, allocations %zu, relayed %llu to peers / %llu to clients\n", echoed, kMessages,
+                allocations.size(), static_cast<unsigned long long>(to_peer),
+                static_cast<unsigned long long>(to_client));
+    if (allocations.size() < 2 || to_peer < static_cast<uint64_t>(kMessages)
+        || to_client < static_cast<uint64_t>(kMessages)) {
+        return fail("turn server did not carry the traffic");
+    }
+
+    a.agent.reset();
+    b.agent.reset();
+    turn.stop();
+    std::printf("ok\n");
+    return 0;
+}